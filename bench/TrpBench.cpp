@@ -0,0 +1,430 @@
+#include "TrpBenchAlloc.hpp"
+#include "TrpBenchFixtures.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct TrpBenchResult {
+    size_t bytes;
+    size_t iterations;
+    double parse_ms;            // per document, best of `iterations`
+    double mapped_parse_ms;     // TrpBufferParser over an mmap-ed file
+    double validate_ms;
+    double compiled_ms;
+    double tape_parse_ms;       // TrpTapeParser, warm
+    double tape_validate_ms;    // TrpTapeValidator
+    size_t parse_allocs;        // per document
+    size_t tape_parse_allocs;   // first parse of a fresh TrpTapeParser
+    size_t parse_alloc_bytes;
+    size_t validate_allocs;
+    size_t peak_rss_kb;         // whole child process
+    int valid;
+};
+
+struct TrpBenchOptions {
+    std::vector<std::string> families;
+    std::vector<size_t> sizes;          // empty: each family's default size
+    std::string fixture_dir;
+    std::string json_file;
+    std::string html_file;
+    double min_time;
+};
+
+static double now( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// "1.2KB", "64MB", "1GB" or a plain byte count, 0 when malformed
+static size_t parseSize( const std::string& str ) {
+    char* end = NULL;
+    double value = std::strtod( str.c_str(), &end );
+    std::string unit( end );
+    double scale = 1;
+
+    if ( unit == "KB" || unit == "K" ) scale = 1024.0;
+    else if ( unit == "MB" || unit == "M" ) scale = 1024.0 * 1024;
+    else if ( unit == "GB" || unit == "G" ) scale = 1024.0 * 1024 * 1024;
+    else if ( !unit.empty() && unit != "B" ) return 0;
+
+    if ( value <= 0 ) return 0;
+    return static_cast<size_t>( value * scale );
+}
+
+static std::string formatSize( size_t bytes ) {
+    std::ostringstream oss;
+    const char* units[] = { "B", "KB", "MB", "GB" };
+    double value = bytes;
+    size_t unit = 0;
+
+    while ( value >= 1024 && unit < 3 ) {
+        value /= 1024;
+        unit++;
+    }
+    oss.precision( value < 10 && unit ? 2 : 3 );
+    oss << value << units[unit];
+    return oss.str();
+}
+
+static std::vector<std::string> splitList( const std::string& list ) {
+    std::vector<std::string> items;
+    std::string item;
+    std::istringstream iss( list );
+
+    while ( std::getline( iss, item, ',' ) ) {
+        if ( !item.empty() ) items.push_back( item );
+    }
+    return items;
+}
+
+// Best-of timing. Each sample repeats `run` enough times to last at least a
+// millisecond, samples are taken until `min_time` has passed.
+template <typename Run>
+static double bestOf( Run& run, double min_time, size_t& iterations ) {
+    size_t reps = 1;
+    double sample;
+
+    for ( ;; ) {
+        sample = now();
+        for ( size_t i = 0; i < reps; i++ ) run();
+        sample = now() - sample;
+        if ( sample >= 1e-3 || reps >= (1u << 20) ) break;
+        reps *= 2;
+    }
+
+    double best = sample / reps;
+    double start = now();
+
+    iterations = reps;
+    while ( now() - start < min_time ) {
+        sample = now();
+        for ( size_t i = 0; i < reps; i++ ) run();
+        sample = (now() - sample) / reps;
+        if ( sample < best ) best = sample;
+        iterations += reps;
+    }
+    return best * 1000;
+}
+
+struct ParseRun {
+    const std::string* file;
+
+    void operator()( void ) {
+        TrpJsonParser parser( *file );
+        parser.parse();
+    }
+};
+
+struct MappedParseRun {
+    const std::string* file;
+
+    void operator()( void ) {
+        TrpBufferParser parser;
+        parser.openFile( *file );
+        parser.parse();
+    }
+};
+
+struct ValidateRun {
+    const TrpSchema* schema;
+    const TrpCompiledSchema* program;
+    ITrpJsonValue* ast;
+    bool ok;
+
+    void operator()( void ) {
+        TrpValidatorContext ctx;
+        ok = program ? program->validate( ast, ctx ) : schema->validate( ast, ctx );
+    }
+};
+
+struct TapeParseRun {
+    TrpTapeParser* parser;
+
+    void operator()( void ) {
+        parser->parse();
+    }
+};
+
+struct TapeValidateRun {
+    TrpTapeValidator* validator;
+    const TrpTape* tape;
+    bool ok;
+
+    void operator()( void ) {
+        TrpValidatorContext ctx;
+        ok = validator->validate( *tape, ctx );
+    }
+};
+
+// Runs in a forked child so ru_maxrss only covers this document
+static void measure( const TrpBenchFamily& family, const std::string& file, double min_time, TrpBenchResult& res ) {
+    size_t iterations;
+
+    ParseRun parse_run;
+    parse_run.file = &file;
+    res.parse_ms = bestOf( parse_run, min_time, iterations );
+    res.iterations = iterations;
+
+    MappedParseRun mapped_run;
+    mapped_run.file = &file;
+    res.mapped_parse_ms = bestOf( mapped_run, min_time, iterations );
+
+    TrpJsonParser parser( file );
+    size_t allocs = g_allocs, alloc_bytes = g_alloc_bytes;
+    res.valid = parser.parse();
+    res.parse_allocs = g_allocs - allocs;
+    res.parse_alloc_bytes = g_alloc_bytes - alloc_bytes;
+
+    TrpSchemaFactory factory;
+    TrpSchema& schema = family.schema( factory );
+    TrpCompiledSchema program( schema );
+
+    ValidateRun validate_run;
+    validate_run.schema = &schema;
+    validate_run.program = NULL;
+    validate_run.ast = parser.getAST();
+
+    allocs = g_allocs;
+    validate_run();
+    res.validate_allocs = g_allocs - allocs;
+    res.valid = res.valid && validate_run.ok;
+
+    res.validate_ms = bestOf( validate_run, min_time, iterations );
+    validate_run.program = &program;
+    res.compiled_ms = bestOf( validate_run, min_time, iterations );
+    res.valid = res.valid && validate_run.ok;
+
+    TrpMappedFile mapped( file );
+    TrpTapeParser tape_parser( mapped.data(), mapped.size() );
+    allocs = g_allocs;
+    res.valid = res.valid && tape_parser.parse();
+    res.tape_parse_allocs = g_allocs - allocs;
+
+    TapeParseRun tape_run;
+    tape_run.parser = &tape_parser;
+    res.tape_parse_ms = bestOf( tape_run, min_time, iterations );
+
+    TrpTapeValidator tape_validator( schema );
+    TapeValidateRun tape_validate_run;
+    tape_validate_run.validator = &tape_validator;
+    tape_validate_run.tape = &tape_parser.getTape();
+    res.tape_validate_ms = bestOf( tape_validate_run, min_time, iterations );
+    res.valid = res.valid && tape_validate_run.ok;
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    res.peak_rss_kb = usage.ru_maxrss;
+}
+
+static bool runChild( const TrpBenchFamily& family, const std::string& file, double min_time, TrpBenchResult& res ) {
+    int fds[2];
+
+    if ( pipe( fds ) ) return false;
+    std::cout.flush();
+
+    pid_t pid = fork();
+    if ( pid < 0 ) return false;
+    if ( pid == 0 ) {
+        close( fds[0] );
+        measure( family, file, min_time, res );
+        ssize_t written = write( fds[1], &res, sizeof(res) );
+        _exit( written == static_cast<ssize_t>(sizeof(res)) ? 0 : 1 );
+    }
+
+    close( fds[1] );
+    ssize_t got = read( fds[0], &res, sizeof(res) );
+    close( fds[0] );
+
+    int status = 0;
+    waitpid( pid, &status, 0 );
+    return got == static_cast<ssize_t>(sizeof(res)) && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+static std::string generateFixture( const TrpBenchFamily& family, size_t bytes, const std::string& dir ) {
+    std::string file = dir + "/" + family.name + "-" + formatSize( bytes ) + ".json";
+    struct stat st;
+
+    // generators are deterministic, an existing file is the same document
+    if ( stat( file.c_str(), &st ) == 0 ) return file;
+
+    std::ofstream out( file.c_str() );
+    family.generate( out, bytes );
+    return file;
+}
+
+static size_t fileSize( const std::string& file ) {
+    struct stat st;
+
+    if ( stat( file.c_str(), &st ) ) return 0;
+    return st.st_size;
+}
+
+struct TrpBenchRow {
+    const TrpBenchFamily* family;
+    TrpBenchResult result;
+};
+
+static void writeJson( const std::vector<TrpBenchRow>& rows, const std::string& path ) {
+    std::ofstream out( path.c_str() );
+    char date[32];
+    time_t t = time( NULL );
+
+    strftime( date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime( &t ) );
+    out << "{\n  \"generated\": \"" << date << "\",\n"
+        << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+        << "  \"results\": [";
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+        const TrpBenchResult& r = rows[i].result;
+        out << (i ? "," : "") << "\n    {"
+            << "\"family\": \"" << rows[i].family->name << "\", "
+            << "\"label\": \"" << rows[i].family->label << "\", "
+            << "\"bytes\": " << r.bytes << ", "
+            << "\"iterations\": " << r.iterations << ", "
+            << "\"parse_ms\": " << r.parse_ms << ", "
+            << "\"mapped_parse_ms\": " << r.mapped_parse_ms << ", "
+            << "\"validate_ms\": " << r.validate_ms << ", "
+            << "\"compiled_ms\": " << r.compiled_ms << ", "
+            << "\"tape_parse_ms\": " << r.tape_parse_ms << ", "
+            << "\"tape_validate_ms\": " << r.tape_validate_ms << ", "
+            << "\"parse_mb_s\": " << (r.parse_ms > 0 ? r.bytes / (r.parse_ms / 1000) / (1024 * 1024) : 0) << ", "
+            << "\"peak_rss_kb\": " << r.peak_rss_kb << ", "
+            << "\"parse_allocs\": " << r.parse_allocs << ", "
+            << "\"parse_alloc_bytes\": " << r.parse_alloc_bytes << ", "
+            << "\"tape_parse_allocs\": " << r.tape_parse_allocs << ", "
+            << "\"validate_allocs\": " << r.validate_allocs << ", "
+            << "\"valid\": " << (r.valid ? "true" : "false") << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Same markup as the placeholder cards; the bar is relative to the slowest
+static void writeHtml( const std::vector<TrpBenchRow>& rows, const std::string& path ) {
+    std::ofstream out( path.c_str() );
+    double slowest = 0;
+
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+        double total = rows[i].result.parse_ms + rows[i].result.validate_ms;
+        if ( total > slowest ) slowest = total;
+    }
+
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+        const TrpBenchResult& r = rows[i].result;
+        double total = r.parse_ms + r.validate_ms;
+        char value[32];
+
+        snprintf( value, sizeof(value), total < 10 ? "%.3f" : "%.1f", total );
+        out << (i ? "\n" : "")
+            << "<div class=\"benchmark-card\">\n"
+            << "    <div class=\"benchmark-value\">" << value << "ms</div>\n"
+            << "    <div class=\"benchmark-label\">" << rows[i].family->label
+            << " (" << formatSize( r.bytes ) << ")</div>\n"
+            << "    <div class=\"progress-bar\">\n"
+            << "        <div class=\"progress-fill\" style=\"width: "
+            << (slowest > 0 ? static_cast<int>(total / slowest * 100 + 0.5) : 0) << "%\"></div>\n"
+            << "    </div>\n"
+            << "</div>\n";
+    }
+}
+
+static int usage( void ) {
+    std::cerr << "usage: trpbench [--families config,api,dataset,nested] [--sizes 1.2KB,64MB,1GB]\n"
+              << "                [--fixtures DIR] [--json FILE] [--html FILE] [--min-time SECONDS]" << std::endl;
+    return 1;
+}
+
+static bool parseOptions( int ac, char** av, TrpBenchOptions& opt ) {
+    opt.fixture_dir = "bench/fixtures";
+    opt.json_file = "bench/results.json";
+    opt.min_time = 0.25;
+
+    for ( int i = 1; i < ac; i++ ) {
+        std::string arg = av[i];
+        if ( i + 1 >= ac ) return false;
+        std::string value = av[++i];
+
+        if ( arg == "--families" ) {
+            opt.families = splitList( value );
+        } else if ( arg == "--sizes" ) {
+            std::vector<std::string> sizes = splitList( value );
+            for ( size_t k = 0; k < sizes.size(); k++ ) {
+                size_t bytes = parseSize( sizes[k] );
+                if ( !bytes ) return false;
+                opt.sizes.push_back( bytes );
+            }
+        } else if ( arg == "--fixtures" ) {
+            opt.fixture_dir = value;
+        } else if ( arg == "--json" ) {
+            opt.json_file = value;
+        } else if ( arg == "--html" ) {
+            opt.html_file = value;
+        } else if ( arg == "--min-time" ) {
+            opt.min_time = std::atof( value.c_str() );
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main( int ac, char** av ) {
+    TrpBenchOptions opt;
+
+    if ( !parseOptions( ac, av, opt ) ) return usage();
+
+    if ( opt.families.empty() ) {
+        size_t count;
+        const TrpBenchFamily* families = benchFamilies( count );
+        for ( size_t i = 0; i < count; i++ ) opt.families.push_back( families[i].name );
+    }
+    mkdir( opt.fixture_dir.c_str(), 0755 );
+
+    std::vector<TrpBenchRow> rows;
+    bool all_valid = true;
+
+    std::printf( "%-16s %10s %12s %12s %12s %12s %12s %12s %10s %10s %10s\n", "family", "size",
+        "parse ms", "mmap ms", "validate ms", "compiled ms", "tape ms", "tape val ms", "allocs", "rss KB", "valid" );
+
+    for ( size_t i = 0; i < opt.families.size(); i++ ) {
+        const TrpBenchFamily* family = findBenchFamily( opt.families[i] );
+        if ( !family ) {
+            std::cerr << "trpbench: unknown family " << opt.families[i] << std::endl;
+            return 1;
+        }
+
+        std::vector<size_t> sizes = opt.sizes;
+        if ( sizes.empty() ) sizes.push_back( family->default_bytes );
+
+        for ( size_t k = 0; k < sizes.size(); k++ ) {
+            TrpBenchRow row;
+            std::string file = generateFixture( *family, sizes[k], opt.fixture_dir );
+
+            std::memset( &row.result, 0, sizeof(row.result) );
+            row.family = family;
+            row.result.bytes = fileSize( file );
+            if ( !runChild( *family, file, opt.min_time, row.result ) ) {
+                std::cerr << "trpbench: " << file << " failed" << std::endl;
+                return 1;
+            }
+            all_valid = all_valid && row.result.valid;
+            rows.push_back( row );
+
+            std::printf( "%-16s %10s %12.4f %12.4f %12.4f %12.4f %12.4f %12.4f %10lu %10lu %10s\n", family->name,
+                formatSize( row.result.bytes ).c_str(), row.result.parse_ms, row.result.mapped_parse_ms,
+                row.result.validate_ms,
+                row.result.compiled_ms, row.result.tape_parse_ms, row.result.tape_validate_ms, static_cast<unsigned long>(row.result.parse_allocs + row.result.validate_allocs),
+                static_cast<unsigned long>(row.result.peak_rss_kb), row.result.valid ? "yes" : "NO" );
+        }
+    }
+
+    writeJson( rows, opt.json_file );
+    if ( !opt.html_file.empty() ) writeHtml( rows, opt.html_file );
+
+    return all_valid ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#include "TrpBenchAlloc.hpp"
+#include <cstdlib>
+#include <new>
+
+size_t g_allocs = 0;
+size_t g_alloc_bytes = 0;
+
+void* operator new( size_t size ) throw(std::bad_alloc) {
+    g_allocs++;
+    g_alloc_bytes += size;
+    void* ptr = std::malloc( size ? size : 1 );
+    if ( !ptr ) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[]( size_t size ) throw(std::bad_alloc) {
+    return operator new( size );
+}
+
+void operator delete( void* ptr ) throw() {
+    std::free( ptr );
+}
+
+void operator delete[]( void* ptr ) throw() {
+    std::free( ptr );
+}
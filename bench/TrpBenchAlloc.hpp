@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+#ifndef TRPBENCHALLOC_HPP
+#define TRPBENCHALLOC_HPP
+
+// Bumped by the replacement operator new of the bench binary, which sees
+// every allocation, libtrpjson's included. Kept in its own translation unit
+// so the replacements are never inlined into their callers.
+extern size_t g_allocs;
+extern size_t g_alloc_bytes;
+
+#endif
@@ -0,0 +1,265 @@
+#include "TrpBenchFixtures.hpp"
+
+// Counts what has been written so generators can stop near the target size
+class TrpSizedWriter {
+    private:
+        std::ostream& out;
+        size_t written;
+
+    public:
+        TrpSizedWriter( std::ostream& _out ) : out(_out), written(0) {}
+
+        TrpSizedWriter& operator<<( const std::string& str ) {
+            out << str;
+            written += str.size();
+            return *this;
+        }
+
+        TrpSizedWriter& operator<<( const char* str ) {
+            return *this << std::string( str );
+        }
+
+        TrpSizedWriter& operator<<( size_t nbr ) {
+            std::ostringstream oss;
+            oss << nbr;
+            return *this << oss.str();
+        }
+
+        size_t size( void ) const { return written; }
+};
+
+// Deterministic, so a size always produces the same document
+static size_t nextRandom( size_t& state ) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (state >> 33) & 0x7fffffff;
+}
+
+static const char* pick( const char* const* words, size_t count, size_t& state ) {
+    return words[nextRandom( state ) % count];
+}
+
+static const char* const WORDS[] = {
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+    "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa"
+};
+static const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+// ----------------------------------------------------------------------------
+// Simple Config: a service configuration whose module list grows with size
+// ----------------------------------------------------------------------------
+
+static void generateConfig( std::ostream& stream, size_t bytes ) {
+    TrpSizedWriter out( stream );
+    size_t state = 1;
+
+    out << "{\n  \"service\": \"trpschema-bench\",\n  \"version\": 3,\n"
+        << "  \"server\": {\"host\": \"0.0.0.0\", \"port\": 8080, \"workers\": 4, "
+        << "\"tls\": {\"enabled\": true, \"cert\": \"/etc/ssl/bench.pem\"}},\n"
+        << "  \"log\": {\"level\": \"info\", \"file\": null},\n"
+        << "  \"modules\": [";
+
+    for ( size_t i = 0; i == 0 || out.size() + 2 < bytes; i++ ) {
+        if ( i ) out << ",";
+        out << "\n    {\"name\": \"" << pick( WORDS, WORD_COUNT, state ) << "-" << i
+            << "\", \"enabled\": " << (nextRandom( state ) % 2 ? "true" : "false")
+            << ", \"priority\": " << nextRandom( state ) % 100
+            << ", \"options\": {\"retries\": " << nextRandom( state ) % 10
+            << ", \"timeout_ms\": " << 100 + nextRandom( state ) % 5000 << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static TrpSchema& configSchema( TrpSchemaFactory& f ) {
+    TrpSchemaObject& module = f.object()
+        .property("name", &f.string().min(1).max(64))
+        .property("enabled", &f.boolean())
+        .property("priority", &f.number().min(0).max(100))
+        .property("options", &f.object()
+            .property("retries", &f.number().min(0).max(10))
+            .property("timeout_ms", &f.number().min(1).max(60000))
+            .required("timeout_ms"))
+        .required("name").required("enabled");
+
+    return f.object()
+        .property("service", &f.string().min(1))
+        .property("version", &f.number().min(1))
+        .property("server", &f.object()
+            .property("host", &f.string().min(1).max(255))
+            .property("port", &f.number().min(1).max(65535))
+            .property("workers", &f.number().min(1).max(256))
+            .property("tls", &f.object()
+                .property("enabled", &f.boolean())
+                .property("cert", &f.string())
+                .required("enabled"))
+            .required("host").required("port"))
+        .property("log", &f.object()
+            .property("level", &f.string().min(4).max(5))
+            .property("file", &f.null()))
+        .property("modules", &f.array().item(&module))
+        .required("service").required("server");
+}
+
+// ----------------------------------------------------------------------------
+// API Response: a paginated envelope around a list of resources
+// ----------------------------------------------------------------------------
+
+static void generateApi( std::ostream& stream, size_t bytes ) {
+    TrpSizedWriter out( stream );
+    size_t state = 2;
+
+    out << "{\"status\": \"ok\", \"code\": 200, "
+        << "\"meta\": {\"page\": 1, \"per_page\": 50, \"request_id\": \"5f0c2a9e-bench\"}, "
+        << "\"data\": [";
+
+    // A resource is ~150 bytes, more than the rounding of a card label:
+    // stop before the one that would pass the target, and pad the rest
+    size_t i = 0;
+    size_t resource = 0;
+    for ( ; i == 0 || out.size() + resource + 32 < bytes; i++ ) {
+        size_t start = out.size();
+
+        if ( i ) out << ", ";
+        out << "{\"id\": " << 1000 + i << ", \"type\": \"user\", \"attributes\": {"
+            << "\"name\": \"" << pick( WORDS, WORD_COUNT, state ) << " " << pick( WORDS, WORD_COUNT, state )
+            << "\", \"email\": \"" << pick( WORDS, WORD_COUNT, state ) << i << "@example.com\""
+            << ", \"score\": " << nextRandom( state ) % 1000
+            << ", \"verified\": " << (nextRandom( state ) % 2 ? "true" : "false")
+            << ", \"tags\": [\"" << pick( WORDS, WORD_COUNT, state ) << "\", \""
+            << pick( WORDS, WORD_COUNT, state ) << "\"]}}";
+        resource = out.size() - start;
+    }
+
+    std::ostringstream tail;
+    tail << "], \"total\": " << i << "}\n";
+    if ( out.size() + tail.str().size() < bytes ) out << std::string( bytes - out.size() - tail.str().size(), ' ' );
+    out << tail.str();
+}
+
+static TrpSchema& apiSchema( TrpSchemaFactory& f ) {
+    TrpSchemaObject& resource = f.object()
+        .property("id", &f.number().min(1))
+        .property("type", &f.string().min(1).max(32))
+        .property("attributes", &f.object()
+            .property("name", &f.string().min(1).max(128))
+            .property("email", &f.string().min(3).max(254))
+            .property("score", &f.number().min(0).max(1000))
+            .property("verified", &f.boolean())
+            .property("tags", &f.array().item(&f.string().min(1)).max(16))
+            .required("name").required("email"))
+        .required("id").required("type").required("attributes");
+
+    return f.object()
+        .property("status", &f.string().min(2).max(5))
+        .property("code", &f.number().min(100).max(599))
+        .property("meta", &f.object()
+            .property("page", &f.number().min(1))
+            .property("per_page", &f.number().min(1).max(500))
+            .property("request_id", &f.string().min(1))
+            .required("page"))
+        .property("data", &f.array().item(&resource))
+        .property("total", &f.number().min(0))
+        .required("status").required("code").required("data");
+}
+
+// ----------------------------------------------------------------------------
+// Large Dataset: a root array of flat records with unique ids
+// ----------------------------------------------------------------------------
+
+static void generateDataset( std::ostream& stream, size_t bytes ) {
+    TrpSizedWriter out( stream );
+    size_t state = 3;
+
+    out << "[";
+    for ( size_t i = 0; i == 0 || out.size() + 2 < bytes; i++ ) {
+        if ( i ) out << ",\n ";
+        out << "{\"id\": " << i << ", \"sensor\": \"" << pick( WORDS, WORD_COUNT, state )
+            << "\", \"value\": " << nextRandom( state ) % 10000
+            << ", \"ok\": " << (nextRandom( state ) % 8 ? "true" : "false")
+            << ", \"ts\": " << 1700000000 + i * 60 << "}";
+    }
+    out << "]\n";
+}
+
+static TrpSchema& datasetSchema( TrpSchemaFactory& f ) {
+    return f.array()
+        .uniq(true)
+        .item(&f.object()
+            .property("id", &f.number().min(0))
+            .property("sensor", &f.string().min(1).max(32))
+            .property("value", &f.number().min(0).max(10000))
+            .property("ok", &f.boolean())
+            .property("ts", &f.number().min(0))
+            .required("id").required("sensor").required("value"));
+}
+
+// ----------------------------------------------------------------------------
+// Complex Nested: a tree of sections, several levels deep
+// ----------------------------------------------------------------------------
+
+static void generateSection( TrpSizedWriter& out, size_t depth, size_t& state ) {
+    out << "{\"title\": \"" << pick( WORDS, WORD_COUNT, state ) << "\", \"depth\": " << depth
+        << ", \"meta\": {\"weight\": " << nextRandom( state ) % 100
+        << ", \"flags\": [" << nextRandom( state ) % 2 << ", " << nextRandom( state ) % 3 << "]}";
+    if ( depth < 6 ) {
+        out << ", \"children\": [";
+        generateSection( out, depth + 1, state );
+        out << ", ";
+        generateSection( out, depth + 1, state );
+        out << "]";
+    }
+    out << "}";
+}
+
+static void generateNested( std::ostream& stream, size_t bytes ) {
+    TrpSizedWriter out( stream );
+    size_t state = 4;
+
+    out << "{\"title\": \"root\", \"depth\": 0, \"meta\": {\"weight\": 0, \"flags\": []}, \"children\": [";
+    for ( size_t i = 0; i == 0 || out.size() + 3 < bytes; i++ ) {
+        if ( i ) out << ", ";
+        // a subtree from depth 1 is about 8KB, each level deeper halves it
+        size_t left = bytes - out.size();
+        size_t depth = 1;
+        while ( depth < 6 && left < (8192u >> (depth - 1)) ) depth++;
+        generateSection( out, depth, state );
+    }
+    out << "]}\n";
+}
+
+static TrpSchema& nestedSchema( TrpSchemaFactory& f ) {
+    TrpSchemaArray& children = f.array();
+    TrpSchemaObject& section = f.object()
+        .property("title", &f.string().min(1).max(64))
+        .property("depth", &f.number().min(0).max(16))
+        .property("meta", &f.object()
+            .property("weight", &f.number().min(0).max(100))
+            .property("flags", &f.array().item(&f.number()).max(8))
+            .required("weight"))
+        .property("children", &children)
+        .required("title").required("depth");
+
+    children.item(&section);
+    return section;
+}
+
+static const TrpBenchFamily FAMILIES[] = {
+    { "config", "Simple Config", 1229, generateConfig, configSchema },
+    { "api", "API Response", 2867, generateApi, apiSchema },
+    { "dataset", "Large Dataset", 4198, generateDataset, datasetSchema },
+    { "nested", "Complex Nested", 3584, generateNested, nestedSchema }
+};
+
+const TrpBenchFamily* benchFamilies( size_t& count ) {
+    count = sizeof(FAMILIES) / sizeof(FAMILIES[0]);
+    return FAMILIES;
+}
+
+const TrpBenchFamily* findBenchFamily( const std::string& name ) {
+    size_t count;
+    const TrpBenchFamily* families = benchFamilies( count );
+
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( name == families[i].name ) return &families[i];
+    }
+    return NULL;
+}
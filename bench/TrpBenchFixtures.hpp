@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../lib/TrpSchema.hpp"
+#include <ostream>
+
+#ifndef TRPBENCHFIXTURES_HPP
+#define TRPBENCHFIXTURES_HPP
+
+// One family of benchmark documents: a generator that writes a valid
+// document of roughly `bytes` bytes, and the schema it conforms to.
+struct TrpBenchFamily {
+    const char* name;           // used in file names and results.json
+    const char* label;          // benchmark card title
+    size_t default_bytes;
+    void (*generate)( std::ostream& out, size_t bytes );
+    TrpSchema& (*schema)( TrpSchemaFactory& factory );
+};
+
+const TrpBenchFamily* benchFamilies( size_t& count );
+const TrpBenchFamily* findBenchFamily( const std::string& name );
+
+#endif
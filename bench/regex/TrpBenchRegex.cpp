@@ -0,0 +1,113 @@
+// TrpRegex against POSIX regexec and std::regex on the same subjects. Built
+// apart from trpbench because std::regex needs C++11: make bench-regex
+#include "../../include/TrpRegex.hpp"
+#include <cstdio>
+#include <ctime>
+#include <regex.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+struct TrpRegexCase {
+    const char* name;
+    const char* pattern;        // TrpRegex and std::regex (ECMAScript)
+    const char* posix;          // same language in POSIX ERE
+    std::vector<std::string> subjects;
+};
+
+static double now( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ns per subject, best of 5 rounds of `rounds` passes
+template <typename Match>
+static double measure( const TrpRegexCase& c, size_t rounds, Match match, size_t& matched ) {
+    double best = 0;
+
+    for ( int r = 0; r < 5; r++ ) {
+        double start = now();
+        matched = 0;
+        for ( size_t i = 0; i < rounds; i++ ) {
+            for ( size_t s = 0; s < c.subjects.size(); s++ ) matched += match( c.subjects[s] );
+        }
+        double ns = (now() - start) * 1e9 / (rounds * c.subjects.size());
+        if ( !r || ns < best ) best = ns;
+    }
+    matched /= rounds;
+    return best;
+}
+
+static std::vector<TrpRegexCase> cases( void ) {
+    std::vector<TrpRegexCase> all;
+    TrpRegexCase c;
+
+    c.name = "sku";
+    c.pattern = "^[A-Z]{3}-\\d{4}$";
+    c.posix = "^[A-Z]{3}-[0-9]{4}$";
+    c.subjects.clear();
+    c.subjects.push_back( "ABC-1234" );
+    c.subjects.push_back( "AB-1234" );
+    c.subjects.push_back( "XYZ-98765" );
+    c.subjects.push_back( "QRS-0000" );
+    all.push_back( c );
+
+    c.name = "email";
+    c.pattern = "^[a-z0-9._+-]+@[a-z0-9-]+(\\.[a-z0-9-]+)+$";
+    c.posix = "^[a-z0-9._+-]+@[a-z0-9-]+(\\.[a-z0-9-]+)+$";
+    c.subjects.clear();
+    c.subjects.push_back( "first.last+tag@example.co.uk" );
+    c.subjects.push_back( "nobody@localhost" );
+    c.subjects.push_back( "someone.with.a.long.name@mail.example.org" );
+    all.push_back( c );
+
+    c.name = "search";
+    c.pattern = "error|warning|fatal";
+    c.posix = "error|warning|fatal";
+    c.subjects.clear();
+    c.subjects.push_back( std::string( 200, 'x' ) + "warning" );
+    c.subjects.push_back( std::string( 1000, 'y' ) );
+    c.subjects.push_back( "fatal" + std::string( 100, 'z' ) );
+    all.push_back( c );
+
+    // exponential for a backtracking matcher, linear for a DFA
+    c.name = "(a|aa)*b";
+    c.pattern = "^(a|aa)*b$";
+    c.posix = "^(a|aa)*b$";
+    c.subjects.clear();
+    c.subjects.push_back( std::string( 24, 'a' ) );
+    all.push_back( c );
+
+    return all;
+}
+
+int main( void ) {
+    std::vector<TrpRegexCase> all = cases();
+
+    std::printf( "%-10s %12s %12s %12s %8s %6s\n", "case", "TrpRegex", "regexec", "std::regex", "states", "agree" );
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        const TrpRegexCase& c = all[i];
+        TrpRegex trp( c.pattern );
+        regex_t posix;
+        std::regex std_rx( c.pattern );
+        size_t trp_matched, posix_matched, std_matched;
+
+        if ( !trp.isValid() || regcomp( &posix, c.posix, REG_EXTENDED | REG_NOSUB ) ) {
+            std::printf( "%-10s does not compile: %s\n", c.name, trp.getError().c_str() );
+            continue;
+        }
+
+        double trp_ns = measure( c, 20000, [&]( const std::string& s ) { return trp.match( s ); }, trp_matched );
+        double posix_ns = measure( c, 200, [&]( const std::string& s ) {
+            return regexec( &posix, s.c_str(), 0, NULL, 0 ) == 0; }, posix_matched );
+        double std_ns = measure( c, 20, [&]( const std::string& s ) {
+            return std::regex_search( s, std_rx ); }, std_matched );
+
+        std::printf( "%-10s %9.1f ns %9.1f ns %9.1f ns %8zu %6s\n", c.name, trp_ns, posix_ns, std_ns, trp.stateCount(),
+            trp_matched == posix_matched && trp_matched == std_matched ? "yes" : "NO" );
+        regfree( &posix );
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "TrpCheckDocs.hpp"
+#include <cstdlib>
+#include <iostream>
+
+// The units trpcheck-emit wrote for the check schemas against
+// TrpSchema::validate over random documents: the same result and the same
+// errors in the same order, with the default budget, fail-fast, and at most
+// 3 errors.
+
+bool trpCheckGenerated0( ITrpJsonValue* value, TrpValidatorContext& ctx );
+bool trpCheckGenerated1( ITrpJsonValue* value, TrpValidatorContext& ctx );
+bool trpCheckGenerated2( ITrpJsonValue* value, TrpValidatorContext& ctx );
+bool trpCheckGenerated3( ITrpJsonValue* value, TrpValidatorContext& ctx );
+bool trpCheckGenerated4( ITrpJsonValue* value, TrpValidatorContext& ctx );
+bool trpCheckGenerated5( ITrpJsonValue* value, TrpValidatorContext& ctx );
+
+typedef bool (*TrpCheckGenerated)( ITrpJsonValue* value, TrpValidatorContext& ctx );
+
+static const TrpCheckGenerated generated[TRP_CHECK_SCHEMAS] = {
+    trpCheckGenerated0, trpCheckGenerated1, trpCheckGenerated2,
+    trpCheckGenerated3, trpCheckGenerated4, trpCheckGenerated5
+};
+
+static const char* const mode_names[] = { "", " fail-fast", " max 3" };
+
+int main( int ac, char** av ) {
+    size_t docs = ac > 1 ? std::strtoul( av[1], NULL, 10 ) : 20000;
+    size_t runs = 0;
+    size_t diffs = 0;
+
+    for ( size_t k = 0; k < TRP_CHECK_SCHEMAS; k++ ) {
+        TrpSchemaFactory factory;
+        TrpSchema& schema = trpCheckSchema( k, factory );
+        TrpCheckDocs generator( k + 1 );
+
+        for ( size_t d = 0; d < docs; d++ ) {
+            std::string text = generator.generate( schema );
+            TrpBufferParser parser( text );
+
+            if ( !parser.parse() ) {
+                std::cerr << "trpcheck-codegen: generated an unparsable document: " << text << std::endl;
+                return 1;
+            }
+            for ( int mode = 0; mode < 3; mode++ ) {
+                TrpValidatorContext tree_ctx( mode == 1, mode == 2 ? 3 : 0 );
+                TrpValidatorContext unit_ctx( mode == 1, mode == 2 ? 3 : 0 );
+                bool tree = schema.validate( parser.getAST(), tree_ctx );
+                bool unit = generated[k]( parser.getAST(), unit_ctx );
+                std::string expected = trpCheckErrors( tree_ctx );
+                std::string actual = trpCheckErrors( unit_ctx );
+
+                runs++;
+                if ( tree == unit && expected == actual ) continue;
+                if ( diffs++ < 5 ) {
+                    std::cout << "schema " << k << mode_names[mode] << ": " << text << "\n"
+                        << "tree " << tree << "\n" << expected << "generated " << unit << "\n" << actual;
+                }
+            }
+        }
+    }
+    std::cout << "trpcheck-codegen: " << runs << " runs, " << diffs << " differences" << std::endl;
+    return diffs != 0;
+}
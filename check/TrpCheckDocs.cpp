@@ -0,0 +1,303 @@
+#include "TrpCheckDocs.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <set>
+
+TrpCheckDocs::TrpCheckDocs( size_t seed ) : state(seed) {}
+
+// Same generator as the bench fixtures
+size_t TrpCheckDocs::next( size_t n ) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return ((state >> 33) & 0x7fffffff) % n;
+}
+
+bool TrpCheckDocs::chance( size_t percent ) {
+    return next( 100 ) < percent;
+}
+
+static std::string quote( const std::string& str ) {
+    std::string out = "\"";
+
+    for ( size_t i = 0; i < str.size(); i++ ) {
+        unsigned char c = str[i];
+
+        if ( c == '"' || c == '\\' ) {
+            out += '\\';
+            out += c;
+        } else if ( c < 0x20 ) {
+            char buffer[8];
+            std::sprintf( buffer, "\\u%04x", c );
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string number( double nbr ) {
+    char buffer[32];
+
+    std::sprintf( buffer, "%.17g", nbr );
+    return buffer;
+}
+
+// Strings the check schemas care about: lengths around their bounds, enum
+// values, tags, formats and pattern matches
+std::string TrpCheckDocs::randomString( void ) {
+    static const char* const pool[] = {
+        "", "a", "ab", "abc", "abcd", "abcde", "abcdef", "abc?", "a?", "acb?", "ff", "0a1", "zz", "x",
+        "\xc3\xa9\xc3\xa9", "\xc3\xa9x", "123e4567-e89b-12d3-a456-426614174000",
+        "red", "green", "blue", "v3", "v19", "v20", "k1", "k11", "circle", "square"
+    };
+    return pool[next( sizeof(pool) / sizeof(pool[0]) )];
+}
+
+std::string TrpCheckDocs::randomValue( int depth ) {
+    static const double numbers[] = { 0, 1, -1, 2.5, 3, 0.125, 150, 151, 1e300, -3, -2.5, 10, 5, 7 };
+
+    switch (next( depth > 2 ? 4 : 6 )) {
+        case 0: return "null";
+        case 1: return chance( 50 ) ? "true" : "false";
+        case 2: return number( numbers[next( sizeof(numbers) / sizeof(numbers[0]) )] );
+        case 3: return quote( randomString() );
+        case 4: return "[" + randomValue( depth + 1 ) + "," + randomValue( depth + 1 ) + "]";
+        default: return "{\"a\":" + randomValue( depth + 1 ) + ",\"q\":1}";
+    }
+}
+
+std::string TrpCheckDocs::object( const TrpSchemaObject* schema, int depth ) {
+    const std::map<std::string, TrpSchema*>& properties = schema->getProperties();
+    std::set<std::string> keys;
+    std::string out = "{";
+
+    for ( std::map<std::string, TrpSchema*>::const_iterator it = properties.begin(); it != properties.end(); it++ ) {
+        if ( !chance( 80 ) ) continue;
+        if ( keys.size() ) out += ",";
+        keys.insert( it->first );
+        out += quote( it->first ) + ":" + (it->second && depth < 6 ? value( it->second, depth + 1 ) : randomValue( depth + 1 ));
+    }
+    while ( chance( 25 ) ) {
+        std::string key = randomString();
+
+        if ( !keys.insert( key ).second ) continue;
+        if ( keys.size() > 1 ) out += ",";
+        out += quote( key ) + ":" + randomValue( depth + 1 );
+    }
+    if ( !keys.empty() && chance( 10 ) ) {
+        std::set<std::string>::const_iterator key = keys.begin();
+        std::advance( key, next( keys.size() ) );
+
+        std::map<std::string, TrpSchema*>::const_iterator it = properties.find( *key );
+        bool declared = it != properties.end() && it->second && depth < 6;
+        out += "," + quote( *key ) + ":" + (declared ? value( it->second, depth + 1 ) : randomValue( depth + 1 ));
+    }
+    return out + "}";
+}
+
+std::string TrpCheckDocs::array( const TrpSchemaArray* schema, int depth ) {
+    const SchemaVec& tuple = schema->getTuple();
+    std::vector<std::string> items;
+
+    if ( !tuple.empty() ) {
+        size_t count = tuple.size();
+        if ( chance( 20 ) ) count = count + next( 3 ) - 1;
+        for ( size_t i = 0; i < count; i++ ) {
+            items.push_back( i < tuple.size() && tuple[i] ? value( tuple[i], depth + 1 ) : randomValue( depth + 1 ) );
+        }
+    } else {
+        size_t count = next( depth > 3 ? 3 : 6 );
+        for ( size_t i = 0; i < count; i++ ) {
+            items.push_back( schema->getItem() ? value( schema->getItem(), depth + 1 ) : randomValue( depth + 1 ) );
+        }
+    }
+    if ( !items.empty() && chance( 30 ) ) items.push_back( items[next( items.size() )] );
+
+    std::string out = "[";
+    for ( size_t i = 0; i < items.size(); i++ ) out += (i ? "," : "") + items[i];
+    return out + "]";
+}
+
+std::string TrpCheckDocs::value( const TrpSchema* schema, int depth ) {
+    static const double numbers[] = {
+        0, -0.0, 1, -1, 2.5, 3, 0.125, 0.375, 0.3, 150, 151, 1e300, -3, -2.5, 10, 5, 7, 4.5, 0.5
+    };
+
+    if ( chance( 10 ) || depth > 7 ) return randomValue( depth );
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING: {
+            const TrpSchemaString* str = static_cast<const TrpSchemaString*>(schema);
+            if ( str->hasEnum() && chance( 60 ) ) return quote( str->getEnum().at( next( str->getEnum().size() ) ) );
+            return quote( randomString() );
+        }
+        case SCHEMA_NUMBER: {
+            const TrpSchemaNumber* nbr = static_cast<const TrpSchemaNumber*>(schema);
+            if ( nbr->hasEnum() && chance( 50 ) ) {
+                // the set holds the bytes of each double
+                std::string bytes = nbr->getEnum().at( next( nbr->getEnum().size() ) );
+                double value;
+                std::memcpy( &value, bytes.data(), sizeof(value) );
+                return number( value );
+            }
+            if ( nbr->hasMin() && chance( 20 ) ) return number( nbr->getMin() + static_cast<double>(next( 3 )) - 1 );
+            if ( nbr->hasMax() && chance( 20 ) ) return number( nbr->getMax() + static_cast<double>(next( 3 )) - 1 );
+            return number( numbers[next( sizeof(numbers) / sizeof(numbers[0]) )] );
+        }
+        case SCHEMA_BOOLEAN:
+            return chance( 50 ) ? "true" : "false";
+        case SCHEMA_NULL:
+            return "null";
+        case SCHEMA_OBJECT:
+            return object( static_cast<const TrpSchemaObject*>(schema), depth );
+        case SCHEMA_ARRAY:
+            return array( static_cast<const TrpSchemaArray*>(schema), depth );
+        case SCHEMA_UNION: {
+            const TrpSchemaUnion* uni = static_cast<const TrpSchemaUnion*>(schema);
+            size_t branch = next( uni->getBranches().size() );
+            std::string out = value( uni->getBranches()[branch], depth + 1 );
+
+            // put the discriminator first, mostly with the branch's own tag
+            if ( uni->isTagged() && out.size() > 1 && out[0] == '{' && chance( 85 )
+                && out.find( quote( uni->getDiscriminator() ) + ":" ) == std::string::npos ) {
+                std::string tag;
+                if ( !uni->getTags()[branch].empty() && chance( 80 ) ) tag = quote( uni->getTags()[branch] );
+                else tag = chance( 50 ) ? quote( randomString() ) : randomValue( 3 );
+                out = "{" + quote( uni->getDiscriminator() ) + ":" + tag + (out == "{}" ? "" : ",") + out.substr( 1 );
+            }
+            return out;
+        }
+        default:
+            return "null";
+    }
+}
+
+std::string TrpCheckDocs::generate( const TrpSchema& schema ) {
+    return value( &schema, 0 );
+}
+
+TrpSchema& trpCheckSchema( size_t index, TrpSchemaFactory& f ) {
+    switch (index) {
+        case 0: {
+            // every constraint, a declared property without a schema
+            SchemaVec tuple;
+            tuple.push_back( &f.number().integer() );
+            tuple.push_back( &f.string().max( 3 ) );
+            tuple.push_back( NULL );
+
+            TrpSchemaObject& deep = f.object();
+            deep.property( "deep", &f.array().item( &f.number() ).min( 1 ) ).required( "deep" );
+            TrpSchemaObject& nested = f.object();
+            nested.property( "k", &f.boolean() ).property( "z", &deep ).required( "k" ).required( "z" ).min( 1 ).max( 3 );
+
+            return f.object()
+                .property( "name", &f.string().min( 3 ).max( 5 ) )
+                .property( "age", &f.number().min( 1 ).max( 150 ).integer() )
+                .property( "score", &f.number().exclusiveMin( 0 ).exclusiveMax( 1 ).multipleOf( 0.125 ) )
+                .property( "tags", &f.array().item( &f.string() ).uniq( true ).min( 1 ).max( 4 ) )
+                .property( "pt", &f.array().tuple( tuple ) )
+                .property( "flag", &f.boolean().constant( true ) )
+                .property( "off", &f.boolean().constant( false ) )
+                .property( "nil", &f.null() )
+                .property( "hole", NULL )
+                .property( "we?rd\\\"k\xc3\xa9y", &f.number() )
+                .property( "nested", &nested )
+                .required( "name" ).required( "age" ).required( "hole" ).max( 9 ).min( 2 );
+        }
+        case 1: {
+            // enums on both sides of the inline threshold, formats, patterns
+            std::vector<std::string> colors;
+            const char* const names[] = { "red", "green", "blue", "" };
+            for ( size_t i = 0; i < 4; i++ ) colors.push_back( names[i] );
+
+            std::vector<std::string> words;
+            for ( int i = 0; i < 20; i++ ) {
+                char buffer[8];
+                std::sprintf( buffer, "v%d", i );
+                words.push_back( buffer );
+            }
+            words.push_back( std::string( "n\0ul?\?=", 7 ) );
+
+            std::vector<double> few;
+            few.push_back( 1 );
+            few.push_back( -0.0 );
+            few.push_back( 2.5 );
+            few.push_back( 1e300 );
+            std::vector<double> many;
+            for ( int i = 0; i < 15; i++ ) many.push_back( i * 0.5 - 3 );
+
+            return f.object()
+                .property( "color", &f.string().enumValues( colors ) )
+                .property( "word", &f.string().enumValues( words ).max( 6 ) )
+                .property( "n", &f.number().enumValues( few ) )
+                .property( "m", &f.number().enumValues( many ).max( 2 ) )
+                .property( "id", &f.string().format( FORMAT_UUID ) )
+                .property( "hex", &f.string().format( FORMAT_HEX ).pattern( "^[a-f0-9]{2,4}$" ) )
+                .property( "cp", &f.string().codePoints().min( 2 ).max( 3 ) )
+                .property( "pat", &f.string().pattern( "^a(b|c)*\\?$" ) )
+                .required( "color" );
+        }
+        case 2: {
+            // untagged unions: several branches per type, nested unions
+            TrpSchemaUnion& one = f.oneOf();
+            one.branch( &f.string().max( 3 ) ).branch( &f.number().max( 10 ) ).branch( &f.number().min( 5 ) )
+                .branch( &f.number().integer() ).branch( &f.array().item( &f.number() ) )
+                .branch( &f.object().property( "a", &f.number() ).required( "a" ) )
+                .branch( &f.object().property( "b", &f.string() ).required( "b" ) );
+            TrpSchemaUnion& any = f.anyOf();
+            any.branch( &f.number().max( 1 ) ).branch( &f.number().min( 3 ) ).branch( &f.boolean() ).branch( &f.null() );
+            TrpSchemaUnion& outer = f.anyOf();
+            outer.branch( &one ).branch( &f.object().property( "u", &any ).required( "u" ) );
+            return f.array().item( &outer );
+        }
+        case 3: {
+            // discriminated unions, with a repeated tag (refused, the first
+            // branch kept) and untagged branches
+            TrpSchemaUnion& shape = f.oneOf();
+            shape.discriminator( "kind" )
+                .branch( "circle", &f.object().property( "kind", &f.string() ).property( "r", &f.number().min( 0 ) ).required( "r" ) )
+                .branch( "square", &f.object().property( "kind", &f.string() ).property( "side", &f.number() ).required( "side" ) )
+                .branch( "square", &f.object().property( "kind", &f.string() ).property( "s2", &f.number() ).required( "s2" ) );
+            TrpSchemaUnion& wide = f.anyOf();
+            wide.discriminator( "t" );
+            for ( int i = 0; i < 12; i++ ) {
+                char tag[8];
+                std::sprintf( tag, "k%d", i );
+                wide.branch( tag, &f.object().property( "t", &f.string() ).property( "x", &f.number().max( i ) ).required( "x" ) );
+            }
+            wide.branch( &f.object().property( "y", &f.number() ).required( "y" ) )
+                .branch( &f.object().property( "z", &f.number() ).required( "z" ) ).branch( &f.string() );
+            TrpSchemaUnion& mixed = f.oneOf();
+            mixed.discriminator( "t" ).branch( "a", &f.object().property( "q", &f.number() ).required( "q" ) )
+                .branch( &f.object().property( "w", &f.number() ).required( "w" ) );
+            return f.object().property( "shapes", &f.array().item( &shape ) )
+                .property( "more", &f.array().item( &wide ) ).property( "t3", &f.array().item( &mixed ) );
+        }
+        case 4: {
+            // a recursive tree
+            TrpSchemaObject& node = f.object();
+            node.property( "v", &f.number().integer().min( 0 ) ).property( "kids", &f.array().item( &node ).max( 3 ) ).required( "v" );
+            return node;
+        }
+        default: {
+            // uniq over tuples and objects
+            SchemaVec tuple;
+            tuple.push_back( &f.string() );
+            tuple.push_back( &f.array().uniq( true ).item( &f.object().property( "x", &f.number() ) ) );
+            return f.array().tuple( tuple ).uniq( true ).min( 1 );
+        }
+    }
+}
+
+std::string trpCheckErrors( const TrpValidatorContext& ctx ) {
+    const TrpValidationError& errors = ctx.getErrors();
+    std::string out;
+
+    for ( size_t i = 0; i < errors.size(); i++ ) {
+        char types[32];
+        std::sprintf( types, " |%d|%d", static_cast<int>(errors[i].expected), static_cast<int>(errors[i].actual) );
+        out += errors[i].path + ": " + errors[i].msg + types + "\n";
+    }
+    return out;
+}
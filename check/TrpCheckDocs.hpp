@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../lib/TrpSchema.hpp"
+#include <string>
+
+#ifndef TRPCHECKDOCS_HPP
+#define TRPCHECKDOCS_HPP
+
+#define TRP_CHECK_SCHEMAS 6
+
+// Random documents shaped by a schema, for the differential checks: mostly
+// what the schema asks for, with wrong types, bounds off by one, repeated
+// items and stray members mixed in. A seed always gives the same documents.
+// Now and then an object repeats one of its keys, whose last value counts.
+class TrpCheckDocs {
+    private:
+        size_t state;
+
+        size_t next( size_t n );
+        bool chance( size_t percent );
+        std::string randomString( void );
+        std::string randomValue( int depth );
+        std::string object( const TrpSchemaObject* schema, int depth );
+        std::string array( const TrpSchemaArray* schema, int depth );
+        std::string value( const TrpSchema* schema, int depth );
+
+    public:
+        TrpCheckDocs( size_t seed = 1 );
+
+        std::string generate( const TrpSchema& schema );
+};
+
+// Schema `index` of the checks, < TRP_CHECK_SCHEMAS: every constraint, enums
+// past the inline threshold, tagged and untagged unions, recursion
+TrpSchema& trpCheckSchema( size_t index, TrpSchemaFactory& factory );
+
+// One line per error, "path: message |expected|actual", in record order
+std::string trpCheckErrors( const TrpValidatorContext& ctx );
+
+#endif
@@ -0,0 +1,28 @@
+#include "TrpCheckDocs.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Writes the check schemas as TrpSchemaCodeGen units into the directory given,
+// one trpCheckGenerated<N>.cpp per schema, for check-codegen to compile.
+int main( int ac, char** av ) {
+    if ( ac != 2 ) {
+        std::cerr << "usage: trpcheck-emit <directory>" << std::endl;
+        return 1;
+    }
+    for ( size_t k = 0; k < TRP_CHECK_SCHEMAS; k++ ) {
+        TrpSchemaFactory factory;
+        TrpSchemaCodeGen codegen;
+        char name[32];
+
+        std::sprintf( name, "trpCheckGenerated%lu", static_cast<unsigned long>(k) );
+        std::string file = std::string( av[1] ) + "/" + name + ".cpp";
+        std::ofstream out( file.c_str() );
+
+        if ( !out || !codegen.generate( trpCheckSchema( k, factory ), name, out ) ) {
+            std::cerr << "trpcheck-emit: " << file << ": " << (out ? codegen.getError() : "cannot write") << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
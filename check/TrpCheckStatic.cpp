@@ -0,0 +1,200 @@
+#include "TrpCheckDocs.hpp"
+#include <cstdlib>
+#include <iostream>
+
+// TrpStatic schemas against the factory trees they spell, over random
+// documents shaped by the tree: the same result and the same errors in the
+// same order, with the default budget, fail-fast, and at most 3 errors.
+
+using namespace TrpStatic;
+
+#define TRP_CHECK_STATIC_SCHEMAS 5
+
+TRP_KEY( KeyName, "name" );
+TRP_KEY( KeyAge, "age" );
+TRP_KEY( KeyScore, "score" );
+TRP_KEY( KeyTags, "tags" );
+TRP_KEY( KeyPt, "pt" );
+TRP_KEY( KeyFlag, "flag" );
+TRP_KEY( KeyOff, "off" );
+TRP_KEY( KeyNil, "nil" );
+TRP_KEY( KeyWeird, "we?rd\\\"k\xc3\xa9y" );
+TRP_KEY( KeyNested, "nested" );
+TRP_KEY( KeyK, "k" );
+TRP_KEY( KeyZ, "z" );
+TRP_KEY( KeyDeep, "deep" );
+TRP_KEY( KeyColor, "color" );
+TRP_KEY( KeyRed, "red" );
+TRP_KEY( KeyGreen, "green" );
+TRP_KEY( KeyBlue, "blue" );
+TRP_KEY( KeyEmpty, "" );
+TRP_KEY( KeyN, "n" );
+TRP_KEY( KeyId, "id" );
+TRP_KEY( KeyHex, "hex" );
+TRP_KEY( KeyCp, "cp" );
+TRP_KEY( KeyPat, "pat" );
+TRP_KEY( PatternHex, "^[a-f0-9]{2,4}$" );
+TRP_KEY( PatternPat, "^a(b|c)*\\?$" );
+TRP_KEY( KeyA, "a" );
+TRP_KEY( KeyB, "b" );
+TRP_KEY( KeyU, "u" );
+TRP_KEY( KeyV, "v" );
+TRP_KEY( KeyKids, "kids" );
+TRP_KEY( KeyX, "x" );
+
+// every constraint
+typedef Object<
+    Required<KeyName, String<Min<3>, Max<5> > >,
+    Required<KeyAge, Number<Min<1>, Max<150>, Integer> >,
+    Prop<KeyScore, Number<ExclusiveMin<0>, ExclusiveMax<1>, MultipleOf<1, 8> > >,
+    Prop<KeyTags, Array<String<>, Uniq, Min<1>, Max<4> > >,
+    Prop<KeyPt, Tuple<Number<Integer>, String<Max<3> > > >,
+    Prop<KeyFlag, Bool<Const<1> > >,
+    Prop<KeyOff, Bool<Const<0> > >,
+    Prop<KeyNil, Null>,
+    Prop<KeyWeird, Number<> >,
+    Prop<KeyNested, Object<Required<KeyK, Bool<> >,
+        Required<KeyZ, Object<Required<KeyDeep, Array<Number<>, Min<1> > > > >, Min<1>, Max<3> > >,
+    Max<9>, Min<2> > StaticConstraints;
+
+// enums, formats, patterns
+typedef Object<
+    Required<KeyColor, String<Enum<KeyRed, KeyGreen, KeyBlue, KeyEmpty> > >,
+    Prop<KeyN, Number<Const<5, 2> > >,
+    Prop<KeyId, String<Format<FORMAT_UUID> > >,
+    Prop<KeyHex, String<Pattern<PatternHex>, Format<FORMAT_HEX> > >,
+    Prop<KeyCp, String<CodePoints, Min<2>, Max<3> > >,
+    Prop<KeyPat, String<Pattern<PatternPat> > > > StaticStrings;
+
+// nested unions
+typedef OneOf< String<Max<3> >, Number<Max<10> >, Number<Min<5> >, Number<Integer>, Array<Number<> >,
+    Object<Required<KeyA, Number<> > >, Object<Required<KeyB, String<> > > > StaticOne;
+typedef AnyOf< Number<Max<1> >, Number<Min<3> >, Bool<>, Null > StaticAny;
+typedef Array< AnyOf< StaticOne, Object<Required<KeyU, StaticAny> > > > StaticUnions;
+
+// a recursive tree
+struct StaticNode : Object< Required<KeyV, Number<Integer, Min<0> > >, Prop<KeyKids, Array<StaticNode, Max<3> > > > {};
+
+// uniq over objects in a tuple
+typedef Tuple< String<>, Array<Object<Prop<KeyX, Number<> > >, Uniq> > StaticTuple;
+
+static TrpSchema& treeSchema( size_t index, TrpSchemaFactory& f ) {
+    switch (index) {
+        case 0: {
+            SchemaVec tuple;
+            tuple.push_back( &f.number().integer() );
+            tuple.push_back( &f.string().max( 3 ) );
+
+            TrpSchemaObject& deep = f.object();
+            deep.property( "deep", &f.array().item( &f.number() ).min( 1 ) ).required( "deep" );
+            TrpSchemaObject& nested = f.object();
+            nested.property( "k", &f.boolean() ).property( "z", &deep ).required( "k" ).required( "z" ).min( 1 ).max( 3 );
+
+            return f.object()
+                .property( "name", &f.string().min( 3 ).max( 5 ) )
+                .property( "age", &f.number().min( 1 ).max( 150 ).integer() )
+                .property( "score", &f.number().exclusiveMin( 0 ).exclusiveMax( 1 ).multipleOf( 0.125 ) )
+                .property( "tags", &f.array().item( &f.string() ).uniq( true ).min( 1 ).max( 4 ) )
+                .property( "pt", &f.array().tuple( tuple ) )
+                .property( "flag", &f.boolean().constant( true ) )
+                .property( "off", &f.boolean().constant( false ) )
+                .property( "nil", &f.null() )
+                .property( "we?rd\\\"k\xc3\xa9y", &f.number() )
+                .property( "nested", &nested )
+                .required( "name" ).required( "age" ).max( 9 ).min( 2 );
+        }
+        case 1: {
+            std::vector<std::string> colors;
+            const char* const names[] = { "red", "green", "blue", "" };
+            for ( size_t i = 0; i < 4; i++ ) colors.push_back( names[i] );
+            std::vector<double> numbers;
+            numbers.push_back( 2.5 );
+
+            return f.object()
+                .property( "color", &f.string().enumValues( colors ) )
+                .property( "n", &f.number().enumValues( numbers ) )
+                .property( "id", &f.string().format( FORMAT_UUID ) )
+                .property( "hex", &f.string().format( FORMAT_HEX ).pattern( "^[a-f0-9]{2,4}$" ) )
+                .property( "cp", &f.string().codePoints().min( 2 ).max( 3 ) )
+                .property( "pat", &f.string().pattern( "^a(b|c)*\\?$" ) )
+                .required( "color" );
+        }
+        case 2: {
+            TrpSchemaUnion& one = f.oneOf();
+            one.branch( &f.string().max( 3 ) ).branch( &f.number().max( 10 ) ).branch( &f.number().min( 5 ) )
+                .branch( &f.number().integer() ).branch( &f.array().item( &f.number() ) )
+                .branch( &f.object().property( "a", &f.number() ).required( "a" ) )
+                .branch( &f.object().property( "b", &f.string() ).required( "b" ) );
+            TrpSchemaUnion& any = f.anyOf();
+            any.branch( &f.number().max( 1 ) ).branch( &f.number().min( 3 ) ).branch( &f.boolean() ).branch( &f.null() );
+            TrpSchemaUnion& outer = f.anyOf();
+            outer.branch( &one ).branch( &f.object().property( "u", &any ).required( "u" ) );
+            return f.array().item( &outer );
+        }
+        case 3: {
+            TrpSchemaObject& node = f.object();
+            node.property( "v", &f.number().integer().min( 0 ) ).property( "kids", &f.array().item( &node ).max( 3 ) ).required( "v" );
+            return node;
+        }
+        default: {
+            SchemaVec tuple;
+            tuple.push_back( &f.string() );
+            tuple.push_back( &f.array().uniq( true ).item( &f.object().property( "x", &f.number() ) ) );
+            return f.array().tuple( tuple );
+        }
+    }
+}
+
+static bool staticValidate( size_t index, ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+    switch (index) {
+        case 0: return StaticConstraints::validate( value, ctx );
+        case 1: return StaticStrings::validate( value, ctx );
+        case 2: {
+            TrpStaticSchema<StaticUnions> schema;   // through the TrpSchema adapter
+            return schema.validate( value, ctx );
+        }
+        case 3: return StaticNode::validate( value, ctx );
+        default: return StaticTuple::validate( value, ctx );
+    }
+}
+
+static const char* const mode_names[] = { "", " fail-fast", " max 3" };
+
+int main( int ac, char** av ) {
+    size_t docs = ac > 1 ? std::strtoul( av[1], NULL, 10 ) : 20000;
+    size_t runs = 0;
+    size_t diffs = 0;
+
+    for ( size_t k = 0; k < TRP_CHECK_STATIC_SCHEMAS; k++ ) {
+        TrpSchemaFactory factory;
+        TrpSchema& schema = treeSchema( k, factory );
+        TrpCheckDocs generator( k + 1 );
+
+        for ( size_t d = 0; d < docs; d++ ) {
+            std::string text = generator.generate( schema );
+            TrpBufferParser parser( text );
+
+            if ( !parser.parse() ) {
+                std::cerr << "trpcheck-static: generated an unparsable document: " << text << std::endl;
+                return 1;
+            }
+            for ( int mode = 0; mode < 3; mode++ ) {
+                TrpValidatorContext tree_ctx( mode == 1, mode == 2 ? 3 : 0 );
+                TrpValidatorContext static_ctx( mode == 1, mode == 2 ? 3 : 0 );
+                bool tree = schema.validate( parser.getAST(), tree_ctx );
+                bool checked = staticValidate( k, parser.getAST(), static_ctx );
+                std::string expected = trpCheckErrors( tree_ctx );
+                std::string actual = trpCheckErrors( static_ctx );
+
+                runs++;
+                if ( tree == checked && expected == actual ) continue;
+                if ( diffs++ < 5 ) {
+                    std::cout << "schema " << k << mode_names[mode] << ": " << text << "\n"
+                        << "tree " << tree << "\n" << expected << "static " << checked << "\n" << actual;
+                }
+            }
+        }
+    }
+    std::cout << "trpcheck-static: " << runs << " runs, " << diffs << " differences" << std::endl;
+    return diffs != 0;
+}
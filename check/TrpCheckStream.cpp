@@ -0,0 +1,63 @@
+#include "TrpCheckDocs.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+// TrpStreamingValidator against TrpSchema::validate over random documents.
+// The streaming validator records errors in token order, which can differ from
+// the tree's member order, so the error lists are compared sorted; fail-fast
+// compares the result only.
+
+static std::string sorted( const std::string& errors ) {
+    std::istringstream in( errors );
+    std::vector<std::string> lines;
+    std::string line;
+    std::string out;
+
+    while ( std::getline( in, line ) ) lines.push_back( line );
+    std::sort( lines.begin(), lines.end() );
+    for ( size_t i = 0; i < lines.size(); i++ ) out += lines[i] + "\n";
+    return out;
+}
+
+int main( int ac, char** av ) {
+    size_t docs = ac > 1 ? std::strtoul( av[1], NULL, 10 ) : 20000;
+    size_t runs = 0;
+    size_t diffs = 0;
+
+    for ( size_t k = 0; k < TRP_CHECK_SCHEMAS; k++ ) {
+        TrpSchemaFactory factory;
+        TrpSchema& schema = trpCheckSchema( k, factory );
+        TrpStreamingValidator stream( schema );
+        TrpCheckDocs generator( k + 1 );
+
+        for ( size_t d = 0; d < docs; d++ ) {
+            std::string text = generator.generate( schema );
+            TrpBufferParser parser( text );
+
+            if ( !parser.parse() ) {
+                std::cerr << "trpcheck-stream: generated an unparsable document: " << text << std::endl;
+                return 1;
+            }
+            for ( int fail_fast = 0; fail_fast < 2; fail_fast++ ) {
+                TrpValidatorContext tree_ctx( fail_fast );
+                TrpValidatorContext stream_ctx( fail_fast );
+                TrpBufferLexer lexer( text.data(), text.size() );
+                bool tree = schema.validate( parser.getAST(), tree_ctx );
+                bool streamed = stream.validate( lexer, stream_ctx );
+                std::string expected = fail_fast ? "" : sorted( trpCheckErrors( tree_ctx ) );
+                std::string actual = fail_fast ? "" : sorted( trpCheckErrors( stream_ctx ) );
+
+                runs++;
+                if ( tree == streamed && expected == actual ) continue;
+                if ( diffs++ < 5 ) {
+                    std::cout << "schema " << k << (fail_fast ? " fail-fast" : "") << ": " << text << "\n"
+                        << "tree " << tree << "\n" << expected << "stream " << streamed << "\n" << actual;
+                }
+            }
+        }
+    }
+    std::cout << "trpcheck-stream: " << runs << " runs, " << diffs << " differences" << std::endl;
+    return diffs != 0;
+}
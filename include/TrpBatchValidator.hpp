@@ -0,0 +1,38 @@
+#pragma once
+
+#include "TrpStreamingValidator.hpp"
+
+#ifndef TRPBATCHVALIDATOR_HPP
+#define TRPBATCHVALIDATOR_HPP
+
+struct TrpBatchStats {
+    size_t docs;
+    size_t passed;
+    size_t failed;
+    size_t bytes;
+    double seconds;
+};
+
+// Validates a JSON Lines stream: the calling thread reads batches of lines,
+// `threads` workers validate them against the shared (read-only) schema and
+// a writer thread prints one result per line, in input order:
+//
+//     <line>\tok
+//     <line>\tfail\t<path>: <message>
+//
+// Blank lines are skipped. Each document stops at its first error.
+class TrpBatchValidator {
+    private:
+        const TrpSchema& schema;
+        size_t threads;
+        size_t batch_lines;
+
+    public:
+        TrpBatchValidator( const TrpSchema& _schema, size_t _threads = 1 );
+
+        TrpBatchValidator& batchSize( size_t _lines );
+
+        TrpBatchStats run( std::istream& in, std::ostream& out );
+};
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../lib/TrpJson.hpp"
+
+#ifndef TRPBUFFERLEXER_HPP
+#define TRPBUFFERLEXER_HPP
+
+// Tokenizes a JSON document that is already in memory. Produces the same
+// tokens as TrpJsonLexer (values unescaped, 0-based line/col) but never
+// copies the input: the buffer must outlive the lexer.
+class TrpBufferLexer {
+    private:
+        const char* start;
+        const char* cur;
+        const char* end;
+        size_t line;
+        const char* line_start;
+
+        void skipWhitespace( void );
+        void readString( token& tok );
+        void readNumber( token& tok );
+        void readLiteral( token& tok );
+        bool skipString( void );
+        void errorToken( token& tok, const std::string& message );
+
+    public:
+        TrpBufferLexer( const char* _data, size_t _size );
+        explicit TrpBufferLexer( const std::string& _data );
+
+        token getNextToken( void );
+        // same as getNextToken() but reuses tok.value's storage
+        void nextToken( token& tok );
+        // Moves past the next value without tokenizing it: brackets are
+        // counted and strings delimited, nothing else is checked. When there
+        // is no value, or it never ends, `tok` is the offending token.
+        bool skipValue( token& tok );
+
+        void reset( void );
+        void reset( const char* _data, size_t _size );
+        size_t offset( void ) const;
+        const char* data( void ) const { return start; }
+        size_t size( void ) const { return end - start; }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "TrpBufferLexer.hpp"
+#include "TrpMappedFile.hpp"
+#include "TrpJsonHash.hpp"
+
+#ifndef TRPBUFFERPARSER_HPP
+#define TRPBUFFERPARSER_HPP
+
+class TrpSchema;
+
+// Builds the same DOM as TrpJsonParser from an in-memory buffer, or from a
+// file mapped with mmap, without going through std::ifstream lines. Unlike
+// TrpJsonParser, anything but whitespace after the root value is an error.
+// The AST belongs to the parser unless release() is called.
+class TrpBufferParser {
+    private:
+        TrpBufferLexer lexer;
+        TrpMappedFile file;
+        ITrpJsonValue* head;
+        bool parsed;
+        token current;
+        token last_err;
+
+        bool hashing;
+        TrpJsonHashCache hashes;
+
+        // `hash` is NULL unless hashing is on, `shape` unless projecting
+        ITrpJsonValue* parseValue( size_t* hash, const TrpSchema* shape );
+        ITrpJsonValue* parseObject( size_t* hash, const TrpSchema* shape );
+        ITrpJsonValue* parseArray( size_t* hash, const TrpSchema* shape );
+        bool parseRoot( const TrpSchema* shape );
+        ITrpJsonValue* fail( const std::string& message );
+
+        TrpBufferParser( const TrpBufferParser& );
+        TrpBufferParser& operator=( const TrpBufferParser& );
+
+    public:
+        TrpBufferParser( void );
+        TrpBufferParser( const char* _data, size_t _size );
+        explicit TrpBufferParser( const std::string& _data );
+        ~TrpBufferParser();
+
+        // Maps `file_name` and makes it the input
+        bool openFile( const std::string& file_name );
+        void setBuffer( const char* _data, size_t _size );
+
+        bool parse( void );
+        // Projection: only what validating against `schema` looks at becomes
+        // nodes. Values of keys an object schema does not declare are
+        // skipped by TrpBufferLexer::skipValue(), unchecked; they are kept
+        // as nulls only when the object has min/max, which counts them.
+        // Unions, uniq arrays and items of arrays with both item and tuple
+        // schemas are parsed in full. The AST is only fit for `schema`.
+        bool parse( const TrpSchema& schema );
+        ITrpJsonValue* getAST( void ) const { return head; }
+        ITrpJsonValue* release( void );
+        bool isParsed( void ) const { return parsed; }
+        const token& getLastError( void ) const { return last_err; }
+        void clearAST( void );
+
+        // Computes the structural hash of every container while parsing,
+        // for TrpValidatorContext::setDocumentHashes() and the memo cache.
+        void computeHashes( bool _enabled = true ) { hashing = _enabled; }
+        TrpJsonHashCache& getHashes( void ) { return hashes; }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "TrpSchemaArray.hpp"
+#include "TrpSchemaBool.hpp"
+#include "TrpSchemaNumber.hpp"
+#include "TrpSchemaObject.hpp"
+#include "TrpSchemaString.hpp"
+#include "TrpSchemaUnion.hpp"
+
+#ifndef TRPCOMPILEDSCHEMA_HPP
+#define TRPCOMPILEDSCHEMA_HPP
+
+#define TRP_NO_NODE 0xffffffffu
+
+enum TrpOpcode
+{
+    OP_STRING,
+    OP_NUMBER,
+    OP_BOOLEAN,
+    OP_NULL,
+    OP_OBJECT,
+    OP_ARRAY,
+    OP_UNION,       // branches in slots, picked by the source union
+    OP_REJECT,      // declared slot without a schema, fails silently
+    OP_DELEGATE     // schema type the compiler does not know, calls validate()
+};
+
+enum TrpNodeFlag
+{
+    NODE_HAS_MIN = 1 << 0,
+    NODE_HAS_MAX = 1 << 1,
+    NODE_UNIQ = 1 << 2,
+    NODE_CODE_POINTS = 1 << 3,  // string length in code points
+    NODE_FORMAT = 1 << 4,
+    NODE_PATTERN = 1 << 5,      // string: the source schema's regex
+    NODE_ENUM = 1 << 6,         // the source's enum set; bool: constant in count
+    NODE_INTEGER = 1 << 7,
+    NODE_MULTIPLE = 1 << 8      // number: the source's multipleOf
+};
+
+// One schema node. Children are referenced by index, never by pointer, so
+// the program is a handful of contiguous arrays.
+struct TrpCompiledNode {
+    unsigned int op;
+    unsigned int flags;
+    unsigned int item;          // array: item node or TRP_NO_NODE
+    unsigned int first;         // object: first key entry, array/union: first slot
+    unsigned int count;         // object: key entries, array: tuple length, union: branches, string: format
+    double min_value;
+    double max_value;
+};
+
+// Object keys, sorted the same way as JsonObjectMap so lookups are a merge
+struct TrpCompiledKey {
+    unsigned int name;          // offset in the string pool
+    unsigned int length;
+    unsigned int node;
+    unsigned int required;
+};
+
+// A finished schema flattened into one immutable program. The fluent
+// TrpSchema tree stays the front end: compile it once, then validate
+// through the program. Error messages come from the source schema nodes,
+// which must outlive the program.
+class TrpCompiledSchema {
+    private:
+        std::vector<TrpCompiledNode> nodes;
+        std::vector<TrpCompiledKey> keys;
+        std::vector<unsigned int> slots;        // tuple children
+        std::string pool;
+
+        std::vector<const TrpSchema*> sources;
+        std::vector<const std::string*> key_names;
+
+        unsigned int emit( const TrpSchema* schema, std::map<const TrpSchema*, unsigned int>& seen );
+        bool run( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool runObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+        bool runArray( unsigned int index, TrpJsonArray* arr, TrpValidatorContext& ctx ) const;
+        bool runMemo( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        int compareKey( const std::string& key, const TrpCompiledKey& entry ) const;
+        bool splitObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+
+        // TrpSplitBody ranges of runArray() / splitObject()
+        class ItemRange;
+        class MemberRange;
+        friend class ItemRange;
+        friend class MemberRange;
+
+    public:
+        TrpCompiledSchema( void );
+        explicit TrpCompiledSchema( const TrpSchema& root );
+
+        void compile( const TrpSchema& root );
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+
+        size_t size( void ) const { return nodes.size(); }
+        bool empty( void ) const { return nodes.empty(); }
+};
+
+#endif
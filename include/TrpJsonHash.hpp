@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../lib/TrpJson.hpp"
+
+#ifndef TRPJSONHASH_HPP
+#define TRPJSONHASH_HPP
+
+// Structural hash of a JSON value. Equal values (trpJsonEqual) always hash
+// the same: object members are combined order-independently and -0 hashes
+// like 0.
+size_t trpJsonHash( ITrpJsonValue* value );
+
+// Hashes of the containers of one document, keyed by address. Valid only
+// while that document is alive: clear() it before the AST goes away.
+class TrpJsonHashCache {
+    private:
+        struct Entry {
+            ITrpJsonValue* value;
+            size_t hash;
+        };
+
+        std::vector<Entry> slots;
+        size_t count;
+
+        void grow( void );
+
+    public:
+        TrpJsonHashCache( void );
+
+        bool find( ITrpJsonValue* value, size_t& hash ) const;
+        void insert( ITrpJsonValue* value, size_t hash );
+        void clear( void );
+        size_t size( void ) const { return count; }
+};
+
+// Same value as trpJsonHash(). Every container hashed on the way is stored
+// in `cache`, so asking again for any subtree of it is a lookup.
+size_t trpJsonHash( ITrpJsonValue* value, TrpJsonHashCache& cache );
+
+// The steps trpJsonHash() combines containers with, for producers that see
+// a document bottom-up (TrpBufferParser). An array folds its items in order
+// from 0 then closes with its size; an object sums its members.
+size_t trpJsonHashItem( size_t h, size_t item );
+size_t trpJsonHashArray( size_t h, size_t size );
+size_t trpJsonHashMember( const std::string& key, size_t value );
+size_t trpJsonHashObject( size_t sum, size_t size );
+
+// Deep structural equality, numbers compared with ==
+bool trpJsonEqual( ITrpJsonValue* a, ITrpJsonValue* b );
+
+// Canonical bytes of a value, appended to `out`: a copy of it that outlives
+// the document, for trpJsonEqualEncoded(). Members go in key order and -0 is
+// written as 0, so equal values encode the same.
+void trpJsonEncode( ITrpJsonValue* value, std::string& out );
+
+// trpJsonEqual() against the bytes trpJsonEncode() wrote for the other value,
+// without decoding them
+bool trpJsonEqualEncoded( ITrpJsonValue* value, const std::string& image );
+
+// Indices of the items of `arr` equal to an earlier one, in order, into
+// `duplicates` (cleared first). False when there is none.
+bool trpJsonDuplicates( TrpJsonArray* arr, std::vector<size_t>& duplicates );
+
+#endif
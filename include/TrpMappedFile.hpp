@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#ifndef TRPMAPPEDFILE_HPP
+#define TRPMAPPEDFILE_HPP
+
+// Read-only mmap of a whole file, to hand to TrpBufferLexer/TrpBufferParser.
+// The mapping lives as long as the object: tokens and DOM values copy what
+// they keep, so it can be closed once parsing or validation is done.
+class TrpMappedFile {
+    private:
+        const char* _data;
+        size_t _size;
+        bool is_open;
+        std::string error;
+
+        TrpMappedFile( const TrpMappedFile& );
+        TrpMappedFile& operator=( const TrpMappedFile& );
+
+    public:
+        TrpMappedFile( void );
+        explicit TrpMappedFile( const std::string& file_name );
+        ~TrpMappedFile();
+
+        bool open( const std::string& file_name );
+        void close( void );
+
+        bool isOpen( void ) const { return is_open; }
+        const char* data( void ) const { return _data; }
+        size_t size( void ) const { return _size; }
+        const std::string& getError( void ) const { return error; }
+};
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#ifndef TRPNUMBERSCAN_HPP
+#define TRPNUMBERSCAN_HPP
+
+// Inclusive bounds, exclusive ones already moved to the next double inward;
+// -inf / +inf when unbounded
+struct TrpNumberRange {
+    double lo;
+    double hi;
+    bool integer;
+};
+
+// True when every value lies in the range (and is integral if asked). Two
+// doubles at a time with SSE2, four with AVX when the CPU has it.
+bool trpNumbersInRange( const double* values, size_t count, const TrpNumberRange& range );
+
+#endif
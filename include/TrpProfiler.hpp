@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#ifndef TRPPROFILER_HPP
+#define TRPPROFILER_HPP
+
+enum TrpProfileMetric
+{
+    PROFILE_TIME,       // exclusive nanoseconds
+    PROFILE_BYTES,      // exclusive bytes allocated
+    PROFILE_VISITS
+};
+
+// Per schema path totals, as reported
+struct TrpProfileEntry {
+    std::string path;       // .users[].address.zip, "$" for the root
+    size_t visits;
+    size_t failures;        // visits during which an error was recorded
+    double inclusive_ns;
+    double exclusive_ns;
+    size_t inclusive_bytes;
+    size_t exclusive_bytes;
+};
+
+// Cost of validation by schema path rather than by C++ function. Attach it
+// with TrpValidatorContext::setProfiler(): every pushKey()/pushIndex() the
+// validators make opens a frame on the node of that path, popPath() closes
+// it, so the tree, compiled, streaming and tape validators all report the
+// same way. Array items share one node ("[]"). Time is read from the TSC on
+// x86 (clock_gettime elsewhere) and converted to nanoseconds when reported.
+//
+// start() and stop() bracket one document and time the root itself; without
+// them the root only groups its members. Union trials and split ranges run
+// in contexts of their own, their cost is the cost of the union or of the
+// container. Not thread safe: one profiler per context.
+class TrpProfiler {
+    private:
+        struct Node {
+            size_t parent;
+            const std::string* key;     // NULL for an array item
+            size_t visits;
+            size_t failures;
+            uint64_t inclusive;
+            uint64_t exclusive;
+            size_t inclusive_bytes;
+            size_t exclusive_bytes;
+        };
+
+        struct Frame {
+            size_t node;
+            uint64_t start;
+            uint64_t children;          // ticks spent in child frames
+            size_t start_bytes;
+            size_t child_bytes;
+            size_t errors;              // error count when it opened
+        };
+
+        std::vector<Node> nodes;        // nodes[0] is the root
+        std::vector<size_t> slots;      // (parent, key) -> node + 1, open addressing
+        std::vector<Frame> frames;
+        size_t errors;
+        const size_t* allocated;
+
+        uint64_t origin_ticks;          // when the profile was cleared
+        uint64_t origin_ns;
+
+        size_t findChild( size_t parent, const std::string* key );
+        void insertSlot( size_t node );
+        void open( size_t node );
+        double nsPerTick( void ) const;
+        void appendPath( std::string& out, size_t node, bool folded ) const;
+        size_t readBytes( void ) const { return allocated ? *allocated : 0; }
+
+        TrpProfiler( const TrpProfiler& other );
+        TrpProfiler& operator=( const TrpProfiler& other );
+
+    public:
+        TrpProfiler( void );
+
+        // `bytes` is a running total of bytes allocated kept by the
+        // application (e.g. by its operator new), NULL to not count them
+        void setAllocationCounter( const size_t* bytes );
+
+        void start( void );
+        void stop( void );
+
+        // Called by TrpValidatorContext
+        void enterKey( const std::string& key ) { open( findChild( frames.empty() ? 0 : frames.back().node, &key ) ); }
+        void enterIndex( void ) { open( findChild( frames.empty() ? 0 : frames.back().node, NULL ) ); }
+        void leave( void );
+        void countError( void ) { errors++; }
+
+        // Drops the totals, keeps the buffers
+        void clear( void );
+
+        // One entry per schema path, nodes reached through different
+        // schemas (union branches) merged, sorted by exclusive time
+        std::vector<TrpProfileEntry> getEntries( void ) const;
+
+        // Brendan Gregg's folded stacks, "$;.users;[];.zip 1234" per line,
+        // for flamegraph.pl
+        void writeFolded( std::ostream& out, TrpProfileMetric metric = PROFILE_TIME ) const;
+        // The `top` most expensive paths by exclusive time, 0 for all
+        void printTable( std::ostream& out, size_t top = 20 ) const;
+};
+
+#endif
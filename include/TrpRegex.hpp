@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#ifndef TRPREGEX_HPP
+#define TRPREGEX_HPP
+
+#define TRP_REGEX_MAX_STATES 4096
+#define TRP_REGEX_NO_STATE 0xffffffffu
+
+// A pattern compiled once into a DFA over byte classes. match() is one table
+// lookup per byte: linear time, no allocation, no backtracking.
+//
+// Searches like JSON Schema's `pattern`: the match may be anywhere unless
+// the pattern starts with ^ / ends with $. Supported: literals, ., [...]
+// and [^...] (ASCII ranges), \d \w \s and their negations, \t \n \r \f \v
+// \xHH \uHHHH, (...) and (?:...), |, * + ? {n} {n,} {n,m} (lazy forms
+// match the same strings). . and negated classes consume a whole UTF-8
+// character. No backreferences, lookaround or \b, and ^ / $ only at the
+// ends of the pattern: compile() refuses them, and a pattern that failed to
+// compile matches nothing.
+class TrpRegex {
+    private:
+        std::string source;
+        std::string error;
+
+        unsigned char classes[256];         // byte -> equivalence class
+        unsigned int class_count;
+        std::vector<unsigned int> table;    // row + class -> row of the next state
+        std::vector<unsigned char> accepting;
+        unsigned int start;                 // rows are state * class_count
+        unsigned int dead;                  // no match possible any more, or TRP_REGEX_NO_STATE
+        bool anchored_end;
+
+    public:
+        TrpRegex( void );
+        explicit TrpRegex( const std::string& pattern );
+
+        bool compile( const std::string& pattern );
+
+        bool match( const char* data, size_t size ) const;
+        bool match( const std::string& str ) const { return match( str.data(), str.size() ); }
+
+        bool isValid( void ) const { return !table.empty(); }
+        const std::string& getSource( void ) const { return source; }
+        const std::string& getError( void ) const { return error; }
+        size_t stateCount( void ) const { return accepting.size(); }
+};
+
+#endif
@@ -14,6 +14,10 @@ class TrpSchemaArray : public TrpSchema {
         bool has_min;
         size_t max_items, min_items;
 
+        bool validateItems( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+
+        friend class TrpSchemaFactory;      // intern() rewrites the children
+
     public:
         TrpSchemaArray();
 
@@ -25,5 +29,17 @@ class TrpSchemaArray : public TrpSchema {
         TrpSchemaArray& uniq(bool uniq);
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkSize( size_t size, TrpValidatorContext& ctx ) const;
+        bool checkTupleSize( size_t size, TrpValidatorContext& ctx ) const;
+        bool checkUniq( TrpJsonArray* arr, TrpValidatorContext& ctx ) const;
+        void reportDuplicate( size_t index, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_ARRAY; }
+
+        const TrpSchema* getItem( void ) const { return _item; }
+        const SchemaVec& getTuple( void ) const { return _tuple; }
+        bool isUniq( void ) const { return _uniq; }
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_items; }
+        size_t getMax( void ) const { return max_items; }
 };
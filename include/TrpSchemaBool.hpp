@@ -3,7 +3,19 @@
 #include "TrpSchema.hpp"
 
 class TrpSchemaBool : public TrpSchema {
+    private:
+        bool has_const;
+        bool const_value;
+
     public:
+        TrpSchemaBool( void );
+
+        TrpSchemaBool& constant( bool value );
+
         bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
-        TrpSchemaType getType( void ) const { return SCHEMA_OBJECT; }
+        bool checkValue( bool value, TrpValidatorContext& ctx ) const;
+        SchemaType getType( void ) const { return SCHEMA_BOOLEAN; }
+
+        bool hasConst( void ) const { return has_const; }
+        bool getConst( void ) const { return const_value; }
 };
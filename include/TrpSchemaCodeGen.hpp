@@ -0,0 +1,67 @@
+#pragma once
+
+#include "TrpSchemaArray.hpp"
+#include "TrpSchemaBool.hpp"
+#include "TrpSchemaNumber.hpp"
+#include "TrpSchemaObject.hpp"
+#include "TrpSchemaString.hpp"
+#include "TrpSchemaUnion.hpp"
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#ifndef TRPSCHEMACODEGEN_HPP
+#define TRPSCHEMACODEGEN_HPP
+
+// Writes a schema tree out as a C++98 translation unit: one static function
+// per schema node with its bounds, keys and constants inlined, and a single
+// entry point
+//   bool <name>( ITrpJsonValue* value, TrpValidatorContext& ctx );
+// that records the same errors as root.validate(), but with no virtual
+// call into schema nodes and no schema to keep alive. The unit includes
+// "TrpSchema.hpp" (the single header in lib/) and links against
+// libtrpschema.a. Memoization and parallel splitting are left to the
+// schema tree: generated code ignores both context settings. Shared and
+// self-referencing nodes become one function each.
+class TrpSchemaCodeGen {
+    private:
+        std::map<const TrpSchema*, size_t> numbers;
+        std::vector<const TrpSchema*> nodes;    // in function order
+        std::vector<std::string> paths;         // first path each node was reached by
+        std::map<std::string, std::string> strings; // text -> its constant
+        std::ostringstream constants;
+        std::ostringstream functions;
+        size_t constant_count;
+        std::string error;
+
+        size_t number( const TrpSchema* schema, const std::string& path );
+        std::string stringConstant( const std::string& value );
+        std::string setConstant( const std::vector<std::string>& values, TrpValueSet& set );
+        std::string enumTest( const TrpValueSet& values, const std::string& data, const std::string& size );
+
+        bool emitNode( size_t index );
+        void emitString( const TrpSchemaString& schema, std::ostream& out );
+        void emitNumber( const TrpSchemaNumber& schema, std::ostream& out );
+        void emitBool( const TrpSchemaBool& schema, std::ostream& out );
+        void emitObject( const TrpSchemaObject& schema, const std::string& path, std::ostream& out );
+        void emitArray( const TrpSchemaArray& schema, const std::string& path, std::ostream& out );
+        void emitUnion( const TrpSchemaUnion& schema, const std::string& path, std::ostream& out );
+        void emitTrial( const TrpSchemaUnion& schema, const std::vector<size_t>& candidates,
+            const std::string& path, const std::string& indent, std::ostream& out );
+        std::string call( const TrpSchema* schema, const std::string& path, const std::string& value, const std::string& ctx );
+
+        TrpSchemaCodeGen( const TrpSchemaCodeGen& );
+        TrpSchemaCodeGen& operator=( const TrpSchemaCodeGen& );
+
+    public:
+        TrpSchemaCodeGen( void );
+
+        // The unit for `root` into `out`, false (and nothing written) when
+        // `name` is not an identifier or a node has no generated form
+        bool generate( const TrpSchema& root, const std::string& name, std::ostream& out );
+
+        const std::string& getError( void ) const { return error; }
+};
+
+#endif
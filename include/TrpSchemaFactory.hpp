@@ -6,13 +6,50 @@
 #include "TrpSchemaNumber.hpp"
 #include "TrpSchemaObject.hpp"
 #include "TrpSchemaString.hpp"
+#include "TrpSchemaUnion.hpp"
 #include <vector>
+#include <map>
+#include <new>
+
+#define TRP_ARENA_BLOCK 16384
+
+enum TrpFactoryMode
+{
+    FACTORY_HEAP,       // one new/delete per schema
+    FACTORY_ARENA       // schemas bump-allocated from large blocks
+};
 
 class TrpSchemaFactory {
     private:
         std::vector<TrpSchema*> _managedSchemas;
 
+        TrpFactoryMode mode;
+        size_t block_size;
+        std::vector<char*> blocks;
+        size_t current;             // block being filled
+        size_t used;                // bytes used in blocks[current]
+
+        void* allocate( size_t size );
+        void release( void );
+
+        // signature -> canonical node, see intern()
+        std::map<std::string, TrpSchema*> interned;
+
+        TrpSchema* internNode( TrpSchema* schema, std::map<TrpSchema*, TrpSchema*>& seen, bool& open );
+
+        template <typename T>
+        T& create( void ) {
+            T* schema = mode == FACTORY_ARENA ? new (allocate(sizeof(T))) T() : new T();
+            _managedSchemas.push_back(schema);
+            return *schema;
+        }
+
+        TrpSchemaFactory( const TrpSchemaFactory& );
+        TrpSchemaFactory& operator=( const TrpSchemaFactory& );
+
     public:
+        TrpSchemaFactory( void );
+        explicit TrpSchemaFactory( TrpFactoryMode _mode, size_t _block_size = TRP_ARENA_BLOCK );
         ~TrpSchemaFactory();
 
         TrpSchemaString& string();
@@ -21,4 +58,29 @@ class TrpSchemaFactory {
         TrpSchemaObject& object();
         TrpSchemaArray& array();
         TrpSchemaNull& null();
-};
\ No newline at end of file
+        TrpSchemaUnion& anyOf();
+        TrpSchemaUnion& oneOf();
+
+        // Destroys every schema made so far, one destructor each. Arena
+        // blocks are kept and refilled by the next schemas, so a rebuild
+        // allocates no node; their members still use the heap.
+        void reset( void );
+
+        // Hash-consing pass over a finished schema: structurally identical
+        // nodes, whole objects and arrays included, are collapsed into one
+        // shared instance, also across calls. Use the returned root; nodes
+        // that were merged away stay owned by the factory until reset().
+        // Nodes on a reference cycle and unknown schema types are kept as is.
+        template <typename T>
+        T& intern( T& root ) {
+            std::map<TrpSchema*, TrpSchema*> seen;
+            bool open = false;
+            return static_cast<T&>(*internNode(&root, seen, open));
+        }
+
+        size_t internedSize( void ) const { return interned.size(); }
+
+        TrpFactoryMode getMode( void ) const { return mode; }
+        size_t size( void ) const { return _managedSchemas.size(); }
+        size_t blockCount( void ) const { return blocks.size(); }
+};
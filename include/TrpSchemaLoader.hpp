@@ -0,0 +1,58 @@
+#pragma once
+
+#include "TrpSchemaFactory.hpp"
+#include <string>
+
+#ifndef TRPSCHEMALOADER_HPP
+#define TRPSCHEMALOADER_HPP
+
+// Builds TrpSchema nodes from a JSON Schema document, through `factory`,
+// which owns them. The subset understood:
+//   type            "string", "number", "integer", "boolean", "object",
+//                   "array", "null", or an array of them (an anyOf)
+//   properties, required, minProperties, maxProperties
+//   items (a schema, or an array of schemas for a tuple of exactly that
+//   length, see TrpSchemaArray::tuple; the document must pin the length
+//   with minItems and maxItems, or minItems and additionalItems: false),
+//   additionalItems (a boolean), minItems, maxItems, uniqueItems
+//   minLength, maxLength, pattern (TrpRegex syntax; one it refuses fails
+//   the load)
+//   minimum, maximum, exclusiveMinimum, exclusiveMaximum (numbers, as in
+//   draft 6 and later), multipleOf
+// A keyword only applies to its type, like in JSON Schema. Annotations
+// ($schema, $id, title, description, ...) and additionalProperties: true
+// are ignored; any other keyword fails the load rather than be dropped
+// silently, and so does a required name that is not a property. Nodes of
+// a failed load stay in the factory until reset().
+class TrpSchemaLoader {
+    private:
+        TrpSchemaFactory& factory;
+        std::string error;
+
+        TrpSchema* loadSchema( ITrpJsonValue* value, const std::string& path );
+        TrpSchema* loadType( const std::string& type, TrpJsonObject* obj, const std::string& path );
+        bool loadObject( TrpSchemaObject& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadArray( TrpSchemaArray& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadNumber( TrpSchemaNumber& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadString( TrpSchemaString& schema, TrpJsonObject* obj, const std::string& path );
+        bool checkKeywords( TrpJsonObject* obj, const std::string& path );
+        bool readCount( TrpJsonObject* obj, const char* keyword, bool& found, size_t& count, const std::string& path );
+        bool readNumber( TrpJsonObject* obj, const char* keyword, bool& found, double& nbr, const std::string& path );
+        TrpSchema* fail( const std::string& path, const std::string& message );
+
+        TrpSchemaLoader( const TrpSchemaLoader& );
+        TrpSchemaLoader& operator=( const TrpSchemaLoader& );
+
+    public:
+        explicit TrpSchemaLoader( TrpSchemaFactory& _factory );
+
+        // The root schema, NULL on error. The document can go once loaded.
+        TrpSchema* load( ITrpJsonValue* document );
+        // Parses `file_name` with TrpJsonParser first
+        TrpSchema* loadFile( const std::string& file_name );
+
+        // "<JSON Pointer>: <what is wrong>" of the last failed load
+        const std::string& getError( void ) const { return error; }
+};
+
+#endif
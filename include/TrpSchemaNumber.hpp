@@ -1,19 +1,56 @@
 #pragma once
 
 #include "TrpSchema.hpp"
+#include "TrpValueSet.hpp"
+#include "TrpNumberScan.hpp"
 
 class TrpSchemaNumber : public TrpSchema {
     private:
         bool has_min, has_max;
-        size_t min_value, max_value;
-        
+        double min_value, max_value;
+        bool min_exclusive, max_exclusive;
+        bool is_integer;
+        double multiple;            // 0 when unset
+        bool has_enum;
+        TrpValueSet enum_values;    // of the numbers' bytes, see inEnum()
+
     public:
         TrpSchemaNumber();
 
-        TrpSchemaNumber& min( size_t _min_value );
-        TrpSchemaNumber& max( size_t _max_value );
+        // the last bound set on a side wins
+        TrpSchemaNumber& min( double _min_value );
+        TrpSchemaNumber& max( double _max_value );
+        TrpSchemaNumber& exclusiveMin( double _min_value );
+        TrpSchemaNumber& exclusiveMax( double _max_value );
+        TrpSchemaNumber& integer( bool _enabled = true );
+        TrpSchemaNumber& multipleOf( double _multiple );
+        TrpSchemaNumber& enumValues( const std::vector<double>& values );
+        TrpSchemaNumber& constant( double value );
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkNumber( double nbr, TrpValidatorContext& ctx ) const;
+        bool checkRange( double nbr, TrpValidatorContext& ctx ) const;
+        bool accepts( double nbr ) const;
+        bool inEnum( double nbr ) const;
+        bool isMultiple( double nbr ) const;
+        // accepts() for a packed run of values, range checked with SIMD
+        bool acceptsAll( const double* values, size_t count ) const;
+        // Items [first, last) of an array of which this is the item schema:
+        // packed 64 at a time and range checked in one go, a run is only
+        // walked value by value when the packed check fails. Valid items get
+        // no path, so the callers skip it when a profiler is attached.
+        bool validateItems( TrpJsonArray* arr, size_t first, size_t last, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_NUMBER; }
-};
 
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        double getMin( void ) const { return min_value; }
+        double getMax( void ) const { return max_value; }
+        bool isMinExclusive( void ) const { return min_exclusive; }
+        bool isMaxExclusive( void ) const { return max_exclusive; }
+        bool isInteger( void ) const { return is_integer; }
+        double getMultipleOf( void ) const { return multiple; }
+        bool hasEnum( void ) const { return has_enum; }
+        const TrpValueSet& getEnum( void ) const { return enum_values; }
+        TrpNumberRange getRange( void ) const;
+};
@@ -7,8 +7,15 @@ class TrpSchemaObject : public TrpSchema
     private:
         std::vector<std::string> required_entries;
         std::map<std::string, TrpSchema*> properties;
+        std::vector<bool> required_mask;
         bool has_min, has_max;
         size_t min_items, max_items;
+
+        void indexRequired( void );
+        bool validateMembers( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool validateSplit( TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+
+        friend class TrpSchemaFactory;      // intern() rewrites properties
     public:
         TrpSchemaObject();
 
@@ -18,5 +25,15 @@ class TrpSchemaObject : public TrpSchema
         TrpSchemaObject& max( size_t max_value);
 
         bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool checkSize( size_t size, TrpValidatorContext& ctx ) const;
+        void reportMissing( const std::string& key, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_OBJECT; }
+
+        const std::map<std::string, TrpSchema*>& getProperties( void ) const { return properties; }
+        const std::vector<std::string>& getRequired( void ) const { return required_entries; }
+        const std::vector<bool>& getRequiredMask( void ) const { return required_mask; }
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_items; }
+        size_t getMax( void ) const { return max_items; }
 };
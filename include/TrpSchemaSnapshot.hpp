@@ -0,0 +1,120 @@
+#pragma once
+
+#include "TrpSchemaFactory.hpp"
+#include "TrpMappedFile.hpp"
+#include <string>
+#include <stdint.h>
+
+#ifndef TRPSCHEMASNAPSHOT_HPP
+#define TRPSCHEMASNAPSHOT_HPP
+
+#define TRP_SNAPSHOT_MAGIC "TRPSNAP"
+#define TRP_SNAPSHOT_VERSION 1
+#define TRP_SNAPSHOT_BYTE_ORDER 0x01020304u
+#define TRP_SNAPSHOT_NONE 0xffffffffu
+
+enum TrpSnapshotFlag
+{
+    SNAP_HAS_MIN = 1 << 0,
+    SNAP_HAS_MAX = 1 << 1,
+    SNAP_MIN_EXCLUSIVE = 1 << 2,
+    SNAP_MAX_EXCLUSIVE = 1 << 3,
+    SNAP_INTEGER = 1 << 4,
+    SNAP_MULTIPLE = 1 << 5,
+    SNAP_UNIQ = 1 << 6,
+    SNAP_CODE_POINTS = 1 << 7,
+    SNAP_CONST = 1 << 8         // boolean: constant in `extra`
+};
+
+// The image: this header, then node_count nodes, key_count keys, slot_count
+// slots and pool_size bytes of key names. Everything refers to everything
+// else by index, so the image means the same wherever it is mapped.
+struct TrpSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // TRP_SNAPSHOT_BYTE_ORDER as written
+    uint32_t node_count;
+    uint32_t key_count;
+    uint32_t slot_count;
+    uint32_t pool_size;
+    uint64_t checksum;          // FNV-1a of everything after the header
+};
+
+struct TrpSnapshotNode {
+    uint32_t type;              // SchemaType
+    uint32_t flags;
+    uint32_t item;              // array: item node or TRP_SNAPSHOT_NONE
+    uint32_t first;             // object: first key, array/union: first slot
+    uint32_t count;             // object: keys, array: tuple length, union: branches
+    uint32_t extra;             // string: format, boolean: constant, union: mode
+    double min;
+    double max;
+    double multiple;
+};
+
+// An object's property, in key order
+struct TrpSnapshotKey {
+    uint32_t name;              // offset in the pool
+    uint32_t length;
+    uint32_t node;              // TRP_SNAPSHOT_NONE for a NULL schema
+    uint32_t required;
+};
+
+// Versioned binary image of a schema tree, for services that load many
+// schemas at startup: capture() once, writeFile(), then openFile() maps it
+// and checks it in place, and instantiate() builds the schema nodes straight
+// from the mapping, with no JSON to parse. Shared nodes and cycles survive
+// the round trip. Patterns, enums and discriminators are not in the format:
+// capture() refuses a schema using them. The image is in the writer's byte
+// order and a reader with another one refuses it.
+class TrpSchemaSnapshot {
+    private:
+        std::vector<uint64_t> buffer;   // the image capture() made, aligned
+        TrpMappedFile file;
+        const char* image;
+        size_t image_size;
+        std::string error;
+
+        const TrpSnapshotHeader* header;
+        const TrpSnapshotNode* nodes;
+        const TrpSnapshotKey* keys;
+        const uint32_t* slots;
+        const char* pool;
+
+        uint32_t emit( const TrpSchema* schema, const std::string& path, std::vector<TrpSnapshotNode>& out_nodes,
+            std::vector<TrpSnapshotKey>& out_keys, std::vector<uint32_t>& out_slots, std::string& out_pool,
+            std::map<const TrpSchema*, uint32_t>& seen );
+        bool attach( const char* data, size_t size );
+        bool fail( const std::string& message );
+        void detach( void );
+
+        TrpSchemaSnapshot( const TrpSchemaSnapshot& );
+        TrpSchemaSnapshot& operator=( const TrpSchemaSnapshot& );
+
+    public:
+        TrpSchemaSnapshot( void );
+
+        // Serializes `root` into an image of its own, false if the schema
+        // uses something the format cannot hold
+        bool capture( const TrpSchema& root );
+        bool writeFile( const std::string& file_name );
+
+        // Maps `file_name` and checks the header, the checksum and that
+        // every index is in bounds before anything reads it
+        bool openFile( const std::string& file_name );
+        // Same checks over an image in memory, which must stay alive and
+        // be 8-byte aligned
+        bool setBuffer( const char* data, size_t size );
+
+        // The root of a copy of the captured schema built through `factory`,
+        // NULL when there is no valid image
+        TrpSchema* instantiate( TrpSchemaFactory& factory ) const;
+
+        bool isValid( void ) const { return header != NULL; }
+        const char* data( void ) const { return image; }
+        size_t size( void ) const { return image_size; }
+        size_t nodeCount( void ) const { return header ? header->node_count : 0; }
+        const std::string& getError( void ) const { return error; }
+};
+
+#endif
@@ -0,0 +1,680 @@
+#pragma once
+
+#include "TrpSchemaUnion.hpp"
+#include "TrpStringFormat.hpp"
+#include "TrpRegex.hpp"
+#include "TrpJsonHash.hpp"
+#include <cmath>
+#include <cstring>
+
+#ifndef TRPSCHEMASTATIC_HPP
+#define TRPSCHEMASTATIC_HPP
+
+// A property name or enum value as a type: TRP_KEY( K_id, "id" );
+#define TRP_KEY( _type, _text ) \
+    struct _type { \
+        enum { size = sizeof(_text) - 1 }; \
+        static const char* data( void ) { return _text; } \
+        static const std::string& value( void ) { \
+            static const std::string text( _text, sizeof(_text) - 1 ); \
+            return text; \
+        } \
+    }
+
+// Schemas known at build time, as types:
+//
+//   TRP_KEY( K_id, "id" );
+//   TRP_KEY( K_tags, "tags" );
+//   typedef Object< Required<K_id, Number<Min<1>, Integer> >,
+//                   Prop<K_tags, Array<String<>, Uniq> > > Message;
+//   Message::validate( value, ctx );
+//
+// validate() is a static function with every bound, key and constant known
+// to the compiler, and child schemas inline into their parent: no virtual
+// call into schema nodes. It records the same errors, in the same order,
+// as the TrpSchemaFactory tree of the same schema, into the same
+// TrpValidatorContext. Errors carry no schema node (TrpErrorRecord::schema
+// is NULL). TrpStaticSchema<S> puts a static schema where a TrpSchema is
+// expected. A recursive schema is a struct deriving from its own definition:
+//   struct Node : Object< Prop<K_kids, Array<Node> > > {};
+//
+// Template arguments cannot be doubles, so bounds are ratios: Min<1, 8> is
+// 0.125, and only the numerator is used for lengths and sizes. Each option
+// is given once per schema; the order they are listed in does not matter.
+// Property names must be distinct. Memoization, parallel splitting and
+// discriminated unions are not available here.
+namespace TrpStatic
+{
+    struct Nil {};
+
+    template <typename H, typename T>
+    struct List {};
+
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil,
+        typename A9 = Nil, typename A10 = Nil, typename A11 = Nil, typename A12 = Nil,
+        typename A13 = Nil, typename A14 = Nil, typename A15 = Nil, typename A16 = Nil>
+    struct MakeList {
+        typedef List<A1, typename MakeList<A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12,
+            A13, A14, A15, A16>::type> type;
+    };
+
+    template <typename A2, typename A3, typename A4, typename A5, typename A6, typename A7, typename A8,
+        typename A9, typename A10, typename A11, typename A12, typename A13, typename A14, typename A15, typename A16>
+    struct MakeList<Nil, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12, A13, A14, A15, A16> {
+        typedef Nil type;
+    };
+
+    // Options
+    template <long N, long D = 1> struct Min {};
+    template <long N, long D = 1> struct Max {};
+    template <long N, long D = 1> struct ExclusiveMin {};
+    template <long N, long D = 1> struct ExclusiveMax {};
+    template <long N, long D = 1> struct MultipleOf {};
+    template <long N, long D = 1> struct Const {};      // number, or bool (N != 0)
+    struct Integer {};
+    struct CodePoints {};                               // string length in code points
+    struct Uniq {};
+    template <TrpStringFormat F> struct Format {};
+    template <typename K> struct Pattern {};            // K::value() is the source
+    template <typename K1, typename K2 = Nil, typename K3 = Nil, typename K4 = Nil,
+        typename K5 = Nil, typename K6 = Nil, typename K7 = Nil, typename K8 = Nil>
+    struct Enum {};                                     // string values
+    template <typename K, typename S> struct Prop {};
+    template <typename K, typename S> struct Required {};
+
+    typedef bool (*MemberStep)( JsonObjectMap::const_iterator&, JsonObjectMap::const_iterator, TrpValidatorContext&, bool& );
+
+    // What one option sets; everything else keeps these defaults
+    template <typename T>
+    struct Part {
+        enum {
+            has_min = 0, has_max = 0, min_exclusive = 0, max_exclusive = 0,
+            integer = 0, has_multiple = 0, has_const = 0, code_points = 0, uniq = 0,
+            format = 0, has_pattern = 0, has_enum = 0, enum_size = 0, is_prop = 0
+        };
+        static double min( void ) { return 0; }
+        static double max( void ) { return 0; }
+        static double multiple( void ) { return 0; }
+        static double constant( void ) { return 0; }
+        static const TrpRegex* pattern( void ) { return NULL; }
+        static const std::string* source( void ) { return NULL; }
+        static bool inEnum( const std::string& ) { return true; }
+        static bool step( JsonObjectMap::const_iterator&, JsonObjectMap::const_iterator, TrpValidatorContext&, bool& ) { return true; }
+        static const std::string* name( void ) { return NULL; }
+    };
+
+    template <long N, long D>
+    struct Part< Min<N, D> > : Part<Nil> {
+        enum { has_min = 1 };
+        static double min( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< Max<N, D> > : Part<Nil> {
+        enum { has_max = 1 };
+        static double max( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< ExclusiveMin<N, D> > : Part<Nil> {
+        enum { has_min = 1, min_exclusive = 1 };
+        static double min( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< ExclusiveMax<N, D> > : Part<Nil> {
+        enum { has_max = 1, max_exclusive = 1 };
+        static double max( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< MultipleOf<N, D> > : Part<Nil> {
+        enum { has_multiple = 1 };
+        static double multiple( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< Const<N, D> > : Part<Nil> {
+        enum { has_const = 1 };
+        static double constant( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <> struct Part<Integer> : Part<Nil> { enum { integer = 1 }; };
+    template <> struct Part<CodePoints> : Part<Nil> { enum { code_points = 1 }; };
+    template <> struct Part<Uniq> : Part<Nil> { enum { uniq = 1 }; };
+
+    template <TrpStringFormat F>
+    struct Part< Format<F> > : Part<Nil> {
+        enum { format = F };
+    };
+
+    template <typename K>
+    struct Part< Pattern<K> > : Part<Nil> {
+        enum { has_pattern = 1 };
+        static const TrpRegex* pattern( void ) {
+            static const TrpRegex regex( K::value() );
+            return &regex;
+        }
+        static const std::string* source( void ) { return &K::value(); }
+    };
+
+    template <typename L>
+    struct Values {
+        enum { size = 0 };
+        static bool contains( const std::string& ) { return false; }
+    };
+
+    template <typename H, typename T>
+    struct Values< List<H, T> > {
+        enum { size = 1 + Values<T>::size };
+        static bool contains( const std::string& value ) { return value == H::value() || Values<T>::contains( value ); }
+    };
+
+    template <typename K1, typename K2, typename K3, typename K4, typename K5, typename K6, typename K7, typename K8>
+    struct Part< Enum<K1, K2, K3, K4, K5, K6, K7, K8> > : Part<Nil> {
+        typedef Values<typename MakeList<K1, K2, K3, K4, K5, K6, K7, K8>::type> Set;
+        enum { has_enum = 1, enum_size = Set::size };
+        static bool inEnum( const std::string& value ) { return Set::contains( value ); }
+    };
+
+    // TrpSchemaObject::validateMembers() for one property: skip the smaller
+    // keys of the document, then the property is either the next key or
+    // missing
+    template <typename K, typename S, bool required>
+    struct Member : Part<Nil> {
+        enum { is_prop = 1 };
+        static const std::string* name( void ) { return &K::value(); }
+
+        // std::string::compare() against the literal
+        static int compare( const std::string& key ) {
+            const size_t size = K::size;
+            int diff = std::memcmp( key.data(), K::data(), key.size() < size ? key.size() : size );
+
+            if ( diff ) return diff;
+            if ( key.size() == size ) return 0;
+            return key.size() < size ? -1 : 1;
+        }
+        static bool step( JsonObjectMap::const_iterator& it, JsonObjectMap::const_iterator end, TrpValidatorContext& ctx, bool& got_error ) {
+            int diff = 0;
+
+            while ( it != end && (diff = compare( it->first )) < 0 ) it++;
+            if ( it != end && !diff ) {
+                ctx.pushKey( K::value() );
+                if ( !S::validate( it->second, ctx ) ) got_error = true;
+                ctx.popPath();
+                it++;
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            } else if ( required ) {
+                ctx.pushError( ERR_MISSING_PROPERTY, SCHEMA_OBJECT, K::value() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            return true;
+        }
+    };
+
+    template <typename K, typename S> struct Part< Prop<K, S> > : Member<K, S, false> {};
+    template <typename K, typename S> struct Part< Required<K, S> > : Member<K, S, true> {};
+
+    // The options of a whole list, each taken from the part that sets it
+    template <typename L>
+    struct Options : Part<Nil> {
+        enum { props = 0 };
+        static void members( const std::string**, MemberStep* ) {}
+    };
+
+    template <typename H, typename T>
+    struct Options< List<H, T> > {
+        typedef Part<H> A;
+        typedef Options<T> B;
+
+        enum {
+            has_min = A::has_min || B::has_min,
+            has_max = A::has_max || B::has_max,
+            min_exclusive = A::has_min ? static_cast<int>(A::min_exclusive) : static_cast<int>(B::min_exclusive),
+            max_exclusive = A::has_max ? static_cast<int>(A::max_exclusive) : static_cast<int>(B::max_exclusive),
+            integer = A::integer || B::integer,
+            has_multiple = A::has_multiple || B::has_multiple,
+            has_const = A::has_const || B::has_const,
+            code_points = A::code_points || B::code_points,
+            uniq = A::uniq || B::uniq,
+            format = A::format > 0 ? static_cast<int>(A::format) : static_cast<int>(B::format),
+            has_pattern = A::has_pattern || B::has_pattern,
+            has_enum = A::has_enum || B::has_enum,
+            enum_size = A::enum_size + B::enum_size,
+            props = A::is_prop + B::props
+        };
+
+        static double min( void ) { return A::has_min ? A::min() : B::min(); }
+        static double max( void ) { return A::has_max ? A::max() : B::max(); }
+        static double multiple( void ) { return A::has_multiple ? A::multiple() : B::multiple(); }
+        static double constant( void ) { return A::has_const ? A::constant() : B::constant(); }
+        static const TrpRegex* pattern( void ) { return A::has_pattern ? A::pattern() : B::pattern(); }
+        static const std::string* source( void ) { return A::has_pattern ? A::source() : B::source(); }
+        static bool inEnum( const std::string& value ) { return A::has_enum ? A::inEnum( value ) : B::inEnum( value ); }
+
+        // the properties, in the order they are listed
+        static void members( const std::string** names, MemberStep* steps ) {
+            if ( A::is_prop ) {
+                *names++ = A::name();
+                *steps++ = &A::step;
+            }
+            B::members( names, steps );
+        }
+    };
+
+    // Property steps in key order, the order the tree walks them in;
+    // sorted once, on first use
+    template <typename L>
+    struct PropOrder {
+        MemberStep steps[Options<L>::props + 1];
+
+        PropOrder( void ) {
+            const std::string* names[Options<L>::props + 1];
+
+            Options<L>::members( names, steps );
+            for ( size_t i = 1; i < static_cast<size_t>(Options<L>::props); i++ ) {
+                const std::string* name = names[i];
+                MemberStep step = steps[i];
+                size_t j = i;
+
+                for ( ; j > 0 && *names[j - 1] > *name; j-- ) {
+                    names[j] = names[j - 1];
+                    steps[j] = steps[j - 1];
+                }
+                names[j] = name;
+                steps[j] = step;
+            }
+        }
+    };
+
+    // Union branches, by the JSON type they take (TRP_ERROR: any)
+    template <typename L>
+    struct Branches {
+        enum { mask = 0, size = 0 };
+        static size_t count( TrpJsonType ) { return 0; }
+        static bool validateOnly( TrpJsonType, ITrpJsonValue*, TrpValidatorContext& ) { return false; }
+        static bool tryAny( TrpJsonType, ITrpJsonValue* ) { return false; }
+        static void tryOne( TrpJsonType, ITrpJsonValue*, size_t& ) {}
+    };
+
+    template <typename H, typename T>
+    struct Branches< List<H, T> > {
+        enum {
+            mask = (H::json_type == TRP_ERROR ? (1u << TRP_UNION_TYPES) - 1 : 1u << H::json_type) | Branches<T>::mask,
+            size = 1 + Branches<T>::size
+        };
+
+        static bool takes( TrpJsonType type ) {
+            return H::json_type == TRP_ERROR || H::json_type == type;
+        }
+        static size_t count( TrpJsonType type ) { return (takes( type ) ? 1 : 0) + Branches<T>::count( type ); }
+        static bool validateOnly( TrpJsonType type, ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( takes( type ) ) return H::validate( value, ctx );
+            return Branches<T>::validateOnly( type, value, ctx );
+        }
+        static bool tryAny( TrpJsonType type, ITrpJsonValue* value ) {
+            if ( takes( type ) ) {
+                TrpValidatorContext scratch( true );
+                if ( H::validate( value, scratch ) ) return true;
+            }
+            return Branches<T>::tryAny( type, value );
+        }
+        static void tryOne( TrpJsonType type, ITrpJsonValue* value, size_t& matches ) {
+            if ( matches >= 2 ) return;
+            if ( takes( type ) ) {
+                TrpValidatorContext scratch( true );
+                if ( H::validate( value, scratch ) ) matches++;
+            }
+            Branches<T>::tryOne( type, value, matches );
+        }
+    };
+
+    // TrpSchemaUnion::validate() for untagged branches
+    template <typename L, TrpUnionMode mode>
+    struct Union {
+        static const TrpJsonType json_type = TRP_ERROR;
+        static const SchemaType schema_type = SCHEMA_UNION;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            TrpJsonType type = value ? value->getType() : TRP_ERROR;
+            size_t candidates = static_cast<size_t>(type) < TRP_UNION_TYPES ? Branches<L>::count( type ) : 0;
+
+            if ( !candidates ) {
+                ctx.pushError( ERR_UNION_TYPE, SCHEMA_UNION, Branches<L>::mask, type );
+                return false;
+            }
+            if ( candidates == 1 ) return Branches<L>::validateOnly( type, value, ctx );
+
+            if ( mode == UNION_ANY_OF ) {
+                if ( Branches<L>::tryAny( type, value ) ) return true;
+                ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, candidates );
+                return false;
+            }
+
+            size_t matches = 0;
+            Branches<L>::tryOne( type, value, matches );
+            if ( matches == 1 ) return true;
+            if ( matches ) ctx.pushError( ERR_UNION_AMBIGUOUS, SCHEMA_UNION );
+            else ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, candidates );
+            return false;
+        }
+    };
+
+    template <typename L>
+    struct Items {
+        enum { size = 0 };
+        static bool validate( TrpJsonArray*, TrpValidatorContext&, bool& ) { return true; }
+    };
+
+    template <typename H, typename T>
+    struct Items< List<H, T> > {
+        enum { size = 1 + Items<T>::size };
+
+        // tuple slot `index` onwards
+        static bool validate( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error, size_t index = 0 ) {
+            ctx.pushIndex( index );
+            if ( !H::validate( arr->at( index ), ctx ) ) got_error = true;
+            ctx.popPath();
+            if ( got_error && !ctx.shouldContinue() ) return false;
+            return Items<T>::validate( arr, ctx, got_error, index + 1 );
+        }
+    };
+
+    template <>
+    struct Items<Nil> {
+        enum { size = 0 };
+        static bool validate( TrpJsonArray*, TrpValidatorContext&, bool&, size_t = 0 ) { return true; }
+    };
+
+    template <typename L>
+    bool checkArraySize( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error ) {
+        typedef Options<L> O;
+
+        if ( O::has_max && arr->size() > O::max() ) {
+            ctx.pushError( ERR_ARRAY_TOO_LONG, SCHEMA_ARRAY, O::max(), arr->size() );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        if ( O::has_min && arr->size() < O::min() ) {
+            ctx.pushError( ERR_ARRAY_TOO_SHORT, SCHEMA_ARRAY, O::min(), arr->size() );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        return true;
+    }
+
+    template <typename L>
+    bool checkUniq( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error ) {
+        std::vector<size_t> duplicates;
+
+        if ( !Options<L>::uniq || !trpJsonDuplicates( arr, duplicates ) ) return true;
+        got_error = true;
+        for ( size_t i = 0; i < duplicates.size(); i++ ) {
+            ctx.pushIndex( duplicates[i] );
+            ctx.pushError( ERR_DUPLICATE_ITEM, SCHEMA_ARRAY, 0, duplicates[i] );
+            ctx.popPath();
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        return true;
+    }
+
+    // Options: Min, Max (length), CodePoints, Format, Pattern, Enum
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil>
+    struct String {
+        typedef Options<typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8>::type> O;
+        static const TrpJsonType json_type = TRP_STRING;
+        static const SchemaType schema_type = SCHEMA_STRING;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_STRING ) {
+                ctx.pushTypeError( SCHEMA_STRING, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            const std::string& str = static_cast<TrpJsonString*>(value)->getValue();
+            bool got_error = false;
+
+            if ( O::has_min || O::has_max ) {
+                size_t length = O::code_points ? trpUtf8Length( str.data(), str.size() ) : str.size();
+
+                if ( O::has_max && length > O::max() ) {
+                    ctx.pushError( ERR_STRING_TOO_LONG, SCHEMA_STRING, O::max(), length );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+                if ( O::has_min && length < O::min() ) {
+                    ctx.pushError( ERR_STRING_TOO_SHORT, SCHEMA_STRING, O::min(), length );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+            }
+            if ( O::format > 0 && !trpCheckFormat( static_cast<TrpStringFormat>(O::format), str.data(), str.size() ) ) {
+                ctx.pushError( ERR_STRING_FORMAT, SCHEMA_STRING, O::format, 0 );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_pattern && !O::pattern()->match( str ) ) {
+                ctx.pushError( ERR_STRING_PATTERN, SCHEMA_STRING, *O::source() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_enum && !O::inEnum( str ) ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_STRING, O::enum_size, 0 );
+                got_error = true;
+            }
+            return !got_error;
+        }
+    };
+
+    // Options: Min, Max, ExclusiveMin, ExclusiveMax, Integer, MultipleOf, Const
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil>
+    struct Number {
+        typedef Options<typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8>::type> O;
+        static const TrpJsonType json_type = TRP_NUMBER;
+        static const SchemaType schema_type = SCHEMA_NUMBER;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_NUMBER ) {
+                ctx.pushTypeError( SCHEMA_NUMBER, value ? value->getType() : TRP_ERROR );
+                return false;
+            }
+
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            bool got_error = false;
+
+            if ( O::has_max && (O::max_exclusive ? nbr >= O::max() : nbr > O::max()) ) {
+                ctx.pushError( O::max_exclusive ? ERR_NUMBER_NOT_BELOW : ERR_NUMBER_TOO_LARGE, SCHEMA_NUMBER, O::max(), nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_min && (O::min_exclusive ? nbr <= O::min() : nbr < O::min()) ) {
+                ctx.pushError( O::min_exclusive ? ERR_NUMBER_NOT_ABOVE : ERR_NUMBER_TOO_SMALL, SCHEMA_NUMBER, O::min(), nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::integer && nbr != std::floor( nbr ) ) {
+                ctx.pushError( ERR_NUMBER_NOT_INTEGER, SCHEMA_NUMBER, 0, nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_multiple ) {
+                double q = nbr / O::multiple();
+                double scale = std::fabs( q ) > 1 ? std::fabs( q ) : 1;
+
+                if ( std::fabs( q - std::floor( q + 0.5 ) ) > 1e-9 * scale ) {
+                    ctx.pushError( ERR_NUMBER_NOT_MULTIPLE, SCHEMA_NUMBER, O::multiple(), nbr );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+            }
+            if ( O::has_const && nbr != O::constant() ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_NUMBER, 1, nbr );
+                got_error = true;
+            }
+            return !got_error;
+        }
+    };
+
+    // Option: Const<1> or Const<0>
+    template <typename A1 = Nil>
+    struct Bool {
+        typedef Options<typename MakeList<A1>::type> O;
+        static const TrpJsonType json_type = TRP_BOOL;
+        static const SchemaType schema_type = SCHEMA_BOOLEAN;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_BOOL ) {
+                ctx.pushTypeError( SCHEMA_BOOLEAN, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            bool flag = static_cast<TrpJsonBool*>(value)->getValue();
+            if ( O::has_const && flag != (O::constant() != 0) ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_BOOLEAN, 1, flag );
+                return false;
+            }
+            return true;
+        }
+    };
+
+    struct Null {
+        static const TrpJsonType json_type = TRP_NULL;
+        static const SchemaType schema_type = SCHEMA_NULL;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_NULL ) {
+                ctx.pushTypeError( SCHEMA_NULL, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // Parts: Prop, Required, Min, Max (member count)
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil,
+        typename A9 = Nil, typename A10 = Nil, typename A11 = Nil, typename A12 = Nil,
+        typename A13 = Nil, typename A14 = Nil, typename A15 = Nil, typename A16 = Nil>
+    struct Object {
+        typedef typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12, A13, A14, A15, A16>::type L;
+        typedef Options<L> O;
+        static const TrpJsonType json_type = TRP_OBJECT;
+        static const SchemaType schema_type = SCHEMA_OBJECT;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_OBJECT ) {
+                ctx.pushTypeError( SCHEMA_OBJECT, value ? value->getType() : TRP_ERROR );
+                return false;
+            }
+
+            TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+            bool got_error = false;
+
+            if ( O::has_min && obj->size() < O::min() ) {
+                ctx.pushError( ERR_OBJECT_TOO_SMALL, SCHEMA_OBJECT, O::min(), obj->size() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_max && obj->size() > O::max() ) {
+                ctx.pushError( ERR_OBJECT_TOO_LARGE, SCHEMA_OBJECT, O::max(), obj->size() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+
+            if ( O::props > 0 ) {
+                static const PropOrder<L> order;
+                JsonObjectMap::const_iterator it = obj->begin();
+
+                for ( size_t i = 0; i < static_cast<size_t>(O::props); i++ ) {
+                    if ( !order.steps[i]( it, obj->end(), ctx, got_error ) ) return false;
+                }
+            }
+            return !got_error;
+        }
+    };
+
+    // Item schema first (Nil for any items), then options: Min, Max, Uniq
+    template <typename Item = Nil, typename A1 = Nil, typename A2 = Nil, typename A3 = Nil>
+    struct Array {
+        typedef typename MakeList<A1, A2, A3>::type L;
+        static const TrpJsonType json_type = TRP_ARRAY;
+        static const SchemaType schema_type = SCHEMA_ARRAY;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_ARRAY ) {
+                ctx.pushTypeError( SCHEMA_ARRAY, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            bool got_error = false;
+
+            if ( !checkArraySize<L>( arr, ctx, got_error ) ) return false;
+            if ( !checkItems( arr, ctx, got_error, static_cast<Item*>(NULL) ) ) return false;
+            if ( !checkUniq<L>( arr, ctx, got_error ) ) return false;
+            return !got_error;
+        }
+
+        template <typename S>
+        static bool checkItems( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error, S* ) {
+            for ( size_t i = 0; i < arr->size(); i++ ) {
+                ctx.pushIndex( i );
+                if ( !S::validate( arr->at( i ), ctx ) ) got_error = true;
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
+            return true;
+        }
+        static bool checkItems( TrpJsonArray*, TrpValidatorContext&, bool&, Nil* ) { return true; }
+    };
+
+    // Exactly these items, in this order
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct Tuple {
+        typedef typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type L;
+        static const TrpJsonType json_type = TRP_ARRAY;
+        static const SchemaType schema_type = SCHEMA_ARRAY;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_ARRAY ) {
+                ctx.pushTypeError( SCHEMA_ARRAY, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            bool got_error = false;
+
+            if ( arr->size() != static_cast<size_t>(Items<L>::size) ) {
+                ctx.pushError( ERR_TUPLE_SIZE, SCHEMA_ARRAY, Items<L>::size, arr->size() );
+                return false;
+            }
+            Items<L>::validate( arr, ctx, got_error );
+            return !got_error;
+        }
+    };
+
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct AnyOf : Union<typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type, UNION_ANY_OF> {};
+
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct OneOf : Union<typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type, UNION_ONE_OF> {};
+}
+
+// A static schema behind the TrpSchema interface, for a factory tree, a
+// TrpBatchValidator or anything else that takes one
+template <typename S>
+class TrpStaticSchema : public TrpSchema
+{
+    public:
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const { return S::validate( value, ctx ); }
+        SchemaType getType( void ) const { return S::schema_type; }
+};
+
+#endif
@@ -1,12 +1,21 @@
 #pragma once
 
 #include "TrpSchema.hpp"
+#include "TrpStringFormat.hpp"
+#include "TrpRegex.hpp"
+#include "TrpValueSet.hpp"
 
 class TrpSchemaString : public TrpSchema
 {
     private:
         bool has_min, has_max;
         size_t min_len, max_len;
+        bool code_points;
+        TrpStringFormat _format;
+        bool has_pattern;
+        TrpRegex _pattern;
+        bool has_enum;
+        TrpValueSet enum_values;
 
     public:
         TrpSchemaString();
@@ -14,9 +23,38 @@ class TrpSchemaString : public TrpSchema
         // good for chaining
         TrpSchemaString& min( size_t _min_len );
         TrpSchemaString& max( size_t _max_len );
+        TrpSchemaString& format( TrpStringFormat _format );
+        // min/max count code points instead of bytes
+        TrpSchemaString& codePoints( bool _enabled = true );
+        // Compiled to a DFA here; see TrpRegex for the syntax. A pattern
+        // TrpRegex refuses is a build error: it would match nothing, so
+        // check hasPatternError() (the reason is getPattern().getError())
+        // before validating with a hand-built schema. TrpSchemaLoader fails
+        // the load instead.
+        TrpSchemaString& pattern( const std::string& _source );
+        // replace the allowed set, O(1) membership whatever its size
+        TrpSchemaString& enumValues( const std::vector<std::string>& values );
+        TrpSchemaString& constant( const std::string& value );
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkString( const char* data, size_t size, TrpValidatorContext& ctx ) const;
+        bool checkString( const std::string& value, TrpValidatorContext& ctx ) const { return checkString( value.data(), value.size(), ctx ); }
+        bool checkLength( size_t len, TrpValidatorContext& ctx ) const;
+        size_t measure( const char* data, size_t size ) const;
+        size_t measure( const std::string& value ) const { return measure( value.data(), value.size() ); }
         SchemaType getType() const { return SCHEMA_STRING; }
+
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_len; }
+        size_t getMax( void ) const { return max_len; }
+        bool isCodePoints( void ) const { return code_points; }
+        TrpStringFormat getFormat( void ) const { return _format; }
+        bool hasPattern( void ) const { return has_pattern; }
+        const TrpRegex& getPattern( void ) const { return _pattern; }
+        bool hasPatternError( void ) const { return has_pattern && !_pattern.isValid(); }
+        bool hasEnum( void ) const { return has_enum; }
+        const TrpValueSet& getEnum( void ) const { return enum_values; }
 };
 
 
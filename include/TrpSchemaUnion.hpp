@@ -0,0 +1,82 @@
+#pragma once
+
+#include "TrpSchema.hpp"
+#include "TrpValueSet.hpp"
+
+#ifndef TRPSCHEMAUNION_HPP
+#define TRPSCHEMAUNION_HPP
+
+#define TRP_UNION_TYPES (TRP_OBJECT + 1)
+
+enum TrpUnionMode
+{
+    UNION_ANY_OF,
+    UNION_ONE_OF
+};
+
+enum TrpUnionPick
+{
+    UNION_BRANCH,       // the only branch the value can belong to
+    UNION_NONE,         // no branch takes it
+    UNION_TRY           // several branches take its type, they must be tried
+};
+
+// Branches are indexed by the JSON type they accept and, once a
+// discriminator is set, objects by the value of that property, so a value
+// goes straight to its one candidate branch. Only branches that share a
+// type and are not told apart by the discriminator are tried one by one,
+// each into a fail-fast scratch context.
+class TrpSchemaUnion : public TrpSchema
+{
+    private:
+        TrpUnionMode mode;
+        std::vector<TrpSchema*> branches;
+        std::vector<size_t> by_type[TRP_UNION_TYPES];
+
+        std::string key;                    // discriminator property
+        std::vector<std::string> tags;      // per branch, empty when untagged
+        TrpValueSet tag_set;
+        std::vector<size_t> tag_branch;     // tag_set slot -> branch
+        std::string duplicate_tag;          // first tag given twice
+
+        void indexBranches( void );
+        TrpUnionPick pickUntagged( TrpJsonType type, size_t& index ) const;
+
+        friend class TrpSchemaFactory;      // sets the mode, intern() rewrites branches
+    public:
+        TrpSchemaUnion( void );
+
+        TrpSchemaUnion& branch( TrpSchema* schema );
+        // objects whose `key` property is the string `tag` go to `schema`.
+        // A tag given twice is a build error: the later branch would hide the
+        // ambiguity, so it is refused and the first one kept; check
+        // hasTagError() after building.
+        TrpSchemaUnion& discriminator( const std::string& _key );
+        TrpSchemaUnion& branch( const std::string& tag, TrpSchema* schema );
+
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        // Reports the error itself when it returns UNION_NONE
+        TrpUnionPick pick( ITrpJsonValue* value, TrpValidatorContext& ctx, size_t& index ) const;
+        // An object of a discriminated union by its tag member: `tag_type` is
+        // TRP_ERROR when there is none, `tag` only set for a string
+        TrpUnionPick pickObject( TrpJsonType tag_type, const char* tag, size_t size, TrpValidatorContext& ctx, size_t& index ) const;
+        // From the type alone: objects of a discriminated union are UNION_TRY
+        TrpUnionPick pickType( TrpJsonType type, size_t& index ) const;
+        bool tryBranches( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        // Verdict once `tried` candidates gave `matches`, reported if it fails
+        bool reportTrial( size_t matches, size_t tried, TrpValidatorContext& ctx ) const;
+        void reportType( TrpJsonType actual, TrpValidatorContext& ctx ) const;
+        SchemaType getType() const { return SCHEMA_UNION; }
+
+        TrpUnionMode getMode( void ) const { return mode; }
+        const std::vector<TrpSchema*>& getBranches( void ) const { return branches; }
+        const std::string& getDiscriminator( void ) const { return key; }
+        const std::vector<std::string>& getTags( void ) const { return tags; }
+        bool isTagged( void ) const { return !tag_branch.empty(); }
+        bool hasTagError( void ) const { return !duplicate_tag.empty(); }
+        const std::string& getDuplicateTag( void ) const { return duplicate_tag; }
+        // branches taking `type` untagged, in declaration order
+        const std::vector<size_t>& getCandidates( TrpJsonType type ) const { return by_type[type]; }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "TrpBufferLexer.hpp"
+#include "TrpSchemaArray.hpp"
+#include "TrpSchemaBool.hpp"
+#include "TrpSchemaNumber.hpp"
+#include "TrpSchemaObject.hpp"
+#include "TrpSchemaString.hpp"
+#include "TrpSchemaUnion.hpp"
+#include <set>
+
+#ifndef TRPSTREAMINGVALIDATOR_HPP
+#define TRPSTREAMINGVALIDATOR_HPP
+
+// Validates a document straight from the lexer's token stream, without
+// building the AST. It keeps one frame per open container, so memory is
+// O(depth); frames are reused from one document to the next.
+//
+// Constraints that need the whole container (min/max, required keys, tuple
+// length) are checked when the container closes, so errors come out in
+// document order rather than in the order TrpSchema::validate reports them.
+// Unions are resolved by the token type where it decides the branch. A
+// value the tokens alone cannot decide (a union whose branches must be
+// tried, the object of a discriminated union, an array with uniq or a
+// tuple) is buffered into a DOM subtree and handed to TrpSchema::validate:
+// only that value is held in memory, and it gets the same errors as in the
+// tree.
+//
+// The tree keeps the last value of a repeated key. A declared key repeated
+// in an object validated as it streams stops the pass: validate() then
+// parses the whole document and hands it to TrpSchema::validate, in place
+// of the errors the pass recorded, and a push caller sees hasRepeatedKey().
+// A repeated undeclared key counts once. Once the error budget is spent,
+// the objects still open are read on for their keys, nothing validated, as
+// a repeat would replace the value that failed.
+class TrpStreamingValidator {
+    private:
+        enum Expect {
+            EXPECT_VALUE,
+            EXPECT_VALUE_OR_END,
+            EXPECT_KEY,
+            EXPECT_KEY_OR_END,
+            EXPECT_COLON,
+            EXPECT_COMMA_OR_END,
+            EXPECT_EOF
+        };
+
+        struct Frame {
+            const TrpSchema* schema;        // NULL when the subtree is skipped
+            bool is_object;
+            bool pushed_path;
+            bool failed;
+            size_t count;
+
+            // object: schema of the value that follows the current key
+            const TrpSchema* next;
+            const std::string* next_key;
+            bool next_declared;
+            std::vector<char> seen;         // one flag per required entry
+            std::vector<const std::string*> declared;   // properties met, sorted
+            std::set<std::string> undeclared;   // other keys, when min/max counts them
+        };
+
+        const TrpSchema& root;
+        TrpValidatorContext* ctx;
+        std::vector<Frame> frames;
+        size_t depth;
+
+        Expect expect;
+        bool done;
+        bool failed;
+        bool syntax_error;
+        bool scanning;                      // the budget is spent, keys only
+        bool repeated;
+        size_t first_error;                 // errors in the context at begin()
+        token last_err;
+        token current;
+
+        // the value being buffered for TrpSchema::validate
+        const TrpSchema* capture_schema;
+        size_t capture_depth;               // depth of its frame
+        std::vector<ITrpJsonValue*> capture_stack;  // open containers, the value first
+        std::string capture_key;
+
+        bool syntaxError( const token& tok, const std::string& msg );
+        bool beginValue( const token& tok );
+        bool endValue( bool ok );
+        bool openContainer( const token& tok, const TrpSchema* schema, bool pushed );
+        bool closeContainer( void );
+        bool checkScalar( const token& tok, const TrpSchema* schema );
+        bool resolveUnion( const TrpSchema*& schema, TrpJsonType actual );
+        bool deferValue( const token& tok, const TrpSchema* schema, bool pushed );
+        bool captureValue( const token& tok );
+        bool finishCapture( void );
+        void dropCapture( void );
+        bool readOn( void );
+        bool repeatedKey( void );
+        bool validateTree( bool parsed, ITrpJsonValue* document, const token& err );
+
+        TrpStreamingValidator( const TrpStreamingValidator& other );
+        TrpStreamingValidator& operator=( const TrpStreamingValidator& other );
+
+    public:
+        TrpStreamingValidator( const TrpSchema& _root );
+        ~TrpStreamingValidator( void );
+
+        // push interface: begin(), then feed() tokens while it returns true
+        void begin( TrpValidatorContext& _ctx );
+        bool feed( const token& tok );
+        bool isValid( void ) const;
+
+        // pulls tokens from the lexer until the document is decided
+        bool validate( TrpJsonLexer& lexer, TrpValidatorContext& _ctx );
+        bool validate( TrpBufferLexer& lexer, TrpValidatorContext& _ctx );
+
+        bool hasSyntaxError( void ) const;
+        const token& getLastError( void ) const;
+        // a declared key came twice: feed() stopped there, validate the
+        // document with TrpSchema::validate rather than trust isValid()
+        bool hasRepeatedKey( void ) const;
+};
+
+#endif
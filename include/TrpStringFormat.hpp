@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#ifndef TRPSTRINGFORMAT_HPP
+#define TRPSTRINGFORMAT_HPP
+
+enum TrpStringFormat
+{
+    FORMAT_NONE,
+    FORMAT_UUID,        // 8-4-4-4-12 hex digits, any case
+    FORMAT_IPV4,        // dotted quad, no leading zeros
+    FORMAT_IPV6,        // RFC 4291 text form, with :: and a dotted quad tail
+    FORMAT_DATE_TIME,   // RFC 3339
+    FORMAT_EMAIL,       // dot-atom local part @ host name
+    FORMAT_HEX,         // [0-9a-fA-F]*
+    FORMAT_BASE64       // RFC 4648 alphabet, padded to a multiple of 4
+};
+
+// Code points of a UTF-8 string, i.e. the bytes that are not continuation
+// bytes. Strings from the lexer are UTF-8 with escapes already decoded.
+size_t trpUtf8Length( const char* data, size_t size );
+
+// The byte classification runs 16 bytes at a time with SSE2, 32 with AVX2
+// when the CPU has it, and byte by byte elsewhere.
+bool trpCheckFormat( TrpStringFormat format, const char* data, size_t size );
+
+const char* trpFormatName( TrpStringFormat format );
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../lib/TrpJson.hpp"
+#include <stdint.h>
+
+#ifndef TRPTAPE_HPP
+#define TRPTAPE_HPP
+
+// Tag in the top byte of a tape word, the payload is the other 56 bits
+enum TrpTapeTag
+{
+    TAPE_OBJECT = '{',          // payload: index of the word after the matching end
+    TAPE_OBJECT_END = '}',      // payload: member count
+    TAPE_ARRAY = '[',
+    TAPE_ARRAY_END = ']',
+    TAPE_STRING = '"',          // payload: offset of the string in the string buffer
+    TAPE_NUMBER = 'd',          // the next word holds the double
+    TAPE_TRUE = 't',
+    TAPE_FALSE = 'f',
+    TAPE_NULL = 'n'
+};
+
+#define TRP_TAPE_PAYLOAD 0x00ffffffffffffffULL
+
+// A whole document as one array of tagged 64-bit words plus one buffer for
+// the string bytes, the way simdjson lays it out. Values follow each other
+// in document order; an object's members are a key string then its value.
+// A value is named by the index of its first word, the root is 0. Strings
+// are stored as a 32-bit length, the bytes and a NUL.
+class TrpTape {
+    private:
+        std::vector<uint64_t> words;
+        std::string strings;
+
+        friend class TrpTapeParser;
+
+    public:
+        void clear( void );
+        bool empty( void ) const { return words.empty(); }
+        size_t size( void ) const { return words.size(); }
+
+        TrpTapeTag tag( size_t index ) const { return static_cast<TrpTapeTag>(words[index] >> 56); }
+        uint64_t payload( size_t index ) const { return words[index] & TRP_TAPE_PAYLOAD; }
+        TrpJsonType type( size_t index ) const;
+
+        // index of the value after the one at `index`, containers included
+        size_t next( size_t index ) const;
+        // members of an object, items of an array
+        size_t count( size_t index ) const { return payload( payload( index ) - 1 ); }
+        // first member / item of a container; equal to its end when empty
+        size_t first( size_t index ) const { return index + 1; }
+        size_t end( size_t index ) const { return payload( index ) - 1; }
+
+        double number( size_t index ) const;
+        bool boolean( size_t index ) const { return tag( index ) == TAPE_TRUE; }
+        const char* string( size_t index, size_t& length ) const;
+        std::string stringValue( size_t index ) const;
+};
+
+#endif
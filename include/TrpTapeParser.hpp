@@ -0,0 +1,50 @@
+#pragma once
+
+#include "TrpBufferLexer.hpp"
+#include "TrpMappedFile.hpp"
+#include "TrpTape.hpp"
+
+#ifndef TRPTAPEPARSER_HPP
+#define TRPTAPEPARSER_HPP
+
+// Parses an in-memory buffer, or a mapped file, into a TrpTape instead of
+// a tree of ITrpJsonValue. Same grammar and error messages as
+// TrpBufferParser. The tape and the lexer's token keep their storage from
+// one parse() to the next, so a warm parser does not allocate at all.
+class TrpTapeParser {
+    private:
+        TrpBufferLexer lexer;
+        TrpMappedFile file;
+        size_t input_size;
+        TrpTape tape;
+        bool parsed;
+        token current;
+        token last_err;
+
+        bool parseValue( void );
+        bool parseObject( void );
+        bool parseArray( void );
+        void appendWord( TrpTapeTag tag, uint64_t payload );
+        void appendString( const std::string& value );
+        void closeContainer( size_t open, TrpTapeTag tag, size_t count );
+        bool fail( const std::string& message );
+
+        TrpTapeParser( const TrpTapeParser& );
+        TrpTapeParser& operator=( const TrpTapeParser& );
+
+    public:
+        TrpTapeParser( void );
+        TrpTapeParser( const char* _data, size_t _size );
+        explicit TrpTapeParser( const std::string& _data );
+
+        // Maps `file_name` and makes it the input
+        bool openFile( const std::string& file_name );
+        void setBuffer( const char* _data, size_t _size );
+
+        bool parse( void );
+        const TrpTape& getTape( void ) const { return tape; }
+        bool isParsed( void ) const { return parsed; }
+        const token& getLastError( void ) const { return last_err; }
+};
+
+#endif
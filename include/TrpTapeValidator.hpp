@@ -0,0 +1,53 @@
+#pragma once
+
+#include "TrpTape.hpp"
+#include "TrpSchemaArray.hpp"
+#include "TrpSchemaBool.hpp"
+#include "TrpSchemaNumber.hpp"
+#include "TrpSchemaObject.hpp"
+#include "TrpSchemaString.hpp"
+#include "TrpSchemaUnion.hpp"
+
+#ifndef TRPTAPEVALIDATOR_HPP
+#define TRPTAPEVALIDATOR_HPP
+
+// Validates a TrpTape against a schema tree: same checks, errors and error
+// order as TrpSchema::validate on the DOM of the same document. The tape is
+// read front to back; an object's members are sorted by key into a scratch
+// array reused from one object (and one document) to the next, and a
+// repeated key keeps its last value, like TrpJsonObject. The memo cache and
+// splitting a container across threads are DOM only.
+class TrpTapeValidator {
+    private:
+        struct Member {
+            const char* key;
+            size_t length;
+            size_t value;
+        };
+
+        const TrpSchema& root;
+        const TrpTape* tape;
+        std::vector<Member> members;        // the open objects' members, stacked
+
+        bool validateValue( const TrpSchema* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateObject( const TrpSchemaObject* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateArray( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateNumbers( const TrpSchemaNumber* item, size_t index, TrpValidatorContext& ctx );
+        bool validateUnion( const TrpSchemaUnion* schema, size_t index, TrpValidatorContext& ctx );
+        bool checkUniq( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx ) const;
+        size_t collectMembers( size_t index );
+        static bool memberLess( const Member& a, const Member& b );
+        size_t hashValue( size_t index ) const;
+        bool equalValues( size_t a, size_t b ) const;
+
+        TrpTapeValidator( const TrpTapeValidator& other );
+        TrpTapeValidator& operator=( const TrpTapeValidator& other );
+
+    public:
+        TrpTapeValidator( const TrpSchema& _root );
+
+        // `tape` must hold a parsed document
+        bool validate( const TrpTape& _tape, TrpValidatorContext& ctx );
+};
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+#ifndef TRPTHREADPOOL_HPP
+#define TRPTHREADPOOL_HPP
+
+class TrpTask {
+    public:
+        virtual ~TrpTask( void ) {}
+        virtual void run( void ) = 0;
+};
+
+// Work-stealing pool. Every worker owns a deque: it pops its newest task and,
+// once empty, steals the oldest task of another worker. A thread waiting in
+// run() executes queued tasks meanwhile, so a task may call run() itself.
+class TrpThreadPool {
+    private:
+        struct Slot {
+            TrpTask* task;
+            size_t* pending;        // of the run() that queued it
+        };
+
+        struct Queue {
+            pthread_mutex_t lock;
+            std::deque<Slot> slots;
+        };
+
+        struct Worker {
+            TrpThreadPool* pool;
+            size_t index;
+        };
+
+        std::vector<Queue*> queues;
+        std::vector<Worker> workers;
+        std::vector<pthread_t> threads;
+        pthread_key_t self;         // Worker* of the calling thread, NULL outside
+
+        pthread_mutex_t lock;
+        pthread_cond_t changed;     // a task was queued or a run() finished
+        size_t queued;
+        size_t next;                // queue for the next task from outside
+        bool stopping;
+
+        static void* workerMain( void* arg );
+        bool runOne( size_t home );
+
+        TrpThreadPool( const TrpThreadPool& );
+        TrpThreadPool& operator=( const TrpThreadPool& );
+
+    public:
+        explicit TrpThreadPool( size_t _threads );
+        ~TrpThreadPool();
+
+        // Runs every task and returns once they are all done
+        void run( TrpTask** tasks, size_t count );
+
+        size_t size( void ) const { return threads.size(); }
+};
+
+#endif
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <set>
 #include <vector>
 #include "../lib/TrpJson.hpp"
+#include "TrpJsonHash.hpp"
 
 #ifndef TRPVALIDATORCONTEXT_HPP
 #define TRPVALIDATORCONTEXT_HPP
@@ -14,11 +16,14 @@ enum SchemaType
     SCHEMA_OBJECT,
     SCHEMA_ARRAY,
     SCHEMA_NULL,
-    SCHEMA_ANY
+    SCHEMA_ANY,
+    SCHEMA_UNION
 };
 
 typedef SchemaType TrpSchemaType;
 
+class TrpSchema;
+
 struct ValidationError {
     std::string path;
     std::string msg;
@@ -26,22 +31,222 @@ struct ValidationError {
     TrpJsonType actual;
 };
 
+enum TrpErrorCode
+{
+    ERR_CUSTOM,             // pushed as a ready-made ValidationError
+    ERR_TYPE,               // expected / actual
+    ERR_STRING_TOO_LONG,    // limit: max length, value: length
+    ERR_STRING_TOO_SHORT,
+    ERR_STRING_FORMAT,      // limit: TrpStringFormat
+    ERR_STRING_PATTERN,     // key: pattern source
+    ERR_ENUM,               // limit: allowed values
+    ERR_NUMBER_TOO_LARGE,   // limit: max, value: number
+    ERR_NUMBER_TOO_SMALL,
+    ERR_NUMBER_NOT_BELOW,   // exclusive maximum
+    ERR_NUMBER_NOT_ABOVE,   // exclusive minimum
+    ERR_NUMBER_NOT_INTEGER, // value: number
+    ERR_NUMBER_NOT_MULTIPLE,// limit: divisor
+    ERR_ARRAY_TOO_LONG,     // limit: max items, value: size
+    ERR_ARRAY_TOO_SHORT,
+    ERR_TUPLE_SIZE,         // limit: tuple length, value: size
+    ERR_DUPLICATE_ITEM,     // value: index (also the last path segment)
+    ERR_OBJECT_TOO_SMALL,   // limit: min properties, value: size
+    ERR_OBJECT_TOO_LARGE,
+    ERR_MISSING_PROPERTY,   // key
+    ERR_UNION_TYPE,         // limit: mask of the JSON types taken, value: actual type
+    ERR_UNION_TAG,          // key: discriminator
+    ERR_UNION_NO_MATCH,     // limit: branches tried
+    ERR_UNION_AMBIGUOUS     // oneOf: a second branch matched
+};
+
+// What the validators record: no text, no allocation of its own. The path is
+// a run of segments in the context's buffer; keys and `key` point at strings
+// owned by the schema, which must outlive the errors.
+struct TrpErrorRecord {
+    TrpErrorCode code;
+    SchemaType expected;
+    TrpJsonType actual;
+    const TrpSchema* schema;    // node that failed, NULL for ERR_CUSTOM and generated code
+    const std::string* key;
+    double limit;
+    double value;
+    size_t path_first;          // ERR_CUSTOM: index of the ValidationError
+    size_t path_length;
+};
+
+enum TrpPathSegmentKind
+{
+    PATH_KEY,
+    PATH_INDEX
+};
+
+enum TrpPathFormat
+{
+    PATH_DOTTED,     // .users[3].name
+    PATH_POINTER     // /users/3/name (RFC 6901)
+};
+
+// A path segment never owns its key: it points at a string that outlives
+// the push/pop pair (the schema's property name, the JSON object's key, or
+// the context's copy of a pushPath() string).
+struct TrpPathSegment {
+    TrpPathSegmentKind kind;
+    size_t index;
+    const std::string* key;
+};
+
+// A subtree proven valid against a schema node, with its trpJsonEncode()
+// bytes to check a hash hit against
+struct TrpMemoEntry {
+    const TrpSchema* schema;
+    size_t hash;
+    std::string value;
+};
+
+#define TRP_PARALLEL_MIN_ITEMS 1024
+
+class TrpThreadPool;
+class TrpProfiler;
+class TrpValidatorContext;
+struct TrpSplitState;
+
+// Validates members [first, last) of one container into `ctx`, a context of
+// its own that starts at the container's path. The container validators
+// implement it for TrpValidatorContext::split().
+class TrpSplitBody {
+    public:
+        virtual ~TrpSplitBody( void ) {}
+        virtual bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const = 0;
+};
+
 typedef std::vector<ValidationError> TrpValidationError;
-typedef std::vector<std::string> TrpValidationPath;
+typedef std::vector<TrpPathSegment> TrpValidationPath;
+typedef std::vector<TrpErrorRecord> TrpErrorRecords;
 
 class TrpValidatorContext {
     private:
-        TrpValidationError errors;
+        TrpErrorRecords records;
+        TrpValidationPath error_paths;      // path segments of every record
+        TrpValidationError custom;          // pushError(ValidationError)
+        mutable TrpValidationError errors;  // getErrors() cache, grows lazily
         TrpValidationPath paths;
+        std::set<std::string> path_keys;    // pushPath() copies, until clear()
+
+        bool fail_fast;
+        size_t max_errors;
+        TrpPathFormat path_format;
+
+        bool memo_enabled;
+        std::vector<TrpMemoEntry> memo;     // open addressing, NULL schema is empty
+        size_t memo_count;
+        size_t memo_hits, memo_misses;
+        size_t memo_depth;
+        TrpJsonHashCache hash_cache;        // hashes of the document being validated
+        TrpJsonHashCache* document_hashes;  // or the parser's, see setDocumentHashes()
+
+        TrpThreadPool* pool;
+        size_t parallel_min;
+        TrpSplitState* split_state;         // of the split this context is a range of
+        size_t split_range;
+
+        TrpProfiler* profiler;
+
+        void merge( const TrpValidatorContext& range );
+
+        void memoInsert( TrpMemoEntry& entry );
+
+        TrpErrorRecord* newRecord( TrpErrorCode code, const TrpSchema* schema );
+        TrpErrorRecord* newRecord( TrpErrorCode code, const TrpSchema* schema, SchemaType expected );
+        void appendPath( std::string& out, const TrpPathSegment* first, size_t length, TrpPathFormat _format ) const;
 
     public:
-        TrpValidatorContext( void );
+        // max_errors == 0 means no error budget
+        TrpValidatorContext( bool _fail_fast = false, size_t _max_errors = 0 );
 
-        void pushPath(const std::string _path);
+        void pushKey( const std::string& _key );
+        void pushIndex( size_t _index );
+        // The string segments validators used to push, ".name" or "[3]";
+        // any other string is a key. The context keeps a copy for the
+        // errors to point at.
+        void pushPath( const std::string _path );
         void popPath();
 
         void pushError(ValidationError _err);
-        std::string getCurrentPath( void );
+        void pushError( TrpErrorCode code, const TrpSchema* schema, double limit = 0, double value = 0 );
+        void pushError( TrpErrorCode code, const TrpSchema* schema, const std::string& key );
+        void pushTypeError( const TrpSchema* schema, SchemaType expected, TrpJsonType actual );
+        void pushMissing( const TrpSchema* schema, const std::string& key );
+        void pushPattern( const TrpSchema* schema, const std::string& pattern );
+        // Same records without a schema node, for validators that have none
+        // (generated code): `expected` stands for the node's type
+        void pushError( TrpErrorCode code, SchemaType expected, double limit = 0, double value = 0 );
+        void pushError( TrpErrorCode code, SchemaType expected, const std::string& key );
+        void pushTypeError( SchemaType expected, TrpJsonType actual );
+
+        // rendered on demand, only call it when an error is recorded
+        std::string getCurrentPath( void ) const;
+        std::string getCurrentPath( TrpPathFormat _format ) const;
+        void setPathFormat( TrpPathFormat _format );
+
+        bool shouldContinue( void ) const;
+        bool isFailFast( void ) const;
+        size_t getMaxErrors( void ) const;
+
+        size_t errorCount( void ) const { return records.size(); }
+        bool hasErrors( void ) const { return !records.empty(); }
+        const TrpErrorRecords& getRecords( void ) const { return records; }
+
+        // Text is only produced here, never while validating
+        std::string formatMessage( const TrpErrorRecord& record ) const;
+        std::string formatPath( const TrpErrorRecord& record ) const;
+        std::string formatPath( const TrpErrorRecord& record, TrpPathFormat _format ) const;
+
+        // forgets the errors, keeps the buffers for the next document
+        void clear( void );
+        // forgets the errors recorded after the first `count`
+        void dropErrors( size_t count );
+
+        // Memo of subtrees already proven valid against a schema node, kept
+        // across documents until clearMemo(). Each keeps an encoded copy of
+        // the subtree: a hash hit is compared with it, so colliding values
+        // are validated. The copies cost memory in proportion to the valid
+        // subtrees seen, which suits repetitive, templated input.
+        void enableMemo( bool _enabled = true );
+        bool isMemoEnabled( void ) const { return memo_enabled; }
+        void clearMemo( void );
+        size_t getMemoHits( void ) const { return memo_hits; }
+        size_t getMemoMisses( void ) const { return memo_misses; }
+        size_t getMemoSize( void ) const { return memo_count; }
+
+        // Hashes the parser computed for the document about to be validated
+        // (TrpBufferParser::computeHashes()), NULL to hash on demand again.
+        // Saves walking each subtree a second time to hash it.
+        void setDocumentHashes( TrpJsonHashCache* hashes );
+
+        // Bracket the validation of a value by a container schema. When
+        // memoEnter() returns true the value is known valid and memoLeave()
+        // must not be called.
+        bool memoEnter( const TrpSchema* schema, ITrpJsonValue* value, size_t& hash );
+        void memoLeave( const TrpSchema* schema, ITrpJsonValue* value, size_t hash, bool valid );
+
+        // Opt-in parallel validation: arrays and objects with at least
+        // `min_items` members are cut into ranges validated on `pool`, each
+        // into a context of its own. The ranges are merged back in document
+        // order, so the errors and the error budget behave as sequentially.
+        // The ranges do not use the memo.
+        void setThreadPool( TrpThreadPool* _pool, size_t _min_items = TRP_PARALLEL_MIN_ITEMS );
+        bool shouldSplit( size_t count ) const { return pool && count >= parallel_min; }
+        bool split( const TrpSplitBody& body, size_t count );
+
+        // True once an earlier range of the same split spent the error
+        // budget: whatever this range finds would be dropped
+        bool isCancelled( void ) const;
+
+        // Charges the time spent under every path to `_profiler`, NULL to
+        // stop. Contexts made for union trials and split ranges are not
+        // profiled on their own.
+        void setProfiler( TrpProfiler* _profiler ) { profiler = _profiler; }
+        TrpProfiler* getProfiler( void ) const { return profiler; }
 
         const TrpValidationError& getErrors( void ) const ;
         bool  printErrors( void ) const;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef TRPVALUESET_HPP
+#define TRPVALUESET_HPP
+
+// A fixed set of byte strings behind a minimal perfect hash (hash and
+// displace): a lookup is one hash of the probe, one bucket read and one
+// compare, whatever the size of the set. Built once by assign(), which
+// tries a bounded number of seeds; if none works the values are kept
+// sorted and looked up by binary search instead.
+class TrpValueSet {
+    private:
+        std::string pool;                   // values in slot order
+        std::vector<unsigned int> offsets;  // slot -> start in pool, plus the end
+        std::vector<int> displace;          // bucket -> seed of its slots, or -1 - slot
+        size_t seed;
+        bool hashed;                        // false: slots in sorted order, no displace
+
+        bool build( const std::vector<std::string>& values );
+        int compareSlot( size_t slot, const char* data, size_t size ) const;
+
+    public:
+        TrpValueSet( void );
+
+        // duplicates are dropped
+        void assign( const std::vector<std::string>& values );
+
+        bool contains( const char* data, size_t size ) const;
+        bool contains( const std::string& value ) const { return contains( value.data(), value.size() ); }
+        // the value's slot, in [0, size())
+        bool find( const char* data, size_t size, size_t& slot ) const;
+
+        size_t size( void ) const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        bool empty( void ) const { return !size(); }
+        // values in slot order, which only depends on the set
+        std::string at( size_t slot ) const;
+};
+
+#endif
@@ -7,6 +7,12 @@
 #include <map>
 #include <sstream>
 #include <set>
+#include <new>
+#include <deque>
+#include <pthread.h>
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
 
 // ============================================================================
 // Forward Declarations
@@ -15,6 +21,191 @@
 class TrpSchema;
 class TrpValidatorContext;
 
+// ============================================================================
+// TrpJsonHash
+// ============================================================================
+
+// Structural hash of a JSON value. Equal values (trpJsonEqual) always hash
+// the same: object members are combined order-independently and -0 hashes
+// like 0.
+size_t trpJsonHash( ITrpJsonValue* value );
+
+// Hashes of the containers of one document, keyed by address. Valid only
+// while that document is alive: clear() it before the AST goes away.
+class TrpJsonHashCache {
+    private:
+        struct Entry {
+            ITrpJsonValue* value;
+            size_t hash;
+        };
+
+        std::vector<Entry> slots;
+        size_t count;
+
+        void grow( void );
+
+    public:
+        TrpJsonHashCache( void );
+
+        bool find( ITrpJsonValue* value, size_t& hash ) const;
+        void insert( ITrpJsonValue* value, size_t hash );
+        void clear( void );
+        size_t size( void ) const { return count; }
+};
+
+// Same value as trpJsonHash(). Every container hashed on the way is stored
+// in `cache`, so asking again for any subtree of it is a lookup.
+size_t trpJsonHash( ITrpJsonValue* value, TrpJsonHashCache& cache );
+
+// The steps trpJsonHash() combines containers with, for producers that see
+// a document bottom-up (TrpBufferParser). An array folds its items in order
+// from 0 then closes with its size; an object sums its members.
+size_t trpJsonHashItem( size_t h, size_t item );
+size_t trpJsonHashArray( size_t h, size_t size );
+size_t trpJsonHashMember( const std::string& key, size_t value );
+size_t trpJsonHashObject( size_t sum, size_t size );
+
+// Deep structural equality, numbers compared with ==
+bool trpJsonEqual( ITrpJsonValue* a, ITrpJsonValue* b );
+
+// Canonical bytes of a value, appended to `out`: a copy of it that outlives
+// the document, for trpJsonEqualEncoded(). Members go in key order and -0 is
+// written as 0, so equal values encode the same.
+void trpJsonEncode( ITrpJsonValue* value, std::string& out );
+
+// trpJsonEqual() against the bytes trpJsonEncode() wrote for the other value,
+// without decoding them
+bool trpJsonEqualEncoded( ITrpJsonValue* value, const std::string& image );
+
+// Indices of the items of `arr` equal to an earlier one, in order, into
+// `duplicates` (cleared first). False when there is none.
+bool trpJsonDuplicates( TrpJsonArray* arr, std::vector<size_t>& duplicates );
+
+// ============================================================================
+// TrpStringFormat
+// ============================================================================
+
+enum TrpStringFormat
+{
+    FORMAT_NONE,
+    FORMAT_UUID,        // 8-4-4-4-12 hex digits, any case
+    FORMAT_IPV4,        // dotted quad, no leading zeros
+    FORMAT_IPV6,        // RFC 4291 text form, with :: and a dotted quad tail
+    FORMAT_DATE_TIME,   // RFC 3339
+    FORMAT_EMAIL,       // dot-atom local part @ host name
+    FORMAT_HEX,         // [0-9a-fA-F]*
+    FORMAT_BASE64       // RFC 4648 alphabet, padded to a multiple of 4
+};
+
+// Code points of a UTF-8 string, i.e. the bytes that are not continuation
+// bytes. Strings from the lexer are UTF-8 with escapes already decoded.
+size_t trpUtf8Length( const char* data, size_t size );
+
+// The byte classification runs 16 bytes at a time with SSE2, 32 with AVX2
+// when the CPU has it, and byte by byte elsewhere.
+bool trpCheckFormat( TrpStringFormat format, const char* data, size_t size );
+
+const char* trpFormatName( TrpStringFormat format );
+
+// ============================================================================
+// TrpRegex
+// ============================================================================
+
+#define TRP_REGEX_MAX_STATES 4096
+#define TRP_REGEX_NO_STATE 0xffffffffu
+
+// A pattern compiled once into a DFA over byte classes. match() is one table
+// lookup per byte: linear time, no allocation, no backtracking.
+//
+// Searches like JSON Schema's `pattern`: the match may be anywhere unless
+// the pattern starts with ^ / ends with $. Supported: literals, ., [...]
+// and [^...] (ASCII ranges), \d \w \s and their negations, \t \n \r \f \v
+// \xHH \uHHHH, (...) and (?:...), |, * + ? {n} {n,} {n,m} (lazy forms
+// match the same strings). . and negated classes consume a whole UTF-8
+// character. No backreferences, lookaround or \b, and ^ / $ only at the
+// ends of the pattern: compile() refuses them, and a pattern that failed to
+// compile matches nothing.
+class TrpRegex {
+    private:
+        std::string source;
+        std::string error;
+
+        unsigned char classes[256];         // byte -> equivalence class
+        unsigned int class_count;
+        std::vector<unsigned int> table;    // row + class -> row of the next state
+        std::vector<unsigned char> accepting;
+        unsigned int start;                 // rows are state * class_count
+        unsigned int dead;                  // no match possible any more, or TRP_REGEX_NO_STATE
+        bool anchored_end;
+
+    public:
+        TrpRegex( void );
+        explicit TrpRegex( const std::string& pattern );
+
+        bool compile( const std::string& pattern );
+
+        bool match( const char* data, size_t size ) const;
+        bool match( const std::string& str ) const { return match( str.data(), str.size() ); }
+
+        bool isValid( void ) const { return !table.empty(); }
+        const std::string& getSource( void ) const { return source; }
+        const std::string& getError( void ) const { return error; }
+        size_t stateCount( void ) const { return accepting.size(); }
+};
+
+// ============================================================================
+// TrpValueSet
+// ============================================================================
+
+// A fixed set of byte strings behind a minimal perfect hash (hash and
+// displace): a lookup is one hash of the probe, one bucket read and one
+// compare, whatever the size of the set. Built once by assign(), which
+// tries a bounded number of seeds; if none works the values are kept
+// sorted and looked up by binary search instead.
+class TrpValueSet {
+    private:
+        std::string pool;                   // values in slot order
+        std::vector<unsigned int> offsets;  // slot -> start in pool, plus the end
+        std::vector<int> displace;          // bucket -> seed of its slots, or -1 - slot
+        size_t seed;
+        bool hashed;                        // false: slots in sorted order, no displace
+
+        bool build( const std::vector<std::string>& values );
+        int compareSlot( size_t slot, const char* data, size_t size ) const;
+
+    public:
+        TrpValueSet( void );
+
+        // duplicates are dropped
+        void assign( const std::vector<std::string>& values );
+
+        bool contains( const char* data, size_t size ) const;
+        bool contains( const std::string& value ) const { return contains( value.data(), value.size() ); }
+        // the value's slot, in [0, size())
+        bool find( const char* data, size_t size, size_t& slot ) const;
+
+        size_t size( void ) const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        bool empty( void ) const { return !size(); }
+        // values in slot order, which only depends on the set
+        std::string at( size_t slot ) const;
+};
+
+// ============================================================================
+// TrpNumberScan
+// ============================================================================
+
+// Inclusive bounds, exclusive ones already moved to the next double inward;
+// -inf / +inf when unbounded
+struct TrpNumberRange {
+    double lo;
+    double hi;
+    bool integer;
+};
+
+// True when every value lies in the range (and is integral if asked). Two
+// doubles at a time with SSE2, four with AVX when the CPU has it.
+bool trpNumbersInRange( const double* values, size_t count, const TrpNumberRange& range );
+
 // ============================================================================
 // Type Definitions and Enums
 // ============================================================================
@@ -27,7 +218,8 @@ enum SchemaType
     SCHEMA_OBJECT,
     SCHEMA_ARRAY,
     SCHEMA_NULL,
-    SCHEMA_ANY
+    SCHEMA_ANY,
+    SCHEMA_UNION
 };
 
 typedef SchemaType TrpSchemaType;
@@ -40,8 +232,97 @@ struct ValidationError {
     TrpJsonType actual;
 };
 
+enum TrpErrorCode
+{
+    ERR_CUSTOM,             // pushed as a ready-made ValidationError
+    ERR_TYPE,               // expected / actual
+    ERR_STRING_TOO_LONG,    // limit: max length, value: length
+    ERR_STRING_TOO_SHORT,
+    ERR_STRING_FORMAT,      // limit: TrpStringFormat
+    ERR_STRING_PATTERN,     // key: pattern source
+    ERR_ENUM,               // limit: allowed values
+    ERR_NUMBER_TOO_LARGE,   // limit: max, value: number
+    ERR_NUMBER_TOO_SMALL,
+    ERR_NUMBER_NOT_BELOW,   // exclusive maximum
+    ERR_NUMBER_NOT_ABOVE,   // exclusive minimum
+    ERR_NUMBER_NOT_INTEGER, // value: number
+    ERR_NUMBER_NOT_MULTIPLE,// limit: divisor
+    ERR_ARRAY_TOO_LONG,     // limit: max items, value: size
+    ERR_ARRAY_TOO_SHORT,
+    ERR_TUPLE_SIZE,         // limit: tuple length, value: size
+    ERR_DUPLICATE_ITEM,     // value: index (also the last path segment)
+    ERR_OBJECT_TOO_SMALL,   // limit: min properties, value: size
+    ERR_OBJECT_TOO_LARGE,
+    ERR_MISSING_PROPERTY,   // key
+    ERR_UNION_TYPE,         // limit: mask of the JSON types taken, value: actual type
+    ERR_UNION_TAG,          // key: discriminator
+    ERR_UNION_NO_MATCH,     // limit: branches tried
+    ERR_UNION_AMBIGUOUS     // oneOf: a second branch matched
+};
+
+// What the validators record: no text, no allocation of its own. The path is
+// a run of segments in the context's buffer; keys and `key` point at strings
+// owned by the schema, which must outlive the errors.
+struct TrpErrorRecord {
+    TrpErrorCode code;
+    SchemaType expected;
+    TrpJsonType actual;
+    const TrpSchema* schema;    // node that failed, NULL for ERR_CUSTOM and generated code
+    const std::string* key;
+    double limit;
+    double value;
+    size_t path_first;          // ERR_CUSTOM: index of the ValidationError
+    size_t path_length;
+};
+
+enum TrpPathSegmentKind
+{
+    PATH_KEY,
+    PATH_INDEX
+};
+
+enum TrpPathFormat
+{
+    PATH_DOTTED,     // .users[3].name
+    PATH_POINTER     // /users/3/name (RFC 6901)
+};
+
+// A path segment never owns its key: it points at a string that outlives
+// the push/pop pair (the schema's property name, the JSON object's key, or
+// the context's copy of a pushPath() string).
+struct TrpPathSegment {
+    TrpPathSegmentKind kind;
+    size_t index;
+    const std::string* key;
+};
+
+// A subtree proven valid against a schema node, with its trpJsonEncode()
+// bytes to check a hash hit against
+struct TrpMemoEntry {
+    const TrpSchema* schema;
+    size_t hash;
+    std::string value;
+};
+
+#define TRP_PARALLEL_MIN_ITEMS 1024
+
+class TrpThreadPool;
+class TrpProfiler;
+class TrpValidatorContext;
+struct TrpSplitState;
+
+// Validates members [first, last) of one container into `ctx`, a context of
+// its own that starts at the container's path. The container validators
+// implement it for TrpValidatorContext::split().
+class TrpSplitBody {
+    public:
+        virtual ~TrpSplitBody( void ) {}
+        virtual bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const = 0;
+};
+
 typedef std::vector<ValidationError> TrpValidationError;
-typedef std::vector<std::string> TrpValidationPath;
+typedef std::vector<TrpPathSegment> TrpValidationPath;
+typedef std::vector<TrpErrorRecord> TrpErrorRecords;
 
 // ============================================================================
 // Utility Functions
@@ -55,17 +336,128 @@ std::string tokenTypeToString(TrpType type);
 
 class TrpValidatorContext {
     private:
-        TrpValidationError errors;
+        TrpErrorRecords records;
+        TrpValidationPath error_paths;      // path segments of every record
+        TrpValidationError custom;          // pushError(ValidationError)
+        mutable TrpValidationError errors;  // getErrors() cache, grows lazily
         TrpValidationPath paths;
+        std::set<std::string> path_keys;    // pushPath() copies, until clear()
+
+        bool fail_fast;
+        size_t max_errors;
+        TrpPathFormat path_format;
+
+        bool memo_enabled;
+        std::vector<TrpMemoEntry> memo;     // open addressing, NULL schema is empty
+        size_t memo_count;
+        size_t memo_hits, memo_misses;
+        size_t memo_depth;
+        TrpJsonHashCache hash_cache;        // hashes of the document being validated
+        TrpJsonHashCache* document_hashes;  // or the parser's, see setDocumentHashes()
+
+        TrpThreadPool* pool;
+        size_t parallel_min;
+        TrpSplitState* split_state;         // of the split this context is a range of
+        size_t split_range;
+
+        TrpProfiler* profiler;
+
+        void merge( const TrpValidatorContext& range );
+
+        void memoInsert( TrpMemoEntry& entry );
+
+        TrpErrorRecord* newRecord( TrpErrorCode code, const TrpSchema* schema );
+        TrpErrorRecord* newRecord( TrpErrorCode code, const TrpSchema* schema, SchemaType expected );
+        void appendPath( std::string& out, const TrpPathSegment* first, size_t length, TrpPathFormat _format ) const;
 
     public:
-        TrpValidatorContext( void );
+        // max_errors == 0 means no error budget
+        TrpValidatorContext( bool _fail_fast = false, size_t _max_errors = 0 );
 
-        void pushPath(const std::string _path);
+        void pushKey( const std::string& _key );
+        void pushIndex( size_t _index );
+        // The string segments validators used to push, ".name" or "[3]";
+        // any other string is a key. The context keeps a copy for the
+        // errors to point at.
+        void pushPath( const std::string _path );
         void popPath();
 
         void pushError(ValidationError _err);
-        std::string getCurrentPath( void );
+        void pushError( TrpErrorCode code, const TrpSchema* schema, double limit = 0, double value = 0 );
+        void pushError( TrpErrorCode code, const TrpSchema* schema, const std::string& key );
+        void pushTypeError( const TrpSchema* schema, SchemaType expected, TrpJsonType actual );
+        void pushMissing( const TrpSchema* schema, const std::string& key );
+        void pushPattern( const TrpSchema* schema, const std::string& pattern );
+        // Same records without a schema node, for validators that have none
+        // (generated code): `expected` stands for the node's type
+        void pushError( TrpErrorCode code, SchemaType expected, double limit = 0, double value = 0 );
+        void pushError( TrpErrorCode code, SchemaType expected, const std::string& key );
+        void pushTypeError( SchemaType expected, TrpJsonType actual );
+
+        // rendered on demand, only call it when an error is recorded
+        std::string getCurrentPath( void ) const;
+        std::string getCurrentPath( TrpPathFormat _format ) const;
+        void setPathFormat( TrpPathFormat _format );
+
+        bool shouldContinue( void ) const;
+        bool isFailFast( void ) const;
+        size_t getMaxErrors( void ) const;
+
+        size_t errorCount( void ) const { return records.size(); }
+        bool hasErrors( void ) const { return !records.empty(); }
+        const TrpErrorRecords& getRecords( void ) const { return records; }
+
+        // Text is only produced here, never while validating
+        std::string formatMessage( const TrpErrorRecord& record ) const;
+        std::string formatPath( const TrpErrorRecord& record ) const;
+        std::string formatPath( const TrpErrorRecord& record, TrpPathFormat _format ) const;
+
+        // forgets the errors, keeps the buffers for the next document
+        void clear( void );
+        // forgets the errors recorded after the first `count`
+        void dropErrors( size_t count );
+
+        // Memo of subtrees already proven valid against a schema node, kept
+        // across documents until clearMemo(). Each keeps an encoded copy of
+        // the subtree: a hash hit is compared with it, so colliding values
+        // are validated. The copies cost memory in proportion to the valid
+        // subtrees seen, which suits repetitive, templated input.
+        void enableMemo( bool _enabled = true );
+        bool isMemoEnabled( void ) const { return memo_enabled; }
+        void clearMemo( void );
+        size_t getMemoHits( void ) const { return memo_hits; }
+        size_t getMemoMisses( void ) const { return memo_misses; }
+        size_t getMemoSize( void ) const { return memo_count; }
+
+        // Hashes the parser computed for the document about to be validated
+        // (TrpBufferParser::computeHashes()), NULL to hash on demand again.
+        // Saves walking each subtree a second time to hash it.
+        void setDocumentHashes( TrpJsonHashCache* hashes );
+
+        // Bracket the validation of a value by a container schema. When
+        // memoEnter() returns true the value is known valid and memoLeave()
+        // must not be called.
+        bool memoEnter( const TrpSchema* schema, ITrpJsonValue* value, size_t& hash );
+        void memoLeave( const TrpSchema* schema, ITrpJsonValue* value, size_t hash, bool valid );
+
+        // Opt-in parallel validation: arrays and objects with at least
+        // `min_items` members are cut into ranges validated on `pool`, each
+        // into a context of its own. The ranges are merged back in document
+        // order, so the errors and the error budget behave as sequentially.
+        // The ranges do not use the memo.
+        void setThreadPool( TrpThreadPool* _pool, size_t _min_items = TRP_PARALLEL_MIN_ITEMS );
+        bool shouldSplit( size_t count ) const { return pool && count >= parallel_min; }
+        bool split( const TrpSplitBody& body, size_t count );
+
+        // True once an earlier range of the same split spent the error
+        // budget: whatever this range finds would be dropped
+        bool isCancelled( void ) const;
+
+        // Charges the time spent under every path to `_profiler`, NULL to
+        // stop. Contexts made for union trials and split ranges are not
+        // profiled on their own.
+        void setProfiler( TrpProfiler* _profiler ) { profiler = _profiler; }
+        TrpProfiler* getProfiler( void ) const { return profiler; }
 
         const TrpValidationError& getErrors( void ) const ;
         bool  printErrors( void ) const;
@@ -92,15 +484,51 @@ class TrpSchemaString : public TrpSchema
     private:
         bool has_min, has_max;
         size_t min_len, max_len;
+        bool code_points;
+        TrpStringFormat _format;
+        bool has_pattern;
+        TrpRegex _pattern;
+        bool has_enum;
+        TrpValueSet enum_values;
 
     public:
         TrpSchemaString();
 
+        // good for chaining
         TrpSchemaString& min( size_t _min_len );
         TrpSchemaString& max( size_t _max_len );
+        TrpSchemaString& format( TrpStringFormat _format );
+        // min/max count code points instead of bytes
+        TrpSchemaString& codePoints( bool _enabled = true );
+        // Compiled to a DFA here; see TrpRegex for the syntax. A pattern
+        // TrpRegex refuses is a build error: it would match nothing, so
+        // check hasPatternError() (the reason is getPattern().getError())
+        // before validating with a hand-built schema. TrpSchemaLoader fails
+        // the load instead.
+        TrpSchemaString& pattern( const std::string& _source );
+        // replace the allowed set, O(1) membership whatever its size
+        TrpSchemaString& enumValues( const std::vector<std::string>& values );
+        TrpSchemaString& constant( const std::string& value );
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkString( const char* data, size_t size, TrpValidatorContext& ctx ) const;
+        bool checkString( const std::string& value, TrpValidatorContext& ctx ) const { return checkString( value.data(), value.size(), ctx ); }
+        bool checkLength( size_t len, TrpValidatorContext& ctx ) const;
+        size_t measure( const char* data, size_t size ) const;
+        size_t measure( const std::string& value ) const { return measure( value.data(), value.size() ); }
         SchemaType getType() const { return SCHEMA_STRING; }
+
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_len; }
+        size_t getMax( void ) const { return max_len; }
+        bool isCodePoints( void ) const { return code_points; }
+        TrpStringFormat getFormat( void ) const { return _format; }
+        bool hasPattern( void ) const { return has_pattern; }
+        const TrpRegex& getPattern( void ) const { return _pattern; }
+        bool hasPatternError( void ) const { return has_pattern && !_pattern.isValid(); }
+        bool hasEnum( void ) const { return has_enum; }
+        const TrpValueSet& getEnum( void ) const { return enum_values; }
 };
 
 // ============================================================================
@@ -110,16 +538,52 @@ class TrpSchemaString : public TrpSchema
 class TrpSchemaNumber : public TrpSchema {
     private:
         bool has_min, has_max;
-        size_t min_value, max_value;
-        
+        double min_value, max_value;
+        bool min_exclusive, max_exclusive;
+        bool is_integer;
+        double multiple;            // 0 when unset
+        bool has_enum;
+        TrpValueSet enum_values;    // of the numbers' bytes, see inEnum()
+
     public:
         TrpSchemaNumber();
 
-        TrpSchemaNumber& min( size_t _min_value );
-        TrpSchemaNumber& max( size_t _max_value );
+        // the last bound set on a side wins
+        TrpSchemaNumber& min( double _min_value );
+        TrpSchemaNumber& max( double _max_value );
+        TrpSchemaNumber& exclusiveMin( double _min_value );
+        TrpSchemaNumber& exclusiveMax( double _max_value );
+        TrpSchemaNumber& integer( bool _enabled = true );
+        TrpSchemaNumber& multipleOf( double _multiple );
+        TrpSchemaNumber& enumValues( const std::vector<double>& values );
+        TrpSchemaNumber& constant( double value );
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkNumber( double nbr, TrpValidatorContext& ctx ) const;
+        bool checkRange( double nbr, TrpValidatorContext& ctx ) const;
+        bool accepts( double nbr ) const;
+        bool inEnum( double nbr ) const;
+        bool isMultiple( double nbr ) const;
+        // accepts() for a packed run of values, range checked with SIMD
+        bool acceptsAll( const double* values, size_t count ) const;
+        // Items [first, last) of an array of which this is the item schema:
+        // packed 64 at a time and range checked in one go, a run is only
+        // walked value by value when the packed check fails. Valid items get
+        // no path, so the callers skip it when a profiler is attached.
+        bool validateItems( TrpJsonArray* arr, size_t first, size_t last, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_NUMBER; }
+
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        double getMin( void ) const { return min_value; }
+        double getMax( void ) const { return max_value; }
+        bool isMinExclusive( void ) const { return min_exclusive; }
+        bool isMaxExclusive( void ) const { return max_exclusive; }
+        bool isInteger( void ) const { return is_integer; }
+        double getMultipleOf( void ) const { return multiple; }
+        bool hasEnum( void ) const { return has_enum; }
+        const TrpValueSet& getEnum( void ) const { return enum_values; }
+        TrpNumberRange getRange( void ) const;
 };
 
 // ============================================================================
@@ -127,9 +591,21 @@ class TrpSchemaNumber : public TrpSchema {
 // ============================================================================
 
 class TrpSchemaBool : public TrpSchema {
+    private:
+        bool has_const;
+        bool const_value;
+
     public:
+        TrpSchemaBool( void );
+
+        TrpSchemaBool& constant( bool value );
+
         bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool checkValue( bool value, TrpValidatorContext& ctx ) const;
         SchemaType getType( void ) const { return SCHEMA_BOOLEAN; }
+
+        bool hasConst( void ) const { return has_const; }
+        bool getConst( void ) const { return const_value; }
 };
 
 // ============================================================================
@@ -157,6 +633,10 @@ class TrpSchemaArray : public TrpSchema {
         bool has_min;
         size_t max_items, min_items;
 
+        bool validateItems( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+
+        friend class TrpSchemaFactory;      // intern() rewrites the children
+
     public:
         TrpSchemaArray();
 
@@ -168,7 +648,19 @@ class TrpSchemaArray : public TrpSchema {
         TrpSchemaArray& uniq(bool uniq);
 
         bool validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const;
+        bool checkSize( size_t size, TrpValidatorContext& ctx ) const;
+        bool checkTupleSize( size_t size, TrpValidatorContext& ctx ) const;
+        bool checkUniq( TrpJsonArray* arr, TrpValidatorContext& ctx ) const;
+        void reportDuplicate( size_t index, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_ARRAY; }
+
+        const TrpSchema* getItem( void ) const { return _item; }
+        const SchemaVec& getTuple( void ) const { return _tuple; }
+        bool isUniq( void ) const { return _uniq; }
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_items; }
+        size_t getMax( void ) const { return max_items; }
 };
 
 // ============================================================================
@@ -180,9 +672,15 @@ class TrpSchemaObject : public TrpSchema
     private:
         std::vector<std::string> required_entries;
         std::map<std::string, TrpSchema*> properties;
+        std::vector<bool> required_mask;
         bool has_min, has_max;
         size_t min_items, max_items;
-        
+
+        void indexRequired( void );
+        bool validateMembers( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool validateSplit( TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+
+        friend class TrpSchemaFactory;      // intern() rewrites properties
     public:
         TrpSchemaObject();
 
@@ -192,18 +690,139 @@ class TrpSchemaObject : public TrpSchema
         TrpSchemaObject& max( size_t max_value);
 
         bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool checkSize( size_t size, TrpValidatorContext& ctx ) const;
+        void reportMissing( const std::string& key, TrpValidatorContext& ctx ) const;
         SchemaType getType() const { return SCHEMA_OBJECT; }
+
+        const std::map<std::string, TrpSchema*>& getProperties( void ) const { return properties; }
+        const std::vector<std::string>& getRequired( void ) const { return required_entries; }
+        const std::vector<bool>& getRequiredMask( void ) const { return required_mask; }
+        bool hasMin( void ) const { return has_min; }
+        bool hasMax( void ) const { return has_max; }
+        size_t getMin( void ) const { return min_items; }
+        size_t getMax( void ) const { return max_items; }
+};
+
+// ============================================================================
+// TrpSchemaUnion
+// ============================================================================
+
+#define TRP_UNION_TYPES (TRP_OBJECT + 1)
+
+enum TrpUnionMode
+{
+    UNION_ANY_OF,
+    UNION_ONE_OF
+};
+
+enum TrpUnionPick
+{
+    UNION_BRANCH,       // the only branch the value can belong to
+    UNION_NONE,         // no branch takes it
+    UNION_TRY           // several branches take its type, they must be tried
+};
+
+// Branches are indexed by the JSON type they accept and, once a
+// discriminator is set, objects by the value of that property, so a value
+// goes straight to its one candidate branch. Only branches that share a
+// type and are not told apart by the discriminator are tried one by one,
+// each into a fail-fast scratch context.
+class TrpSchemaUnion : public TrpSchema
+{
+    private:
+        TrpUnionMode mode;
+        std::vector<TrpSchema*> branches;
+        std::vector<size_t> by_type[TRP_UNION_TYPES];
+
+        std::string key;                    // discriminator property
+        std::vector<std::string> tags;      // per branch, empty when untagged
+        TrpValueSet tag_set;
+        std::vector<size_t> tag_branch;     // tag_set slot -> branch
+        std::string duplicate_tag;          // first tag given twice
+
+        void indexBranches( void );
+        TrpUnionPick pickUntagged( TrpJsonType type, size_t& index ) const;
+
+        friend class TrpSchemaFactory;      // sets the mode, intern() rewrites branches
+    public:
+        TrpSchemaUnion( void );
+
+        TrpSchemaUnion& branch( TrpSchema* schema );
+        // objects whose `key` property is the string `tag` go to `schema`.
+        // A tag given twice is a build error: the later branch would hide the
+        // ambiguity, so it is refused and the first one kept; check
+        // hasTagError() after building.
+        TrpSchemaUnion& discriminator( const std::string& _key );
+        TrpSchemaUnion& branch( const std::string& tag, TrpSchema* schema );
+
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        // Reports the error itself when it returns UNION_NONE
+        TrpUnionPick pick( ITrpJsonValue* value, TrpValidatorContext& ctx, size_t& index ) const;
+        // An object of a discriminated union by its tag member: `tag_type` is
+        // TRP_ERROR when there is none, `tag` only set for a string
+        TrpUnionPick pickObject( TrpJsonType tag_type, const char* tag, size_t size, TrpValidatorContext& ctx, size_t& index ) const;
+        // From the type alone: objects of a discriminated union are UNION_TRY
+        TrpUnionPick pickType( TrpJsonType type, size_t& index ) const;
+        bool tryBranches( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        // Verdict once `tried` candidates gave `matches`, reported if it fails
+        bool reportTrial( size_t matches, size_t tried, TrpValidatorContext& ctx ) const;
+        void reportType( TrpJsonType actual, TrpValidatorContext& ctx ) const;
+        SchemaType getType() const { return SCHEMA_UNION; }
+
+        TrpUnionMode getMode( void ) const { return mode; }
+        const std::vector<TrpSchema*>& getBranches( void ) const { return branches; }
+        const std::string& getDiscriminator( void ) const { return key; }
+        const std::vector<std::string>& getTags( void ) const { return tags; }
+        bool isTagged( void ) const { return !tag_branch.empty(); }
+        bool hasTagError( void ) const { return !duplicate_tag.empty(); }
+        const std::string& getDuplicateTag( void ) const { return duplicate_tag; }
+        // branches taking `type` untagged, in declaration order
+        const std::vector<size_t>& getCandidates( TrpJsonType type ) const { return by_type[type]; }
 };
 
 // ============================================================================
 // TrpSchemaFactory
 // ============================================================================
 
+#define TRP_ARENA_BLOCK 16384
+
+enum TrpFactoryMode
+{
+    FACTORY_HEAP,       // one new/delete per schema
+    FACTORY_ARENA       // schemas bump-allocated from large blocks
+};
+
 class TrpSchemaFactory {
     private:
         std::vector<TrpSchema*> _managedSchemas;
 
+        TrpFactoryMode mode;
+        size_t block_size;
+        std::vector<char*> blocks;
+        size_t current;             // block being filled
+        size_t used;                // bytes used in blocks[current]
+
+        void* allocate( size_t size );
+        void release( void );
+
+        // signature -> canonical node, see intern()
+        std::map<std::string, TrpSchema*> interned;
+
+        TrpSchema* internNode( TrpSchema* schema, std::map<TrpSchema*, TrpSchema*>& seen, bool& open );
+
+        template <typename T>
+        T& create( void ) {
+            T* schema = mode == FACTORY_ARENA ? new (allocate(sizeof(T))) T() : new T();
+            _managedSchemas.push_back(schema);
+            return *schema;
+        }
+
+        TrpSchemaFactory( const TrpSchemaFactory& );
+        TrpSchemaFactory& operator=( const TrpSchemaFactory& );
+
     public:
+        TrpSchemaFactory( void );
+        explicit TrpSchemaFactory( TrpFactoryMode _mode, size_t _block_size = TRP_ARENA_BLOCK );
         ~TrpSchemaFactory();
 
         TrpSchemaString& string();
@@ -212,6 +831,1594 @@ class TrpSchemaFactory {
         TrpSchemaObject& object();
         TrpSchemaArray& array();
         TrpSchemaNull& null();
+        TrpSchemaUnion& anyOf();
+        TrpSchemaUnion& oneOf();
+
+        // Destroys every schema made so far, one destructor each. Arena
+        // blocks are kept and refilled by the next schemas, so a rebuild
+        // allocates no node; their members still use the heap.
+        void reset( void );
+
+        // Hash-consing pass over a finished schema: structurally identical
+        // nodes, whole objects and arrays included, are collapsed into one
+        // shared instance, also across calls. Use the returned root; nodes
+        // that were merged away stay owned by the factory until reset().
+        // Nodes on a reference cycle and unknown schema types are kept as is.
+        template <typename T>
+        T& intern( T& root ) {
+            std::map<TrpSchema*, TrpSchema*> seen;
+            bool open = false;
+            return static_cast<T&>(*internNode(&root, seen, open));
+        }
+
+        size_t internedSize( void ) const { return interned.size(); }
+
+        TrpFactoryMode getMode( void ) const { return mode; }
+        size_t size( void ) const { return _managedSchemas.size(); }
+        size_t blockCount( void ) const { return blocks.size(); }
+};
+
+// ============================================================================
+// TrpBufferLexer
+// ============================================================================
+
+// Tokenizes a JSON document that is already in memory. Produces the same
+// tokens as TrpJsonLexer (values unescaped, 0-based line/col) but never
+// copies the input: the buffer must outlive the lexer.
+class TrpBufferLexer {
+    private:
+        const char* start;
+        const char* cur;
+        const char* end;
+        size_t line;
+        const char* line_start;
+
+        void skipWhitespace( void );
+        void readString( token& tok );
+        void readNumber( token& tok );
+        void readLiteral( token& tok );
+        bool skipString( void );
+        void errorToken( token& tok, const std::string& message );
+
+    public:
+        TrpBufferLexer( const char* _data, size_t _size );
+        explicit TrpBufferLexer( const std::string& _data );
+
+        token getNextToken( void );
+        // same as getNextToken() but reuses tok.value's storage
+        void nextToken( token& tok );
+        // Moves past the next value without tokenizing it: brackets are
+        // counted and strings delimited, nothing else is checked. When there
+        // is no value, or it never ends, `tok` is the offending token.
+        bool skipValue( token& tok );
+
+        void reset( void );
+        void reset( const char* _data, size_t _size );
+        size_t offset( void ) const;
+        const char* data( void ) const { return start; }
+        size_t size( void ) const { return end - start; }
+};
+
+// ============================================================================
+// TrpStreamingValidator
+// ============================================================================
+
+// Validates a document straight from the lexer's token stream, without
+// building the AST. It keeps one frame per open container, so memory is
+// O(depth); frames are reused from one document to the next.
+//
+// Constraints that need the whole container (min/max, required keys, tuple
+// length) are checked when the container closes, so errors come out in
+// document order rather than in the order TrpSchema::validate reports them.
+// Unions are resolved by the token type where it decides the branch. A
+// value the tokens alone cannot decide (a union whose branches must be
+// tried, the object of a discriminated union, an array with uniq or a
+// tuple) is buffered into a DOM subtree and handed to TrpSchema::validate:
+// only that value is held in memory, and it gets the same errors as in the
+// tree.
+//
+// The tree keeps the last value of a repeated key. A declared key repeated
+// in an object validated as it streams stops the pass: validate() then
+// parses the whole document and hands it to TrpSchema::validate, in place
+// of the errors the pass recorded, and a push caller sees hasRepeatedKey().
+// A repeated undeclared key counts once. Once the error budget is spent,
+// the objects still open are read on for their keys, nothing validated, as
+// a repeat would replace the value that failed.
+class TrpStreamingValidator {
+    private:
+        enum Expect {
+            EXPECT_VALUE,
+            EXPECT_VALUE_OR_END,
+            EXPECT_KEY,
+            EXPECT_KEY_OR_END,
+            EXPECT_COLON,
+            EXPECT_COMMA_OR_END,
+            EXPECT_EOF
+        };
+
+        struct Frame {
+            const TrpSchema* schema;        // NULL when the subtree is skipped
+            bool is_object;
+            bool pushed_path;
+            bool failed;
+            size_t count;
+
+            // object: schema of the value that follows the current key
+            const TrpSchema* next;
+            const std::string* next_key;
+            bool next_declared;
+            std::vector<char> seen;         // one flag per required entry
+            std::vector<const std::string*> declared;   // properties met, sorted
+            std::set<std::string> undeclared;   // other keys, when min/max counts them
+        };
+
+        const TrpSchema& root;
+        TrpValidatorContext* ctx;
+        std::vector<Frame> frames;
+        size_t depth;
+
+        Expect expect;
+        bool done;
+        bool failed;
+        bool syntax_error;
+        bool scanning;                      // the budget is spent, keys only
+        bool repeated;
+        size_t first_error;                 // errors in the context at begin()
+        token last_err;
+        token current;
+
+        // the value being buffered for TrpSchema::validate
+        const TrpSchema* capture_schema;
+        size_t capture_depth;               // depth of its frame
+        std::vector<ITrpJsonValue*> capture_stack;  // open containers, the value first
+        std::string capture_key;
+
+        bool syntaxError( const token& tok, const std::string& msg );
+        bool beginValue( const token& tok );
+        bool endValue( bool ok );
+        bool openContainer( const token& tok, const TrpSchema* schema, bool pushed );
+        bool closeContainer( void );
+        bool checkScalar( const token& tok, const TrpSchema* schema );
+        bool resolveUnion( const TrpSchema*& schema, TrpJsonType actual );
+        bool deferValue( const token& tok, const TrpSchema* schema, bool pushed );
+        bool captureValue( const token& tok );
+        bool finishCapture( void );
+        void dropCapture( void );
+        bool readOn( void );
+        bool repeatedKey( void );
+        bool validateTree( bool parsed, ITrpJsonValue* document, const token& err );
+
+        TrpStreamingValidator( const TrpStreamingValidator& other );
+        TrpStreamingValidator& operator=( const TrpStreamingValidator& other );
+
+    public:
+        TrpStreamingValidator( const TrpSchema& _root );
+        ~TrpStreamingValidator( void );
+
+        // push interface: begin(), then feed() tokens while it returns true
+        void begin( TrpValidatorContext& _ctx );
+        bool feed( const token& tok );
+        bool isValid( void ) const;
+
+        // pulls tokens from the lexer until the document is decided
+        bool validate( TrpJsonLexer& lexer, TrpValidatorContext& _ctx );
+        bool validate( TrpBufferLexer& lexer, TrpValidatorContext& _ctx );
+
+        bool hasSyntaxError( void ) const;
+        const token& getLastError( void ) const;
+        // a declared key came twice: feed() stopped there, validate the
+        // document with TrpSchema::validate rather than trust isValid()
+        bool hasRepeatedKey( void ) const;
+};
+
+// ============================================================================
+// TrpCompiledSchema
+// ============================================================================
+
+#define TRP_NO_NODE 0xffffffffu
+
+enum TrpOpcode
+{
+    OP_STRING,
+    OP_NUMBER,
+    OP_BOOLEAN,
+    OP_NULL,
+    OP_OBJECT,
+    OP_ARRAY,
+    OP_UNION,       // branches in slots, picked by the source union
+    OP_REJECT,      // declared slot without a schema, fails silently
+    OP_DELEGATE     // schema type the compiler does not know, calls validate()
+};
+
+enum TrpNodeFlag
+{
+    NODE_HAS_MIN = 1 << 0,
+    NODE_HAS_MAX = 1 << 1,
+    NODE_UNIQ = 1 << 2,
+    NODE_CODE_POINTS = 1 << 3,  // string length in code points
+    NODE_FORMAT = 1 << 4,
+    NODE_PATTERN = 1 << 5,      // string: the source schema's regex
+    NODE_ENUM = 1 << 6,         // the source's enum set; bool: constant in count
+    NODE_INTEGER = 1 << 7,
+    NODE_MULTIPLE = 1 << 8      // number: the source's multipleOf
+};
+
+// One schema node. Children are referenced by index, never by pointer, so
+// the program is a handful of contiguous arrays.
+struct TrpCompiledNode {
+    unsigned int op;
+    unsigned int flags;
+    unsigned int item;          // array: item node or TRP_NO_NODE
+    unsigned int first;         // object: first key entry, array/union: first slot
+    unsigned int count;         // object: key entries, array: tuple length, union: branches, string: format
+    double min_value;
+    double max_value;
+};
+
+// Object keys, sorted the same way as JsonObjectMap so lookups are a merge
+struct TrpCompiledKey {
+    unsigned int name;          // offset in the string pool
+    unsigned int length;
+    unsigned int node;
+    unsigned int required;
+};
+
+// A finished schema flattened into one immutable program. The fluent
+// TrpSchema tree stays the front end: compile it once, then validate
+// through the program. Error messages come from the source schema nodes,
+// which must outlive the program.
+class TrpCompiledSchema {
+    private:
+        std::vector<TrpCompiledNode> nodes;
+        std::vector<TrpCompiledKey> keys;
+        std::vector<unsigned int> slots;        // tuple children
+        std::string pool;
+
+        std::vector<const TrpSchema*> sources;
+        std::vector<const std::string*> key_names;
+
+        unsigned int emit( const TrpSchema* schema, std::map<const TrpSchema*, unsigned int>& seen );
+        bool run( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        bool runObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+        bool runArray( unsigned int index, TrpJsonArray* arr, TrpValidatorContext& ctx ) const;
+        bool runMemo( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+        int compareKey( const std::string& key, const TrpCompiledKey& entry ) const;
+        bool splitObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const;
+
+        // TrpSplitBody ranges of runArray() / splitObject()
+        class ItemRange;
+        class MemberRange;
+        friend class ItemRange;
+        friend class MemberRange;
+
+    public:
+        TrpCompiledSchema( void );
+        explicit TrpCompiledSchema( const TrpSchema& root );
+
+        void compile( const TrpSchema& root );
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const;
+
+        size_t size( void ) const { return nodes.size(); }
+        bool empty( void ) const { return nodes.empty(); }
+};
+
+// ============================================================================
+// TrpBatchValidator
+// ============================================================================
+
+struct TrpBatchStats {
+    size_t docs;
+    size_t passed;
+    size_t failed;
+    size_t bytes;
+    double seconds;
+};
+
+// Validates a JSON Lines stream: the calling thread reads batches of lines,
+// `threads` workers validate them against the shared (read-only) schema and
+// a writer thread prints one result per line, in input order:
+//
+//     <line>\tok
+//     <line>\tfail\t<path>: <message>
+//
+// Blank lines are skipped. Each document stops at its first error.
+class TrpBatchValidator {
+    private:
+        const TrpSchema& schema;
+        size_t threads;
+        size_t batch_lines;
+
+    public:
+        TrpBatchValidator( const TrpSchema& _schema, size_t _threads = 1 );
+
+        TrpBatchValidator& batchSize( size_t _lines );
+
+        TrpBatchStats run( std::istream& in, std::ostream& out );
+};
+
+// ============================================================================
+// TrpMappedFile
+// ============================================================================
+
+// Read-only mmap of a whole file, to hand to TrpBufferLexer/TrpBufferParser.
+// The mapping lives as long as the object: tokens and DOM values copy what
+// they keep, so it can be closed once parsing or validation is done.
+class TrpMappedFile {
+    private:
+        const char* _data;
+        size_t _size;
+        bool is_open;
+        std::string error;
+
+        TrpMappedFile( const TrpMappedFile& );
+        TrpMappedFile& operator=( const TrpMappedFile& );
+
+    public:
+        TrpMappedFile( void );
+        explicit TrpMappedFile( const std::string& file_name );
+        ~TrpMappedFile();
+
+        bool open( const std::string& file_name );
+        void close( void );
+
+        bool isOpen( void ) const { return is_open; }
+        const char* data( void ) const { return _data; }
+        size_t size( void ) const { return _size; }
+        const std::string& getError( void ) const { return error; }
+};
+
+// ============================================================================
+// TrpBufferParser
+// ============================================================================
+
+// Builds the same DOM as TrpJsonParser from an in-memory buffer, or from a
+// file mapped with mmap, without going through std::ifstream lines. Unlike
+// TrpJsonParser, anything but whitespace after the root value is an error.
+// The AST belongs to the parser unless release() is called.
+class TrpBufferParser {
+    private:
+        TrpBufferLexer lexer;
+        TrpMappedFile file;
+        ITrpJsonValue* head;
+        bool parsed;
+        token current;
+        token last_err;
+
+        bool hashing;
+        TrpJsonHashCache hashes;
+
+        // `hash` is NULL unless hashing is on, `shape` unless projecting
+        ITrpJsonValue* parseValue( size_t* hash, const TrpSchema* shape );
+        ITrpJsonValue* parseObject( size_t* hash, const TrpSchema* shape );
+        ITrpJsonValue* parseArray( size_t* hash, const TrpSchema* shape );
+        bool parseRoot( const TrpSchema* shape );
+        ITrpJsonValue* fail( const std::string& message );
+
+        TrpBufferParser( const TrpBufferParser& );
+        TrpBufferParser& operator=( const TrpBufferParser& );
+
+    public:
+        TrpBufferParser( void );
+        TrpBufferParser( const char* _data, size_t _size );
+        explicit TrpBufferParser( const std::string& _data );
+        ~TrpBufferParser();
+
+        // Maps `file_name` and makes it the input
+        bool openFile( const std::string& file_name );
+        void setBuffer( const char* _data, size_t _size );
+
+        bool parse( void );
+        // Projection: only what validating against `schema` looks at becomes
+        // nodes. Values of keys an object schema does not declare are
+        // skipped by TrpBufferLexer::skipValue(), unchecked; they are kept
+        // as nulls only when the object has min/max, which counts them.
+        // Unions, uniq arrays and items of arrays with both item and tuple
+        // schemas are parsed in full. The AST is only fit for `schema`.
+        bool parse( const TrpSchema& schema );
+        ITrpJsonValue* getAST( void ) const { return head; }
+        ITrpJsonValue* release( void );
+        bool isParsed( void ) const { return parsed; }
+        const token& getLastError( void ) const { return last_err; }
+        void clearAST( void );
+
+        // Computes the structural hash of every container while parsing,
+        // for TrpValidatorContext::setDocumentHashes() and the memo cache.
+        void computeHashes( bool _enabled = true ) { hashing = _enabled; }
+        TrpJsonHashCache& getHashes( void ) { return hashes; }
+};
+
+// ============================================================================
+// TrpThreadPool
+// ============================================================================
+
+class TrpTask {
+    public:
+        virtual ~TrpTask( void ) {}
+        virtual void run( void ) = 0;
+};
+
+// Work-stealing pool. Every worker owns a deque: it pops its newest task and,
+// once empty, steals the oldest task of another worker. A thread waiting in
+// run() executes queued tasks meanwhile, so a task may call run() itself.
+class TrpThreadPool {
+    private:
+        struct Slot {
+            TrpTask* task;
+            size_t* pending;        // of the run() that queued it
+        };
+
+        struct Queue {
+            pthread_mutex_t lock;
+            std::deque<Slot> slots;
+        };
+
+        struct Worker {
+            TrpThreadPool* pool;
+            size_t index;
+        };
+
+        std::vector<Queue*> queues;
+        std::vector<Worker> workers;
+        std::vector<pthread_t> threads;
+        pthread_key_t self;         // Worker* of the calling thread, NULL outside
+
+        pthread_mutex_t lock;
+        pthread_cond_t changed;     // a task was queued or a run() finished
+        size_t queued;
+        size_t next;                // queue for the next task from outside
+        bool stopping;
+
+        static void* workerMain( void* arg );
+        bool runOne( size_t home );
+
+        TrpThreadPool( const TrpThreadPool& );
+        TrpThreadPool& operator=( const TrpThreadPool& );
+
+    public:
+        explicit TrpThreadPool( size_t _threads );
+        ~TrpThreadPool();
+
+        // Runs every task and returns once they are all done
+        void run( TrpTask** tasks, size_t count );
+
+        size_t size( void ) const { return threads.size(); }
+};
+
+// ============================================================================
+// TrpTape
+// ============================================================================
+
+// Tag in the top byte of a tape word, the payload is the other 56 bits
+enum TrpTapeTag
+{
+    TAPE_OBJECT = '{',          // payload: index of the word after the matching end
+    TAPE_OBJECT_END = '}',      // payload: member count
+    TAPE_ARRAY = '[',
+    TAPE_ARRAY_END = ']',
+    TAPE_STRING = '"',          // payload: offset of the string in the string buffer
+    TAPE_NUMBER = 'd',          // the next word holds the double
+    TAPE_TRUE = 't',
+    TAPE_FALSE = 'f',
+    TAPE_NULL = 'n'
+};
+
+#define TRP_TAPE_PAYLOAD 0x00ffffffffffffffULL
+
+// A whole document as one array of tagged 64-bit words plus one buffer for
+// the string bytes, the way simdjson lays it out. Values follow each other
+// in document order; an object's members are a key string then its value.
+// A value is named by the index of its first word, the root is 0. Strings
+// are stored as a 32-bit length, the bytes and a NUL.
+class TrpTape {
+    private:
+        std::vector<uint64_t> words;
+        std::string strings;
+
+        friend class TrpTapeParser;
+
+    public:
+        void clear( void );
+        bool empty( void ) const { return words.empty(); }
+        size_t size( void ) const { return words.size(); }
+
+        TrpTapeTag tag( size_t index ) const { return static_cast<TrpTapeTag>(words[index] >> 56); }
+        uint64_t payload( size_t index ) const { return words[index] & TRP_TAPE_PAYLOAD; }
+        TrpJsonType type( size_t index ) const;
+
+        // index of the value after the one at `index`, containers included
+        size_t next( size_t index ) const;
+        // members of an object, items of an array
+        size_t count( size_t index ) const { return payload( payload( index ) - 1 ); }
+        // first member / item of a container; equal to its end when empty
+        size_t first( size_t index ) const { return index + 1; }
+        size_t end( size_t index ) const { return payload( index ) - 1; }
+
+        double number( size_t index ) const;
+        bool boolean( size_t index ) const { return tag( index ) == TAPE_TRUE; }
+        const char* string( size_t index, size_t& length ) const;
+        std::string stringValue( size_t index ) const;
+};
+
+// ============================================================================
+// TrpTapeParser
+// ============================================================================
+
+// Parses an in-memory buffer, or a mapped file, into a TrpTape instead of
+// a tree of ITrpJsonValue. Same grammar and error messages as
+// TrpBufferParser. The tape and the lexer's token keep their storage from
+// one parse() to the next, so a warm parser does not allocate at all.
+class TrpTapeParser {
+    private:
+        TrpBufferLexer lexer;
+        TrpMappedFile file;
+        size_t input_size;
+        TrpTape tape;
+        bool parsed;
+        token current;
+        token last_err;
+
+        bool parseValue( void );
+        bool parseObject( void );
+        bool parseArray( void );
+        void appendWord( TrpTapeTag tag, uint64_t payload );
+        void appendString( const std::string& value );
+        void closeContainer( size_t open, TrpTapeTag tag, size_t count );
+        bool fail( const std::string& message );
+
+        TrpTapeParser( const TrpTapeParser& );
+        TrpTapeParser& operator=( const TrpTapeParser& );
+
+    public:
+        TrpTapeParser( void );
+        TrpTapeParser( const char* _data, size_t _size );
+        explicit TrpTapeParser( const std::string& _data );
+
+        // Maps `file_name` and makes it the input
+        bool openFile( const std::string& file_name );
+        void setBuffer( const char* _data, size_t _size );
+
+        bool parse( void );
+        const TrpTape& getTape( void ) const { return tape; }
+        bool isParsed( void ) const { return parsed; }
+        const token& getLastError( void ) const { return last_err; }
+};
+
+// ============================================================================
+// TrpTapeValidator
+// ============================================================================
+
+// Validates a TrpTape against a schema tree: same checks, errors and error
+// order as TrpSchema::validate on the DOM of the same document. The tape is
+// read front to back; an object's members are sorted by key into a scratch
+// array reused from one object (and one document) to the next, and a
+// repeated key keeps its last value, like TrpJsonObject. The memo cache and
+// splitting a container across threads are DOM only.
+class TrpTapeValidator {
+    private:
+        struct Member {
+            const char* key;
+            size_t length;
+            size_t value;
+        };
+
+        const TrpSchema& root;
+        const TrpTape* tape;
+        std::vector<Member> members;        // the open objects' members, stacked
+
+        bool validateValue( const TrpSchema* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateObject( const TrpSchemaObject* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateArray( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx );
+        bool validateNumbers( const TrpSchemaNumber* item, size_t index, TrpValidatorContext& ctx );
+        bool validateUnion( const TrpSchemaUnion* schema, size_t index, TrpValidatorContext& ctx );
+        bool checkUniq( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx ) const;
+        size_t collectMembers( size_t index );
+        static bool memberLess( const Member& a, const Member& b );
+        size_t hashValue( size_t index ) const;
+        bool equalValues( size_t a, size_t b ) const;
+
+        TrpTapeValidator( const TrpTapeValidator& other );
+        TrpTapeValidator& operator=( const TrpTapeValidator& other );
+
+    public:
+        TrpTapeValidator( const TrpSchema& _root );
+
+        // `tape` must hold a parsed document
+        bool validate( const TrpTape& _tape, TrpValidatorContext& ctx );
+};
+
+// ============================================================================
+// TrpProfiler
+// ============================================================================
+
+enum TrpProfileMetric
+{
+    PROFILE_TIME,       // exclusive nanoseconds
+    PROFILE_BYTES,      // exclusive bytes allocated
+    PROFILE_VISITS
+};
+
+// Per schema path totals, as reported
+struct TrpProfileEntry {
+    std::string path;       // .users[].address.zip, "$" for the root
+    size_t visits;
+    size_t failures;        // visits during which an error was recorded
+    double inclusive_ns;
+    double exclusive_ns;
+    size_t inclusive_bytes;
+    size_t exclusive_bytes;
+};
+
+// Cost of validation by schema path rather than by C++ function. Attach it
+// with TrpValidatorContext::setProfiler(): every pushKey()/pushIndex() the
+// validators make opens a frame on the node of that path, popPath() closes
+// it, so the tree, compiled, streaming and tape validators all report the
+// same way. Array items share one node ("[]"). Time is read from the TSC on
+// x86 (clock_gettime elsewhere) and converted to nanoseconds when reported.
+//
+// start() and stop() bracket one document and time the root itself; without
+// them the root only groups its members. Union trials and split ranges run
+// in contexts of their own, their cost is the cost of the union or of the
+// container. Not thread safe: one profiler per context.
+class TrpProfiler {
+    private:
+        struct Node {
+            size_t parent;
+            const std::string* key;     // NULL for an array item
+            size_t visits;
+            size_t failures;
+            uint64_t inclusive;
+            uint64_t exclusive;
+            size_t inclusive_bytes;
+            size_t exclusive_bytes;
+        };
+
+        struct Frame {
+            size_t node;
+            uint64_t start;
+            uint64_t children;          // ticks spent in child frames
+            size_t start_bytes;
+            size_t child_bytes;
+            size_t errors;              // error count when it opened
+        };
+
+        std::vector<Node> nodes;        // nodes[0] is the root
+        std::vector<size_t> slots;      // (parent, key) -> node + 1, open addressing
+        std::vector<Frame> frames;
+        size_t errors;
+        const size_t* allocated;
+
+        uint64_t origin_ticks;          // when the profile was cleared
+        uint64_t origin_ns;
+
+        size_t findChild( size_t parent, const std::string* key );
+        void insertSlot( size_t node );
+        void open( size_t node );
+        double nsPerTick( void ) const;
+        void appendPath( std::string& out, size_t node, bool folded ) const;
+        size_t readBytes( void ) const { return allocated ? *allocated : 0; }
+
+        TrpProfiler( const TrpProfiler& other );
+        TrpProfiler& operator=( const TrpProfiler& other );
+
+    public:
+        TrpProfiler( void );
+
+        // `bytes` is a running total of bytes allocated kept by the
+        // application (e.g. by its operator new), NULL to not count them
+        void setAllocationCounter( const size_t* bytes );
+
+        void start( void );
+        void stop( void );
+
+        // Called by TrpValidatorContext
+        void enterKey( const std::string& key ) { open( findChild( frames.empty() ? 0 : frames.back().node, &key ) ); }
+        void enterIndex( void ) { open( findChild( frames.empty() ? 0 : frames.back().node, NULL ) ); }
+        void leave( void );
+        void countError( void ) { errors++; }
+
+        // Drops the totals, keeps the buffers
+        void clear( void );
+
+        // One entry per schema path, nodes reached through different
+        // schemas (union branches) merged, sorted by exclusive time
+        std::vector<TrpProfileEntry> getEntries( void ) const;
+
+        // Brendan Gregg's folded stacks, "$;.users;[];.zip 1234" per line,
+        // for flamegraph.pl
+        void writeFolded( std::ostream& out, TrpProfileMetric metric = PROFILE_TIME ) const;
+        // The `top` most expensive paths by exclusive time, 0 for all
+        void printTable( std::ostream& out, size_t top = 20 ) const;
+};
+
+// ============================================================================
+// TrpSchemaLoader
+// ============================================================================
+
+// Builds TrpSchema nodes from a JSON Schema document, through `factory`,
+// which owns them. The subset understood:
+//   type            "string", "number", "integer", "boolean", "object",
+//                   "array", "null", or an array of them (an anyOf)
+//   properties, required, minProperties, maxProperties
+//   items (a schema, or an array of schemas for a tuple of exactly that
+//   length, see TrpSchemaArray::tuple; the document must pin the length
+//   with minItems and maxItems, or minItems and additionalItems: false),
+//   additionalItems (a boolean), minItems, maxItems, uniqueItems
+//   minLength, maxLength, pattern (TrpRegex syntax; one it refuses fails
+//   the load)
+//   minimum, maximum, exclusiveMinimum, exclusiveMaximum (numbers, as in
+//   draft 6 and later), multipleOf
+// A keyword only applies to its type, like in JSON Schema. Annotations
+// ($schema, $id, title, description, ...) and additionalProperties: true
+// are ignored; any other keyword fails the load rather than be dropped
+// silently, and so does a required name that is not a property. Nodes of
+// a failed load stay in the factory until reset().
+class TrpSchemaLoader {
+    private:
+        TrpSchemaFactory& factory;
+        std::string error;
+
+        TrpSchema* loadSchema( ITrpJsonValue* value, const std::string& path );
+        TrpSchema* loadType( const std::string& type, TrpJsonObject* obj, const std::string& path );
+        bool loadObject( TrpSchemaObject& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadArray( TrpSchemaArray& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadNumber( TrpSchemaNumber& schema, TrpJsonObject* obj, const std::string& path );
+        bool loadString( TrpSchemaString& schema, TrpJsonObject* obj, const std::string& path );
+        bool checkKeywords( TrpJsonObject* obj, const std::string& path );
+        bool readCount( TrpJsonObject* obj, const char* keyword, bool& found, size_t& count, const std::string& path );
+        bool readNumber( TrpJsonObject* obj, const char* keyword, bool& found, double& nbr, const std::string& path );
+        TrpSchema* fail( const std::string& path, const std::string& message );
+
+        TrpSchemaLoader( const TrpSchemaLoader& );
+        TrpSchemaLoader& operator=( const TrpSchemaLoader& );
+
+    public:
+        explicit TrpSchemaLoader( TrpSchemaFactory& _factory );
+
+        // The root schema, NULL on error. The document can go once loaded.
+        TrpSchema* load( ITrpJsonValue* document );
+        // Parses `file_name` with TrpJsonParser first
+        TrpSchema* loadFile( const std::string& file_name );
+
+        // "<JSON Pointer>: <what is wrong>" of the last failed load
+        const std::string& getError( void ) const { return error; }
+};
+
+// ============================================================================
+// TrpSchemaSnapshot
+// ============================================================================
+
+#define TRP_SNAPSHOT_MAGIC "TRPSNAP"
+#define TRP_SNAPSHOT_VERSION 1
+#define TRP_SNAPSHOT_BYTE_ORDER 0x01020304u
+#define TRP_SNAPSHOT_NONE 0xffffffffu
+
+enum TrpSnapshotFlag
+{
+    SNAP_HAS_MIN = 1 << 0,
+    SNAP_HAS_MAX = 1 << 1,
+    SNAP_MIN_EXCLUSIVE = 1 << 2,
+    SNAP_MAX_EXCLUSIVE = 1 << 3,
+    SNAP_INTEGER = 1 << 4,
+    SNAP_MULTIPLE = 1 << 5,
+    SNAP_UNIQ = 1 << 6,
+    SNAP_CODE_POINTS = 1 << 7,
+    SNAP_CONST = 1 << 8         // boolean: constant in `extra`
+};
+
+// The image: this header, then node_count nodes, key_count keys, slot_count
+// slots and pool_size bytes of key names. Everything refers to everything
+// else by index, so the image means the same wherever it is mapped.
+struct TrpSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // TRP_SNAPSHOT_BYTE_ORDER as written
+    uint32_t node_count;
+    uint32_t key_count;
+    uint32_t slot_count;
+    uint32_t pool_size;
+    uint64_t checksum;          // FNV-1a of everything after the header
+};
+
+struct TrpSnapshotNode {
+    uint32_t type;              // SchemaType
+    uint32_t flags;
+    uint32_t item;              // array: item node or TRP_SNAPSHOT_NONE
+    uint32_t first;             // object: first key, array/union: first slot
+    uint32_t count;             // object: keys, array: tuple length, union: branches
+    uint32_t extra;             // string: format, boolean: constant, union: mode
+    double min;
+    double max;
+    double multiple;
+};
+
+// An object's property, in key order
+struct TrpSnapshotKey {
+    uint32_t name;              // offset in the pool
+    uint32_t length;
+    uint32_t node;              // TRP_SNAPSHOT_NONE for a NULL schema
+    uint32_t required;
+};
+
+// Versioned binary image of a schema tree, for services that load many
+// schemas at startup: capture() once, writeFile(), then openFile() maps it
+// and checks it in place, and instantiate() builds the schema nodes straight
+// from the mapping, with no JSON to parse. Shared nodes and cycles survive
+// the round trip. Patterns, enums and discriminators are not in the format:
+// capture() refuses a schema using them. The image is in the writer's byte
+// order and a reader with another one refuses it.
+class TrpSchemaSnapshot {
+    private:
+        std::vector<uint64_t> buffer;   // the image capture() made, aligned
+        TrpMappedFile file;
+        const char* image;
+        size_t image_size;
+        std::string error;
+
+        const TrpSnapshotHeader* header;
+        const TrpSnapshotNode* nodes;
+        const TrpSnapshotKey* keys;
+        const uint32_t* slots;
+        const char* pool;
+
+        uint32_t emit( const TrpSchema* schema, const std::string& path, std::vector<TrpSnapshotNode>& out_nodes,
+            std::vector<TrpSnapshotKey>& out_keys, std::vector<uint32_t>& out_slots, std::string& out_pool,
+            std::map<const TrpSchema*, uint32_t>& seen );
+        bool attach( const char* data, size_t size );
+        bool fail( const std::string& message );
+        void detach( void );
+
+        TrpSchemaSnapshot( const TrpSchemaSnapshot& );
+        TrpSchemaSnapshot& operator=( const TrpSchemaSnapshot& );
+
+    public:
+        TrpSchemaSnapshot( void );
+
+        // Serializes `root` into an image of its own, false if the schema
+        // uses something the format cannot hold
+        bool capture( const TrpSchema& root );
+        bool writeFile( const std::string& file_name );
+
+        // Maps `file_name` and checks the header, the checksum and that
+        // every index is in bounds before anything reads it
+        bool openFile( const std::string& file_name );
+        // Same checks over an image in memory, which must stay alive and
+        // be 8-byte aligned
+        bool setBuffer( const char* data, size_t size );
+
+        // The root of a copy of the captured schema built through `factory`,
+        // NULL when there is no valid image
+        TrpSchema* instantiate( TrpSchemaFactory& factory ) const;
+
+        bool isValid( void ) const { return header != NULL; }
+        const char* data( void ) const { return image; }
+        size_t size( void ) const { return image_size; }
+        size_t nodeCount( void ) const { return header ? header->node_count : 0; }
+        const std::string& getError( void ) const { return error; }
+};
+
+// ============================================================================
+// TrpSchemaCodeGen
+// ============================================================================
+
+// Writes a schema tree out as a C++98 translation unit: one static function
+// per schema node with its bounds, keys and constants inlined, and a single
+// entry point
+//   bool <name>( ITrpJsonValue* value, TrpValidatorContext& ctx );
+// that records the same errors as root.validate(), but with no virtual
+// call into schema nodes and no schema to keep alive. The unit includes
+// "TrpSchema.hpp" (the single header in lib/) and links against
+// libtrpschema.a. Memoization and parallel splitting are left to the
+// schema tree: generated code ignores both context settings. Shared and
+// self-referencing nodes become one function each.
+class TrpSchemaCodeGen {
+    private:
+        std::map<const TrpSchema*, size_t> numbers;
+        std::vector<const TrpSchema*> nodes;    // in function order
+        std::vector<std::string> paths;         // first path each node was reached by
+        std::map<std::string, std::string> strings; // text -> its constant
+        std::ostringstream constants;
+        std::ostringstream functions;
+        size_t constant_count;
+        std::string error;
+
+        size_t number( const TrpSchema* schema, const std::string& path );
+        std::string stringConstant( const std::string& value );
+        std::string setConstant( const std::vector<std::string>& values, TrpValueSet& set );
+        std::string enumTest( const TrpValueSet& values, const std::string& data, const std::string& size );
+
+        bool emitNode( size_t index );
+        void emitString( const TrpSchemaString& schema, std::ostream& out );
+        void emitNumber( const TrpSchemaNumber& schema, std::ostream& out );
+        void emitBool( const TrpSchemaBool& schema, std::ostream& out );
+        void emitObject( const TrpSchemaObject& schema, const std::string& path, std::ostream& out );
+        void emitArray( const TrpSchemaArray& schema, const std::string& path, std::ostream& out );
+        void emitUnion( const TrpSchemaUnion& schema, const std::string& path, std::ostream& out );
+        void emitTrial( const TrpSchemaUnion& schema, const std::vector<size_t>& candidates,
+            const std::string& path, const std::string& indent, std::ostream& out );
+        std::string call( const TrpSchema* schema, const std::string& path, const std::string& value, const std::string& ctx );
+
+        TrpSchemaCodeGen( const TrpSchemaCodeGen& );
+        TrpSchemaCodeGen& operator=( const TrpSchemaCodeGen& );
+
+    public:
+        TrpSchemaCodeGen( void );
+
+        // The unit for `root` into `out`, false (and nothing written) when
+        // `name` is not an identifier or a node has no generated form
+        bool generate( const TrpSchema& root, const std::string& name, std::ostream& out );
+
+        const std::string& getError( void ) const { return error; }
+};
+
+// ============================================================================
+// TrpSchemaStatic
+// ============================================================================
+
+// A property name or enum value as a type: TRP_KEY( K_id, "id" );
+#define TRP_KEY( _type, _text ) \
+    struct _type { \
+        enum { size = sizeof(_text) - 1 }; \
+        static const char* data( void ) { return _text; } \
+        static const std::string& value( void ) { \
+            static const std::string text( _text, sizeof(_text) - 1 ); \
+            return text; \
+        } \
+    }
+
+// Schemas known at build time, as types:
+//
+//   TRP_KEY( K_id, "id" );
+//   TRP_KEY( K_tags, "tags" );
+//   typedef Object< Required<K_id, Number<Min<1>, Integer> >,
+//                   Prop<K_tags, Array<String<>, Uniq> > > Message;
+//   Message::validate( value, ctx );
+//
+// validate() is a static function with every bound, key and constant known
+// to the compiler, and child schemas inline into their parent: no virtual
+// call into schema nodes. It records the same errors, in the same order,
+// as the TrpSchemaFactory tree of the same schema, into the same
+// TrpValidatorContext. Errors carry no schema node (TrpErrorRecord::schema
+// is NULL). TrpStaticSchema<S> puts a static schema where a TrpSchema is
+// expected. A recursive schema is a struct deriving from its own definition:
+//   struct Node : Object< Prop<K_kids, Array<Node> > > {};
+//
+// Template arguments cannot be doubles, so bounds are ratios: Min<1, 8> is
+// 0.125, and only the numerator is used for lengths and sizes. Each option
+// is given once per schema; the order they are listed in does not matter.
+// Property names must be distinct. Memoization, parallel splitting and
+// discriminated unions are not available here.
+namespace TrpStatic
+{
+    struct Nil {};
+
+    template <typename H, typename T>
+    struct List {};
+
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil,
+        typename A9 = Nil, typename A10 = Nil, typename A11 = Nil, typename A12 = Nil,
+        typename A13 = Nil, typename A14 = Nil, typename A15 = Nil, typename A16 = Nil>
+    struct MakeList {
+        typedef List<A1, typename MakeList<A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12,
+            A13, A14, A15, A16>::type> type;
+    };
+
+    template <typename A2, typename A3, typename A4, typename A5, typename A6, typename A7, typename A8,
+        typename A9, typename A10, typename A11, typename A12, typename A13, typename A14, typename A15, typename A16>
+    struct MakeList<Nil, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12, A13, A14, A15, A16> {
+        typedef Nil type;
+    };
+
+    // Options
+    template <long N, long D = 1> struct Min {};
+    template <long N, long D = 1> struct Max {};
+    template <long N, long D = 1> struct ExclusiveMin {};
+    template <long N, long D = 1> struct ExclusiveMax {};
+    template <long N, long D = 1> struct MultipleOf {};
+    template <long N, long D = 1> struct Const {};      // number, or bool (N != 0)
+    struct Integer {};
+    struct CodePoints {};                               // string length in code points
+    struct Uniq {};
+    template <TrpStringFormat F> struct Format {};
+    template <typename K> struct Pattern {};            // K::value() is the source
+    template <typename K1, typename K2 = Nil, typename K3 = Nil, typename K4 = Nil,
+        typename K5 = Nil, typename K6 = Nil, typename K7 = Nil, typename K8 = Nil>
+    struct Enum {};                                     // string values
+    template <typename K, typename S> struct Prop {};
+    template <typename K, typename S> struct Required {};
+
+    typedef bool (*MemberStep)( JsonObjectMap::const_iterator&, JsonObjectMap::const_iterator, TrpValidatorContext&, bool& );
+
+    // What one option sets; everything else keeps these defaults
+    template <typename T>
+    struct Part {
+        enum {
+            has_min = 0, has_max = 0, min_exclusive = 0, max_exclusive = 0,
+            integer = 0, has_multiple = 0, has_const = 0, code_points = 0, uniq = 0,
+            format = 0, has_pattern = 0, has_enum = 0, enum_size = 0, is_prop = 0
+        };
+        static double min( void ) { return 0; }
+        static double max( void ) { return 0; }
+        static double multiple( void ) { return 0; }
+        static double constant( void ) { return 0; }
+        static const TrpRegex* pattern( void ) { return NULL; }
+        static const std::string* source( void ) { return NULL; }
+        static bool inEnum( const std::string& ) { return true; }
+        static bool step( JsonObjectMap::const_iterator&, JsonObjectMap::const_iterator, TrpValidatorContext&, bool& ) { return true; }
+        static const std::string* name( void ) { return NULL; }
+    };
+
+    template <long N, long D>
+    struct Part< Min<N, D> > : Part<Nil> {
+        enum { has_min = 1 };
+        static double min( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< Max<N, D> > : Part<Nil> {
+        enum { has_max = 1 };
+        static double max( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< ExclusiveMin<N, D> > : Part<Nil> {
+        enum { has_min = 1, min_exclusive = 1 };
+        static double min( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< ExclusiveMax<N, D> > : Part<Nil> {
+        enum { has_max = 1, max_exclusive = 1 };
+        static double max( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< MultipleOf<N, D> > : Part<Nil> {
+        enum { has_multiple = 1 };
+        static double multiple( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <long N, long D>
+    struct Part< Const<N, D> > : Part<Nil> {
+        enum { has_const = 1 };
+        static double constant( void ) { return static_cast<double>(N) / D; }
+    };
+
+    template <> struct Part<Integer> : Part<Nil> { enum { integer = 1 }; };
+    template <> struct Part<CodePoints> : Part<Nil> { enum { code_points = 1 }; };
+    template <> struct Part<Uniq> : Part<Nil> { enum { uniq = 1 }; };
+
+    template <TrpStringFormat F>
+    struct Part< Format<F> > : Part<Nil> {
+        enum { format = F };
+    };
+
+    template <typename K>
+    struct Part< Pattern<K> > : Part<Nil> {
+        enum { has_pattern = 1 };
+        static const TrpRegex* pattern( void ) {
+            static const TrpRegex regex( K::value() );
+            return &regex;
+        }
+        static const std::string* source( void ) { return &K::value(); }
+    };
+
+    template <typename L>
+    struct Values {
+        enum { size = 0 };
+        static bool contains( const std::string& ) { return false; }
+    };
+
+    template <typename H, typename T>
+    struct Values< List<H, T> > {
+        enum { size = 1 + Values<T>::size };
+        static bool contains( const std::string& value ) { return value == H::value() || Values<T>::contains( value ); }
+    };
+
+    template <typename K1, typename K2, typename K3, typename K4, typename K5, typename K6, typename K7, typename K8>
+    struct Part< Enum<K1, K2, K3, K4, K5, K6, K7, K8> > : Part<Nil> {
+        typedef Values<typename MakeList<K1, K2, K3, K4, K5, K6, K7, K8>::type> Set;
+        enum { has_enum = 1, enum_size = Set::size };
+        static bool inEnum( const std::string& value ) { return Set::contains( value ); }
+    };
+
+    // TrpSchemaObject::validateMembers() for one property: skip the smaller
+    // keys of the document, then the property is either the next key or
+    // missing
+    template <typename K, typename S, bool required>
+    struct Member : Part<Nil> {
+        enum { is_prop = 1 };
+        static const std::string* name( void ) { return &K::value(); }
+
+        // std::string::compare() against the literal
+        static int compare( const std::string& key ) {
+            const size_t size = K::size;
+            int diff = std::memcmp( key.data(), K::data(), key.size() < size ? key.size() : size );
+
+            if ( diff ) return diff;
+            if ( key.size() == size ) return 0;
+            return key.size() < size ? -1 : 1;
+        }
+        static bool step( JsonObjectMap::const_iterator& it, JsonObjectMap::const_iterator end, TrpValidatorContext& ctx, bool& got_error ) {
+            int diff = 0;
+
+            while ( it != end && (diff = compare( it->first )) < 0 ) it++;
+            if ( it != end && !diff ) {
+                ctx.pushKey( K::value() );
+                if ( !S::validate( it->second, ctx ) ) got_error = true;
+                ctx.popPath();
+                it++;
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            } else if ( required ) {
+                ctx.pushError( ERR_MISSING_PROPERTY, SCHEMA_OBJECT, K::value() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            return true;
+        }
+    };
+
+    template <typename K, typename S> struct Part< Prop<K, S> > : Member<K, S, false> {};
+    template <typename K, typename S> struct Part< Required<K, S> > : Member<K, S, true> {};
+
+    // The options of a whole list, each taken from the part that sets it
+    template <typename L>
+    struct Options : Part<Nil> {
+        enum { props = 0 };
+        static void members( const std::string**, MemberStep* ) {}
+    };
+
+    template <typename H, typename T>
+    struct Options< List<H, T> > {
+        typedef Part<H> A;
+        typedef Options<T> B;
+
+        enum {
+            has_min = A::has_min || B::has_min,
+            has_max = A::has_max || B::has_max,
+            min_exclusive = A::has_min ? static_cast<int>(A::min_exclusive) : static_cast<int>(B::min_exclusive),
+            max_exclusive = A::has_max ? static_cast<int>(A::max_exclusive) : static_cast<int>(B::max_exclusive),
+            integer = A::integer || B::integer,
+            has_multiple = A::has_multiple || B::has_multiple,
+            has_const = A::has_const || B::has_const,
+            code_points = A::code_points || B::code_points,
+            uniq = A::uniq || B::uniq,
+            format = A::format > 0 ? static_cast<int>(A::format) : static_cast<int>(B::format),
+            has_pattern = A::has_pattern || B::has_pattern,
+            has_enum = A::has_enum || B::has_enum,
+            enum_size = A::enum_size + B::enum_size,
+            props = A::is_prop + B::props
+        };
+
+        static double min( void ) { return A::has_min ? A::min() : B::min(); }
+        static double max( void ) { return A::has_max ? A::max() : B::max(); }
+        static double multiple( void ) { return A::has_multiple ? A::multiple() : B::multiple(); }
+        static double constant( void ) { return A::has_const ? A::constant() : B::constant(); }
+        static const TrpRegex* pattern( void ) { return A::has_pattern ? A::pattern() : B::pattern(); }
+        static const std::string* source( void ) { return A::has_pattern ? A::source() : B::source(); }
+        static bool inEnum( const std::string& value ) { return A::has_enum ? A::inEnum( value ) : B::inEnum( value ); }
+
+        // the properties, in the order they are listed
+        static void members( const std::string** names, MemberStep* steps ) {
+            if ( A::is_prop ) {
+                *names++ = A::name();
+                *steps++ = &A::step;
+            }
+            B::members( names, steps );
+        }
+    };
+
+    // Property steps in key order, the order the tree walks them in;
+    // sorted once, on first use
+    template <typename L>
+    struct PropOrder {
+        MemberStep steps[Options<L>::props + 1];
+
+        PropOrder( void ) {
+            const std::string* names[Options<L>::props + 1];
+
+            Options<L>::members( names, steps );
+            for ( size_t i = 1; i < static_cast<size_t>(Options<L>::props); i++ ) {
+                const std::string* name = names[i];
+                MemberStep step = steps[i];
+                size_t j = i;
+
+                for ( ; j > 0 && *names[j - 1] > *name; j-- ) {
+                    names[j] = names[j - 1];
+                    steps[j] = steps[j - 1];
+                }
+                names[j] = name;
+                steps[j] = step;
+            }
+        }
+    };
+
+    // Union branches, by the JSON type they take (TRP_ERROR: any)
+    template <typename L>
+    struct Branches {
+        enum { mask = 0, size = 0 };
+        static size_t count( TrpJsonType ) { return 0; }
+        static bool validateOnly( TrpJsonType, ITrpJsonValue*, TrpValidatorContext& ) { return false; }
+        static bool tryAny( TrpJsonType, ITrpJsonValue* ) { return false; }
+        static void tryOne( TrpJsonType, ITrpJsonValue*, size_t& ) {}
+    };
+
+    template <typename H, typename T>
+    struct Branches< List<H, T> > {
+        enum {
+            mask = (H::json_type == TRP_ERROR ? (1u << TRP_UNION_TYPES) - 1 : 1u << H::json_type) | Branches<T>::mask,
+            size = 1 + Branches<T>::size
+        };
+
+        static bool takes( TrpJsonType type ) {
+            return H::json_type == TRP_ERROR || H::json_type == type;
+        }
+        static size_t count( TrpJsonType type ) { return (takes( type ) ? 1 : 0) + Branches<T>::count( type ); }
+        static bool validateOnly( TrpJsonType type, ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( takes( type ) ) return H::validate( value, ctx );
+            return Branches<T>::validateOnly( type, value, ctx );
+        }
+        static bool tryAny( TrpJsonType type, ITrpJsonValue* value ) {
+            if ( takes( type ) ) {
+                TrpValidatorContext scratch( true );
+                if ( H::validate( value, scratch ) ) return true;
+            }
+            return Branches<T>::tryAny( type, value );
+        }
+        static void tryOne( TrpJsonType type, ITrpJsonValue* value, size_t& matches ) {
+            if ( matches >= 2 ) return;
+            if ( takes( type ) ) {
+                TrpValidatorContext scratch( true );
+                if ( H::validate( value, scratch ) ) matches++;
+            }
+            Branches<T>::tryOne( type, value, matches );
+        }
+    };
+
+    // TrpSchemaUnion::validate() for untagged branches
+    template <typename L, TrpUnionMode mode>
+    struct Union {
+        static const TrpJsonType json_type = TRP_ERROR;
+        static const SchemaType schema_type = SCHEMA_UNION;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            TrpJsonType type = value ? value->getType() : TRP_ERROR;
+            size_t candidates = static_cast<size_t>(type) < TRP_UNION_TYPES ? Branches<L>::count( type ) : 0;
+
+            if ( !candidates ) {
+                ctx.pushError( ERR_UNION_TYPE, SCHEMA_UNION, Branches<L>::mask, type );
+                return false;
+            }
+            if ( candidates == 1 ) return Branches<L>::validateOnly( type, value, ctx );
+
+            if ( mode == UNION_ANY_OF ) {
+                if ( Branches<L>::tryAny( type, value ) ) return true;
+                ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, candidates );
+                return false;
+            }
+
+            size_t matches = 0;
+            Branches<L>::tryOne( type, value, matches );
+            if ( matches == 1 ) return true;
+            if ( matches ) ctx.pushError( ERR_UNION_AMBIGUOUS, SCHEMA_UNION );
+            else ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, candidates );
+            return false;
+        }
+    };
+
+    template <typename L>
+    struct Items {
+        enum { size = 0 };
+        static bool validate( TrpJsonArray*, TrpValidatorContext&, bool& ) { return true; }
+    };
+
+    template <typename H, typename T>
+    struct Items< List<H, T> > {
+        enum { size = 1 + Items<T>::size };
+
+        // tuple slot `index` onwards
+        static bool validate( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error, size_t index = 0 ) {
+            ctx.pushIndex( index );
+            if ( !H::validate( arr->at( index ), ctx ) ) got_error = true;
+            ctx.popPath();
+            if ( got_error && !ctx.shouldContinue() ) return false;
+            return Items<T>::validate( arr, ctx, got_error, index + 1 );
+        }
+    };
+
+    template <>
+    struct Items<Nil> {
+        enum { size = 0 };
+        static bool validate( TrpJsonArray*, TrpValidatorContext&, bool&, size_t = 0 ) { return true; }
+    };
+
+    template <typename L>
+    bool checkArraySize( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error ) {
+        typedef Options<L> O;
+
+        if ( O::has_max && arr->size() > O::max() ) {
+            ctx.pushError( ERR_ARRAY_TOO_LONG, SCHEMA_ARRAY, O::max(), arr->size() );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        if ( O::has_min && arr->size() < O::min() ) {
+            ctx.pushError( ERR_ARRAY_TOO_SHORT, SCHEMA_ARRAY, O::min(), arr->size() );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        return true;
+    }
+
+    template <typename L>
+    bool checkUniq( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error ) {
+        std::vector<size_t> duplicates;
+
+        if ( !Options<L>::uniq || !trpJsonDuplicates( arr, duplicates ) ) return true;
+        got_error = true;
+        for ( size_t i = 0; i < duplicates.size(); i++ ) {
+            ctx.pushIndex( duplicates[i] );
+            ctx.pushError( ERR_DUPLICATE_ITEM, SCHEMA_ARRAY, 0, duplicates[i] );
+            ctx.popPath();
+            if ( !ctx.shouldContinue() ) return false;
+        }
+        return true;
+    }
+
+    // Options: Min, Max (length), CodePoints, Format, Pattern, Enum
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil>
+    struct String {
+        typedef Options<typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8>::type> O;
+        static const TrpJsonType json_type = TRP_STRING;
+        static const SchemaType schema_type = SCHEMA_STRING;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_STRING ) {
+                ctx.pushTypeError( SCHEMA_STRING, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            const std::string& str = static_cast<TrpJsonString*>(value)->getValue();
+            bool got_error = false;
+
+            if ( O::has_min || O::has_max ) {
+                size_t length = O::code_points ? trpUtf8Length( str.data(), str.size() ) : str.size();
+
+                if ( O::has_max && length > O::max() ) {
+                    ctx.pushError( ERR_STRING_TOO_LONG, SCHEMA_STRING, O::max(), length );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+                if ( O::has_min && length < O::min() ) {
+                    ctx.pushError( ERR_STRING_TOO_SHORT, SCHEMA_STRING, O::min(), length );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+            }
+            if ( O::format > 0 && !trpCheckFormat( static_cast<TrpStringFormat>(O::format), str.data(), str.size() ) ) {
+                ctx.pushError( ERR_STRING_FORMAT, SCHEMA_STRING, O::format, 0 );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_pattern && !O::pattern()->match( str ) ) {
+                ctx.pushError( ERR_STRING_PATTERN, SCHEMA_STRING, *O::source() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_enum && !O::inEnum( str ) ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_STRING, O::enum_size, 0 );
+                got_error = true;
+            }
+            return !got_error;
+        }
+    };
+
+    // Options: Min, Max, ExclusiveMin, ExclusiveMax, Integer, MultipleOf, Const
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil>
+    struct Number {
+        typedef Options<typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8>::type> O;
+        static const TrpJsonType json_type = TRP_NUMBER;
+        static const SchemaType schema_type = SCHEMA_NUMBER;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_NUMBER ) {
+                ctx.pushTypeError( SCHEMA_NUMBER, value ? value->getType() : TRP_ERROR );
+                return false;
+            }
+
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            bool got_error = false;
+
+            if ( O::has_max && (O::max_exclusive ? nbr >= O::max() : nbr > O::max()) ) {
+                ctx.pushError( O::max_exclusive ? ERR_NUMBER_NOT_BELOW : ERR_NUMBER_TOO_LARGE, SCHEMA_NUMBER, O::max(), nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_min && (O::min_exclusive ? nbr <= O::min() : nbr < O::min()) ) {
+                ctx.pushError( O::min_exclusive ? ERR_NUMBER_NOT_ABOVE : ERR_NUMBER_TOO_SMALL, SCHEMA_NUMBER, O::min(), nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::integer && nbr != std::floor( nbr ) ) {
+                ctx.pushError( ERR_NUMBER_NOT_INTEGER, SCHEMA_NUMBER, 0, nbr );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_multiple ) {
+                double q = nbr / O::multiple();
+                double scale = std::fabs( q ) > 1 ? std::fabs( q ) : 1;
+
+                if ( std::fabs( q - std::floor( q + 0.5 ) ) > 1e-9 * scale ) {
+                    ctx.pushError( ERR_NUMBER_NOT_MULTIPLE, SCHEMA_NUMBER, O::multiple(), nbr );
+                    got_error = true;
+                    if ( !ctx.shouldContinue() ) return false;
+                }
+            }
+            if ( O::has_const && nbr != O::constant() ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_NUMBER, 1, nbr );
+                got_error = true;
+            }
+            return !got_error;
+        }
+    };
+
+    // Option: Const<1> or Const<0>
+    template <typename A1 = Nil>
+    struct Bool {
+        typedef Options<typename MakeList<A1>::type> O;
+        static const TrpJsonType json_type = TRP_BOOL;
+        static const SchemaType schema_type = SCHEMA_BOOLEAN;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_BOOL ) {
+                ctx.pushTypeError( SCHEMA_BOOLEAN, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            bool flag = static_cast<TrpJsonBool*>(value)->getValue();
+            if ( O::has_const && flag != (O::constant() != 0) ) {
+                ctx.pushError( ERR_ENUM, SCHEMA_BOOLEAN, 1, flag );
+                return false;
+            }
+            return true;
+        }
+    };
+
+    struct Null {
+        static const TrpJsonType json_type = TRP_NULL;
+        static const SchemaType schema_type = SCHEMA_NULL;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_NULL ) {
+                ctx.pushTypeError( SCHEMA_NULL, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // Parts: Prop, Required, Min, Max (member count)
+    template <typename A1 = Nil, typename A2 = Nil, typename A3 = Nil, typename A4 = Nil,
+        typename A5 = Nil, typename A6 = Nil, typename A7 = Nil, typename A8 = Nil,
+        typename A9 = Nil, typename A10 = Nil, typename A11 = Nil, typename A12 = Nil,
+        typename A13 = Nil, typename A14 = Nil, typename A15 = Nil, typename A16 = Nil>
+    struct Object {
+        typedef typename MakeList<A1, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11, A12, A13, A14, A15, A16>::type L;
+        typedef Options<L> O;
+        static const TrpJsonType json_type = TRP_OBJECT;
+        static const SchemaType schema_type = SCHEMA_OBJECT;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_OBJECT ) {
+                ctx.pushTypeError( SCHEMA_OBJECT, value ? value->getType() : TRP_ERROR );
+                return false;
+            }
+
+            TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+            bool got_error = false;
+
+            if ( O::has_min && obj->size() < O::min() ) {
+                ctx.pushError( ERR_OBJECT_TOO_SMALL, SCHEMA_OBJECT, O::min(), obj->size() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+            if ( O::has_max && obj->size() > O::max() ) {
+                ctx.pushError( ERR_OBJECT_TOO_LARGE, SCHEMA_OBJECT, O::max(), obj->size() );
+                got_error = true;
+                if ( !ctx.shouldContinue() ) return false;
+            }
+
+            if ( O::props > 0 ) {
+                static const PropOrder<L> order;
+                JsonObjectMap::const_iterator it = obj->begin();
+
+                for ( size_t i = 0; i < static_cast<size_t>(O::props); i++ ) {
+                    if ( !order.steps[i]( it, obj->end(), ctx, got_error ) ) return false;
+                }
+            }
+            return !got_error;
+        }
+    };
+
+    // Item schema first (Nil for any items), then options: Min, Max, Uniq
+    template <typename Item = Nil, typename A1 = Nil, typename A2 = Nil, typename A3 = Nil>
+    struct Array {
+        typedef typename MakeList<A1, A2, A3>::type L;
+        static const TrpJsonType json_type = TRP_ARRAY;
+        static const SchemaType schema_type = SCHEMA_ARRAY;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_ARRAY ) {
+                ctx.pushTypeError( SCHEMA_ARRAY, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            bool got_error = false;
+
+            if ( !checkArraySize<L>( arr, ctx, got_error ) ) return false;
+            if ( !checkItems( arr, ctx, got_error, static_cast<Item*>(NULL) ) ) return false;
+            if ( !checkUniq<L>( arr, ctx, got_error ) ) return false;
+            return !got_error;
+        }
+
+        template <typename S>
+        static bool checkItems( TrpJsonArray* arr, TrpValidatorContext& ctx, bool& got_error, S* ) {
+            for ( size_t i = 0; i < arr->size(); i++ ) {
+                ctx.pushIndex( i );
+                if ( !S::validate( arr->at( i ), ctx ) ) got_error = true;
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
+            return true;
+        }
+        static bool checkItems( TrpJsonArray*, TrpValidatorContext&, bool&, Nil* ) { return true; }
+    };
+
+    // Exactly these items, in this order
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct Tuple {
+        typedef typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type L;
+        static const TrpJsonType json_type = TRP_ARRAY;
+        static const SchemaType schema_type = SCHEMA_ARRAY;
+
+        static bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) {
+            if ( !value || value->getType() != TRP_ARRAY ) {
+                ctx.pushTypeError( SCHEMA_ARRAY, value ? value->getType() : TRP_NULL );
+                return false;
+            }
+
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            bool got_error = false;
+
+            if ( arr->size() != static_cast<size_t>(Items<L>::size) ) {
+                ctx.pushError( ERR_TUPLE_SIZE, SCHEMA_ARRAY, Items<L>::size, arr->size() );
+                return false;
+            }
+            Items<L>::validate( arr, ctx, got_error );
+            return !got_error;
+        }
+    };
+
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct AnyOf : Union<typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type, UNION_ANY_OF> {};
+
+    template <typename S1, typename S2 = Nil, typename S3 = Nil, typename S4 = Nil,
+        typename S5 = Nil, typename S6 = Nil, typename S7 = Nil, typename S8 = Nil>
+    struct OneOf : Union<typename MakeList<S1, S2, S3, S4, S5, S6, S7, S8>::type, UNION_ONE_OF> {};
+}
+
+// A static schema behind the TrpSchema interface, for a factory tree, a
+// TrpBatchValidator or anything else that takes one
+template <typename S>
+class TrpStaticSchema : public TrpSchema
+{
+    public:
+        bool validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const { return S::validate( value, ctx ); }
+        SchemaType getType( void ) const { return S::schema_type; }
 };
 
 #endif // TRPSCHEMA_CONSOLIDATED_HPP
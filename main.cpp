@@ -1,8 +1,87 @@
 #include "lib/TrpSchema.hpp"
+#include <cstring>
+#include <unistd.h>
 
-int main (int ac, char ** av) {
-    if (ac != 2) return 1;
-    TrpJsonParser parser(av[1]);
+static TrpSchemaObject& buildSchema( TrpSchemaFactory& factory ) {
+    return factory.object()
+        .property("arr", &factory.array()
+                    .uniq(true)
+                    .item(&factory
+                        .number()
+                        .min(5)
+                        .max(10)
+                    )
+                );
+}
+
+// A schema file is a JSON Schema document, or a snapshot of one
+static TrpSchema* loadSchema( TrpSchemaFactory& factory, const char* schema_file ) {
+    char magic[sizeof(TRP_SNAPSHOT_MAGIC)] = { 0 };
+    std::ifstream file(schema_file, std::ios::binary);
+
+    file.read(magic, sizeof(magic));
+    if (!std::memcmp(magic, TRP_SNAPSHOT_MAGIC, sizeof(magic))) {
+        TrpSchemaSnapshot snapshot;
+
+        if (!snapshot.openFile(schema_file)) {
+            std::cerr << "bad trip: " << snapshot.getError() << std::endl;
+            return NULL;
+        }
+        return snapshot.instantiate(factory);
+    }
+
+    TrpSchemaLoader loader(factory);
+    TrpSchema* schema = loader.loadFile(schema_file);
+    if (!schema) std::cerr << "bad trip: " << loader.getError() << std::endl;
+    return schema;
+}
+
+// The demo schema above unless a schema file is given
+static TrpSchema* rootSchema( TrpSchemaFactory& factory, const char* schema_file ) {
+    return schema_file ? loadSchema(factory, schema_file) : &buildSchema(factory);
+}
+
+// trpschema --snapshot <schema.json> <out>
+static int writeSnapshot( const char* schema_file, const char* out_file ) {
+    TrpSchemaFactory factory;
+    TrpSchemaLoader loader(factory);
+    TrpSchema* schema = loader.loadFile(schema_file);
+
+    if (!schema) {
+        std::cerr << "bad trip: " << loader.getError() << std::endl;
+        return 1;
+    }
+
+    TrpSchemaSnapshot snapshot;
+    if (!snapshot.capture(*schema) || !snapshot.writeFile(out_file)) {
+        std::cerr << "bad trip: " << snapshot.getError() << std::endl;
+        return 1;
+    }
+    std::cout << out_file << ": " << snapshot.nodeCount() << " nodes, "
+              << snapshot.size() << " bytes" << std::endl;
+    return 0;
+}
+
+// trpschema --emit-cpp <schema> <name>: the validator as C++ on stdout
+static int emitCpp( const char* schema_file, const char* name ) {
+    TrpSchemaFactory factory;
+    TrpSchema* schema = loadSchema(factory, schema_file);
+
+    if (!schema) return 1;
+
+    TrpSchemaCodeGen codegen;
+    std::ostringstream out;
+    if (!codegen.generate(*schema, name, out)) {
+        std::cerr << "bad trip: " << codegen.getError() << std::endl;
+        return 1;
+    }
+    std::cout << out.str();
+    return 0;
+}
+
+// trpschema [--schema <schema>] <file>
+static int validateFile( const char* file_name, const char* schema_file ) {
+    TrpJsonParser parser(file_name);
 
     if (!parser.parse()) {
         std::cerr << "bad trip: Failed to parse JSON file." << std::endl;
@@ -12,19 +91,11 @@ int main (int ac, char ** av) {
     parser.prettyPrint();
 
     TrpSchemaFactory factory;
+    TrpSchema* schema = rootSchema(factory, schema_file);
+    if (!schema) return 1;
 
-    TrpSchemaObject& rootSchema = factory.object()
-        .property("arr", &factory.array()
-                    .uniq(true)
-                    .item(&factory
-                        .number()
-                        .min(5)
-                        .max(10)
-                    )
-                );
-    
     TrpValidatorContext ctx;
-    if (!rootSchema.validate(parser.getAST(), ctx)) {
+    if (!schema->validate(parser.getAST(), ctx)) {
         std::cerr << "\n--- Validation Errors ---" << std::endl;
         ctx.printErrors();
         return 1;
@@ -33,4 +104,99 @@ int main (int ac, char ** av) {
     }
 
     return 0;
-}  
\ No newline at end of file
+}
+
+// trpschema --profile [--schema <schema>] <file> [top]: folded stacks on
+// stdout, for flamegraph.pl, and the most expensive schema paths on stderr
+static int profileFile( const char* file_name, size_t top, const char* schema_file ) {
+    TrpBufferParser parser;
+
+    if (!parser.openFile(file_name) || !parser.parse()) {
+        std::cerr << "bad trip: Failed to parse JSON file." << std::endl;
+        return 1;
+    }
+
+    TrpSchemaFactory factory;
+    TrpSchema* schema = rootSchema(factory, schema_file);
+    if (!schema) return 1;
+
+    TrpProfiler profiler;
+    TrpValidatorContext ctx;
+    ctx.setProfiler(&profiler);
+
+    profiler.start();
+    bool valid = schema->validate(parser.getAST(), ctx);
+    profiler.stop();
+
+    profiler.writeFolded(std::cout);
+    profiler.printTable(std::cerr, top);
+    return valid ? 0 : 1;
+}
+
+// trpschema --jsonl [--schema <schema>] <file|-> [threads]
+static int validateJsonLines( const char* path, size_t threads, const char* schema_file ) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+
+    if (std::strcmp(path, "-")) {
+        file.open(path);
+        if (!file.is_open()) {
+            std::cerr << "bad trip: Failed to open " << path << std::endl;
+            return 1;
+        }
+        in = &file;
+    }
+
+    TrpSchemaFactory factory;
+    TrpSchema* schema = rootSchema(factory, schema_file);
+    if (!schema) return 1;
+
+    TrpBatchValidator batch(*schema, threads);
+    TrpBatchStats stats = batch.run(*in, std::cout);
+
+    double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+    std::cerr << "docs: " << stats.docs
+              << " passed: " << stats.passed
+              << " failed: " << stats.failed
+              << " threads: " << threads << "\n"
+              << "time: " << stats.seconds << "s"
+              << " docs/s: " << stats.docs / seconds
+              << " MB/s: " << stats.bytes / seconds / (1024 * 1024) << std::endl;
+
+    return stats.failed ? 1 : 0;
+}
+
+static int usage( void ) {
+    std::cerr << "usage: trpschema [--schema <schema>] <file>\n"
+              << "       trpschema --jsonl [--schema <schema>] <file|-> [threads]\n"
+              << "       trpschema --profile [--schema <schema>] <file> [top]\n"
+              << "       trpschema --snapshot <schema.json> <out>\n"
+              << "       trpschema --emit-cpp <schema> <name>" << std::endl;
+    return 1;
+}
+
+int main (int ac, char ** av) {
+    if (ac >= 2 && (!std::strcmp(av[1], "--jsonl") || !std::strcmp(av[1], "--profile"))) {
+        const char* schema_file = NULL;
+        int arg = 2;
+
+        if (arg < ac && !std::strcmp(av[arg], "--schema")) {
+            if (arg + 1 >= ac) return usage();
+            schema_file = av[arg + 1];
+            arg += 2;
+        }
+        if (ac - arg < 1 || ac - arg > 2) return usage();
+
+        if (!std::strcmp(av[1], "--jsonl")) {
+            long threads = ac - arg == 2 ? std::atol(av[arg + 1]) : sysconf(_SC_NPROCESSORS_ONLN);
+            return validateJsonLines(av[arg], threads > 0 ? threads : 1, schema_file);
+        }
+        long top = ac - arg == 2 ? std::atol(av[arg + 1]) : 20;
+        return profileFile(av[arg], top > 0 ? top : 0, schema_file);
+    }
+    if (ac == 4 && !std::strcmp(av[1], "--emit-cpp")) return emitCpp(av[2], av[3]);
+    if (ac == 4 && !std::strcmp(av[1], "--snapshot")) return writeSnapshot(av[2], av[3]);
+    if (ac == 4 && !std::strcmp(av[1], "--schema")) return validateFile(av[3], av[2]);
+    if (ac != 2 || !std::strncmp(av[1], "--", 2)) return usage();
+    return validateFile(av[1], NULL);
+}
@@ -0,0 +1,223 @@
+#include "../include/TrpBatchValidator.hpp"
+#include <deque>
+#include <pthread.h>
+#include <sys/time.h>
+
+struct TrpLineBatch {
+    size_t id;
+    size_t first_line;
+    std::vector<std::string> lines;
+    std::string output;
+    size_t passed;
+    size_t failed;
+};
+
+struct TrpBatchPipeline {
+    const TrpSchema* schema;
+    std::ostream* out;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t result_ready;
+    pthread_cond_t space_ready;
+
+    std::deque<TrpLineBatch*> todo;
+    std::map<size_t, TrpLineBatch*> done;
+    size_t in_flight;
+    size_t max_in_flight;
+    size_t total;           // number of batches, known once the reader hits EOF
+    bool eof;
+
+    size_t passed;
+    size_t failed;
+};
+
+static double now( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void appendNumber( std::string& out, size_t nbr ) {
+    char buf[24];
+    size_t len = 0;
+
+    do {
+        buf[len++] = '0' + (nbr % 10);
+        nbr /= 10;
+    } while ( nbr );
+
+    while ( len ) out += buf[--len];
+}
+
+static void validateBatch( TrpLineBatch& batch, TrpStreamingValidator& validator ) {
+    TrpValidatorContext ctx( true );
+
+    batch.passed = batch.failed = 0;
+
+    for ( size_t i = 0; i < batch.lines.size(); i++ ) {
+        const std::string& line = batch.lines[i];
+        if ( line.find_first_not_of( " \t\r" ) == std::string::npos ) continue;
+
+        TrpBufferLexer lexer( line );
+        ctx.clear();
+
+        appendNumber( batch.output, batch.first_line + i );
+        if ( validator.validate( lexer, ctx ) ) {
+            batch.output += "\tok\n";
+            batch.passed++;
+            continue;
+        }
+
+        batch.failed++;
+        batch.output += "\tfail\t";
+        if ( validator.hasSyntaxError() ) {
+            batch.output += "syntax error at column ";
+            appendNumber( batch.output, validator.getLastError().col );
+            batch.output += ": " + validator.getLastError().value;
+        } else if ( ctx.hasErrors() ) {
+            const TrpErrorRecord& record = ctx.getRecords()[0];
+            batch.output += ctx.formatPath( record ) + ": " + ctx.formatMessage( record );
+        }
+        batch.output += '\n';
+    }
+}
+
+static void* workerMain( void* arg ) {
+    TrpBatchPipeline& p = *static_cast<TrpBatchPipeline*>(arg);
+    TrpStreamingValidator validator( *p.schema );
+
+    for ( ;; ) {
+        pthread_mutex_lock( &p.lock );
+        while ( p.todo.empty() && !p.eof ) pthread_cond_wait( &p.work_ready, &p.lock );
+        if ( p.todo.empty() ) {
+            pthread_mutex_unlock( &p.lock );
+            return NULL;
+        }
+        TrpLineBatch* batch = p.todo.front();
+        p.todo.pop_front();
+        pthread_mutex_unlock( &p.lock );
+
+        validateBatch( *batch, validator );
+        batch->lines.clear();
+
+        pthread_mutex_lock( &p.lock );
+        p.done[batch->id] = batch;
+        pthread_cond_signal( &p.result_ready );
+        pthread_mutex_unlock( &p.lock );
+    }
+}
+
+// Prints batches strictly in id order, whatever order the workers finish in
+static void* writerMain( void* arg ) {
+    TrpBatchPipeline& p = *static_cast<TrpBatchPipeline*>(arg);
+
+    for ( size_t next = 0; ; next++ ) {
+        pthread_mutex_lock( &p.lock );
+        while ( !(p.eof && next == p.total) && p.done.find( next ) == p.done.end() )
+            pthread_cond_wait( &p.result_ready, &p.lock );
+        if ( p.eof && next == p.total ) {
+            pthread_mutex_unlock( &p.lock );
+            return NULL;
+        }
+        TrpLineBatch* batch = p.done[next];
+        p.done.erase( next );
+        pthread_mutex_unlock( &p.lock );
+
+        p.out->write( batch->output.data(), batch->output.size() );
+
+        pthread_mutex_lock( &p.lock );
+        p.passed += batch->passed;
+        p.failed += batch->failed;
+        p.in_flight--;
+        pthread_cond_signal( &p.space_ready );
+        pthread_mutex_unlock( &p.lock );
+
+        delete batch;
+    }
+}
+
+TrpBatchValidator::TrpBatchValidator( const TrpSchema& _schema, size_t _threads )
+    : schema(_schema), threads(_threads ? _threads : 1), batch_lines(256) {}
+
+TrpBatchValidator& TrpBatchValidator::batchSize( size_t _lines ) {
+    batch_lines = _lines ? _lines : 1;
+    return *this;
+}
+
+TrpBatchStats TrpBatchValidator::run( std::istream& in, std::ostream& out ) {
+    TrpBatchStats stats;
+    TrpBatchPipeline p;
+
+    p.schema = &schema;
+    p.out = &out;
+    pthread_mutex_init( &p.lock, NULL );
+    pthread_cond_init( &p.work_ready, NULL );
+    pthread_cond_init( &p.result_ready, NULL );
+    pthread_cond_init( &p.space_ready, NULL );
+    p.in_flight = 0;
+    p.max_in_flight = threads * 4;
+    p.total = 0;
+    p.eof = false;
+    p.passed = p.failed = 0;
+
+    double start = now();
+
+    std::vector<pthread_t> workers( threads );
+    pthread_t writer;
+    for ( size_t i = 0; i < threads; i++ ) pthread_create( &workers[i], NULL, workerMain, &p );
+    pthread_create( &writer, NULL, writerMain, &p );
+
+    stats.bytes = 0;
+    size_t line_no = 1;
+    size_t id = 0;
+    std::string line;
+
+    while ( in ) {
+        TrpLineBatch* batch = new TrpLineBatch();
+        batch->id = id;
+        batch->first_line = line_no;
+        batch->lines.reserve( batch_lines );
+
+        while ( batch->lines.size() < batch_lines && std::getline( in, line ) ) {
+            stats.bytes += line.size() + 1;
+            batch->lines.push_back( line );
+            line_no++;
+        }
+        if ( batch->lines.empty() ) {
+            delete batch;
+            break;
+        }
+
+        pthread_mutex_lock( &p.lock );
+        while ( p.in_flight >= p.max_in_flight ) pthread_cond_wait( &p.space_ready, &p.lock );
+        p.in_flight++;
+        p.todo.push_back( batch );
+        pthread_cond_signal( &p.work_ready );
+        pthread_mutex_unlock( &p.lock );
+        id++;
+    }
+
+    pthread_mutex_lock( &p.lock );
+    p.eof = true;
+    p.total = id;
+    pthread_cond_broadcast( &p.work_ready );
+    pthread_cond_broadcast( &p.result_ready );
+    pthread_mutex_unlock( &p.lock );
+
+    for ( size_t i = 0; i < threads; i++ ) pthread_join( workers[i], NULL );
+    pthread_join( writer, NULL );
+    out.flush();
+
+    stats.seconds = now() - start;
+    stats.passed = p.passed;
+    stats.failed = p.failed;
+    stats.docs = p.passed + p.failed;
+
+    pthread_cond_destroy( &p.space_ready );
+    pthread_cond_destroy( &p.result_ready );
+    pthread_cond_destroy( &p.work_ready );
+    pthread_mutex_destroy( &p.lock );
+    return stats;
+}
@@ -0,0 +1,274 @@
+#include "../include/TrpBufferLexer.hpp"
+#include <cstring>
+
+TrpBufferLexer::TrpBufferLexer( const char* _data, size_t _size ) {
+    reset( _data, _size );
+}
+
+TrpBufferLexer::TrpBufferLexer( const std::string& _data ) {
+    reset( _data.data(), _data.size() );
+}
+
+void TrpBufferLexer::reset( const char* _data, size_t _size ) {
+    start = _data;
+    end = _data + _size;
+    reset();
+}
+
+void TrpBufferLexer::reset( void ) {
+    cur = start;
+    line = 0;
+    line_start = start;
+}
+
+size_t TrpBufferLexer::offset( void ) const {
+    return cur - start;
+}
+
+void TrpBufferLexer::skipWhitespace( void ) {
+    while ( cur < end ) {
+        if ( *cur == '\n' ) {
+            line++;
+            line_start = cur + 1;
+        } else if ( *cur != ' ' && *cur != '\t' && *cur != '\r' ) {
+            return;
+        }
+        cur++;
+    }
+}
+
+void TrpBufferLexer::errorToken( token& tok, const std::string& message ) {
+    tok.type = T_ERROR;
+    tok.value = message;
+    cur = end;
+}
+
+static int hexValue( char c ) {
+    if ( c >= '0' && c <= '9' ) return c - '0';
+    if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+    if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+    return -1;
+}
+
+static void appendUtf8( std::string& out, unsigned long cp ) {
+    if ( cp < 0x80 ) {
+        out += static_cast<char>(cp);
+    } else if ( cp < 0x800 ) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if ( cp < 0x10000 ) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+void TrpBufferLexer::readString( token& tok ) {
+    tok.type = T_STRING;
+    tok.value.clear();
+    cur++;
+
+    while ( cur < end ) {
+        // copy the unescaped run in one go
+        const char* run = cur;
+        while ( cur < end && *cur != '"' && *cur != '\\' && *cur != '\n' ) cur++;
+        tok.value.append( run, cur - run );
+
+        if ( cur == end ) break;
+        if ( *cur == '"' ) {
+            cur++;
+            return;
+        }
+        if ( *cur == '\n' ) return errorToken( tok, "Invalid unescaped newline in string" );
+
+        if ( ++cur == end ) break;
+        switch (*cur) {
+            case '"': tok.value += '"'; break;
+            case '\\': tok.value += '\\'; break;
+            case '/': tok.value += '/'; break;
+            case 'b': tok.value += '\b'; break;
+            case 'f': tok.value += '\f'; break;
+            case 'n': tok.value += '\n'; break;
+            case 'r': tok.value += '\r'; break;
+            case 't': tok.value += '\t'; break;
+            case 'u': {
+                unsigned long cp = 0;
+                for ( int i = 0; i < 4; i++ ) {
+                    int digit = ++cur < end ? hexValue( *cur ) : -1;
+                    if ( digit < 0 ) return errorToken( tok, "Invalid escape sequence: \\u" );
+                    cp = (cp << 4) | digit;
+                }
+                // surrogate pair
+                if ( cp >= 0xD800 && cp <= 0xDBFF && end - cur > 6 && cur[1] == '\\' && cur[2] == 'u' ) {
+                    unsigned long low = 0;
+                    int i = 0;
+                    for ( ; i < 4; i++ ) {
+                        int digit = hexValue( cur[3 + i] );
+                        if ( digit < 0 ) break;
+                        low = (low << 4) | digit;
+                    }
+                    if ( i == 4 && low >= 0xDC00 && low <= 0xDFFF ) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        cur += 6;
+                    }
+                }
+                appendUtf8( tok.value, cp );
+                break;
+            }
+            default:
+                return errorToken( tok, std::string("Invalid escape sequence: \\") + *cur );
+        }
+        cur++;
+    }
+    errorToken( tok, "Unterminated string" );
+}
+
+static bool isDigit( char c ) {
+    return c >= '0' && c <= '9';
+}
+
+void TrpBufferLexer::readNumber( token& tok ) {
+    const char* begin = cur;
+
+    if ( *cur == '-' ) cur++;
+    if ( cur == end || !isDigit( *cur ) ) return errorToken( tok, "Invalid number" );
+    if ( *cur == '0' ) cur++;
+    else while ( cur < end && isDigit( *cur ) ) cur++;
+
+    if ( cur < end && *cur == '.' ) {
+        cur++;
+        if ( cur == end || !isDigit( *cur ) ) return errorToken( tok, "Invalid number" );
+        while ( cur < end && isDigit( *cur ) ) cur++;
+    }
+    if ( cur < end && (*cur == 'e' || *cur == 'E') ) {
+        cur++;
+        if ( cur < end && (*cur == '+' || *cur == '-') ) cur++;
+        if ( cur == end || !isDigit( *cur ) ) return errorToken( tok, "Invalid number" );
+        while ( cur < end && isDigit( *cur ) ) cur++;
+    }
+
+    tok.type = T_NUMBER;
+    tok.value.assign( begin, cur - begin );
+}
+
+void TrpBufferLexer::readLiteral( token& tok ) {
+    static const char* const names[] = { "true", "false", "null" };
+    static const TrpTokenType types[] = { T_TRUE, T_FALSE, T_NULL };
+
+    for ( size_t i = 0; i < 3; i++ ) {
+        size_t len = std::strlen( names[i] );
+        if ( static_cast<size_t>(end - cur) >= len && !std::memcmp( cur, names[i], len ) ) {
+            cur += len;
+            tok.type = types[i];
+            tok.value.clear();
+            return;
+        }
+    }
+    errorToken( tok, "Unexpected character" );
+}
+
+void TrpBufferLexer::nextToken( token& tok ) {
+    skipWhitespace();
+
+    tok.line = line;
+    tok.col = cur - line_start;
+
+    if ( cur >= end ) {
+        tok.type = T_END_OF_FILE;
+        tok.value.clear();
+        return;
+    }
+
+    switch (*cur) {
+        case '{': tok.type = T_BRACE_OPEN; break;
+        case '}': tok.type = T_BRACE_CLOSE; break;
+        case '[': tok.type = T_BRACKET_OPEN; break;
+        case ']': tok.type = T_BRACKET_CLOSE; break;
+        case ':': tok.type = T_COLON; break;
+        case ',': tok.type = T_COMMA; break;
+        case '"': return readString( tok );
+        default:
+            if ( *cur == '-' || isDigit( *cur ) ) return readNumber( tok );
+            return readLiteral( tok );
+    }
+    tok.value.clear();
+    cur++;
+}
+
+// From the opening quote to past the closing one, false if there is none
+bool TrpBufferLexer::skipString( void ) {
+    for ( cur++; cur < end; cur++ ) {
+        if ( *cur == '"' ) {
+            cur++;
+            return true;
+        }
+        if ( *cur == '\\' ) {
+            if ( ++cur == end ) break;
+        } else if ( *cur == '\n' ) {
+            line++;
+            line_start = cur + 1;
+        }
+    }
+    return false;
+}
+
+bool TrpBufferLexer::skipValue( token& tok ) {
+    size_t depth = 0;
+
+    skipWhitespace();
+    tok.line = line;
+    tok.col = cur - line_start;
+
+    const char* begin = cur;
+    while ( cur < end ) {
+        char c = *cur;
+
+        if ( c == '"' ) {
+            if ( !skipString() ) {
+                errorToken( tok, "Unterminated string" );
+                return false;
+            }
+            if ( !depth ) return true;
+            continue;
+        }
+
+        if ( c == '{' || c == '[' ) {
+            depth++;
+        } else if ( c == '}' || c == ']' ) {
+            if ( !depth ) break;
+            if ( !--depth ) {
+                cur++;
+                return true;
+            }
+        } else if ( c == '\n' ) {
+            if ( !depth ) break;
+            line++;
+            line_start = cur + 1;
+        } else if ( !depth && (c == ',' || c == ':' || c == ' ' || c == '\t' || c == '\r') ) {
+            break;
+        }
+        cur++;
+    }
+
+    if ( depth ) {
+        errorToken( tok, "Unterminated value" );
+        return false;
+    }
+    if ( cur == begin ) {
+        nextToken( tok );
+        return false;
+    }
+    return true;
+}
+
+token TrpBufferLexer::getNextToken( void ) {
+    token tok;
+
+    nextToken( tok );
+    return tok;
+}
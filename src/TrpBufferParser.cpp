@@ -0,0 +1,236 @@
+#include "../include/TrpBufferParser.hpp"
+#include "../include/TrpSchemaArray.hpp"
+#include "../include/TrpSchemaObject.hpp"
+
+TrpBufferParser::TrpBufferParser( void ) : lexer(NULL, 0), head(NULL), parsed(false), hashing(false) {}
+
+TrpBufferParser::TrpBufferParser( const char* _data, size_t _size )
+    : lexer(_data, _size), head(NULL), parsed(false), hashing(false) {}
+
+TrpBufferParser::TrpBufferParser( const std::string& _data )
+    : lexer(_data), head(NULL), parsed(false), hashing(false) {}
+
+TrpBufferParser::~TrpBufferParser() {
+    clearAST();
+}
+
+bool TrpBufferParser::openFile( const std::string& file_name ) {
+    clearAST();
+    lexer.reset( NULL, 0 );
+    if ( !file.open( file_name ) ) {
+        last_err.type = T_ERROR;
+        last_err.value = file.getError();
+        last_err.line = last_err.col = 0;
+        return false;
+    }
+    lexer.reset( file.data(), file.size() );
+    return true;
+}
+
+void TrpBufferParser::setBuffer( const char* _data, size_t _size ) {
+    clearAST();
+    file.close();
+    lexer.reset( _data, _size );
+}
+
+void TrpBufferParser::clearAST( void ) {
+    hashes.clear();
+    delete head;
+    head = NULL;
+    parsed = false;
+}
+
+ITrpJsonValue* TrpBufferParser::release( void ) {
+    ITrpJsonValue* ast = head;
+
+    hashes.clear();
+    head = NULL;
+    parsed = false;
+    return ast;
+}
+
+bool TrpBufferParser::parse( void ) {
+    return parseRoot( NULL );
+}
+
+bool TrpBufferParser::parse( const TrpSchema& schema ) {
+    return parseRoot( &schema );
+}
+
+bool TrpBufferParser::parseRoot( const TrpSchema* shape ) {
+    clearAST();
+    lexer.reset();
+
+    size_t hash;
+    lexer.nextToken( current );
+    AutoPointer<ITrpJsonValue> root( parseValue( hashing ? &hash : NULL, shape ) );
+    if ( root.isNULL() ) {
+        hashes.clear();
+        return false;
+    }
+
+    // parseValue() leaves `current` on the token after the value
+    if ( current.type != T_END_OF_FILE ) {
+        fail( "Unexpected token after document" );
+        hashes.clear();
+        return false;
+    }
+
+    head = root.release();
+    parsed = true;
+    return true;
+}
+
+ITrpJsonValue* TrpBufferParser::fail( const std::string& message ) {
+    last_err = current;
+    if ( current.type != T_ERROR ) {
+        last_err.type = T_ERROR;
+        last_err.value = message;
+    }
+    return NULL;
+}
+
+// What projection keeps below a value: only object and array schemas
+// narrow it, anything else (NULL included) takes the whole subtree
+static const TrpSchema* projectable( const TrpSchema* shape ) {
+    if ( !shape ) return NULL;
+    if ( shape->getType() == SCHEMA_OBJECT ) return shape;
+    if ( shape->getType() == SCHEMA_ARRAY && !static_cast<const TrpSchemaArray*>(shape)->isUniq() ) return shape;
+    return NULL;
+}
+
+// The schema of item `index`, NULL for a full parse
+static const TrpSchema* itemShape( const TrpSchemaArray* arr, size_t index ) {
+    const SchemaVec& tuple = arr->getTuple();
+
+    if ( tuple.empty() ) return projectable( arr->getItem() );
+    if ( arr->getItem() || index >= tuple.size() ) return NULL;
+    return projectable( tuple[index] );
+}
+
+// Parses the value starting at `current` and moves past it
+ITrpJsonValue* TrpBufferParser::parseValue( size_t* hash, const TrpSchema* shape ) {
+    ITrpJsonValue* value = NULL;
+
+    switch (current.type) {
+        case T_BRACE_OPEN:
+            return parseObject( hash, projectable( shape ) );
+        case T_BRACKET_OPEN:
+            return parseArray( hash, projectable( shape ) );
+        case T_STRING:
+            value = new TrpJsonString( current.value );
+            break;
+        case T_NUMBER:
+            value = new TrpJsonNumber( std::strtod( current.value.c_str(), NULL ) );
+            break;
+        case T_TRUE:
+            value = new TrpJsonBool( true );
+            break;
+        case T_FALSE:
+            value = new TrpJsonBool( false );
+            break;
+        case T_NULL:
+            value = new TrpJsonNull();
+            break;
+        default:
+            return fail( "Unexpected token, expected a value" );
+    }
+
+    if ( hash ) *hash = trpJsonHash( value );
+    lexer.nextToken( current );
+    return value;
+}
+
+// Containers are hashed bottom-up from their children's hashes, with the
+// same steps as trpJsonHash(), and stored in `hashes`
+ITrpJsonValue* TrpBufferParser::parseObject( size_t* hash, const TrpSchema* shape ) {
+    AutoPointer<TrpJsonObject> obj( new TrpJsonObject() );
+    const TrpSchemaObject* schema = shape && shape->getType() == SCHEMA_OBJECT
+        ? static_cast<const TrpSchemaObject*>(shape) : NULL;
+    bool counted = schema && (schema->hasMin() || schema->hasMax());
+    std::string key;
+    size_t sum = 0, members = 0, member_hash;
+
+    lexer.nextToken( current );
+    if ( current.type == T_BRACE_CLOSE ) {
+        lexer.nextToken( current );
+        if ( hash ) hashes.insert( obj.get(), *hash = trpJsonHashObject( 0, 0 ) );
+        return obj.release();
+    }
+
+    for ( ;; ) {
+        if ( current.type != T_STRING ) return fail( "Expected string key in object" );
+        key.swap( current.value );
+
+        lexer.nextToken( current );
+        if ( current.type != T_COLON ) return fail( "Expected ':' after object key" );
+
+        const TrpSchema* child = NULL;
+        bool declared = true;
+        if ( schema ) {
+            std::map<std::string, TrpSchema*>::const_iterator it = schema->getProperties().find( key );
+            declared = it != schema->getProperties().end();
+            if ( declared ) child = it->second;
+        }
+
+        ITrpJsonValue* value = NULL;
+        if ( declared ) {
+            lexer.nextToken( current );
+            value = parseValue( hash ? &member_hash : NULL, child );
+            if ( !value ) return NULL;
+        } else {
+            if ( !lexer.skipValue( current ) ) return fail( "Unexpected token, expected a value" );
+            lexer.nextToken( current );
+            if ( counted ) value = new TrpJsonNull();
+            if ( hash && value ) member_hash = trpJsonHash( value );
+        }
+
+        if ( value ) {
+            if ( hash ) sum += trpJsonHashMember( key, member_hash );
+            members++;
+            obj->add( key, value );
+        }
+
+        if ( current.type == T_BRACE_CLOSE ) break;
+        if ( current.type != T_COMMA ) return fail( "Expected ',' or '}' in object" );
+        lexer.nextToken( current );
+    }
+
+    if ( hash ) {
+        // a repeated key kept only one value: hash what the object holds
+        *hash = members == obj->size() ? trpJsonHashObject( sum, members ) : trpJsonHash( obj.get() );
+        hashes.insert( obj.get(), *hash );
+    }
+    lexer.nextToken( current );
+    return obj.release();
+}
+
+ITrpJsonValue* TrpBufferParser::parseArray( size_t* hash, const TrpSchema* shape ) {
+    AutoPointer<TrpJsonArray> arr( new TrpJsonArray() );
+    const TrpSchemaArray* schema = shape && shape->getType() == SCHEMA_ARRAY
+        ? static_cast<const TrpSchemaArray*>(shape) : NULL;
+    size_t h = 0, size = 0, item_hash;
+
+    lexer.nextToken( current );
+    if ( current.type == T_BRACKET_CLOSE ) {
+        lexer.nextToken( current );
+        if ( hash ) hashes.insert( arr.get(), *hash = trpJsonHashArray( 0, 0 ) );
+        return arr.release();
+    }
+
+    for ( ;; ) {
+        ITrpJsonValue* value = parseValue( hash ? &item_hash : NULL, schema ? itemShape( schema, size ) : NULL );
+        if ( !value ) return NULL;
+        if ( hash ) h = trpJsonHashItem( h, item_hash );
+        size++;
+        arr->add( value );
+
+        if ( current.type == T_BRACKET_CLOSE ) break;
+        if ( current.type != T_COMMA ) return fail( "Expected ',' or ']' in array" );
+        lexer.nextToken( current );
+    }
+
+    if ( hash ) hashes.insert( arr.get(), *hash = trpJsonHashArray( h, size ) );
+    lexer.nextToken( current );
+    return arr.release();
+}
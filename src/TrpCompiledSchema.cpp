@@ -0,0 +1,464 @@
+#include "../include/TrpCompiledSchema.hpp"
+#include <cmath>
+#include <cstring>
+
+TrpCompiledSchema::TrpCompiledSchema( void ) {}
+
+TrpCompiledSchema::TrpCompiledSchema( const TrpSchema& root ) {
+    compile( root );
+}
+
+void TrpCompiledSchema::compile( const TrpSchema& root ) {
+    std::map<const TrpSchema*, unsigned int> seen;
+
+    nodes.clear();
+    keys.clear();
+    slots.clear();
+    pool.clear();
+    sources.clear();
+    key_names.clear();
+
+    emit( &root, seen );
+}
+
+// Appends the node for `schema` and, depth first, its children. Nodes are
+// memoized by address so shared (or self-referencing) schemas compile once.
+// Never hold a reference into `nodes` across a recursive emit().
+unsigned int TrpCompiledSchema::emit( const TrpSchema* schema, std::map<const TrpSchema*, unsigned int>& seen ) {
+    TrpCompiledNode node;
+    std::memset( &node, 0, sizeof(node) );
+    node.item = TRP_NO_NODE;
+
+    unsigned int index = nodes.size();
+
+    if ( !schema ) {
+        node.op = OP_REJECT;
+        nodes.push_back( node );
+        sources.push_back( NULL );
+        return index;
+    }
+
+    std::map<const TrpSchema*, unsigned int>::iterator found = seen.find( schema );
+    if ( found != seen.end() ) return found->second;
+
+    seen[schema] = index;
+    nodes.push_back( node );
+    sources.push_back( schema );
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING: {
+            const TrpSchemaString* str = static_cast<const TrpSchemaString*>(schema);
+
+            node.op = OP_STRING;
+            if ( str->hasMin() ) { node.flags |= NODE_HAS_MIN; node.min_value = str->getMin(); }
+            if ( str->hasMax() ) { node.flags |= NODE_HAS_MAX; node.max_value = str->getMax(); }
+            if ( str->isCodePoints() ) node.flags |= NODE_CODE_POINTS;
+            if ( str->getFormat() != FORMAT_NONE ) { node.flags |= NODE_FORMAT; node.count = str->getFormat(); }
+            if ( str->hasPattern() ) node.flags |= NODE_PATTERN;
+            if ( str->hasEnum() ) node.flags |= NODE_ENUM;
+            break;
+        }
+        case SCHEMA_NUMBER: {
+            const TrpSchemaNumber* nbr = static_cast<const TrpSchemaNumber*>(schema);
+
+            TrpNumberRange range = nbr->getRange();
+
+            // inclusive bounds, exclusive ones already moved inward
+            node.op = OP_NUMBER;
+            if ( nbr->hasMin() ) { node.flags |= NODE_HAS_MIN; node.min_value = range.lo; }
+            if ( nbr->hasMax() ) { node.flags |= NODE_HAS_MAX; node.max_value = range.hi; }
+            if ( nbr->isInteger() ) node.flags |= NODE_INTEGER;
+            if ( nbr->getMultipleOf() ) node.flags |= NODE_MULTIPLE;
+            if ( nbr->hasEnum() ) node.flags |= NODE_ENUM;
+            break;
+        }
+        case SCHEMA_BOOLEAN: {
+            const TrpSchemaBool* bl = static_cast<const TrpSchemaBool*>(schema);
+
+            node.op = OP_BOOLEAN;
+            if ( bl->hasConst() ) { node.flags |= NODE_ENUM; node.count = bl->getConst(); }
+            break;
+        }
+        case SCHEMA_NULL:
+            node.op = OP_NULL;
+            break;
+        case SCHEMA_OBJECT: {
+            const TrpSchemaObject* obj = static_cast<const TrpSchemaObject*>(schema);
+            const std::map<std::string, TrpSchema*>& props = obj->getProperties();
+            const std::vector<bool>& mask = obj->getRequiredMask();
+
+            node.op = OP_OBJECT;
+            if ( obj->hasMin() ) { node.flags |= NODE_HAS_MIN; node.min_value = obj->getMin(); }
+            if ( obj->hasMax() ) { node.flags |= NODE_HAS_MAX; node.max_value = obj->getMax(); }
+
+            node.first = keys.size();
+            node.count = props.size();
+            std::map<std::string, TrpSchema*>::const_iterator it;
+            size_t ordinal = 0;
+            for ( it = props.begin(); it != props.end(); it++, ordinal++ ) {
+                TrpCompiledKey key;
+
+                key.name = pool.size();
+                key.length = it->first.size();
+                key.node = TRP_NO_NODE;
+                key.required = mask[ordinal] ? 1 : 0;
+                pool += it->first;
+                keys.push_back( key );
+                key_names.push_back( &it->first );
+            }
+
+            nodes[index] = node;
+            unsigned int k = node.first;
+            for ( it = props.begin(); it != props.end(); it++, k++ ) {
+                unsigned int child = emit( it->second, seen );
+                keys[k].node = child;
+            }
+            return index;
+        }
+        case SCHEMA_ARRAY: {
+            const TrpSchemaArray* arr = static_cast<const TrpSchemaArray*>(schema);
+            const SchemaVec& tuple = arr->getTuple();
+
+            node.op = OP_ARRAY;
+            if ( arr->hasMin() ) { node.flags |= NODE_HAS_MIN; node.min_value = arr->getMin(); }
+            if ( arr->hasMax() ) { node.flags |= NODE_HAS_MAX; node.max_value = arr->getMax(); }
+            if ( arr->isUniq() ) node.flags |= NODE_UNIQ;
+
+            node.first = slots.size();
+            node.count = tuple.size();
+            slots.resize( slots.size() + tuple.size(), TRP_NO_NODE );
+            nodes[index] = node;
+
+            if ( arr->getItem() ) {
+                unsigned int item = emit( arr->getItem(), seen );
+                nodes[index].item = item;
+            }
+            for ( size_t i = 0; i < tuple.size(); i++ ) {
+                unsigned int child = emit( tuple[i], seen );
+                slots[node.first + i] = child;
+            }
+            return index;
+        }
+        case SCHEMA_UNION: {
+            const std::vector<TrpSchema*>& branches = static_cast<const TrpSchemaUnion*>(schema)->getBranches();
+
+            node.op = OP_UNION;
+            node.first = slots.size();
+            node.count = branches.size();
+            slots.resize( slots.size() + branches.size(), TRP_NO_NODE );
+            nodes[index] = node;
+
+            for ( size_t i = 0; i < branches.size(); i++ ) {
+                unsigned int child = emit( branches[i], seen );
+                slots[node.first + i] = child;
+            }
+            return index;
+        }
+        default:
+            node.op = OP_DELEGATE;
+            break;
+    }
+
+    nodes[index] = node;
+    return index;
+}
+
+bool TrpCompiledSchema::validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
+    if ( nodes.empty() ) return true;
+    return run( 0, value, ctx );
+}
+
+// Same ordering as std::string::compare, which is what JsonObjectMap uses
+int TrpCompiledSchema::compareKey( const std::string& key, const TrpCompiledKey& entry ) const {
+    size_t len = key.size() < entry.length ? key.size() : entry.length;
+    int diff = std::memcmp( key.data(), pool.data() + entry.name, len );
+
+    if ( diff ) return diff;
+    if ( key.size() < entry.length ) return -1;
+    return key.size() > entry.length ? 1 : 0;
+}
+
+// The happy path never leaves the program. As soon as a check fails, the
+// source schema is asked to report it, so messages match TrpSchema::validate.
+bool TrpCompiledSchema::run( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
+    const TrpCompiledNode& node = nodes[index];
+    TrpJsonType type = value ? value->getType() : TRP_ERROR;
+
+    switch (node.op) {
+        case OP_STRING: {
+            if ( type != TRP_STRING ) break;
+            const std::string& str = static_cast<TrpJsonString*>(value)->getValue();
+            size_t len = node.flags & NODE_CODE_POINTS ? trpUtf8Length( str.data(), str.size() ) : str.size();
+            if ( ((node.flags & NODE_HAS_MAX) && len > node.max_value)
+                || ((node.flags & NODE_HAS_MIN) && len < node.min_value)
+                || ((node.flags & NODE_FORMAT) && !trpCheckFormat( static_cast<TrpStringFormat>(node.count), str.data(), str.size() ))
+                || ((node.flags & NODE_PATTERN) && !static_cast<const TrpSchemaString*>(sources[index])->getPattern().match( str ))
+                || ((node.flags & NODE_ENUM) && !static_cast<const TrpSchemaString*>(sources[index])->getEnum().contains( str )) ) {
+                return static_cast<const TrpSchemaString*>(sources[index])->checkString( str, ctx );
+            }
+            return true;
+        }
+        case OP_NUMBER: {
+            if ( type != TRP_NUMBER ) break;
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            if ( ((node.flags & NODE_HAS_MAX) && nbr > node.max_value)
+                || ((node.flags & NODE_HAS_MIN) && nbr < node.min_value)
+                || ((node.flags & NODE_INTEGER) && nbr != std::floor( nbr ))
+                || ((node.flags & NODE_MULTIPLE) && !static_cast<const TrpSchemaNumber*>(sources[index])->isMultiple( nbr ))
+                || ((node.flags & NODE_ENUM) && !static_cast<const TrpSchemaNumber*>(sources[index])->inEnum( nbr )) ) {
+                return static_cast<const TrpSchemaNumber*>(sources[index])->checkNumber( nbr, ctx );
+            }
+            return true;
+        }
+        case OP_BOOLEAN:
+            if ( type != TRP_BOOL ) break;
+            if ( (node.flags & NODE_ENUM) && static_cast<TrpJsonBool*>(value)->getValue() != (node.count != 0) )
+                return static_cast<const TrpSchemaBool*>(sources[index])->checkValue( !node.count, ctx );
+            return true;
+        case OP_NULL:
+            if ( type != TRP_NULL ) break;
+            return true;
+        case OP_OBJECT:
+            if ( type != TRP_OBJECT ) break;
+            if ( ctx.isMemoEnabled() ) return runMemo( index, value, ctx );
+            return runObject( index, static_cast<TrpJsonObject*>(value), ctx );
+        case OP_ARRAY:
+            if ( type != TRP_ARRAY ) break;
+            if ( ctx.isMemoEnabled() ) return runMemo( index, value, ctx );
+            return runArray( index, static_cast<TrpJsonArray*>(value), ctx );
+        case OP_UNION: {
+            const TrpSchemaUnion* uni = static_cast<const TrpSchemaUnion*>(sources[index]);
+            size_t branch;
+
+            switch (uni->pick( value, ctx, branch )) {
+                case UNION_BRANCH:
+                    return run( slots[node.first + branch], value, ctx );
+                case UNION_TRY:
+                    return uni->tryBranches( value, ctx );
+                default:
+                    return false;
+            }
+        }
+        case OP_REJECT:
+            return false;
+        default:
+            break;
+    }
+
+    // type mismatch or OP_DELEGATE
+    return sources[index]->validate( value, ctx );
+}
+
+// Memo entries are keyed by the source schema, so the tree validators and
+// the program share them
+bool TrpCompiledSchema::runMemo( unsigned int index, ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
+    size_t hash;
+    bool valid;
+
+    if ( ctx.memoEnter( sources[index], value, hash ) ) return true;
+    if ( nodes[index].op == OP_OBJECT ) valid = runObject( index, static_cast<TrpJsonObject*>(value), ctx );
+    else valid = runArray( index, static_cast<TrpJsonArray*>(value), ctx );
+    ctx.memoLeave( sources[index], value, hash, valid );
+    return valid;
+}
+
+class TrpCompiledSchema::ItemRange : public TrpSplitBody {
+    private:
+        const TrpCompiledSchema& program;
+        unsigned int item;
+        TrpJsonArray* arr;
+
+    public:
+        ItemRange( const TrpCompiledSchema& _program, unsigned int _item, TrpJsonArray* _arr )
+            : program(_program), item(_item), arr(_arr) {}
+
+        bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const {
+            bool got_error = false;
+
+            if ( program.nodes[item].op == OP_NUMBER && !ctx.getProfiler() )
+                return static_cast<const TrpSchemaNumber*>(program.sources[item])->validateItems( arr, first, last, ctx );
+
+            for ( size_t i = first; i < last; i++ ) {
+                if ( !((i - first) & 63) && ctx.isCancelled() ) break;
+                ctx.pushIndex( i );
+                if ( !program.run( item, arr->at(i), ctx ) ) got_error = true;
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
+
+            if ( got_error ) return false;
+            return true;
+        }
+};
+
+// A matched member (value set) or a missing required key
+struct TrpCompiledStep {
+    unsigned int key;           // entry in keys / key_names
+    ITrpJsonValue* value;
+};
+
+class TrpCompiledSchema::MemberRange : public TrpSplitBody {
+    private:
+        const TrpCompiledSchema& program;
+        const TrpSchemaObject* source;
+        const std::vector<TrpCompiledStep>& steps;
+
+    public:
+        MemberRange( const TrpCompiledSchema& _program, const TrpSchemaObject* _source, const std::vector<TrpCompiledStep>& _steps )
+            : program(_program), source(_source), steps(_steps) {}
+
+        bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const {
+            bool got_errors = false;
+
+            for ( size_t i = first; i < last && !ctx.isCancelled(); i++ ) {
+                const std::string& name = *program.key_names[steps[i].key];
+
+                if ( !steps[i].value ) {
+                    source->reportMissing( name, ctx );
+                    got_errors = true;
+                } else {
+                    ctx.pushKey( name );
+                    if ( !program.run( program.keys[steps[i].key].node, steps[i].value, ctx ) ) got_errors = true;
+                    ctx.popPath();
+                }
+                if ( got_errors && !ctx.shouldContinue() ) return false;
+            }
+
+            if ( got_errors ) return false;
+            return true;
+        }
+};
+
+bool TrpCompiledSchema::runObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const {
+    const TrpCompiledNode& node = nodes[index];
+    const TrpSchemaObject* source = static_cast<const TrpSchemaObject*>(sources[index]);
+    bool got_errors = false;
+
+    if ( node.flags & (NODE_HAS_MIN | NODE_HAS_MAX) ) {
+        size_t size = obj->size();
+        if ( ((node.flags & NODE_HAS_MIN) && size < node.min_value)
+            || ((node.flags & NODE_HAS_MAX) && size > node.max_value) ) {
+            source->checkSize( size, ctx );
+            got_errors = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+    }
+
+    if ( !node.count ) {
+        if ( got_errors ) return false;
+        return true;
+    }
+
+    if ( ctx.shouldSplit( node.count ) ) {
+        if ( !splitObject( index, obj, ctx ) ) got_errors = true;
+        if ( got_errors ) return false;
+        return true;
+    }
+
+    const TrpCompiledKey* entries = &keys[node.first];
+    JsonObjectMap::const_iterator it = obj->begin();
+
+    for ( unsigned int k = 0; k < node.count; ) {
+        int diff = it == obj->end() ? 1 : compareKey( it->first, entries[k] );
+
+        if ( diff < 0 ) {
+            it++;
+            continue;
+        }
+
+        if ( diff > 0 ) {
+            if ( entries[k].required ) {
+                source->reportMissing( *key_names[node.first + k], ctx );
+                got_errors = true;
+            }
+        } else {
+            ctx.pushKey( *key_names[node.first + k] );
+            if ( !run( entries[k].node, it->second, ctx ) ) got_errors = true;
+            ctx.popPath();
+            it++;
+        }
+        if ( got_errors && !ctx.shouldContinue() ) return false;
+        k++;
+    }
+
+    if ( got_errors ) return false;
+    return true;
+}
+
+bool TrpCompiledSchema::runArray( unsigned int index, TrpJsonArray* arr, TrpValidatorContext& ctx ) const {
+    const TrpCompiledNode& node = nodes[index];
+    const TrpSchemaArray* source = static_cast<const TrpSchemaArray*>(sources[index]);
+    size_t size = arr->size();
+    bool got_error = false;
+
+    if ( ((node.flags & NODE_HAS_MAX) && size > node.max_value)
+        || ((node.flags & NODE_HAS_MIN) && size < node.min_value) ) {
+        source->checkSize( size, ctx );
+        got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if ( node.item != TRP_NO_NODE ) {
+        ItemRange items( *this, node.item, arr );
+        bool valid = ctx.shouldSplit( size ) ? ctx.split( items, size ) : items.validateRange( 0, size, ctx );
+
+        if ( !valid ) {
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+    }
+
+    if ( node.count ) {
+        if ( size != node.count ) {
+            source->checkTupleSize( size, ctx );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        } else {
+            for ( size_t i = 0; i < size; i++ ) {
+                ctx.pushIndex( i );
+                if ( !run( slots[node.first + i], arr->at(i), ctx ) ) got_error = true;
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
+        }
+    }
+
+    if ( (node.flags & NODE_UNIQ) && !source->checkUniq( arr, ctx ) ) got_error = true;
+
+    if ( got_error ) return false;
+    return true;
+}
+
+// The merge walk of runObject(), recorded first so it can be cut into ranges
+bool TrpCompiledSchema::splitObject( unsigned int index, TrpJsonObject* obj, TrpValidatorContext& ctx ) const {
+    const TrpCompiledNode& node = nodes[index];
+    const TrpSchemaObject* source = static_cast<const TrpSchemaObject*>(sources[index]);
+    const TrpCompiledKey* entries = &keys[node.first];
+    JsonObjectMap::const_iterator it = obj->begin();
+    std::vector<TrpCompiledStep> steps;
+
+    steps.reserve( node.count );
+    for ( unsigned int k = 0; k < node.count; ) {
+        int diff = it == obj->end() ? 1 : compareKey( it->first, entries[k] );
+
+        if ( diff < 0 ) {
+            it++;
+            continue;
+        }
+
+        TrpCompiledStep step;
+        step.key = node.first + k;
+        step.value = NULL;
+        if ( !diff ) {
+            step.value = it->second;
+            steps.push_back( step );
+            it++;
+        } else if ( entries[k].required ) {
+            steps.push_back( step );
+        }
+        k++;
+    }
+
+    MemberRange members( *this, source, steps );
+    return ctx.split( members, steps.size() );
+}
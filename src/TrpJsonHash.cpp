@@ -0,0 +1,346 @@
+#include "../include/TrpJsonHash.hpp"
+#include <cstring>
+
+// Finalizer from splitmix64, spreads every input bit over the whole word
+static size_t mix( size_t h ) {
+    h ^= h >> 31;
+    h *= static_cast<size_t>(0x7fb5d329728ea185ULL);
+    h ^= h >> 27;
+    h *= static_cast<size_t>(0x81dadef4bc2dd44dULL);
+    h ^= h >> 33;
+    return h;
+}
+
+// A word at a time; the tail is zero-padded and the length mixed in, so
+// "a" and "a\0" still differ
+static size_t hashBytes( const char* data, size_t len, size_t seed ) {
+    size_t h = seed ^ static_cast<size_t>(0xcbf29ce484222325ULL) ^ len;
+    size_t word;
+
+    for ( ; len >= sizeof(word); data += sizeof(word), len -= sizeof(word) ) {
+        std::memcpy( &word, data, sizeof(word) );
+        h = (h ^ word) * static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+        h ^= h >> 29;
+    }
+    if ( len ) {
+        word = 0;
+        std::memcpy( &word, data, len );
+        h = (h ^ word) * static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+    }
+    return mix( h );
+}
+
+size_t trpJsonHashItem( size_t h, size_t item ) {
+    return mix( h * 31 + item );
+}
+
+size_t trpJsonHashArray( size_t h, size_t size ) {
+    return mix( (h ^ size) + TRP_ARRAY * 0x9e3779b9u );
+}
+
+// summed by the caller: a sum does not depend on member order
+size_t trpJsonHashMember( const std::string& key, size_t value ) {
+    return mix( hashBytes( key.data(), key.size(), TRP_OBJECT ) ^ (value * 31) );
+}
+
+size_t trpJsonHashObject( size_t sum, size_t size ) {
+    return mix( (sum ^ size) + TRP_OBJECT * 0x9e3779b9u );
+}
+
+static size_t hashValue( ITrpJsonValue* value, TrpJsonHashCache* cache );
+
+size_t trpJsonHash( ITrpJsonValue* value ) {
+    return hashValue( value, NULL );
+}
+
+size_t trpJsonHash( ITrpJsonValue* value, TrpJsonHashCache& cache ) {
+    return hashValue( value, &cache );
+}
+
+static size_t hashContainer( ITrpJsonValue* value, TrpJsonHashCache* cache ) {
+    size_t h;
+
+    if ( cache && cache->find( value, h ) ) return h;
+
+    if ( value->getType() == TRP_ARRAY ) {
+        TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+        size_t size = arr->size();
+        h = 0;
+
+        for ( size_t i = 0; i < size; i++ ) {
+            h = trpJsonHashItem( h, hashValue( arr->at(i), cache ) );
+        }
+        h = trpJsonHashArray( h, size );
+    } else {
+        TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+        h = 0;
+
+        for ( JsonObjectMap::const_iterator it = obj->begin(); it != obj->end(); it++ ) {
+            h += trpJsonHashMember( it->first, hashValue( it->second, cache ) );
+        }
+        h = trpJsonHashObject( h, obj->size() );
+    }
+
+    if ( cache ) cache->insert( value, h );
+    return h;
+}
+
+static size_t hashValue( ITrpJsonValue* value, TrpJsonHashCache* cache ) {
+    if ( !value ) return 0;
+
+    switch (value->getType()) {
+        case TRP_NULL:
+            return mix( 1 );
+        case TRP_BOOL:
+            return mix( static_cast<TrpJsonBool*>(value)->getValue() ? 2 : 3 );
+        case TRP_NUMBER: {
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            if ( nbr == 0 ) nbr = 0;
+            return hashBytes( reinterpret_cast<const char*>(&nbr), sizeof(nbr), TRP_NUMBER );
+        }
+        case TRP_STRING: {
+            const std::string& str = static_cast<TrpJsonString*>(value)->getValue();
+            return hashBytes( str.data(), str.size(), TRP_STRING );
+        }
+        case TRP_ARRAY:
+        case TRP_OBJECT:
+            return hashContainer( value, cache );
+        default:
+            return 0;
+    }
+}
+
+bool trpJsonEqual( ITrpJsonValue* a, ITrpJsonValue* b ) {
+    if ( a == b ) return true;
+    if ( !a || !b || a->getType() != b->getType() ) return false;
+
+    switch (a->getType()) {
+        case TRP_NULL:
+            return true;
+        case TRP_BOOL:
+            return static_cast<TrpJsonBool*>(a)->getValue() == static_cast<TrpJsonBool*>(b)->getValue();
+        case TRP_NUMBER:
+            return static_cast<TrpJsonNumber*>(a)->getValue() == static_cast<TrpJsonNumber*>(b)->getValue();
+        case TRP_STRING:
+            return static_cast<TrpJsonString*>(a)->getValue() == static_cast<TrpJsonString*>(b)->getValue();
+        case TRP_ARRAY: {
+            TrpJsonArray* lhs = static_cast<TrpJsonArray*>(a);
+            TrpJsonArray* rhs = static_cast<TrpJsonArray*>(b);
+
+            if ( lhs->size() != rhs->size() ) return false;
+            for ( size_t i = 0; i < lhs->size(); i++ ) {
+                if ( !trpJsonEqual( lhs->at(i), rhs->at(i) ) ) return false;
+            }
+            return true;
+        }
+        case TRP_OBJECT: {
+            TrpJsonObject* lhs = static_cast<TrpJsonObject*>(a);
+            TrpJsonObject* rhs = static_cast<TrpJsonObject*>(b);
+
+            if ( lhs->size() != rhs->size() ) return false;
+            JsonObjectMap::const_iterator it = lhs->begin();
+            JsonObjectMap::const_iterator jt = rhs->begin();
+            for ( ; it != lhs->end(); it++, jt++ ) {
+                if ( it->first != jt->first || !trpJsonEqual( it->second, jt->second ) ) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// One type byte, then: a number's bytes (-0 as 0), a string's length and
+// bytes, a container's size and its items or its members in key order
+static void encodeSize( size_t size, std::string& out ) {
+    out.append( reinterpret_cast<const char*>(&size), sizeof(size) );
+}
+
+void trpJsonEncode( ITrpJsonValue* value, std::string& out ) {
+    TrpJsonType type = value ? value->getType() : TRP_NULL;
+
+    out += static_cast<char>(type);
+    switch (type) {
+        case TRP_BOOL:
+            out += static_cast<TrpJsonBool*>(value)->getValue() ? '\1' : '\0';
+            break;
+        case TRP_NUMBER: {
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            if ( nbr == 0 ) nbr = 0;
+            out.append( reinterpret_cast<const char*>(&nbr), sizeof(nbr) );
+            break;
+        }
+        case TRP_STRING: {
+            const std::string& str = static_cast<TrpJsonString*>(value)->getValue();
+            encodeSize( str.size(), out );
+            out += str;
+            break;
+        }
+        case TRP_ARRAY: {
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            encodeSize( arr->size(), out );
+            for ( size_t i = 0; i < arr->size(); i++ ) trpJsonEncode( arr->at(i), out );
+            break;
+        }
+        case TRP_OBJECT: {
+            TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+            encodeSize( obj->size(), out );
+            for ( JsonObjectMap::const_iterator it = obj->begin(); it != obj->end(); it++ ) {
+                encodeSize( it->first.size(), out );
+                out += it->first;
+                trpJsonEncode( it->second, out );
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static bool matchSize( const std::string& image, size_t& pos, size_t size ) {
+    if ( image.size() - pos < sizeof(size) || std::memcmp( image.data() + pos, &size, sizeof(size) ) ) return false;
+    pos += sizeof(size);
+    return true;
+}
+
+static bool matchBytes( const std::string& image, size_t& pos, const std::string& bytes ) {
+    if ( !matchSize( image, pos, bytes.size() ) || image.size() - pos < bytes.size()
+        || image.compare( pos, bytes.size(), bytes ) ) return false;
+    pos += bytes.size();
+    return true;
+}
+
+static bool matchValue( ITrpJsonValue* value, const std::string& image, size_t& pos ) {
+    TrpJsonType type = value ? value->getType() : TRP_NULL;
+
+    if ( pos >= image.size() || image[pos] != static_cast<char>(type) ) return false;
+    pos++;
+    switch (type) {
+        case TRP_BOOL:
+            if ( pos >= image.size() || image[pos] != (static_cast<TrpJsonBool*>(value)->getValue() ? '\1' : '\0') ) return false;
+            pos++;
+            return true;
+        case TRP_NUMBER: {
+            double nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+            if ( nbr == 0 ) nbr = 0;
+            if ( image.size() - pos < sizeof(nbr) || std::memcmp( image.data() + pos, &nbr, sizeof(nbr) ) ) return false;
+            pos += sizeof(nbr);
+            return true;
+        }
+        case TRP_STRING:
+            return matchBytes( image, pos, static_cast<TrpJsonString*>(value)->getValue() );
+        case TRP_ARRAY: {
+            TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+            if ( !matchSize( image, pos, arr->size() ) ) return false;
+            for ( size_t i = 0; i < arr->size(); i++ ) {
+                if ( !matchValue( arr->at(i), image, pos ) ) return false;
+            }
+            return true;
+        }
+        case TRP_OBJECT: {
+            TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+            if ( !matchSize( image, pos, obj->size() ) ) return false;
+            for ( JsonObjectMap::const_iterator it = obj->begin(); it != obj->end(); it++ ) {
+                if ( !matchBytes( image, pos, it->first ) || !matchValue( it->second, image, pos ) ) return false;
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+bool trpJsonEqualEncoded( ITrpJsonValue* value, const std::string& image ) {
+    size_t pos = 0;
+
+    return matchValue( value, image, pos ) && pos == image.size();
+}
+
+TrpJsonHashCache::TrpJsonHashCache( void ) : count(0) {}
+
+// Open addressing over item indices, sized to at most half full. Deep
+// equality only runs when two items land on the same full hash.
+bool trpJsonDuplicates( TrpJsonArray* arr, std::vector<size_t>& duplicates ) {
+    size_t size = arr->size();
+
+    duplicates.clear();
+    if ( size < 2 ) return false;
+
+    size_t capacity = 4;
+    while ( capacity < size * 2 ) capacity <<= 1;
+    size_t mask = capacity - 1;
+
+    std::vector<size_t> slots( capacity, 0 );   // item index + 1, 0 is empty
+    std::vector<size_t> hashes( size );
+
+    for ( size_t i = 0; i < size; i++ ) {
+        ITrpJsonValue* item = arr->at(i);
+        size_t hash = trpJsonHash( item );
+        size_t pos = hash & mask;
+        bool is_duplicate = false;
+
+        hashes[i] = hash;
+        while ( slots[pos] ) {
+            size_t other = slots[pos] - 1;
+            if ( hashes[other] == hash && trpJsonEqual( arr->at(other), item ) ) {
+                is_duplicate = true;
+                break;
+            }
+            pos = (pos + 1) & mask;
+        }
+
+        if ( is_duplicate ) duplicates.push_back( i );
+        else slots[pos] = i + 1;
+    }
+    return !duplicates.empty();
+}
+
+// Heap addresses are aligned, the top bits of a product spread them well
+static size_t pointerSlot( ITrpJsonValue* value, size_t mask ) {
+    size_t h = reinterpret_cast<size_t>(value) * static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+    return (h ^ (h >> 32)) & mask;
+}
+
+bool TrpJsonHashCache::find( ITrpJsonValue* value, size_t& hash ) const {
+    if ( slots.empty() ) return false;
+
+    size_t mask = slots.size() - 1;
+    for ( size_t pos = pointerSlot( value, mask ); slots[pos].value; pos = (pos + 1) & mask ) {
+        if ( slots[pos].value == value ) {
+            hash = slots[pos].hash;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TrpJsonHashCache::insert( ITrpJsonValue* value, size_t hash ) {
+    if ( (count + 1) * 2 > slots.size() ) grow();
+
+    size_t mask = slots.size() - 1;
+    size_t pos = pointerSlot( value, mask );
+    while ( slots[pos].value && slots[pos].value != value ) pos = (pos + 1) & mask;
+
+    if ( !slots[pos].value ) count++;
+    slots[pos].value = value;
+    slots[pos].hash = hash;
+}
+
+void TrpJsonHashCache::grow( void ) {
+    std::vector<Entry> old;
+    Entry empty = { NULL, 0 };
+
+    old.swap( slots );
+    slots.assign( old.empty() ? 64 : old.size() * 2, empty );
+    count = 0;
+    for ( size_t i = 0; i < old.size(); i++ ) {
+        if ( old[i].value ) insert( old[i].value, old[i].hash );
+    }
+}
+
+void TrpJsonHashCache::clear( void ) {
+    Entry empty = { NULL, 0 };
+
+    if ( count ) slots.assign( slots.size(), empty );
+    count = 0;
+}
@@ -0,0 +1,62 @@
+#include "../include/TrpMappedFile.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TrpMappedFile::TrpMappedFile( void ) : _data(NULL), _size(0), is_open(false) {}
+
+TrpMappedFile::TrpMappedFile( const std::string& file_name ) : _data(NULL), _size(0), is_open(false) {
+    open( file_name );
+}
+
+TrpMappedFile::~TrpMappedFile() {
+    close();
+}
+
+bool TrpMappedFile::open( const std::string& file_name ) {
+    close();
+
+    int fd = ::open( file_name.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        error = file_name + ": " + std::strerror( errno );
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) < 0 ) {
+        error = file_name + ": " + std::strerror( errno );
+        ::close( fd );
+        return false;
+    }
+
+    // mmap refuses empty ranges, an empty file is an empty buffer
+    if ( st.st_size > 0 ) {
+        void* ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( ptr == MAP_FAILED ) {
+            error = file_name + ": " + std::strerror( errno );
+            ::close( fd );
+            return false;
+        }
+        madvise( ptr, st.st_size, MADV_SEQUENTIAL );
+        _data = static_cast<const char*>(ptr);
+        _size = st.st_size;
+    } else {
+        _data = "";
+        _size = 0;
+    }
+
+    ::close( fd );
+    error.clear();
+    is_open = true;
+    return true;
+}
+
+void TrpMappedFile::close( void ) {
+    if ( is_open && _size ) munmap( const_cast<char*>(_data), _size );
+    _data = NULL;
+    _size = 0;
+    is_open = false;
+}
@@ -0,0 +1,91 @@
+#include "../include/TrpNumberScan.hpp"
+#include <cmath>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define TRP_SSE2 1
+#endif
+
+// AVX kernels are compiled for their own target and picked at run time
+#if defined(TRP_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define TRP_AVX 1
+#endif
+
+static bool inRangeScalar( const double* values, size_t count, const TrpNumberRange& range ) {
+    for ( size_t i = 0; i < count; i++ ) {
+        double nbr = values[i];
+        if ( !(nbr >= range.lo && nbr <= range.hi) ) return false;
+        if ( range.integer && nbr != std::floor( nbr ) ) return false;
+    }
+    return true;
+}
+
+#ifdef TRP_SSE2
+
+// SSE2 has no rounding, integers are left to the scalar loop
+static bool inRangeSse2( const double* values, size_t count, const TrpNumberRange& range ) {
+    __m128d lo = _mm_set1_pd( range.lo );
+    __m128d hi = _mm_set1_pd( range.hi );
+    __m128d ok = _mm_castsi128_pd( _mm_set1_epi32( -1 ) );
+    size_t i = 0;
+
+    for ( ; i + 2 <= count; i += 2 ) {
+        __m128d v = _mm_loadu_pd( values + i );
+        ok = _mm_and_pd( ok, _mm_and_pd( _mm_cmpge_pd( v, lo ), _mm_cmple_pd( v, hi ) ) );
+    }
+    if ( _mm_movemask_pd( ok ) != 0x3 ) return false;
+    if ( !inRangeScalar( values + i, count - i, range ) ) return false;
+    if ( !range.integer ) return true;
+
+    TrpNumberRange any = { -HUGE_VAL, HUGE_VAL, true };
+    return inRangeScalar( values, i, any );
+}
+
+#endif
+
+#ifdef TRP_AVX
+
+__attribute__((target("avx")))
+static bool inRangeAvx( const double* values, size_t count, const TrpNumberRange& range ) {
+    __m256d lo = _mm256_set1_pd( range.lo );
+    __m256d hi = _mm256_set1_pd( range.hi );
+    __m256d ok = _mm256_castsi256_pd( _mm256_set1_epi32( -1 ) );
+    size_t i = 0;
+
+    if ( range.integer ) {
+        for ( ; i + 4 <= count; i += 4 ) {
+            __m256d v = _mm256_loadu_pd( values + i );
+            __m256d in = _mm256_and_pd( _mm256_cmp_pd( v, lo, _CMP_GE_OQ ), _mm256_cmp_pd( v, hi, _CMP_LE_OQ ) );
+            __m256d whole = _mm256_cmp_pd( v, _mm256_floor_pd( v ), _CMP_EQ_OQ );
+            ok = _mm256_and_pd( ok, _mm256_and_pd( in, whole ) );
+        }
+    } else {
+        for ( ; i + 4 <= count; i += 4 ) {
+            __m256d v = _mm256_loadu_pd( values + i );
+            ok = _mm256_and_pd( ok, _mm256_and_pd( _mm256_cmp_pd( v, lo, _CMP_GE_OQ ), _mm256_cmp_pd( v, hi, _CMP_LE_OQ ) ) );
+        }
+    }
+    if ( _mm256_movemask_pd( ok ) != 0xf ) return false;
+    return inRangeScalar( values + i, count - i, range );
+}
+
+static bool hasAvx( void ) {
+    static const bool avx = ( __builtin_cpu_init(), __builtin_cpu_supports( "avx" ) != 0 );
+    return avx;
+}
+
+#endif
+
+// A whole run is tested before looking at the result: failures are rare
+// and the caller rescans the run to report them
+bool trpNumbersInRange( const double* values, size_t count, const TrpNumberRange& range ) {
+#if defined(TRP_AVX)
+    if ( count >= 4 && hasAvx() ) return inRangeAvx( values, count, range );
+#endif
+#if defined(TRP_SSE2)
+    return inRangeSse2( values, count, range );
+#else
+    return inRangeScalar( values, count, range );
+#endif
+}
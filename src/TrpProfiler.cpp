@@ -0,0 +1,249 @@
+#include "../include/TrpProfiler.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <time.h>
+
+static uint64_t readNs( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// A few cycles on x86, against a vDSO call for clock_gettime
+static uint64_t readTicks( void ) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return readNs();
+#endif
+}
+
+TrpProfiler::TrpProfiler( void ) : errors(0), allocated(NULL) {
+    clear();
+}
+
+void TrpProfiler::setAllocationCounter( const size_t* bytes ) {
+    allocated = bytes;
+}
+
+void TrpProfiler::clear( void ) {
+    Node root = { 0, NULL, 0, 0, 0, 0, 0, 0 };
+
+    nodes.clear();
+    nodes.push_back( root );
+    slots.assign( 64, 0 );
+    frames.clear();
+    errors = 0;
+    origin_ticks = readTicks();
+    origin_ns = readNs();
+}
+
+static size_t slotOf( size_t parent, const std::string* key, size_t mask ) {
+    size_t h = parent * 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<size_t>(key);
+
+    h ^= h >> 29;
+    return (h * 0xbf58476d1ce4e5b9ULL >> 17) & mask;
+}
+
+void TrpProfiler::insertSlot( size_t node ) {
+    size_t mask = slots.size() - 1;
+    size_t pos = slotOf( nodes[node].parent, nodes[node].key, mask );
+
+    while ( slots[pos] ) pos = (pos + 1) & mask;
+    slots[pos] = node + 1;
+}
+
+// Nodes are keyed by the key's address: the validators push the schema's
+// own property names, so a path costs one probe once it is known
+size_t TrpProfiler::findChild( size_t parent, const std::string* key ) {
+    size_t mask = slots.size() - 1;
+
+    for ( size_t pos = slotOf( parent, key, mask ); slots[pos]; pos = (pos + 1) & mask ) {
+        const Node& node = nodes[slots[pos] - 1];
+        if ( node.parent == parent && node.key == key ) return slots[pos] - 1;
+    }
+
+    Node child = { parent, key, 0, 0, 0, 0, 0, 0 };
+    nodes.push_back( child );
+    if ( nodes.size() * 2 > slots.size() ) {
+        slots.assign( slots.size() * 2, 0 );
+        for ( size_t i = 1; i < nodes.size(); i++ ) insertSlot( i );
+    } else {
+        insertSlot( nodes.size() - 1 );
+    }
+    return nodes.size() - 1;
+}
+
+void TrpProfiler::open( size_t node ) {
+    Frame frame;
+
+    frame.node = node;
+    frame.children = 0;
+    frame.start_bytes = readBytes();
+    frame.child_bytes = 0;
+    frame.errors = errors;
+    frame.start = readTicks();
+    frames.push_back( frame );
+}
+
+void TrpProfiler::leave( void ) {
+    uint64_t now = readTicks();
+
+    if ( frames.empty() ) return;
+
+    const Frame& frame = frames.back();
+    Node& node = nodes[frame.node];
+    uint64_t spent = now - frame.start;
+    size_t bytes = readBytes() - frame.start_bytes;
+
+    node.visits++;
+    if ( errors != frame.errors ) node.failures++;
+    node.inclusive += spent;
+    node.exclusive += spent - std::min( spent, frame.children );
+    node.inclusive_bytes += bytes;
+    node.exclusive_bytes += bytes - std::min( bytes, frame.child_bytes );
+    frames.pop_back();
+
+    if ( !frames.empty() ) {
+        frames.back().children += spent;
+        frames.back().child_bytes += bytes;
+    }
+}
+
+void TrpProfiler::start( void ) {
+    frames.clear();
+    open( 0 );
+}
+
+// Closes whatever a validator that returned early left open, then the root
+void TrpProfiler::stop( void ) {
+    while ( !frames.empty() ) leave();
+}
+
+// Calibrated over the whole profile, which is long next to a TSC tick
+double TrpProfiler::nsPerTick( void ) const {
+    uint64_t ticks = readTicks() - origin_ticks;
+    uint64_t ns = readNs() - origin_ns;
+
+    if ( !ticks ) return 1;
+    return static_cast<double>(ns) / ticks;
+}
+
+// ".users[].zip", or "$;.users;[];.zip" for a folded stack
+void TrpProfiler::appendPath( std::string& out, size_t node, bool folded ) const {
+    std::vector<size_t> chain;
+
+    for ( ; node; node = nodes[node].parent ) chain.push_back( node );
+    if ( folded || chain.empty() ) out += '$';
+
+    while ( !chain.empty() ) {
+        const Node& it = nodes[chain.back()];
+        size_t first = out.size();
+
+        chain.pop_back();
+        if ( folded ) out += ';';
+        if ( !it.key ) {
+            out += "[]";
+            continue;
+        }
+        out += '.';
+        out += *it.key;
+        // ';' separates frames
+        if ( folded ) std::replace( out.begin() + first + 1, out.end(), ';', '_' );
+    }
+}
+
+static bool moreExclusive( const TrpProfileEntry& a, const TrpProfileEntry& b ) {
+    if ( a.exclusive_ns != b.exclusive_ns ) return a.exclusive_ns > b.exclusive_ns;
+    return a.path < b.path;
+}
+
+std::vector<TrpProfileEntry> TrpProfiler::getEntries( void ) const {
+    std::map<std::string, TrpProfileEntry> merged;
+    double scale = nsPerTick();
+
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+        const Node& node = nodes[i];
+        std::string path;
+
+        appendPath( path, i, false );
+        std::map<std::string, TrpProfileEntry>::iterator it = merged.find( path );
+        if ( it == merged.end() ) {
+            TrpProfileEntry entry = { path, 0, 0, 0, 0, 0, 0 };
+            it = merged.insert( std::make_pair( path, entry ) ).first;
+        }
+
+        TrpProfileEntry& entry = it->second;
+        entry.visits += node.visits;
+        entry.failures += node.failures;
+        entry.inclusive_ns += node.inclusive * scale;
+        entry.exclusive_ns += node.exclusive * scale;
+        entry.inclusive_bytes += node.inclusive_bytes;
+        entry.exclusive_bytes += node.exclusive_bytes;
+    }
+
+    // without start()/stop() the root is the sum of its members
+    TrpProfileEntry& root = merged["$"];
+    if ( !nodes[0].visits ) {
+        for ( size_t i = 1; i < nodes.size(); i++ ) {
+            if ( nodes[i].parent ) continue;
+            root.inclusive_ns += nodes[i].inclusive * scale;
+            root.inclusive_bytes += nodes[i].inclusive_bytes;
+        }
+    }
+
+    std::vector<TrpProfileEntry> entries;
+    for ( std::map<std::string, TrpProfileEntry>::const_iterator it = merged.begin(); it != merged.end(); it++ ) {
+        entries.push_back( it->second );
+    }
+    std::sort( entries.begin(), entries.end(), moreExclusive );
+    return entries;
+}
+
+void TrpProfiler::writeFolded( std::ostream& out, TrpProfileMetric metric ) const {
+    std::map<std::string, double> stacks;
+    double scale = nsPerTick();
+
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+        const Node& node = nodes[i];
+        double weight;
+
+        if ( metric == PROFILE_TIME ) weight = node.exclusive * scale;
+        else if ( metric == PROFILE_BYTES ) weight = node.exclusive_bytes;
+        else weight = node.visits;
+
+        std::string stack;
+        appendPath( stack, i, true );
+        stacks[stack] += weight;
+    }
+
+    for ( std::map<std::string, double>::const_iterator it = stacks.begin(); it != stacks.end(); it++ ) {
+        uint64_t weight = static_cast<uint64_t>(it->second + 0.5);
+        if ( weight ) out << it->first << ' ' << weight << '\n';
+    }
+}
+
+void TrpProfiler::printTable( std::ostream& out, size_t top ) const {
+    std::vector<TrpProfileEntry> entries = getEntries();
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    if ( top && entries.size() > top ) entries.resize( top );
+
+    out << std::setw(12) << "excl ms" << std::setw(12) << "incl ms"
+        << std::setw(12) << "visits" << std::setw(10) << "failures"
+        << std::setw(14) << "excl bytes" << std::setw(14) << "incl bytes" << "  path\n";
+    out << std::fixed << std::setprecision(3);
+    for ( size_t i = 0; i < entries.size(); i++ ) {
+        const TrpProfileEntry& entry = entries[i];
+
+        out << std::setw(12) << entry.exclusive_ns / 1e6 << std::setw(12) << entry.inclusive_ns / 1e6
+            << std::setw(12) << entry.visits << std::setw(10) << entry.failures
+            << std::setw(14) << entry.exclusive_bytes << std::setw(14) << entry.inclusive_bytes
+            << "  " << entry.path << '\n';
+    }
+    out.flags( flags );
+    out.precision( precision );
+}
@@ -0,0 +1,677 @@
+#include "../include/TrpRegex.hpp"
+#include <algorithm>
+#include <bitset>
+#include <map>
+
+#define RX_NONE static_cast<size_t>(-1)
+#define RX_INFINITE 0xffffffffu
+#define RX_MAX_REPEAT 1000
+#define RX_MAX_NFA 65536
+
+typedef std::bitset<256> TrpByteSet;
+
+enum TrpRxKind
+{
+    RX_SET,         // one byte out of `set`
+    RX_CAT,
+    RX_ALT,
+    RX_REPEAT,      // kids[0] between min and max times
+    RX_EMPTY
+};
+
+struct TrpRxNode {
+    TrpRxKind kind;
+    std::vector<size_t> kids;
+    size_t set;
+    unsigned int min, max;
+};
+
+enum TrpRxStateType
+{
+    RX_STATE_SET,       // consume a byte of `set`, go to out
+    RX_STATE_SPLIT,     // epsilon to out and out1
+    RX_STATE_MATCH
+};
+
+struct TrpRxState {
+    TrpRxStateType type;
+    size_t out, out1;
+    size_t set;
+};
+
+// Pattern -> AST (recursive descent) -> Thompson NFA. Errors stop at the
+// first one, every step returns RX_NONE after it.
+class TrpRxCompiler {
+    public:
+        std::string error;
+        std::vector<TrpByteSet> sets;
+        std::vector<TrpRxNode> nodes;
+        std::vector<TrpRxState> states;
+
+        TrpRxCompiler( const std::string& _pattern, size_t _first, size_t _last, bool _anchored )
+            : pattern(_pattern), pos(_first), end(_last), depth(0), anchored(_anchored) {}
+
+        size_t parse( void ) {
+            size_t root = parseAlt();
+            if ( root != RX_NONE && pos != end ) return fail( "unmatched )" );
+            return root;
+        }
+
+        size_t emit( size_t node, size_t next );
+        size_t matchState( void ) { return newState( RX_STATE_MATCH, 0, 0, 0 ); }
+
+    private:
+        const std::string& pattern;
+        size_t pos, end;
+        size_t depth;
+        bool anchored;
+
+        size_t fail( const char* msg ) {
+            if ( error.empty() ) error = msg;
+            return RX_NONE;
+        }
+
+        bool failed( const char* msg ) {
+            fail( msg );
+            return false;
+        }
+
+        unsigned char peek( void ) const { return static_cast<unsigned char>(pattern[pos]); }
+
+        size_t newNode( TrpRxKind kind ) {
+            TrpRxNode node;
+            node.kind = kind;
+            node.set = 0;
+            node.min = node.max = 0;
+            nodes.push_back( node );
+            return nodes.size() - 1;
+        }
+
+        size_t newSet( const TrpByteSet& set ) {
+            size_t node = newNode( RX_SET );
+            sets.push_back( set );
+            nodes[node].set = sets.size() - 1;
+            return node;
+        }
+
+        size_t newByte( unsigned char byte ) {
+            TrpByteSet set;
+            set.set( byte );
+            return newSet( set );
+        }
+
+        size_t newState( TrpRxStateType type, size_t out, size_t out1, size_t set ) {
+            if ( states.size() >= RX_MAX_NFA ) fail( "pattern is too large" );
+            TrpRxState state;
+            state.type = type;
+            state.out = out;
+            state.out1 = out1;
+            state.set = set;
+            states.push_back( state );
+            return states.size() - 1;
+        }
+
+        size_t parseAlt( void );
+        size_t parseCat( void );
+        size_t parseRepeat( void );
+        size_t parseAtom( void );
+        size_t parseClass( void );
+        size_t parseEscape( void );
+        bool parseBraces( unsigned int& min, unsigned int& max );
+        bool escapeValue( unsigned char escape, unsigned int& cp );
+        size_t literal( unsigned int cp );
+        size_t anyMultibyte( void );
+        size_t classNode( const TrpByteSet& ascii, bool non_ascii );
+};
+
+static TrpByteSet asciiRange( unsigned int lo, unsigned int hi ) {
+    TrpByteSet set;
+    for ( unsigned int c = lo; c <= hi; c++ ) set.set( c );
+    return set;
+}
+
+static const TrpByteSet& asciiMask( void ) {
+    static const TrpByteSet mask = asciiRange( 0, 0x7f );
+    return mask;
+}
+
+// \d \w \s, upper case for the complement (which takes every non-ASCII
+// character too). Returns false for any other letter.
+static bool classEscape( unsigned char escape, TrpByteSet& set, bool& non_ascii ) {
+    TrpByteSet cls;
+
+    switch (escape | 0x20) {
+        case 'd':
+            cls = asciiRange( '0', '9' );
+            break;
+        case 'w':
+            cls = asciiRange( '0', '9' ) | asciiRange( 'a', 'z' ) | asciiRange( 'A', 'Z' );
+            cls.set( '_' );
+            break;
+        case 's':
+            cls = asciiRange( '\t', '\r' );
+            cls.set( ' ' );
+            break;
+        default:
+            return false;
+    }
+
+    if ( escape >= 'a' ) {
+        set |= cls;
+    } else {
+        set |= ~cls & asciiMask();
+        non_ascii = true;
+    }
+    return true;
+}
+
+static int hexValue( unsigned char c ) {
+    if ( c >= '0' && c <= '9' ) return c - '0';
+    if ( (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ) return (c | 0x20) - 'a' + 10;
+    return -1;
+}
+
+size_t TrpRxCompiler::parseAlt( void ) {
+    size_t first = parseCat();
+    if ( first == RX_NONE || pos == end || peek() != '|' ) return first;
+
+    // ^a|b$ anchors each branch, not the alternation
+    if ( !depth && anchored ) return fail( "wrap an anchored alternation in a group: ^(a|b)$" );
+
+    size_t alt = newNode( RX_ALT );
+    nodes[alt].kids.push_back( first );
+    while ( pos < end && peek() == '|' ) {
+        pos++;
+        size_t branch = parseCat();
+        if ( branch == RX_NONE ) return RX_NONE;
+        nodes[alt].kids.push_back( branch );
+    }
+    return alt;
+}
+
+size_t TrpRxCompiler::parseCat( void ) {
+    std::vector<size_t> kids;
+
+    while ( pos < end && peek() != '|' && peek() != ')' ) {
+        size_t kid = parseRepeat();
+        if ( kid == RX_NONE ) return RX_NONE;
+        kids.push_back( kid );
+    }
+
+    if ( kids.empty() ) return newNode( RX_EMPTY );
+    if ( kids.size() == 1 ) return kids[0];
+
+    size_t cat = newNode( RX_CAT );
+    nodes[cat].kids = kids;
+    return cat;
+}
+
+size_t TrpRxCompiler::parseRepeat( void ) {
+    size_t atom = parseAtom();
+    unsigned int min, max;
+
+    if ( atom == RX_NONE || pos == end ) return atom;
+
+    switch (peek()) {
+        case '*': min = 0; max = RX_INFINITE; pos++; break;
+        case '+': min = 1; max = RX_INFINITE; pos++; break;
+        case '?': min = 0; max = 1; pos++; break;
+        case '{':
+            if ( !parseBraces( min, max ) ) return RX_NONE;
+            break;
+        default:
+            return atom;
+    }
+
+    if ( pos < end && peek() == '?' ) pos++;
+    if ( pos < end && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{') )
+        return fail( "nothing to repeat" );
+
+    size_t repeat = newNode( RX_REPEAT );
+    nodes[repeat].kids.push_back( atom );
+    nodes[repeat].min = min;
+    nodes[repeat].max = max;
+    return repeat;
+}
+
+// {n} {n,} {n,m}
+bool TrpRxCompiler::parseBraces( unsigned int& min, unsigned int& max ) {
+    size_t start;
+
+    pos++;
+    start = pos;
+    for ( min = 0; pos < end && peek() >= '0' && peek() <= '9' && min <= RX_MAX_REPEAT; pos++ )
+        min = min * 10 + (peek() - '0');
+    if ( pos == start ) return failed( "bad {n,m} quantifier" );
+
+    max = min;
+    if ( pos < end && peek() == ',' ) {
+        pos++;
+        start = pos;
+        for ( max = 0; pos < end && peek() >= '0' && peek() <= '9' && max <= RX_MAX_REPEAT; pos++ )
+            max = max * 10 + (peek() - '0');
+        if ( pos == start ) max = RX_INFINITE;
+    }
+
+    if ( pos == end || peek() != '}' ) return failed( "bad {n,m} quantifier" );
+    pos++;
+
+    if ( min > RX_MAX_REPEAT || (max != RX_INFINITE && max > RX_MAX_REPEAT) )
+        return failed( "repeat count above 1000" );
+    if ( max < min ) return failed( "bad {n,m} quantifier: m < n" );
+    return true;
+}
+
+size_t TrpRxCompiler::parseAtom( void ) {
+    unsigned char c = peek();
+
+    switch (c) {
+        case '(': {
+            pos++;
+            if ( pos + 1 < end && peek() == '?' && pattern[pos + 1] == ':' ) pos += 2;
+            else if ( pos < end && peek() == '?' ) return fail( "lookaround and named groups are not supported" );
+
+            depth++;
+            size_t inner = parseAlt();
+            depth--;
+            if ( inner == RX_NONE ) return RX_NONE;
+            if ( pos == end || peek() != ')' ) return fail( "missing )" );
+            pos++;
+            return inner;
+        }
+        case '[':
+            return parseClass();
+        case '.': {
+            TrpByteSet set = asciiMask();
+            set.reset( '\n' );
+            set.reset( '\r' );
+            pos++;
+            return classNode( set, true );
+        }
+        case '\\':
+            return parseEscape();
+        case '^':
+            return fail( "^ is only supported at the start of the pattern" );
+        case '$':
+            return fail( "$ is only supported at the end of the pattern" );
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            return fail( "nothing to repeat" );
+        default:
+            break;
+    }
+
+    // a multibyte character is one atom, so a quantifier applies to all of it
+    size_t length = c < 0xc0 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+    if ( length == 1 ) {
+        pos++;
+        return newByte( c );
+    }
+
+    size_t cat = newNode( RX_CAT );
+    for ( size_t i = 0; i < length && pos < end; i++ ) {
+        size_t byte = newByte( peek() );
+        nodes[cat].kids.push_back( byte );
+        pos++;
+    }
+    return cat;
+}
+
+// Escapes that stand for one character, as a code point
+bool TrpRxCompiler::escapeValue( unsigned char escape, unsigned int& cp ) {
+    switch (escape) {
+        case 't': cp = '\t'; return true;
+        case 'n': cp = '\n'; return true;
+        case 'r': cp = '\r'; return true;
+        case 'f': cp = '\f'; return true;
+        case 'v': cp = '\v'; return true;
+        case '0': cp = 0; return true;
+        case 'x':
+        case 'u': {
+            size_t digits = escape == 'x' ? 2 : 4;
+            cp = 0;
+            for ( size_t i = 0; i < digits; i++, pos++ ) {
+                int value = pos < end ? hexValue( peek() ) : -1;
+                if ( value < 0 ) return failed( "bad \\x or \\u escape" );
+                cp = cp * 16 + value;
+            }
+            return true;
+        }
+        case 'b':
+        case 'B':
+            return failed( "\\b and \\B are not supported" );
+        default:
+            break;
+    }
+
+    if ( escape >= '1' && escape <= '9' ) return failed( "backreferences are not supported" );
+    if ( (escape >= '0' && escape <= '9') || ((escape | 0x20) >= 'a' && (escape | 0x20) <= 'z') )
+        return failed( "unknown escape" );
+    cp = escape;
+    return true;
+}
+
+// A code point as its UTF-8 bytes
+size_t TrpRxCompiler::literal( unsigned int cp ) {
+    unsigned char bytes[3];
+    size_t length = 0;
+
+    if ( cp < 0x80 ) return newByte( cp );
+    if ( cp < 0x800 ) {
+        bytes[length++] = 0xc0 | (cp >> 6);
+    } else {
+        bytes[length++] = 0xe0 | (cp >> 12);
+        bytes[length++] = 0x80 | ((cp >> 6) & 0x3f);
+    }
+    bytes[length++] = 0x80 | (cp & 0x3f);
+
+    size_t cat = newNode( RX_CAT );
+    for ( size_t i = 0; i < length; i++ ) {
+        size_t byte = newByte( bytes[i] );
+        nodes[cat].kids.push_back( byte );
+    }
+    return cat;
+}
+
+size_t TrpRxCompiler::parseEscape( void ) {
+    TrpByteSet set;
+    bool non_ascii = false;
+    unsigned int cp;
+
+    pos++;
+    if ( pos == end ) return fail( "trailing \\" );
+
+    unsigned char escape = peek();
+    pos++;
+    if ( classEscape( escape, set, non_ascii ) ) return classNode( set, non_ascii );
+    if ( !escapeValue( escape, cp ) ) return RX_NONE;
+    return literal( cp );
+}
+
+// Classes hold ASCII; "and every non-ASCII character" is a flag, for
+// negations and \D \W \S
+size_t TrpRxCompiler::parseClass( void ) {
+    TrpByteSet set;
+    bool non_ascii = false;
+    bool negate = false;
+
+    pos++;
+    if ( pos < end && peek() == '^' ) {
+        negate = true;
+        pos++;
+    }
+
+    while ( pos < end && peek() != ']' ) {
+        unsigned int lo, hi;
+
+        if ( peek() == '\\' ) {
+            pos++;
+            if ( pos == end ) break;
+            unsigned char escape = peek();
+            pos++;
+            if ( classEscape( escape, set, non_ascii ) ) continue;
+            if ( escape == 'b' ) lo = '\b';
+            else if ( !escapeValue( escape, lo ) ) return RX_NONE;
+        } else {
+            lo = peek();
+            pos++;
+        }
+
+        hi = lo;
+        if ( pos + 1 < end && peek() == '-' && pattern[pos + 1] != ']' ) {
+            pos++;
+            if ( peek() == '\\' ) {
+                pos++;
+                if ( pos == end ) break;
+                unsigned char escape = peek();
+                pos++;
+                if ( !escapeValue( escape, hi ) ) return fail( "bad class range" );
+            } else {
+                hi = peek();
+                pos++;
+            }
+            if ( hi < lo ) return fail( "bad class range" );
+        }
+
+        if ( hi >= 0x80 ) return fail( "non-ASCII characters in a class are not supported" );
+        set |= asciiRange( lo, hi );
+    }
+
+    if ( pos == end ) return fail( "missing ]" );
+    pos++;
+
+    if ( negate ) {
+        set = ~set & asciiMask();
+        non_ascii = !non_ascii;
+    }
+    return classNode( set, non_ascii );
+}
+
+// Any well-formed multibyte UTF-8 sequence
+size_t TrpRxCompiler::anyMultibyte( void ) {
+    static const unsigned int leads[3][2] = { { 0xc2, 0xdf }, { 0xe0, 0xef }, { 0xf0, 0xf4 } };
+    size_t alt = newNode( RX_ALT );
+
+    for ( size_t length = 0; length < 3; length++ ) {
+        size_t cat = newNode( RX_CAT );
+        size_t lead = newSet( asciiRange( leads[length][0], leads[length][1] ) );
+        nodes[cat].kids.push_back( lead );
+        for ( size_t i = 0; i <= length; i++ ) {
+            size_t tail = newSet( asciiRange( 0x80, 0xbf ) );
+            nodes[cat].kids.push_back( tail );
+        }
+        nodes[alt].kids.push_back( cat );
+    }
+    return alt;
+}
+
+size_t TrpRxCompiler::classNode( const TrpByteSet& ascii, bool non_ascii ) {
+    if ( !non_ascii ) return newSet( ascii );
+
+    size_t multibyte = anyMultibyte();
+    if ( ascii.none() ) return multibyte;
+
+    size_t alt = newNode( RX_ALT );
+    size_t single = newSet( ascii );
+    nodes[alt].kids.push_back( single );
+    nodes[alt].kids.push_back( multibyte );
+    return alt;
+}
+
+// Built back to front: returns the state that matches `node` then goes on
+// to `next`
+size_t TrpRxCompiler::emit( size_t node, size_t next ) {
+    if ( !error.empty() ) return next;
+
+    switch (nodes[node].kind) {
+        case RX_EMPTY:
+            return next;
+        case RX_SET:
+            return newState( RX_STATE_SET, next, 0, nodes[node].set );
+        case RX_CAT:
+            for ( size_t i = nodes[node].kids.size(); i-- > 0; ) next = emit( nodes[node].kids[i], next );
+            return next;
+        case RX_ALT: {
+            size_t first = emit( nodes[node].kids.back(), next );
+            for ( size_t i = nodes[node].kids.size() - 1; i-- > 0; ) {
+                size_t branch = emit( nodes[node].kids[i], next );
+                first = newState( RX_STATE_SPLIT, branch, first, 0 );
+            }
+            return first;
+        }
+        case RX_REPEAT: {
+            size_t kid = nodes[node].kids[0];
+            unsigned int min = nodes[node].min, max = nodes[node].max;
+            size_t tail = next;
+
+            if ( max == RX_INFINITE ) {
+                size_t loop = newState( RX_STATE_SPLIT, 0, next, 0 );
+                size_t body = emit( kid, loop );
+                states[loop].out = body;
+                tail = loop;
+            } else {
+                for ( unsigned int k = min; k < max && error.empty(); k++ ) {
+                    size_t body = emit( kid, tail );
+                    tail = newState( RX_STATE_SPLIT, body, tail, 0 );
+                }
+            }
+            for ( unsigned int k = 0; k < min && error.empty(); k++ ) tail = emit( kid, tail );
+            return tail;
+        }
+    }
+    return next;
+}
+
+// The SET and MATCH states reachable from `seeds` through splits, sorted
+static void closure( const std::vector<TrpRxState>& states, std::vector<size_t>& seeds,
+                     std::vector<unsigned int>& marks, unsigned int mark, std::vector<size_t>& out ) {
+    out.clear();
+    while ( !seeds.empty() ) {
+        size_t s = seeds.back();
+        seeds.pop_back();
+        if ( marks[s] == mark ) continue;
+        marks[s] = mark;
+
+        if ( states[s].type == RX_STATE_SPLIT ) {
+            seeds.push_back( states[s].out1 );
+            seeds.push_back( states[s].out );
+        } else {
+            out.push_back( s );
+        }
+    }
+    std::sort( out.begin(), out.end() );
+}
+
+TrpRegex::TrpRegex( void ) : class_count(0), start(0), dead(TRP_REGEX_NO_STATE), anchored_end(false) {}
+
+TrpRegex::TrpRegex( const std::string& pattern ) : class_count(0), start(0),
+    dead(TRP_REGEX_NO_STATE), anchored_end(false) {
+    compile( pattern );
+}
+
+// Subset construction over byte classes: bytes no set tells apart share a
+// column. Unanchored, the NFA start joins every step (a leading .*), and
+// without $ the first accepting state ends the search.
+bool TrpRegex::compile( const std::string& pattern ) {
+    size_t first = 0, last = pattern.size();
+
+    source = pattern;
+    error.clear();
+    table.clear();
+    accepting.clear();
+    class_count = 0;
+    dead = TRP_REGEX_NO_STATE;
+
+    bool anchored_start = last && pattern[0] == '^';
+    if ( anchored_start ) first = 1;
+
+    size_t escapes = 0;
+    while ( last >= 2 + escapes && pattern[last - 2 - escapes] == '\\' ) escapes++;
+    anchored_end = last > first && pattern[last - 1] == '$' && escapes % 2 == 0;
+    if ( anchored_end ) last--;
+
+    TrpRxCompiler rx( pattern, first, last, anchored_start || anchored_end );
+    size_t root = rx.parse();
+    if ( root != RX_NONE ) root = rx.emit( root, rx.matchState() );
+    if ( !rx.error.empty() ) {
+        error = rx.error;
+        return false;
+    }
+
+    std::map<std::string, unsigned int> signatures;
+    unsigned char representative[256];
+    for ( unsigned int byte = 0; byte < 256; byte++ ) {
+        std::string signature( rx.sets.size(), '0' );
+        for ( size_t i = 0; i < rx.sets.size(); i++ ) {
+            if ( rx.sets[i].test( byte ) ) signature[i] = '1';
+        }
+
+        std::map<std::string, unsigned int>::iterator found = signatures.find( signature );
+        if ( found == signatures.end() ) {
+            representative[class_count] = byte;
+            found = signatures.insert( std::make_pair( signature, class_count++ ) ).first;
+        }
+        classes[byte] = found->second;
+    }
+
+    std::map<std::vector<size_t>, unsigned int> ids;
+    std::vector<std::vector<size_t> > subsets;
+    std::vector<unsigned int> marks( rx.states.size(), 0 );
+    std::vector<size_t> seeds, subset;
+    unsigned int mark = 0;
+
+    seeds.push_back( root );
+    closure( rx.states, seeds, marks, ++mark, subset );
+    ids[subset] = 0;
+    subsets.push_back( subset );
+    start = 0;
+
+    for ( unsigned int d = 0; d < subsets.size(); d++ ) {
+        bool is_accepting = false;
+        for ( size_t i = 0; i < subsets[d].size(); i++ ) {
+            if ( rx.states[subsets[d][i]].type == RX_STATE_MATCH ) is_accepting = true;
+        }
+        accepting.push_back( is_accepting );
+        if ( subsets[d].empty() ) dead = d;
+        table.resize( (d + 1) * class_count, d );
+
+        // the search stops here, no need for the row
+        if ( is_accepting && !anchored_end ) continue;
+
+        for ( unsigned int c = 0; c < class_count; c++ ) {
+            for ( size_t i = 0; i < subsets[d].size(); i++ ) {
+                const TrpRxState& state = rx.states[subsets[d][i]];
+                if ( state.type == RX_STATE_SET && rx.sets[state.set].test( representative[c] ) )
+                    seeds.push_back( state.out );
+            }
+            if ( !anchored_start ) seeds.push_back( root );
+            closure( rx.states, seeds, marks, ++mark, subset );
+
+            std::map<std::vector<size_t>, unsigned int>::iterator found = ids.find( subset );
+            if ( found == ids.end() ) {
+                if ( subsets.size() == TRP_REGEX_MAX_STATES ) {
+                    error = "pattern needs too many DFA states";
+                    table.clear();
+                    accepting.clear();
+                    return false;
+                }
+                found = ids.insert( std::make_pair( subset, static_cast<unsigned int>(subsets.size()) ) ).first;
+                subsets.push_back( subset );
+            }
+            table[d * class_count + c] = found->second;
+        }
+    }
+
+    // rows by offset, saves the multiply per byte
+    for ( size_t i = 0; i < table.size(); i++ ) table[i] *= class_count;
+    if ( dead != TRP_REGEX_NO_STATE ) dead *= class_count;
+    return true;
+}
+
+// Accepting states (when not $-anchored) and the dead state loop on
+// themselves, so the walk only looks at them once per block of bytes. In
+// the start state the bytes that lead back to it are skipped first: those
+// lookups do not depend on each other, which is most of a search.
+bool TrpRegex::match( const char* data, size_t size ) const {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    unsigned int state = start;
+    size_t i = 0;
+
+    if ( table.empty() ) return false;
+
+    while ( i < size ) {
+        if ( state == start ) {
+            while ( i < size && table[start + classes[p[i]]] == start ) i++;
+            if ( i == size ) break;
+        }
+
+        size_t block = size - i < 16 ? size : i + 16;
+        for ( ; i < block; i++ ) state = table[state + classes[p[i]]];
+
+        if ( state == dead ) return false;
+        if ( !anchored_end && accepting[state / class_count] ) return true;
+    }
+    return accepting[state / class_count];
+}
@@ -1,4 +1,6 @@
 #include "../include/TrpSchemaArray.hpp"
+#include "../include/TrpJsonHash.hpp"
+#include "../include/TrpSchemaNumber.hpp"
 
 
 TrpSchemaArray::TrpSchemaArray( void ) : _item(NULL), _uniq(false),
@@ -33,129 +35,134 @@ TrpSchemaArray& TrpSchemaArray::tuple( SchemaVec& _schema_vec ) {
     return *this;
 }
 
-static std::string intToString( int nbr ) {
-    std::stringstream oss;
-    oss << nbr;
+bool TrpSchemaArray::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
+    if ( !ctx.isMemoEnabled() ) return validateItems( value, ctx );
 
-    return oss.str();
+    size_t hash;
+    if ( ctx.memoEnter( this, value, hash ) ) return true;
+    bool valid = validateItems( value, ctx );
+    ctx.memoLeave( this, value, hash, valid );
+    return valid;
 }
 
-bool TrpSchemaArray::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
-    bool got_error = false;
-
-    if ( !value || value->getType() != TRP_ARRAY ) {
-        ValidationError err;
+// Items [first, last) against the item schema. The whole array when not split.
+class TrpArrayItems : public TrpSplitBody {
+    private:
+        const TrpSchema* item;
+        TrpJsonArray* arr;
 
-        err.expected = SCHEMA_ARRAY;
-        err.actual = value ? value->getType() : TRP_NULL;
-        err.msg = "Expected array, found " + tokenTypeToString(err.actual);
-        err.path = ctx.getCurrentPath();
+    public:
+        TrpArrayItems( const TrpSchema* _item, TrpJsonArray* _arr ) : item(_item), arr(_arr) {}
 
-        ctx.pushError( err );
-        return false;
-    }
+        bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const {
+            bool got_error = false;
 
-    TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
-    if ( has_max && arr->size() > max_items ) {
-        ValidationError err;
+            if ( item->getType() == SCHEMA_NUMBER && !ctx.getProfiler() )
+                return static_cast<const TrpSchemaNumber*>(item)->validateItems( arr, first, last, ctx );
 
-        err.path = ctx.getCurrentPath();
-        std::stringstream ss;
-        ss << "Array must contain at most " << max_items << " items, but got " << arr->size();
-        err.msg = ss.str();
+            for ( size_t i = first; i < last; i++ ) {
+                if ( !((i - first) & 63) && ctx.isCancelled() ) break;
+                ctx.pushIndex(i);
+                if ( !item->validate( arr->at(i), ctx ) ) {
+                    if ( !got_error ) got_error = true;
+                }
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
 
-        ctx.pushError(err);
-        if ( !got_error ) got_error = true;
-    }
+            if ( got_error ) return false;
+            return true;
+        }
+};
 
-    if ( has_min && arr->size() < min_items ) {
-        ValidationError err;
+bool TrpSchemaArray::validateItems(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
+    bool got_error = false;
 
-        err.path = ctx.getCurrentPath();
-        std::stringstream ss;
-        ss << "Array must contain at least " << min_items << " items, but got " << arr->size();
-        err.msg = ss.str();
+    if ( !value || value->getType() != TRP_ARRAY ) {
+        ctx.pushTypeError( this, SCHEMA_ARRAY, value ? value->getType() : TRP_NULL );
+        return false;
+    }
 
-        ctx.pushError(err);
+    TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);
+    if ( !checkSize( arr->size(), ctx ) ) {
         if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
     }
 
     if ( _item ) {
-        for ( size_t i = 0; i < arr->size(); i++ ) {
-            ctx.pushPath("[" + intToString(i) + "]");
-            if ( !_item->validate( arr->at(i), ctx ) ) {
-                if ( !got_error ) got_error = true;
-            }
-            ctx.popPath();
+        TrpArrayItems items( _item, arr );
+        bool valid = ctx.shouldSplit( arr->size() )
+            ? ctx.split( items, arr->size() )
+            : items.validateRange( 0, arr->size(), ctx );
+
+        if ( !valid ) {
+            if ( !got_error ) got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
         }
     }
 
     if ( !_tuple.empty() ) {
-        if (arr->size() != _tuple.size()) {
-            ValidationError err;
-            err.path = ctx.getCurrentPath();
-            err.msg = "Tuple array must have exactly " + intToString(_tuple.size()) + 
-                    " items, but has " + intToString(arr->size());
-            ctx.pushError(err);
+        if ( !checkTupleSize( arr->size(), ctx ) ) {
             if ( !got_error ) got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
         } else {
             for ( size_t i = 0; i < _tuple.size() && i < arr->size(); i++ ) {
-                ctx.pushPath("[" + intToString(i) + "]");
+                ctx.pushIndex(i);
                 if ( !_tuple[i] || !_tuple[i]->validate(arr->at(i), ctx) ) {
                     if ( !got_error ) got_error = true;
                 }
                 ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
             }
         }
     }
 
-    if ( _uniq ) {
-        std::set<double> nbr_bucket;
-        std::set<std::string> str_bucket;
-        std::set<bool> bool_bucket;
-        bool null_found = false;
-
-        for ( size_t i = 0; i < arr->size(); i++ ) {
-            ITrpJsonValue* element = arr->at(i);
-            bool is_duplicate = false;
-
-            switch (element->getType()) {
-                case TRP_STRING:
-                    if (!str_bucket.insert(static_cast<TrpJsonString*>(element)->getValue()).second) {
-                        is_duplicate = true;
-                    }
-                    break;
-                case TRP_NUMBER:
-                    if (!nbr_bucket.insert(static_cast<TrpJsonNumber*>(element)->getValue()).second) {
-                        is_duplicate = true;
-                    }
-                    break;
-                case TRP_BOOL:
-                    if (!bool_bucket.insert(static_cast<TrpJsonBool*>(element)->getValue()).second) {
-                        is_duplicate = true;
-                    }
-                    break;
-                case TRP_NULL:
-                    if (null_found) is_duplicate = true;
-                    else null_found = true;
-                    break;
-                default:
-                    break;
-            }
+    if ( _uniq && !checkUniq( arr, ctx ) ) {
+        if ( !got_error ) got_error = true;
+    }
 
-            if (is_duplicate) {
-                ValidationError err;
+    if ( got_error ) return false;
+    return true;
+}
 
-                ctx.pushPath("[" + intToString(i) + "]");
-                err.path = ctx.getCurrentPath();
-                ctx.popPath();
-                err.msg = "Duplicate item found in array, Items must be unique";
-        
-                ctx.pushError(err);
-                if ( !got_error ) got_error = true;
-            }
-        }
+bool TrpSchemaArray::checkSize( size_t size, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
+
+    if ( has_max && size > max_items ) {
+        ctx.pushError( ERR_ARRAY_TOO_LONG, this, max_items, size );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if ( has_min && size < min_items ) {
+        ctx.pushError( ERR_ARRAY_TOO_SHORT, this, min_items, size );
+        if ( !got_error ) got_error = true;
     }
+
     if ( got_error ) return false;
     return true;
+}
+
+bool TrpSchemaArray::checkTupleSize( size_t size, TrpValidatorContext& ctx ) const {
+    if ( _tuple.empty() || size == _tuple.size() ) return true;
+
+    ctx.pushError( ERR_TUPLE_SIZE, this, _tuple.size(), size );
+    return false;
+}
+
+bool TrpSchemaArray::checkUniq( TrpJsonArray* arr, TrpValidatorContext& ctx ) const {
+    std::vector<size_t> duplicates;
+
+    if ( !trpJsonDuplicates( arr, duplicates ) ) return true;
+    for ( size_t i = 0; i < duplicates.size(); i++ ) {
+        reportDuplicate( duplicates[i], ctx );
+        if ( !ctx.shouldContinue() ) return false;
+    }
+    return false;
+}
+
+void TrpSchemaArray::reportDuplicate( size_t index, TrpValidatorContext& ctx ) const {
+    ctx.pushIndex(index);
+    ctx.pushError( ERR_DUPLICATE_ITEM, this, 0, index );
+    ctx.popPath();
 }
\ No newline at end of file
@@ -1,17 +1,26 @@
 #include "../include/TrpSchemaBool.hpp"
 
+TrpSchemaBool::TrpSchemaBool( void ) : has_const(false), const_value(false) {}
+
+TrpSchemaBool& TrpSchemaBool::constant( bool value ) {
+    has_const = true;
+    const_value = value;
+    return *this;
+}
+
 bool TrpSchemaBool::validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
     if (!value || value->getType() != TRP_BOOL ) {
-        ValidationError err;
+        ctx.pushTypeError( this, SCHEMA_BOOLEAN, value ? value->getType() : TRP_NULL );
+        return false;
+    }
 
-        err.expected = SCHEMA_BOOLEAN;
-        err.actual = value ? value->getType() : TRP_NULL;
-        err.msg = "Expected boolean, found " + tokenTypeToString(err.actual);
-        err.path = ctx.getCurrentPath();
+    return checkValue( static_cast<TrpJsonBool*>(value)->getValue(), ctx );
+}
 
-        ctx.pushError( err );
+bool TrpSchemaBool::checkValue( bool value, TrpValidatorContext& ctx ) const {
+    if ( has_const && value != const_value ) {
+        ctx.pushError( ERR_ENUM, this, 1, value );
         return false;
     }
-
     return true;
 }
\ No newline at end of file
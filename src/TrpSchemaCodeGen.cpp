@@ -0,0 +1,616 @@
+#include "../include/TrpSchemaCodeGen.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+
+// Small sets are a chain of compares, larger ones a lookup
+#define TRP_CODEGEN_CHAIN_MAX 8
+
+static const char* prelude =
+    "#include \"TrpSchema.hpp\"\n"
+    "#include <algorithm>\n"
+    "#include <cmath>\n"
+    "#include <cstring>\n"
+    "\n"
+    "// Same order as std::string::compare, against a literal\n"
+    "static inline int keyCompare( const std::string& key, const char* name, size_t size ) {\n"
+    "    int diff = std::memcmp( key.data(), name, key.size() < size ? key.size() : size );\n"
+    "\n"
+    "    if ( diff ) return diff;\n"
+    "    if ( key.size() == size ) return 0;\n"
+    "    return key.size() < size ? -1 : 1;\n"
+    "}\n"
+    "\n"
+    "// TrpSchemaNumber::isMultiple()\n"
+    "static inline bool isMultiple( double nbr, double multiple ) {\n"
+    "    double q = nbr / multiple;\n"
+    "    double scale = std::fabs( q ) > 1 ? std::fabs( q ) : 1;\n"
+    "\n"
+    "    return std::fabs( q - std::floor( q + 0.5 ) ) <= 1e-9 * scale;\n"
+    "}\n"
+    "\n"
+    "static inline TrpValueSet makeSet( const char* const* values, const size_t* sizes, size_t count ) {\n"
+    "    std::vector<std::string> list;\n"
+    "    TrpValueSet set;\n"
+    "\n"
+    "    for ( size_t i = 0; i < count; i++ ) list.push_back( std::string( values[i], sizes[i] ) );\n"
+    "    set.assign( list );\n"
+    "    return set;\n"
+    "}\n";
+
+// Octal escapes are always three digits, so a digit after one is not taken
+// in, and '?' is escaped against trigraphs
+static std::string quote( const std::string& value ) {
+    std::string out = "\"";
+
+    for ( size_t i = 0; i < value.size(); i++ ) {
+        unsigned char c = value[i];
+
+        if ( c == '"' || c == '\\' || c == '?' ) {
+            out += '\\';
+            out += c;
+        } else if ( c < 0x20 || c >= 0x7f ) {
+            char buf[5];
+            buf[0] = '\\';
+            buf[1] = '0' + (c >> 6);
+            buf[2] = '0' + ((c >> 3) & 7);
+            buf[3] = '0' + (c & 7);
+            buf[4] = 0;
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + '"';
+}
+
+// A comment must not end in a line splice or hide a trigraph
+static std::string commentSafe( const std::string& text ) {
+    std::string out = text;
+
+    for ( size_t i = 0; i < out.size(); i++ ) {
+        unsigned char c = out[i];
+        if ( c < 0x20 || c >= 0x7f || c == '\\' || c == '?' ) out[i] = '_';
+    }
+    return out;
+}
+
+// Round-trips through the compiler's strtod
+static std::string numberLiteral( double nbr ) {
+    if ( nbr == HUGE_VAL ) return "HUGE_VAL";
+    if ( nbr == -HUGE_VAL ) return "-HUGE_VAL";
+
+    std::ostringstream oss;
+    oss << std::setprecision( 17 ) << nbr;
+
+    std::string out = oss.str();
+    if ( out.find_first_of( ".e" ) == std::string::npos ) out += ".0";
+    return out;
+}
+
+static std::string sizeLiteral( size_t size ) {
+    std::ostringstream oss;
+
+    oss << size;
+    return oss.str();
+}
+
+static std::string function( size_t index ) {
+    return "v" + sizeLiteral( index );
+}
+
+// Whatever follows a failed check in the validators: go on only while the
+// context takes more errors
+static void fail( std::ostream& out, const std::string& indent, const std::string& push ) {
+    out << indent << "    ctx." << push << ";\n"
+        << indent << "    got_error = true;\n"
+        << indent << "    if ( !ctx.shouldContinue() ) return false;\n"
+        << indent << "}\n";
+}
+
+static void typeCheck( std::ostream& out, const char* json_type, const char* schema_type, const char* none ) {
+    out << "    if ( !value || value->getType() != " << json_type << " ) {\n"
+        << "        ctx.pushTypeError( " << schema_type << ", value ? value->getType() : " << none << " );\n"
+        << "        return false;\n"
+        << "    }\n";
+}
+
+TrpSchemaCodeGen::TrpSchemaCodeGen( void ) : constant_count(0) {}
+
+size_t TrpSchemaCodeGen::number( const TrpSchema* schema, const std::string& path ) {
+    std::map<const TrpSchema*, size_t>::iterator found = numbers.find( schema );
+    if ( found != numbers.end() ) return found->second;
+
+    numbers[schema] = nodes.size();
+    nodes.push_back( schema );
+    paths.push_back( path );
+    return nodes.size() - 1;
+}
+
+std::string TrpSchemaCodeGen::call( const TrpSchema* schema, const std::string& path, const std::string& value, const std::string& ctx ) {
+    return function( number( schema, path ) ) + "( " + value + ", " + ctx + " )";
+}
+
+// A namespace-scope string, so pushKey() and the error records can keep
+// its address
+std::string TrpSchemaCodeGen::stringConstant( const std::string& value ) {
+    std::map<std::string, std::string>::iterator found = strings.find( value );
+    if ( found != strings.end() ) return found->second;
+
+    std::string name = "s" + sizeLiteral( constant_count++ );
+    constants << "static const std::string " << name << "( " << quote( value ) << ", " << value.size() << " );\n";
+    strings[value] = name;
+    return name;
+}
+
+// Built at static initialization from the values; `set` is the same set
+// here, so its slots are the generated one's
+std::string TrpSchemaCodeGen::setConstant( const std::vector<std::string>& values, TrpValueSet& set ) {
+    std::string name = "set" + sizeLiteral( constant_count++ );
+
+    set.assign( values );
+    constants << "static const char* const " << name << "_values[] = {";
+    for ( size_t i = 0; i < set.size(); i++ ) constants << (i ? ", " : " ") << quote( set.at( i ) );
+    constants << " };\nstatic const size_t " << name << "_sizes[] = {";
+    for ( size_t i = 0; i < set.size(); i++ ) constants << (i ? ", " : " ") << set.at( i ).size();
+    constants << " };\nstatic const TrpValueSet " << name << " = makeSet( " << name << "_values, "
+        << name << "_sizes, " << set.size() << " );\n";
+    return name;
+}
+
+// The expression testing that the bytes [data, data + size) are in `values`
+std::string TrpSchemaCodeGen::enumTest( const TrpValueSet& values, const std::string& data, const std::string& size ) {
+    std::vector<std::string> list;
+    std::string out;
+
+    for ( size_t i = 0; i < values.size(); i++ ) list.push_back( values.at( i ) );
+    if ( list.size() > TRP_CODEGEN_CHAIN_MAX ) {
+        TrpValueSet set;
+        return setConstant( list, set ) + ".contains( " + data + ", " + size + " )";
+    }
+
+    for ( size_t i = 0; i < list.size(); i++ ) {
+        if ( i ) out += " || ";
+        out += "(" + size + " == " + sizeLiteral( list[i].size() );
+        if ( !list[i].empty() ) out += " && !std::memcmp( " + data + ", " + quote( list[i] ) + ", " + sizeLiteral( list[i].size() ) + " )";
+        out += ")";
+    }
+    return out.empty() ? "false" : out;
+}
+
+bool TrpSchemaCodeGen::generate( const TrpSchema& root, const std::string& name, std::ostream& out ) {
+    bool valid_name = !name.empty() && !std::isdigit( static_cast<unsigned char>(name[0]) );
+    for ( size_t i = 0; i < name.size(); i++ ) {
+        if ( !std::isalnum( static_cast<unsigned char>(name[i]) ) && name[i] != '_' ) valid_name = false;
+    }
+    if ( !valid_name ) {
+        error = "'" + name + "' is not a C++ identifier";
+        return false;
+    }
+
+    numbers.clear();
+    nodes.clear();
+    paths.clear();
+    strings.clear();
+    constants.str( "" );
+    functions.str( "" );
+    constant_count = 0;
+    error.clear();
+
+    // functions number the nodes they call, so the list grows while it is walked
+    number( &root, "$" );
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+        if ( !emitNode( i ) ) return false;
+    }
+
+    out << "// Generated by TrpSchemaCodeGen, do not edit\n" << prelude << '\n';
+    if ( constant_count ) out << constants.str() << '\n';
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+        out << "static bool " << function( i ) << "( ITrpJsonValue* value, TrpValidatorContext& ctx );\n";
+    }
+    out << '\n' << functions.str()
+        << "bool " << name << "( ITrpJsonValue* value, TrpValidatorContext& ctx ) {\n"
+        << "    return " << function( 0 ) << "( value, ctx );\n"
+        << "}\n";
+    return true;
+}
+
+// Checks after the type go to `body`, which declares got_error only when
+// there is one
+bool TrpSchemaCodeGen::emitNode( size_t index ) {
+    const TrpSchema* schema = nodes[index];
+    std::string path = paths[index];    // the list grows while this node calls others
+    std::ostringstream body;
+
+    functions << "// " << commentSafe( path ) << '\n'
+        << "static bool " << function( index ) << "( ITrpJsonValue* value, TrpValidatorContext& ctx ) {\n";
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING:
+            typeCheck( functions, "TRP_STRING", "SCHEMA_STRING", "TRP_NULL" );
+            emitString( *static_cast<const TrpSchemaString*>(schema), body );
+            break;
+        case SCHEMA_NUMBER:
+            typeCheck( functions, "TRP_NUMBER", "SCHEMA_NUMBER", "TRP_ERROR" );
+            emitNumber( *static_cast<const TrpSchemaNumber*>(schema), body );
+            break;
+        case SCHEMA_BOOLEAN:
+            typeCheck( functions, "TRP_BOOL", "SCHEMA_BOOLEAN", "TRP_NULL" );
+            emitBool( *static_cast<const TrpSchemaBool*>(schema), functions );
+            break;
+        case SCHEMA_NULL:
+            typeCheck( functions, "TRP_NULL", "SCHEMA_NULL", "TRP_NULL" );
+            break;
+        case SCHEMA_OBJECT:
+            typeCheck( functions, "TRP_OBJECT", "SCHEMA_OBJECT", "TRP_ERROR" );
+            emitObject( *static_cast<const TrpSchemaObject*>(schema), path, body );
+            break;
+        case SCHEMA_ARRAY:
+            typeCheck( functions, "TRP_ARRAY", "SCHEMA_ARRAY", "TRP_NULL" );
+            emitArray( *static_cast<const TrpSchemaArray*>(schema), path, body );
+            break;
+        case SCHEMA_UNION:
+            emitUnion( *static_cast<const TrpSchemaUnion*>(schema), path, functions );
+            functions << "}\n\n";
+            return true;
+        default:
+            error = "Cannot generate code for " + path + ": its schema type has no generated form";
+            return false;
+    }
+
+    if ( !body.str().empty() ) {
+        functions << body.str() << '\n' << "    return !got_error;\n";
+    } else {
+        functions << "    return true;\n";
+    }
+    functions << "}\n\n";
+    return true;
+}
+
+void TrpSchemaCodeGen::emitString( const TrpSchemaString& schema, std::ostream& out ) {
+    if ( !schema.hasMin() && !schema.hasMax() && schema.getFormat() == FORMAT_NONE
+        && !schema.hasPattern() && !schema.hasEnum() ) return;
+
+    out << "\n    const std::string& str = static_cast<TrpJsonString*>(value)->getValue();\n"
+        << "    bool got_error = false;\n";
+
+    if ( schema.hasMin() || schema.hasMax() ) {
+        out << "    size_t length = " << (schema.isCodePoints() ? "trpUtf8Length( str.data(), str.size() )" : "str.size()") << ";\n";
+    }
+    if ( schema.hasMax() ) {
+        std::string max = sizeLiteral( schema.getMax() );
+        out << "\n    if ( length > " << max << " ) {\n";
+        fail( out, "    ", "pushError( ERR_STRING_TOO_LONG, SCHEMA_STRING, " + max + ", length )" );
+    }
+    if ( schema.hasMin() ) {
+        std::string min = sizeLiteral( schema.getMin() );
+        out << "\n    if ( length < " << min << " ) {\n";
+        fail( out, "    ", "pushError( ERR_STRING_TOO_SHORT, SCHEMA_STRING, " + min + ", length )" );
+    }
+    if ( schema.getFormat() != FORMAT_NONE ) {
+        std::string format = sizeLiteral( schema.getFormat() );
+        out << "\n    if ( !trpCheckFormat( static_cast<TrpStringFormat>(" << format << "), str.data(), str.size() ) ) {\n";
+        fail( out, "    ", "pushError( ERR_STRING_FORMAT, SCHEMA_STRING, " + format + ", 0 )" );
+    }
+    if ( schema.hasPattern() ) {
+        const std::string& source = schema.getPattern().getSource();
+        std::string name = "pattern" + sizeLiteral( constant_count++ );
+
+        constants << "static const TrpRegex " << name << "( std::string( " << quote( source ) << ", " << source.size() << " ) );\n";
+        out << "\n    if ( !" << name << ".match( str ) ) {\n";
+        fail( out, "    ", "pushError( ERR_STRING_PATTERN, SCHEMA_STRING, " + stringConstant( source ) + " )" );
+    }
+    if ( schema.hasEnum() ) {
+        out << "\n    if ( !(" << enumTest( schema.getEnum(), "str.data()", "str.size()" ) << ") ) {\n";
+        fail( out, "    ", "pushError( ERR_ENUM, SCHEMA_STRING, " + sizeLiteral( schema.getEnum().size() ) + ", 0 )" );
+    }
+}
+
+// Enum values are the numbers' bytes: sorted for a binary search when
+// there are many, a chain of == otherwise, where -0 equals 0 as it does
+// for the schema
+void TrpSchemaCodeGen::emitNumber( const TrpSchemaNumber& schema, std::ostream& out ) {
+    if ( !schema.hasMin() && !schema.hasMax() && !schema.isInteger()
+        && !schema.getMultipleOf() && !schema.hasEnum() ) return;
+
+    out << "\n    double nbr = static_cast<TrpJsonNumber*>(value)->getValue();\n"
+        << "    bool got_error = false;\n";
+
+    if ( schema.hasMax() ) {
+        std::string max = numberLiteral( schema.getMax() );
+        if ( schema.isMaxExclusive() ) {
+            out << "\n    if ( nbr >= " << max << " ) {\n";
+            fail( out, "    ", "pushError( ERR_NUMBER_NOT_BELOW, SCHEMA_NUMBER, " + max + ", nbr )" );
+        } else {
+            out << "\n    if ( nbr > " << max << " ) {\n";
+            fail( out, "    ", "pushError( ERR_NUMBER_TOO_LARGE, SCHEMA_NUMBER, " + max + ", nbr )" );
+        }
+    }
+    if ( schema.hasMin() ) {
+        std::string min = numberLiteral( schema.getMin() );
+        if ( schema.isMinExclusive() ) {
+            out << "\n    if ( nbr <= " << min << " ) {\n";
+            fail( out, "    ", "pushError( ERR_NUMBER_NOT_ABOVE, SCHEMA_NUMBER, " + min + ", nbr )" );
+        } else {
+            out << "\n    if ( nbr < " << min << " ) {\n";
+            fail( out, "    ", "pushError( ERR_NUMBER_TOO_SMALL, SCHEMA_NUMBER, " + min + ", nbr )" );
+        }
+    }
+    if ( schema.isInteger() ) {
+        out << "\n    if ( nbr != std::floor( nbr ) ) {\n";
+        fail( out, "    ", "pushError( ERR_NUMBER_NOT_INTEGER, SCHEMA_NUMBER, 0, nbr )" );
+    }
+    if ( schema.getMultipleOf() ) {
+        std::string multiple = numberLiteral( schema.getMultipleOf() );
+        out << "\n    if ( !isMultiple( nbr, " << multiple << " ) ) {\n";
+        fail( out, "    ", "pushError( ERR_NUMBER_NOT_MULTIPLE, SCHEMA_NUMBER, " + multiple + ", nbr )" );
+    }
+    if ( schema.hasEnum() ) {
+        const TrpValueSet& values = schema.getEnum();
+        std::vector<double> list;
+        std::string test;
+
+        for ( size_t i = 0; i < values.size(); i++ ) {
+            std::string bytes = values.at( i );
+            double nbr = 0;
+
+            std::memcpy( &nbr, bytes.data(), std::min( bytes.size(), sizeof(nbr) ) );
+            list.push_back( nbr );
+        }
+        std::sort( list.begin(), list.end() );
+
+        if ( list.size() > TRP_CODEGEN_CHAIN_MAX ) {
+            std::string name = "enum" + sizeLiteral( constant_count++ );
+
+            constants << "static const double " << name << "[] = {";
+            for ( size_t i = 0; i < list.size(); i++ ) constants << (i ? ", " : " ") << numberLiteral( list[i] );
+            constants << " };\n";
+            test = "std::binary_search( " + name + ", " + name + " + " + sizeLiteral( list.size() ) + ", nbr )";
+        } else {
+            for ( size_t i = 0; i < list.size(); i++ ) test += (i ? " || nbr == " : "nbr == ") + numberLiteral( list[i] );
+        }
+        out << "\n    if ( !(" << (test.empty() ? "false" : test) << ") ) {\n";
+        fail( out, "    ", "pushError( ERR_ENUM, SCHEMA_NUMBER, " + sizeLiteral( values.size() ) + ", nbr )" );
+    }
+}
+
+void TrpSchemaCodeGen::emitBool( const TrpSchemaBool& schema, std::ostream& out ) {
+    if ( !schema.hasConst() ) return;
+
+    out << "\n    if ( " << (schema.getConst() ? "!" : "") << "static_cast<TrpJsonBool*>(value)->getValue() ) {\n"
+        << "        ctx.pushError( ERR_ENUM, SCHEMA_BOOLEAN, 1, " << (schema.getConst() ? 0 : 1) << " );\n"
+        << "        return false;\n"
+        << "    }\n";
+}
+
+// The merge walk of TrpSchemaObject::validateMembers(), unrolled: each
+// declared property skips the document's smaller keys, then is either the
+// next key or missing
+void TrpSchemaCodeGen::emitObject( const TrpSchemaObject& schema, const std::string& path, std::ostream& out ) {
+    const std::map<std::string, TrpSchema*>& properties = schema.getProperties();
+    const std::vector<bool>& required = schema.getRequiredMask();
+
+    if ( !schema.hasMin() && !schema.hasMax() && properties.empty() ) return;
+
+    out << "\n    TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);\n"
+        << "    bool got_error = false;\n";
+
+    if ( schema.hasMin() ) {
+        std::string min = sizeLiteral( schema.getMin() );
+        out << "\n    if ( obj->size() < " << min << " ) {\n";
+        fail( out, "    ", "pushError( ERR_OBJECT_TOO_SMALL, SCHEMA_OBJECT, " + min + ", obj->size() )" );
+    }
+    if ( schema.hasMax() ) {
+        std::string max = sizeLiteral( schema.getMax() );
+        out << "\n    if ( obj->size() > " << max << " ) {\n";
+        fail( out, "    ", "pushError( ERR_OBJECT_TOO_LARGE, SCHEMA_OBJECT, " + max + ", obj->size() )" );
+    }
+    if ( properties.empty() ) return;
+
+    out << "\n    JsonObjectMap::const_iterator it = obj->begin();\n"
+        << "    JsonObjectMap::const_iterator end = obj->end();\n"
+        << "    int diff = 0;\n";
+
+    std::map<std::string, TrpSchema*>::const_iterator it = properties.begin();
+    for ( size_t index = 0; it != properties.end(); it++, index++ ) {
+        std::string key = stringConstant( it->first );
+
+        out << "\n    while ( it != end && (diff = keyCompare( it->first, " << quote( it->first ) << ", "
+            << it->first.size() << " )) < 0 ) it++;\n"
+            << "    if ( it != end && !diff ) {\n"
+            << "        ctx.pushKey( " << key << " );\n";
+        if ( it->second ) out << "        if ( !" << call( it->second, path + "." + it->first, "it->second", "ctx" ) << " ) got_error = true;\n";
+        else out << "        got_error = true;\n";
+        out << "        ctx.popPath();\n"
+            << "        it++;\n"
+            << "        if ( got_error && !ctx.shouldContinue() ) return false;\n"
+            << "    }";
+        if ( required[index] ) {
+            out << " else {\n";
+            fail( out, "    ", "pushError( ERR_MISSING_PROPERTY, SCHEMA_OBJECT, " + key + " )" );
+        } else {
+            out << '\n';
+        }
+    }
+}
+
+void TrpSchemaCodeGen::emitArray( const TrpSchemaArray& schema, const std::string& path, std::ostream& out ) {
+    const SchemaVec& tuple = schema.getTuple();
+
+    if ( !schema.hasMin() && !schema.hasMax() && !schema.getItem() && tuple.empty() && !schema.isUniq() ) return;
+
+    out << "\n    TrpJsonArray* arr = static_cast<TrpJsonArray*>(value);\n"
+        << "    bool got_error = false;\n";
+
+    if ( schema.hasMax() ) {
+        std::string max = sizeLiteral( schema.getMax() );
+        out << "\n    if ( arr->size() > " << max << " ) {\n";
+        fail( out, "    ", "pushError( ERR_ARRAY_TOO_LONG, SCHEMA_ARRAY, " + max + ", arr->size() )" );
+    }
+    if ( schema.hasMin() ) {
+        std::string min = sizeLiteral( schema.getMin() );
+        out << "\n    if ( arr->size() < " << min << " ) {\n";
+        fail( out, "    ", "pushError( ERR_ARRAY_TOO_SHORT, SCHEMA_ARRAY, " + min + ", arr->size() )" );
+    }
+
+    if ( schema.getItem() ) {
+        out << "\n    for ( size_t i = 0; i < arr->size(); i++ ) {\n"
+            << "        ctx.pushIndex( i );\n"
+            << "        if ( !" << call( schema.getItem(), path + "[]", "arr->at( i )", "ctx" ) << " ) got_error = true;\n"
+            << "        ctx.popPath();\n"
+            << "        if ( got_error && !ctx.shouldContinue() ) return false;\n"
+            << "    }\n";
+    }
+
+    if ( !tuple.empty() ) {
+        std::string size = sizeLiteral( tuple.size() );
+
+        out << "\n    if ( arr->size() != " << size << " ) {\n"
+            << "        ctx.pushError( ERR_TUPLE_SIZE, SCHEMA_ARRAY, " << size << ", arr->size() );\n"
+            << "        got_error = true;\n"
+            << "        if ( !ctx.shouldContinue() ) return false;\n"
+            << "    } else {\n";
+        for ( size_t i = 0; i < tuple.size(); i++ ) {
+            std::string slot = sizeLiteral( i );
+
+            out << (i ? "\n" : "") << "        ctx.pushIndex( " << slot << " );\n";
+            if ( tuple[i] ) out << "        if ( !" << call( tuple[i], path + "[" + slot + "]", "arr->at( " + slot + " )", "ctx" ) << " ) got_error = true;\n";
+            else out << "        got_error = true;\n";
+            out << "        ctx.popPath();\n"
+                << "        if ( got_error && !ctx.shouldContinue() ) return false;\n";
+        }
+        out << "    }\n";
+    }
+
+    if ( schema.isUniq() ) {
+        out << "\n    std::vector<size_t> duplicates;\n"
+            << "    if ( trpJsonDuplicates( arr, duplicates ) ) {\n"
+            << "        got_error = true;\n"
+            << "        for ( size_t i = 0; i < duplicates.size(); i++ ) {\n"
+            << "            ctx.pushIndex( duplicates[i] );\n"
+            << "            ctx.pushError( ERR_DUPLICATE_ITEM, SCHEMA_ARRAY, 0, duplicates[i] );\n"
+            << "            ctx.popPath();\n"
+            << "            if ( !ctx.shouldContinue() ) return false;\n"
+            << "        }\n"
+            << "    }\n";
+    }
+}
+
+// TrpSchemaUnion::tryBranches(): each candidate into a fail-fast scratch
+// context, anyOf done at the first match, oneOf at the second
+void TrpSchemaCodeGen::emitTrial( const TrpSchemaUnion& schema, const std::vector<size_t>& candidates,
+    const std::string& path, const std::string& indent, std::ostream& out ) {
+    const std::vector<TrpSchema*>& branches = schema.getBranches();
+    bool any_of = schema.getMode() == UNION_ANY_OF;
+
+    if ( !any_of ) out << indent << "size_t matches = 0;\n";
+    for ( size_t i = 0; i < candidates.size(); i++ ) {
+        std::string test = call( branches[candidates[i]], path, "value", "scratch" );
+
+        out << '\n' << indent << (!any_of && i >= 2 ? "if ( matches < 2 ) {\n" : "{\n")
+            << indent << "    TrpValidatorContext scratch( true );\n"
+            << indent << "    if ( " << test << " ) " << (any_of ? "return true;\n" : "matches++;\n")
+            << indent << "}\n";
+    }
+
+    out << '\n';
+    if ( !any_of ) {
+        out << indent << "if ( matches == 1 ) return true;\n"
+            << indent << "if ( matches ) ctx.pushError( ERR_UNION_AMBIGUOUS, SCHEMA_UNION );\n"
+            << indent << "else ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, " << candidates.size() << " );\n";
+    } else {
+        out << indent << "ctx.pushError( ERR_UNION_NO_MATCH, SCHEMA_UNION, " << candidates.size() << " );\n";
+    }
+    out << indent << "return false;\n";
+}
+
+// TrpSchemaUnion::pick() settled at generation time: a case per JSON type
+// that has candidates, the discriminator's tags compared in the object case
+void TrpSchemaCodeGen::emitUnion( const TrpSchemaUnion& schema, const std::string& path, std::ostream& out ) {
+    const std::vector<TrpSchema*>& branches = schema.getBranches();
+    const std::vector<std::string>& tags = schema.getTags();
+    static const char* type_names[TRP_UNION_TYPES] = {
+        "TRP_NULL", "TRP_BOOL", "TRP_NUMBER", "TRP_STRING", "TRP_ARRAY", "TRP_OBJECT"
+    };
+    unsigned int mask = 0;
+
+    out << "    TrpJsonType type = value ? value->getType() : TRP_ERROR;\n\n"
+        << "    switch (type) {\n";
+
+    for ( size_t t = 0; t < TRP_UNION_TYPES; t++ ) {
+        const std::vector<size_t>& candidates = schema.getCandidates( static_cast<TrpJsonType>(t) );
+        bool tagged = t == TRP_OBJECT && schema.isTagged();
+
+        if ( candidates.empty() && !tagged ) continue;
+        mask |= 1u << t;
+
+        if ( !tagged && candidates.size() == 1 ) {
+            out << "        case " << type_names[t] << ":\n"
+                << "            return " << call( branches[candidates[0]], path, "value", "ctx" ) << ";\n";
+            continue;
+        }
+
+        out << "        case " << type_names[t] << ": {\n";
+        if ( tagged ) {
+            // tags are unique, branch() refuses a repeat
+            std::map<std::string, size_t> by_tag;
+            for ( size_t i = 0; i < branches.size(); i++ ) {
+                if ( !tags[i].empty() ) by_tag[tags[i]] = i;
+            }
+
+            std::string key = stringConstant( schema.getDiscriminator() );
+            out << "            ITrpJsonValue* tag = static_cast<TrpJsonObject*>(value)->find( " << key << " );\n\n"
+                << "            if ( tag && tag->getType() == TRP_STRING ) {\n"
+                << "                const std::string& name = static_cast<TrpJsonString*>(tag)->getValue();\n";
+
+            if ( by_tag.size() > TRP_CODEGEN_CHAIN_MAX ) {
+                std::vector<std::string> values;
+                TrpValueSet set;
+
+                for ( std::map<std::string, size_t>::const_iterator it = by_tag.begin(); it != by_tag.end(); it++ ) values.push_back( it->first );
+                std::string name = setConstant( values, set );
+                out << "                size_t slot;\n\n"
+                    << "                if ( " << name << ".find( name.data(), name.size(), slot ) ) {\n"
+                    << "                    switch (slot) {\n";
+                for ( size_t slot = 0; slot < set.size(); slot++ ) {
+                    out << "                        case " << slot << ": return "
+                        << call( branches[by_tag[set.at( slot )]], path, "value", "ctx" ) << ";\n";
+                }
+                out << "                    }\n"
+                    << "                }\n";
+            } else {
+                for ( std::map<std::string, size_t>::const_iterator it = by_tag.begin(); it != by_tag.end(); it++ ) {
+                    TrpValueSet one;
+                    one.assign( std::vector<std::string>( 1, it->first ) );
+                    out << "                if ( " << enumTest( one, "name.data()", "name.size()" ) << " ) return "
+                        << call( branches[it->second], path, "value", "ctx" ) << ";\n";
+                }
+            }
+            out << "            }\n";
+
+            if ( candidates.empty() ) {
+                out << "            if ( tag ) ctx.pushError( ERR_UNION_TAG, SCHEMA_UNION, " << key << " );\n"
+                    << "            else ctx.pushError( ERR_MISSING_PROPERTY, SCHEMA_UNION, " << key << " );\n"
+                    << "            return false;\n"
+                    << "        }\n";
+                continue;
+            }
+            if ( candidates.size() == 1 ) {
+                out << "            return " << call( branches[candidates[0]], path, "value", "ctx" ) << ";\n"
+                    << "        }\n";
+                continue;
+            }
+            out << '\n';
+        }
+        emitTrial( schema, candidates, path, "            ", out );
+        out << "        }\n";
+    }
+
+    out << "        default:\n"
+        << "            break;\n"
+        << "    }\n\n"
+        << "    ctx.pushError( ERR_UNION_TYPE, SCHEMA_UNION, " << mask << ", type );\n"
+        << "    return false;\n";
+}
@@ -1,43 +1,224 @@
 #include "../include/TrpSchemaFactory.hpp"
+#include <cstdlib>
+
+// Enough for every member of the schema classes (size_t, double, pointers)
+#define TRP_ARENA_ALIGN 16
+
+TrpSchemaFactory::TrpSchemaFactory( void ) : mode(FACTORY_HEAP),
+    block_size(TRP_ARENA_BLOCK), current(0), used(0) {}
+
+TrpSchemaFactory::TrpSchemaFactory( TrpFactoryMode _mode, size_t _block_size ) : mode(_mode),
+    block_size(_block_size ? _block_size : TRP_ARENA_BLOCK), current(0), used(0) {}
 
 TrpSchemaFactory::~TrpSchemaFactory() {
+    release();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        std::free(blocks[i]);
+    }
+}
+
+// Schemas are laid out in creation order, so a parent sits right before the
+// children built in its fluent chain.
+void* TrpSchemaFactory::allocate( size_t size ) {
+    size = (size + TRP_ARENA_ALIGN - 1) & ~static_cast<size_t>(TRP_ARENA_ALIGN - 1);
+
+    while ( current < blocks.size() && used + size > block_size ) {
+        current++;
+        used = 0;
+    }
+
+    if ( current == blocks.size() ) {
+        char* block = static_cast<char*>(std::malloc(size > block_size ? size : block_size));
+        if ( !block ) throw std::bad_alloc();
+        blocks.push_back(block);
+        used = 0;
+    }
+
+    void* ptr = blocks[current] + used;
+    used += size;
+    return ptr;
+}
+
+// One destructor per schema either way: it frees what the members hold
+// (maps, vectors, strings, compiled patterns and value sets live on the
+// heap). Only the nodes themselves go back with the arena blocks.
+void TrpSchemaFactory::release( void ) {
     for (size_t i = 0; i < _managedSchemas.size(); ++i) {
-        delete _managedSchemas[i];
+        if ( mode == FACTORY_ARENA ) _managedSchemas[i]->~TrpSchema();
+        else delete _managedSchemas[i];
     }
+    _managedSchemas.clear();
+}
+
+void TrpSchemaFactory::reset( void ) {
+    release();
+    interned.clear();
+    current = 0;
+    used = 0;
 }
 
 TrpSchemaString& TrpSchemaFactory::string() {
-    TrpSchemaString* schema = new TrpSchemaString();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaString>();
 }
 
 TrpSchemaNumber& TrpSchemaFactory::number() {
-    TrpSchemaNumber* schema = new TrpSchemaNumber();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaNumber>();
 }
 
 TrpSchemaBool& TrpSchemaFactory::boolean() {
-    TrpSchemaBool* schema = new TrpSchemaBool();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaBool>();
+}
+
+TrpSchemaUnion& TrpSchemaFactory::anyOf() {
+    return create<TrpSchemaUnion>();
+}
+
+TrpSchemaUnion& TrpSchemaFactory::oneOf() {
+    TrpSchemaUnion& schema = create<TrpSchemaUnion>();
+    schema.mode = UNION_ONE_OF;
+    return schema;
 }
 
 TrpSchemaObject& TrpSchemaFactory::object() {
-    TrpSchemaObject* schema = new TrpSchemaObject();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaObject>();
 }
 
 TrpSchemaArray& TrpSchemaFactory::array() {
-    TrpSchemaArray* schema = new TrpSchemaArray();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaArray>();
 }
 
 TrpSchemaNull& TrpSchemaFactory::null() {
-    TrpSchemaNull* schema = new TrpSchemaNull();
-    _managedSchemas.push_back(schema);
-    return *schema;
+    return create<TrpSchemaNull>();
+}
+
+template <typename T>
+static void appendRaw( std::string& sig, const T& value ) {
+    sig.append( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+// Bounds only count when set, the unset fields are uninitialized
+static void appendBounds( std::string& sig, bool has_min, size_t min_value, bool has_max, size_t max_value ) {
+    sig += static_cast<char>((has_min ? 1 : 0) | (has_max ? 2 : 0));
+    if ( has_min ) appendRaw( sig, min_value );
+    if ( has_max ) appendRaw( sig, max_value );
+}
+
+static void appendKey( std::string& sig, const std::string& key ) {
+    appendRaw( sig, key.size() );
+    sig += key;
+}
+
+// Slot order only depends on the set, equal sets list the same way
+static void appendEnum( std::string& sig, bool has_enum, const TrpValueSet& values ) {
+    sig += static_cast<char>(has_enum);
+    appendRaw( sig, values.size() );
+    for ( size_t i = 0; i < values.size(); i++ ) appendKey( sig, values.at( i ) );
+}
+
+// Children are interned first, so a parent's signature can name them by
+// address: two subtrees are identical iff their roots get the same one.
+// `seen` maps visited nodes to their canonical node, NULL while in
+// progress; meeting one of those means a cycle, and `open` tells the
+// callers to keep themselves out of the table.
+TrpSchema* TrpSchemaFactory::internNode( TrpSchema* schema, std::map<TrpSchema*, TrpSchema*>& seen, bool& open ) {
+    if ( !schema ) return NULL;
+
+    std::map<TrpSchema*, TrpSchema*>::iterator found = seen.find( schema );
+    if ( found != seen.end() ) {
+        if ( found->second ) return found->second;
+        open = true;
+        return schema;
+    }
+    seen[schema] = NULL;
+
+    bool child_open = false;
+    std::string sig;
+    sig += static_cast<char>(schema->getType());
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING: {
+            TrpSchemaString* str = static_cast<TrpSchemaString*>(schema);
+            appendBounds( sig, str->hasMin(), str->getMin(), str->hasMax(), str->getMax() );
+            sig += static_cast<char>(str->isCodePoints());
+            sig += static_cast<char>(str->getFormat());
+            sig += static_cast<char>(str->hasPattern());
+            if ( str->hasPattern() ) appendKey( sig, str->getPattern().getSource() );
+            appendEnum( sig, str->hasEnum(), str->getEnum() );
+            break;
+        }
+        case SCHEMA_NUMBER: {
+            TrpSchemaNumber* nbr = static_cast<TrpSchemaNumber*>(schema);
+
+            // the bounds as given, not getRange(): exclusiveMin(5) and
+            // min(nextafter(5)) accept the same numbers but report differently
+            sig += static_cast<char>((nbr->hasMin() ? 1 : 0) | (nbr->hasMax() ? 2 : 0)
+                | (nbr->isMinExclusive() ? 4 : 0) | (nbr->isMaxExclusive() ? 8 : 0) | (nbr->isInteger() ? 16 : 0));
+            if ( nbr->hasMin() ) appendRaw( sig, nbr->getMin() );
+            if ( nbr->hasMax() ) appendRaw( sig, nbr->getMax() );
+            appendRaw( sig, nbr->getMultipleOf() );
+            appendEnum( sig, nbr->hasEnum(), nbr->getEnum() );
+            break;
+        }
+        case SCHEMA_BOOLEAN: {
+            TrpSchemaBool* bl = static_cast<TrpSchemaBool*>(schema);
+            sig += static_cast<char>((bl->hasConst() ? 1 : 0) | (bl->getConst() ? 2 : 0));
+            break;
+        }
+        case SCHEMA_NULL:
+            break;
+        case SCHEMA_OBJECT: {
+            TrpSchemaObject* obj = static_cast<TrpSchemaObject*>(schema);
+            std::map<std::string, TrpSchema*>::iterator it;
+
+            appendBounds( sig, obj->has_min, obj->min_items, obj->has_max, obj->max_items );
+            for ( it = obj->properties.begin(); it != obj->properties.end(); it++ ) {
+                it->second = internNode( it->second, seen, child_open );
+                appendKey( sig, it->first );
+                appendRaw( sig, it->second );
+            }
+            // in declaration order, which is the order errors come out in
+            sig += '\0';
+            for ( size_t i = 0; i < obj->required_entries.size(); i++ )
+                appendKey( sig, obj->required_entries[i] );
+            break;
+        }
+        case SCHEMA_ARRAY: {
+            TrpSchemaArray* arr = static_cast<TrpSchemaArray*>(schema);
+
+            appendBounds( sig, arr->has_min, arr->min_items, arr->has_max, arr->max_items );
+            sig += static_cast<char>(arr->_uniq);
+            arr->_item = internNode( arr->_item, seen, child_open );
+            appendRaw( sig, arr->_item );
+            for ( size_t i = 0; i < arr->_tuple.size(); i++ ) {
+                arr->_tuple[i] = internNode( arr->_tuple[i], seen, child_open );
+                appendRaw( sig, arr->_tuple[i] );
+            }
+            break;
+        }
+        case SCHEMA_UNION: {
+            TrpSchemaUnion* uni = static_cast<TrpSchemaUnion*>(schema);
+
+            sig += static_cast<char>(uni->mode);
+            appendKey( sig, uni->key );
+            for ( size_t i = 0; i < uni->branches.size(); i++ ) {
+                uni->branches[i] = internNode( uni->branches[i], seen, child_open );
+                appendKey( sig, uni->tags[i] );
+                appendRaw( sig, uni->branches[i] );
+            }
+            break;
+        }
+        default:
+            seen[schema] = schema;
+            return schema;
+    }
+
+    if ( child_open ) {
+        open = true;
+        seen[schema] = schema;
+        return schema;
+    }
+
+    TrpSchema* canonical = interned.insert( std::make_pair( sig, schema ) ).first->second;
+    seen[schema] = canonical;
+    return canonical;
 }
@@ -0,0 +1,320 @@
+#include "../include/TrpSchemaLoader.hpp"
+#include <cmath>
+#include <sstream>
+
+TrpSchemaLoader::TrpSchemaLoader( TrpSchemaFactory& _factory ) : factory(_factory) {}
+
+TrpSchema* TrpSchemaLoader::loadFile( const std::string& file_name ) {
+    TrpJsonParser parser( file_name );
+
+    error.clear();
+    if ( !parser.parse() ) {
+        const token& err = parser.getLastError();
+        std::ostringstream oss;
+
+        oss << file_name << ":" << err.line << ":" << err.col << ": " << err.value;
+        error = oss.str();
+        return NULL;
+    }
+    return load( parser.getAST() );
+}
+
+TrpSchema* TrpSchemaLoader::load( ITrpJsonValue* document ) {
+    error.clear();
+    return loadSchema( document, "" );
+}
+
+TrpSchema* TrpSchemaLoader::fail( const std::string& path, const std::string& message ) {
+    error = (path.empty() ? "/" : path) + ": " + message;
+    return NULL;
+}
+
+// RFC 6901: '~' is written as "~0" and '/' as "~1"
+static std::string pointerTo( const std::string& path, const std::string& key ) {
+    std::string out = path + '/';
+
+    for ( size_t i = 0; i < key.size(); i++ ) {
+        if ( key[i] == '~' ) out += "~0";
+        else if ( key[i] == '/' ) out += "~1";
+        else out += key[i];
+    }
+    return out;
+}
+
+static std::string pointerTo( const std::string& path, size_t index ) {
+    std::ostringstream oss;
+
+    oss << path << '/' << index;
+    return oss.str();
+}
+
+static const char* keywords[] = {
+    "type", "properties", "required", "minProperties", "maxProperties",
+    "items", "additionalItems", "minItems", "maxItems", "uniqueItems",
+    "minLength", "maxLength",
+    "pattern",
+    "minimum", "maximum", "exclusiveMinimum", "exclusiveMaximum", "multipleOf",
+    "additionalProperties",
+    // annotations, nothing to validate
+    "$schema", "$id", "id", "$comment", "title", "description", "default",
+    "examples", "deprecated", "readOnly", "writeOnly", "$defs", "definitions"
+};
+
+bool TrpSchemaLoader::checkKeywords( TrpJsonObject* obj, const std::string& path ) {
+    for ( JsonObjectMap::const_iterator it = obj->begin(); it != obj->end(); it++ ) {
+        size_t i = 0;
+
+        while ( i < sizeof(keywords) / sizeof(keywords[0]) && it->first != keywords[i] ) i++;
+        if ( i == sizeof(keywords) / sizeof(keywords[0]) ) {
+            fail( path, "unsupported keyword '" + it->first + "'" );
+            return false;
+        }
+    }
+
+    ITrpJsonValue* extra = obj->find( "additionalProperties" );
+    if ( extra && (extra->getType() != TRP_BOOL || !static_cast<TrpJsonBool*>(extra)->getValue()) ) {
+        fail( pointerTo( path, "additionalProperties" ), "only true is supported" );
+        return false;
+    }
+    return true;
+}
+
+bool TrpSchemaLoader::readNumber( TrpJsonObject* obj, const char* keyword, bool& found, double& nbr, const std::string& path ) {
+    ITrpJsonValue* value = obj->find( keyword );
+
+    found = value != NULL;
+    if ( !value ) return true;
+    if ( value->getType() != TRP_NUMBER ) {
+        fail( pointerTo( path, keyword ), "must be a number" );
+        return false;
+    }
+    nbr = static_cast<TrpJsonNumber*>(value)->getValue();
+    return true;
+}
+
+bool TrpSchemaLoader::readCount( TrpJsonObject* obj, const char* keyword, bool& found, size_t& count, const std::string& path ) {
+    double nbr = 0;
+
+    if ( !readNumber( obj, keyword, found, nbr, path ) ) return false;
+    if ( !found ) return true;
+    if ( nbr < 0 || nbr != std::floor( nbr ) || nbr > 4294967295.0 ) {
+        fail( pointerTo( path, keyword ), "must be a non-negative integer" );
+        return false;
+    }
+    count = static_cast<size_t>(nbr);
+    return true;
+}
+
+TrpSchema* TrpSchemaLoader::loadSchema( ITrpJsonValue* value, const std::string& path ) {
+    if ( !value || value->getType() != TRP_OBJECT ) return fail( path, "expected a schema object" );
+
+    TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
+    if ( !checkKeywords( obj, path ) ) return NULL;
+
+    ITrpJsonValue* type = obj->find( "type" );
+    if ( !type ) return fail( path, "missing 'type'" );
+    if ( type->getType() == TRP_STRING ) return loadType( static_cast<TrpJsonString*>(type)->getValue(), obj, path );
+
+    std::string type_path = pointerTo( path, "type" );
+    if ( type->getType() != TRP_ARRAY || !static_cast<TrpJsonArray*>(type)->size() )
+        return fail( type_path, "must be a type name or a non-empty array of them" );
+
+    // a branch per type; the other keywords apply to the branch of their type
+    TrpJsonArray* types = static_cast<TrpJsonArray*>(type);
+    std::vector<TrpSchema*> branches;
+    for ( size_t i = 0; i < types->size(); i++ ) {
+        ITrpJsonValue* name = types->at( i );
+
+        if ( name->getType() != TRP_STRING ) return fail( pointerTo( type_path, i ), "must be a type name" );
+        for ( size_t j = 0; j < i; j++ ) {
+            if ( static_cast<TrpJsonString*>(types->at( j ))->getValue() == static_cast<TrpJsonString*>(name)->getValue() )
+                return fail( pointerTo( type_path, i ), "repeated type" );
+        }
+
+        TrpSchema* branch = loadType( static_cast<TrpJsonString*>(name)->getValue(), obj, path );
+        if ( !branch ) return NULL;
+        branches.push_back( branch );
+    }
+    if ( branches.size() == 1 ) return branches[0];
+
+    TrpSchemaUnion& schema = factory.anyOf();
+    for ( size_t i = 0; i < branches.size(); i++ ) schema.branch( branches[i] );
+    return &schema;
+}
+
+TrpSchema* TrpSchemaLoader::loadType( const std::string& type, TrpJsonObject* obj, const std::string& path ) {
+    if ( type == "string" ) {
+        TrpSchemaString& schema = factory.string();
+        return loadString( schema, obj, path ) ? &schema : NULL;
+    }
+    if ( type == "number" || type == "integer" ) {
+        TrpSchemaNumber& schema = factory.number();
+        if ( type == "integer" ) schema.integer();
+        return loadNumber( schema, obj, path ) ? &schema : NULL;
+    }
+    if ( type == "object" ) {
+        TrpSchemaObject& schema = factory.object();
+        return loadObject( schema, obj, path ) ? &schema : NULL;
+    }
+    if ( type == "array" ) {
+        TrpSchemaArray& schema = factory.array();
+        return loadArray( schema, obj, path ) ? &schema : NULL;
+    }
+    if ( type == "boolean" ) return &factory.boolean();
+    if ( type == "null" ) return &factory.null();
+    return fail( pointerTo( path, "type" ), "unknown type '" + type + "'" );
+}
+
+bool TrpSchemaLoader::loadString( TrpSchemaString& schema, TrpJsonObject* obj, const std::string& path ) {
+    bool found;
+    size_t count = 0;
+
+    if ( !readCount( obj, "minLength", found, count, path ) ) return false;
+    if ( found ) schema.min( count );
+    if ( !readCount( obj, "maxLength", found, count, path ) ) return false;
+    if ( found ) schema.max( count );
+
+    ITrpJsonValue* pattern = obj->find( "pattern" );
+    if ( pattern ) {
+        if ( pattern->getType() != TRP_STRING ) {
+            fail( pointerTo( path, "pattern" ), "must be a string" );
+            return false;
+        }
+        schema.pattern( static_cast<TrpJsonString*>(pattern)->getValue() );
+        if ( schema.hasPatternError() ) {
+            fail( pointerTo( path, "pattern" ), schema.getPattern().getError() );
+            return false;
+        }
+    }
+    return true;
+}
+
+// Both bounds of a side apply, so only the stricter one is kept
+bool TrpSchemaLoader::loadNumber( TrpSchemaNumber& schema, TrpJsonObject* obj, const std::string& path ) {
+    bool has_min, has_max, has_exclusive_min, has_exclusive_max, has_multiple;
+    double min = 0, max = 0, exclusive_min = 0, exclusive_max = 0, multiple = 0;
+
+    if ( !readNumber( obj, "minimum", has_min, min, path )
+        || !readNumber( obj, "maximum", has_max, max, path )
+        || !readNumber( obj, "exclusiveMinimum", has_exclusive_min, exclusive_min, path )
+        || !readNumber( obj, "exclusiveMaximum", has_exclusive_max, exclusive_max, path )
+        || !readNumber( obj, "multipleOf", has_multiple, multiple, path ) ) return false;
+
+    if ( has_exclusive_min && (!has_min || exclusive_min >= min) ) schema.exclusiveMin( exclusive_min );
+    else if ( has_min ) schema.min( min );
+    if ( has_exclusive_max && (!has_max || exclusive_max <= max) ) schema.exclusiveMax( exclusive_max );
+    else if ( has_max ) schema.max( max );
+
+    if ( has_multiple ) {
+        if ( multiple <= 0 ) {
+            fail( pointerTo( path, "multipleOf" ), "must be greater than 0" );
+            return false;
+        }
+        schema.multipleOf( multiple );
+    }
+    return true;
+}
+
+// TrpSchemaObject::required() only takes declared properties, so they go first
+bool TrpSchemaLoader::loadObject( TrpSchemaObject& schema, TrpJsonObject* obj, const std::string& path ) {
+    ITrpJsonValue* properties = obj->find( "properties" );
+    ITrpJsonValue* required = obj->find( "required" );
+    std::string properties_path = pointerTo( path, "properties" );
+    std::string required_path = pointerTo( path, "required" );
+    bool found;
+    size_t count = 0;
+
+    if ( !readCount( obj, "minProperties", found, count, path ) ) return false;
+    if ( found ) schema.min( count );
+    if ( !readCount( obj, "maxProperties", found, count, path ) ) return false;
+    if ( found ) schema.max( count );
+
+    if ( properties && properties->getType() != TRP_OBJECT ) {
+        fail( properties_path, "must be an object" );
+        return false;
+    }
+    if ( properties ) {
+        TrpJsonObject* members = static_cast<TrpJsonObject*>(properties);
+
+        for ( JsonObjectMap::const_iterator it = members->begin(); it != members->end(); it++ ) {
+            TrpSchema* child = loadSchema( it->second, pointerTo( properties_path, it->first ) );
+            if ( !child ) return false;
+            schema.property( it->first, child );
+        }
+    }
+
+    if ( required && required->getType() != TRP_ARRAY ) {
+        fail( required_path, "must be an array" );
+        return false;
+    }
+    for ( size_t i = 0; required && i < static_cast<TrpJsonArray*>(required)->size(); i++ ) {
+        ITrpJsonValue* name = static_cast<TrpJsonArray*>(required)->at( i );
+
+        if ( name->getType() != TRP_STRING ) {
+            fail( pointerTo( required_path, i ), "must be a string" );
+            return false;
+        }
+
+        const std::string& key = static_cast<TrpJsonString*>(name)->getValue();
+        if ( !schema.getProperties().count( key ) ) {
+            fail( pointerTo( required_path, i ), "'" + key + "' is not in properties" );
+            return false;
+        }
+        schema.required( key );
+    }
+    return true;
+}
+
+// An array of schemas is a tuple of exactly that many items, so the
+// document has to pin the length: minItems == maxItems == the number of
+// schemas, or additionalItems: false with that minItems. JSON Schema would
+// otherwise take shorter arrays and extra items, which a tuple refuses.
+bool TrpSchemaLoader::loadArray( TrpSchemaArray& schema, TrpJsonObject* obj, const std::string& path ) {
+    ITrpJsonValue* items = obj->find( "items" );
+    ITrpJsonValue* uniq = obj->find( "uniqueItems" );
+    ITrpJsonValue* additional = obj->find( "additionalItems" );
+    std::string items_path = pointerTo( path, "items" );
+    bool has_min, has_max;
+    size_t min_items = 0;
+    size_t max_items = 0;
+
+    if ( !readCount( obj, "minItems", has_min, min_items, path ) ) return false;
+    if ( has_min ) schema.min( min_items );
+    if ( !readCount( obj, "maxItems", has_max, max_items, path ) ) return false;
+    if ( has_max ) schema.max( max_items );
+
+    if ( additional && additional->getType() != TRP_BOOL ) {
+        fail( pointerTo( path, "additionalItems" ), "only a boolean is supported" );
+        return false;
+    }
+
+    if ( uniq && uniq->getType() != TRP_BOOL ) {
+        fail( pointerTo( path, "uniqueItems" ), "must be a boolean" );
+        return false;
+    }
+    if ( uniq ) schema.uniq( static_cast<TrpJsonBool*>(uniq)->getValue() );
+
+    if ( !items ) return true;
+    if ( items->getType() != TRP_ARRAY ) {
+        TrpSchema* item = loadSchema( items, items_path );
+        if ( !item ) return false;
+        schema.item( item );
+        return true;
+    }
+
+    TrpJsonArray* list = static_cast<TrpJsonArray*>(items);
+    bool closed = additional && !static_cast<TrpJsonBool*>(additional)->getValue();
+    if ( !has_min || min_items != list->size() || (!closed && (!has_max || max_items != list->size())) ) {
+        fail( items_path, "a tuple needs minItems equal to its length, and maxItems too or additionalItems: false" );
+        return false;
+    }
+
+    SchemaVec tuple;
+    for ( size_t i = 0; i < list->size(); i++ ) {
+        TrpSchema* child = loadSchema( list->at( i ), pointerTo( items_path, i ) );
+        if ( !child ) return false;
+        tuple.push_back( child );
+    }
+    schema.tuple( tuple );
+    return true;
+}
@@ -1,65 +1,207 @@
 #include "../include/TrpSchemaNumber.hpp"
+#include <cmath>
 
-TrpSchemaNumber::TrpSchemaNumber() : has_min(false), has_max(false) {}
+TrpSchemaNumber::TrpSchemaNumber() : has_min(false), has_max(false), min_value(0), max_value(0),
+    min_exclusive(false), max_exclusive(false), is_integer(false), multiple(0), has_enum(false) {}
 
-TrpSchemaNumber& TrpSchemaNumber::min( size_t _min_value ) {
-    if ( !has_min ) has_min = true;
+// Equal numbers have equal bytes once -0 is folded into 0 (JSON has no NaN)
+static std::string numberKey( double nbr ) {
+    if ( nbr == 0 ) nbr = 0;
+    return std::string( reinterpret_cast<const char*>(&nbr), sizeof(nbr) );
+}
 
+TrpSchemaNumber& TrpSchemaNumber::min( double _min_value ) {
+    has_min = true;
+    min_exclusive = false;
     min_value = _min_value;
     return *this;
 }
 
-TrpSchemaNumber& TrpSchemaNumber::max( size_t _max_value ) {
-    if ( !has_max ) has_max = true;
-
+TrpSchemaNumber& TrpSchemaNumber::max( double _max_value ) {
+    has_max = true;
+    max_exclusive = false;
     max_value = _max_value;
     return *this;
 }
 
-static std::string intToString( int nbr ) {
-    std::stringstream oss;
-    oss << nbr;
+TrpSchemaNumber& TrpSchemaNumber::exclusiveMin( double _min_value ) {
+    min( _min_value );
+    min_exclusive = true;
+    return *this;
+}
 
-    return oss.str();
+TrpSchemaNumber& TrpSchemaNumber::exclusiveMax( double _max_value ) {
+    max( _max_value );
+    max_exclusive = true;
+    return *this;
 }
 
-bool TrpSchemaNumber::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
-    bool got_error = false;
+TrpSchemaNumber& TrpSchemaNumber::integer( bool _enabled ) {
+    is_integer = _enabled;
+    return *this;
+}
 
-    if ( !value || value->getType() != TRP_NUMBER ) {
-        ValidationError err;
+TrpSchemaNumber& TrpSchemaNumber::multipleOf( double _multiple ) {
+    if ( !(_multiple > 0) ) return *this;
+    multiple = _multiple;
+    return *this;
+}
+
+TrpSchemaNumber& TrpSchemaNumber::enumValues( const std::vector<double>& values ) {
+    std::vector<std::string> keys;
+
+    for ( size_t i = 0; i < values.size(); i++ ) keys.push_back( numberKey( values[i] ) );
+    has_enum = true;
+    enum_values.assign( keys );
+    return *this;
+}
 
-        err.expected = SCHEMA_NUMBER;
-        err.actual = value ? value->getType() : TRP_ERROR;
-        err.path = ctx.getCurrentPath();
-        err.msg = "Expected number, found " + tokenTypeToString(err.actual);
+TrpSchemaNumber& TrpSchemaNumber::constant( double value ) {
+    return enumValues( std::vector<double>( 1, value ) );
+}
+
+bool TrpSchemaNumber::inEnum( double nbr ) const {
+    if ( nbr == 0 ) nbr = 0;
+    return enum_values.contains( reinterpret_cast<const char*>(&nbr), sizeof(nbr) );
+}
+
+// Within rounding of a whole quotient, so 0.3 is a multiple of 0.1
+bool TrpSchemaNumber::isMultiple( double nbr ) const {
+    if ( !multiple ) return true;
+
+    double q = nbr / multiple;
+    double scale = std::fabs( q ) > 1 ? std::fabs( q ) : 1;
+    return std::fabs( q - std::floor( q + 0.5 ) ) <= 1e-9 * scale;
+}
+
+TrpNumberRange TrpSchemaNumber::getRange( void ) const {
+    TrpNumberRange range;
+
+    range.lo = has_min ? min_value : -HUGE_VAL;
+    range.hi = has_max ? max_value : HUGE_VAL;
+    if ( has_min && min_exclusive ) range.lo = nextafter( range.lo, HUGE_VAL );
+    if ( has_max && max_exclusive ) range.hi = nextafter( range.hi, -HUGE_VAL );
+    range.integer = is_integer;
+    return range;
+}
+
+// Same verdict as checkNumber(), without reporting
+bool TrpSchemaNumber::accepts( double nbr ) const {
+    if ( has_max && (nbr > max_value || (max_exclusive && nbr == max_value)) ) return false;
+    if ( has_min && (nbr < min_value || (min_exclusive && nbr == min_value)) ) return false;
+    if ( is_integer && nbr != std::floor( nbr ) ) return false;
+    if ( multiple && !isMultiple( nbr ) ) return false;
+    if ( has_enum && !inEnum( nbr ) ) return false;
+    return true;
+}
 
-        ctx.pushError( err );
+bool TrpSchemaNumber::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
+    if ( !value || value->getType() != TRP_NUMBER ) {
+        ctx.pushTypeError( this, SCHEMA_NUMBER, value ? value->getType() : TRP_ERROR );
         return false;
     }
 
     TrpJsonNumber* nbr = static_cast<TrpJsonNumber*>(value);
 
-    if ( has_max && nbr->getValue() > max_value ) {
-        ValidationError err;
+    return checkNumber( nbr->getValue(), ctx );
+}
+
+bool TrpSchemaNumber::checkNumber( double nbr, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
+
+    if ( (has_min || has_max) && !checkRange( nbr, ctx ) ) {
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        err.path = ctx.getCurrentPath();
-        err.msg = "Number exceeds maximum value of " + intToString(max_value);
+    if ( is_integer && nbr != std::floor( nbr ) ) {
+        ctx.pushError( ERR_NUMBER_NOT_INTEGER, this, 0, nbr );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if ( multiple && !isMultiple( nbr ) ) {
+        ctx.pushError( ERR_NUMBER_NOT_MULTIPLE, this, multiple, nbr );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        ctx.pushError( err );
+    if ( has_enum && !inEnum( nbr ) ) {
+        ctx.pushError( ERR_ENUM, this, enum_values.size(), nbr );
         if ( !got_error ) got_error = true;
     }
 
-    if ( has_min && nbr->getValue() < min_value ) {
-        ValidationError err;
+    if ( got_error ) return false;
+    return true;
+}
+
+bool TrpSchemaNumber::checkRange( double nbr, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
 
-        err.path = ctx.getCurrentPath();
-        err.msg = "Number is below minimum value of " + intToString(min_value);
+    if ( has_max && max_exclusive && nbr >= max_value ) {
+        ctx.pushError( ERR_NUMBER_NOT_BELOW, this, max_value, nbr );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    } else if ( has_max && nbr > max_value ) {
+        ctx.pushError( ERR_NUMBER_TOO_LARGE, this, max_value, nbr );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        ctx.pushError( err );
+    if ( has_min && min_exclusive && nbr <= min_value ) {
+        ctx.pushError( ERR_NUMBER_NOT_ABOVE, this, min_value, nbr );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    } else if ( has_min && nbr < min_value ) {
+        ctx.pushError( ERR_NUMBER_TOO_SMALL, this, min_value, nbr );
         if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if ( got_error ) return false;
+    return true;
+}
+
+bool TrpSchemaNumber::acceptsAll( const double* values, size_t count ) const {
+    if ( (has_min || has_max || is_integer) && !trpNumbersInRange( values, count, getRange() ) ) return false;
+    if ( !multiple && !has_enum ) return true;
+
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( multiple && !isMultiple( values[i] ) ) return false;
+        if ( has_enum && !inEnum( values[i] ) ) return false;
+    }
+    return true;
+}
+
+#define TRP_NUMBER_RUN 64
+
+bool TrpSchemaNumber::validateItems( TrpJsonArray* arr, size_t first, size_t last, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
+    double packed[TRP_NUMBER_RUN];
+
+    for ( size_t run = first; run < last; run += TRP_NUMBER_RUN ) {
+        size_t count = last - run < TRP_NUMBER_RUN ? last - run : TRP_NUMBER_RUN;
+        size_t i;
+
+        if ( ctx.isCancelled() ) break;
+        for ( i = 0; i < count; i++ ) {
+            ITrpJsonValue* item = arr->at(run + i);
+            if ( !item || item->getType() != TRP_NUMBER ) break;
+            packed[i] = static_cast<TrpJsonNumber*>(item)->getValue();
+        }
+
+        if ( i == count && acceptsAll( packed, count ) ) continue;
+
+        for ( i = run; i < run + count; i++ ) {
+            ctx.pushIndex(i);
+            if ( !validate( arr->at(i), ctx ) ) {
+                if ( !got_error ) got_error = true;
+            }
+            ctx.popPath();
+            if ( got_error && !ctx.shouldContinue() ) return false;
+        }
     }
 
     if ( got_error ) return false;
     return true;
-}
\ No newline at end of file
+}
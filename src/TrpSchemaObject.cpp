@@ -22,6 +22,7 @@ TrpSchemaObject& TrpSchemaObject::property( std::string key, TrpSchema* schema )
     if (it != properties.end()) return *this;
 
     properties.insert(std::pair<std::string, TrpSchema*>(key, schema));
+    indexRequired();
     return *this;
 }
 
@@ -32,79 +33,184 @@ TrpSchemaObject& TrpSchemaObject::required( std::string required ) {
     if (it == properties.end()) return *this;
 
     required_entries.push_back( required );
+    indexRequired();
     return *this;
 }
 
-static std::string intToString( int nbr ) {
-    std::stringstream oss;
-    oss << nbr;
+// required_mask[i] tells whether the i-th property (in key order) is
+// required, so validate() never has to search required_entries
+void TrpSchemaObject::indexRequired( void ) {
+    std::map<std::string, TrpSchema*>::const_iterator it;
+    size_t index = 0;
 
-    return oss.str();
+    required_mask.assign( properties.size(), false );
+    for ( it = properties.begin(); it != properties.end(); it++, index++ ) {
+        for ( size_t i = 0; i < required_entries.size(); i++ ) {
+            if ( required_entries[i] == it->first ) required_mask[index] = true;
+        }
+    }
 }
 
 bool TrpSchemaObject::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
-    bool got_errors = false;
+    if ( !ctx.isMemoEnabled() ) return validateMembers( value, ctx );
 
-    if (!value || value->getType() != TRP_OBJECT ) {
-         ValidationError err;
+    size_t hash;
+    if ( ctx.memoEnter( this, value, hash ) ) return true;
+    bool valid = validateMembers( value, ctx );
+    ctx.memoLeave( this, value, hash, valid );
+    return valid;
+}
 
-        err.path = ctx.getCurrentPath();
-        err.expected = SCHEMA_OBJECT;
-        err.actual = value ? value->getType() : TRP_ERROR;
-        err.msg = "Expected object, found " + tokenTypeToString(err.actual);
+// One step of the merge walk in validateMembers(): validate a member, or
+// report a required one missing
+struct TrpMemberStep {
+    const std::string* key;
+    ITrpJsonValue* value;
+    const TrpSchema* schema;    // NULL: missing
+};
+
+class TrpObjectMembers : public TrpSplitBody {
+    private:
+        const TrpSchemaObject* object;
+        const std::vector<TrpMemberStep>& steps;
+
+    public:
+        TrpObjectMembers( const TrpSchemaObject* _object, const std::vector<TrpMemberStep>& _steps )
+            : object(_object), steps(_steps) {}
+
+        bool validateRange( size_t first, size_t last, TrpValidatorContext& ctx ) const {
+            bool got_errors = false;
+
+            for ( size_t i = first; i < last && !ctx.isCancelled(); i++ ) {
+                const TrpMemberStep& step = steps[i];
+
+                if ( !step.value ) {
+                    object->reportMissing( *step.key, ctx );
+                    if ( !got_errors ) got_errors = true;
+                } else {
+                    ctx.pushKey( *step.key );
+                    if ( !step.schema || !step.schema->validate( step.value, ctx ) ) {
+                        if ( !got_errors ) got_errors = true;
+                    }
+                    ctx.popPath();
+                }
+                if ( got_errors && !ctx.shouldContinue() ) return false;
+            }
+
+            if ( got_errors ) return false;
+            return true;
+        }
+};
+
+bool TrpSchemaObject::validateMembers(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
+    bool got_errors = false;
 
-        ctx.pushError(err);
+    if (!value || value->getType() != TRP_OBJECT ) {
+        ctx.pushTypeError( this, SCHEMA_OBJECT, value ? value->getType() : TRP_ERROR );
         return false;
     }
 
     TrpJsonObject* obj = static_cast<TrpJsonObject*>(value);
 
-    if (has_min && obj->size() < min_items) {
-        ValidationError err;
-
-        err.path = ctx.getCurrentPath();
-        err.msg = "Object must have at least " + intToString(min_items) + " properties, but has " + intToString(obj->size());
-
-        ctx.pushError(err);
+    if ( !checkSize( obj->size(), ctx ) ) {
         if ( !got_errors ) got_errors = true;
+        if ( !ctx.shouldContinue() ) return false;
     }
 
-    if (has_max && obj->size() > max_items) {
-        ValidationError err;
+    if ( ctx.shouldSplit( properties.size() ) ) {
+        if ( !validateSplit( obj, ctx ) ) got_errors = true;
+        if ( got_errors ) return false;
+        return true;
+    }
 
-        err.path = ctx.getCurrentPath();
-        err.msg = "Object must have at most " + intToString(max_items) + " properties, but has " + intToString(obj->size());
+    // Both maps are sorted by key, so one merge walk settles declared
+    // properties, missing required keys and undeclared keys together.
+    std::map<std::string, TrpSchema*>::const_iterator it = properties.begin();
+    JsonObjectMap::const_iterator jt = obj->begin();
 
-        ctx.pushError(err);
-        if ( !got_errors ) got_errors = true;
-    }
+    for ( size_t index = 0; it != properties.end(); ) {
+        int diff = jt == obj->end() ? -1 : it->first.compare( jt->first );
 
-    if ( required_entries.size() ) {
-        for (size_t i = 0; i < required_entries.size(); i++) {
-            if (!obj->find(required_entries[i])) {
-                ValidationError err;
+        if ( diff > 0 ) {
+            jt++;
+            continue;
+        }
 
-                err.path = ctx.getCurrentPath();
-                err.msg = "Required property '" + required_entries[i] + "' is missing";
-                
-                ctx.pushError(err);
+        if ( diff < 0 ) {
+            if ( required_mask[index] ) {
+                reportMissing( it->first, ctx );
+                if ( !got_errors ) got_errors = true;
+            }
+        } else {
+            ctx.pushKey(it->first);
+            if (!it->second || !it->second->validate(jt->second, ctx)) {
                 if ( !got_errors ) got_errors = true;
             }
+            ctx.popPath();
+            jt++;
         }
+        if ( got_errors && !ctx.shouldContinue() ) return false;
+        it++;
+        index++;
     }
 
-    std::map<std::string, TrpSchema*>::const_iterator it;
-    for (it = properties.begin(); it != properties.end(); it ++) {
-        ctx.pushPath("." + it->first);
-        ITrpJsonValue* prop = obj->find(it->first);
-        if (prop) {
-            if (!it->second || !it->second->validate(prop, ctx)) {
-                if ( !got_errors ) got_errors = true;
-            }
+    if ( got_errors ) return false;
+    return true;
+}
+
+// Same walk as validateMembers(), recorded first so the steps can be cut
+// into ranges
+bool TrpSchemaObject::validateSplit( TrpJsonObject* obj, TrpValidatorContext& ctx ) const {
+    std::vector<TrpMemberStep> steps;
+    std::map<std::string, TrpSchema*>::const_iterator it = properties.begin();
+    JsonObjectMap::const_iterator jt = obj->begin();
+
+    steps.reserve( properties.size() );
+    for ( size_t index = 0; it != properties.end(); ) {
+        int diff = jt == obj->end() ? -1 : it->first.compare( jt->first );
+
+        if ( diff > 0 ) {
+            jt++;
+            continue;
+        }
+
+        TrpMemberStep step;
+        step.key = &it->first;
+        step.value = NULL;
+        step.schema = it->second;
+        if ( diff == 0 ) {
+            step.value = jt->second;
+            steps.push_back( step );
+            jt++;
+        } else if ( required_mask[index] ) {
+            steps.push_back( step );
         }
-        ctx.popPath();
+        it++;
+        index++;
+    }
+
+    TrpObjectMembers members( this, steps );
+    return ctx.split( members, steps.size() );
+}
+
+bool TrpSchemaObject::checkSize( size_t size, TrpValidatorContext& ctx ) const {
+    bool got_errors = false;
+
+    if (has_min && size < min_items) {
+        ctx.pushError( ERR_OBJECT_TOO_SMALL, this, min_items, size );
+        if ( !got_errors ) got_errors = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if (has_max && size > max_items) {
+        ctx.pushError( ERR_OBJECT_TOO_LARGE, this, max_items, size );
+        if ( !got_errors ) got_errors = true;
     }
 
     if ( got_errors ) return false;
     return true;
+}
+
+void TrpSchemaObject::reportMissing( const std::string& key, TrpValidatorContext& ctx ) const {
+    ctx.pushMissing( this, key );
 }
\ No newline at end of file
@@ -0,0 +1,425 @@
+#include "../include/TrpSchemaSnapshot.hpp"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+TrpSchemaSnapshot::TrpSchemaSnapshot( void ) : image(NULL), image_size(0),
+    header(NULL), nodes(NULL), keys(NULL), slots(NULL), pool(NULL) {}
+
+bool TrpSchemaSnapshot::fail( const std::string& message ) {
+    detach();
+    error = message;
+    return false;
+}
+
+void TrpSchemaSnapshot::detach( void ) {
+    image = NULL;
+    image_size = 0;
+    header = NULL;
+    nodes = NULL;
+    keys = NULL;
+    slots = NULL;
+    pool = NULL;
+}
+
+static uint64_t checksum( const char* data, size_t size ) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for ( size_t i = 0; i < size; i++ ) h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    return h;
+}
+
+// Nodes are numbered depth first and memoized by address, like
+// TrpCompiledSchema::emit(), so shared and self-referencing schemas are
+// written once. Returns TRP_SNAPSHOT_NONE for a NULL schema, and with
+// `error` set when the schema cannot be written.
+uint32_t TrpSchemaSnapshot::emit( const TrpSchema* schema, const std::string& path, std::vector<TrpSnapshotNode>& out_nodes,
+    std::vector<TrpSnapshotKey>& out_keys, std::vector<uint32_t>& out_slots, std::string& out_pool,
+    std::map<const TrpSchema*, uint32_t>& seen ) {
+    if ( !schema || !error.empty() ) return TRP_SNAPSHOT_NONE;
+
+    std::map<const TrpSchema*, uint32_t>::iterator found = seen.find( schema );
+    if ( found != seen.end() ) return found->second;
+
+    TrpSnapshotNode node;
+    std::memset( &node, 0, sizeof(node) );
+    node.type = schema->getType();
+    node.item = TRP_SNAPSHOT_NONE;
+
+    uint32_t index = out_nodes.size();
+    std::string where = path.empty() ? "the root" : path;
+
+    seen[schema] = index;
+    out_nodes.push_back( node );
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING: {
+            const TrpSchemaString* str = static_cast<const TrpSchemaString*>(schema);
+
+            if ( str->hasPattern() || str->hasEnum() ) {
+                error = "Cannot snapshot the pattern or enum of " + where;
+                return TRP_SNAPSHOT_NONE;
+            }
+            if ( str->hasMin() ) { node.flags |= SNAP_HAS_MIN; node.min = str->getMin(); }
+            if ( str->hasMax() ) { node.flags |= SNAP_HAS_MAX; node.max = str->getMax(); }
+            if ( str->isCodePoints() ) node.flags |= SNAP_CODE_POINTS;
+            node.extra = str->getFormat();
+            break;
+        }
+        case SCHEMA_NUMBER: {
+            const TrpSchemaNumber* nbr = static_cast<const TrpSchemaNumber*>(schema);
+
+            if ( nbr->hasEnum() ) {
+                error = "Cannot snapshot the enum of " + where;
+                return TRP_SNAPSHOT_NONE;
+            }
+            if ( nbr->hasMin() ) { node.flags |= SNAP_HAS_MIN; node.min = nbr->getMin(); }
+            if ( nbr->hasMax() ) { node.flags |= SNAP_HAS_MAX; node.max = nbr->getMax(); }
+            if ( nbr->isMinExclusive() ) node.flags |= SNAP_MIN_EXCLUSIVE;
+            if ( nbr->isMaxExclusive() ) node.flags |= SNAP_MAX_EXCLUSIVE;
+            if ( nbr->isInteger() ) node.flags |= SNAP_INTEGER;
+            if ( nbr->getMultipleOf() ) { node.flags |= SNAP_MULTIPLE; node.multiple = nbr->getMultipleOf(); }
+            break;
+        }
+        case SCHEMA_BOOLEAN: {
+            const TrpSchemaBool* bl = static_cast<const TrpSchemaBool*>(schema);
+
+            if ( bl->hasConst() ) { node.flags |= SNAP_CONST; node.extra = bl->getConst(); }
+            break;
+        }
+        case SCHEMA_NULL:
+            break;
+        case SCHEMA_OBJECT: {
+            const TrpSchemaObject* obj = static_cast<const TrpSchemaObject*>(schema);
+            const std::map<std::string, TrpSchema*>& props = obj->getProperties();
+            const std::vector<bool>& mask = obj->getRequiredMask();
+
+            if ( obj->hasMin() ) { node.flags |= SNAP_HAS_MIN; node.min = obj->getMin(); }
+            if ( obj->hasMax() ) { node.flags |= SNAP_HAS_MAX; node.max = obj->getMax(); }
+            node.first = out_keys.size();
+            node.count = props.size();
+
+            std::map<std::string, TrpSchema*>::const_iterator it;
+            size_t ordinal = 0;
+            for ( it = props.begin(); it != props.end(); it++, ordinal++ ) {
+                TrpSnapshotKey key;
+
+                key.name = out_pool.size();
+                key.length = it->first.size();
+                key.node = TRP_SNAPSHOT_NONE;
+                key.required = mask[ordinal] ? 1 : 0;
+                out_pool += it->first;
+                out_keys.push_back( key );
+            }
+            out_nodes[index] = node;
+
+            uint32_t k = node.first;
+            for ( it = props.begin(); it != props.end(); it++, k++ ) {
+                uint32_t child = emit( it->second, path + "." + it->first, out_nodes, out_keys, out_slots, out_pool, seen );
+                out_keys[k].node = child;
+            }
+            return error.empty() ? index : TRP_SNAPSHOT_NONE;
+        }
+        case SCHEMA_ARRAY: {
+            const TrpSchemaArray* arr = static_cast<const TrpSchemaArray*>(schema);
+            const SchemaVec& tuple = arr->getTuple();
+
+            if ( arr->hasMin() ) { node.flags |= SNAP_HAS_MIN; node.min = arr->getMin(); }
+            if ( arr->hasMax() ) { node.flags |= SNAP_HAS_MAX; node.max = arr->getMax(); }
+            if ( arr->isUniq() ) node.flags |= SNAP_UNIQ;
+            node.first = out_slots.size();
+            node.count = tuple.size();
+            out_slots.resize( out_slots.size() + tuple.size(), TRP_SNAPSHOT_NONE );
+            out_nodes[index] = node;
+
+            uint32_t item = emit( arr->getItem(), path + "[]", out_nodes, out_keys, out_slots, out_pool, seen );
+            out_nodes[index].item = item;
+            for ( size_t i = 0; i < tuple.size(); i++ ) {
+                std::ostringstream oss;
+                oss << path << '[' << i << ']';
+                uint32_t child = emit( tuple[i], oss.str(), out_nodes, out_keys, out_slots, out_pool, seen );
+                out_slots[node.first + i] = child;
+            }
+            return error.empty() ? index : TRP_SNAPSHOT_NONE;
+        }
+        case SCHEMA_UNION: {
+            const TrpSchemaUnion* uni = static_cast<const TrpSchemaUnion*>(schema);
+            const std::vector<TrpSchema*>& branches = uni->getBranches();
+
+            if ( !uni->getDiscriminator().empty() || uni->isTagged() ) {
+                error = "Cannot snapshot the discriminator of " + where;
+                return TRP_SNAPSHOT_NONE;
+            }
+            node.extra = uni->getMode();
+            node.first = out_slots.size();
+            node.count = branches.size();
+            out_slots.resize( out_slots.size() + branches.size(), TRP_SNAPSHOT_NONE );
+            out_nodes[index] = node;
+
+            for ( size_t i = 0; i < branches.size(); i++ ) {
+                uint32_t child = emit( branches[i], path, out_nodes, out_keys, out_slots, out_pool, seen );
+                out_slots[node.first + i] = child;
+            }
+            return error.empty() ? index : TRP_SNAPSHOT_NONE;
+        }
+        default:
+            error = "Cannot snapshot the schema type of " + where;
+            return TRP_SNAPSHOT_NONE;
+    }
+
+    out_nodes[index] = node;
+    return index;
+}
+
+bool TrpSchemaSnapshot::capture( const TrpSchema& root ) {
+    std::vector<TrpSnapshotNode> out_nodes;
+    std::vector<TrpSnapshotKey> out_keys;
+    std::vector<uint32_t> out_slots;
+    std::string out_pool;
+    std::map<const TrpSchema*, uint32_t> seen;
+
+    file.close();
+    buffer.clear();
+    detach();
+    error.clear();
+    emit( &root, "", out_nodes, out_keys, out_slots, out_pool, seen );
+    if ( !error.empty() ) return fail( error );
+
+    TrpSnapshotHeader head;
+    std::memset( &head, 0, sizeof(head) );
+    std::memcpy( head.magic, TRP_SNAPSHOT_MAGIC, sizeof(TRP_SNAPSHOT_MAGIC) );
+    head.version = TRP_SNAPSHOT_VERSION;
+    head.byte_order = TRP_SNAPSHOT_BYTE_ORDER;
+    head.node_count = out_nodes.size();
+    head.key_count = out_keys.size();
+    head.slot_count = out_slots.size();
+    head.pool_size = out_pool.size();
+
+    size_t size = sizeof(head) + out_nodes.size() * sizeof(TrpSnapshotNode) + out_keys.size() * sizeof(TrpSnapshotKey)
+        + out_slots.size() * sizeof(uint32_t) + out_pool.size();
+    buffer.assign( (size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0 );
+
+    char* out = reinterpret_cast<char*>(&buffer[0]);
+    char* body = out + sizeof(head);
+    size_t offset = sizeof(head);
+    if ( !out_nodes.empty() ) std::memcpy( out + offset, &out_nodes[0], out_nodes.size() * sizeof(TrpSnapshotNode) );
+    offset += out_nodes.size() * sizeof(TrpSnapshotNode);
+    if ( !out_keys.empty() ) std::memcpy( out + offset, &out_keys[0], out_keys.size() * sizeof(TrpSnapshotKey) );
+    offset += out_keys.size() * sizeof(TrpSnapshotKey);
+    if ( !out_slots.empty() ) std::memcpy( out + offset, &out_slots[0], out_slots.size() * sizeof(uint32_t) );
+    offset += out_slots.size() * sizeof(uint32_t);
+    std::memcpy( out + offset, out_pool.data(), out_pool.size() );
+
+    head.checksum = checksum( body, size - sizeof(head) );
+    std::memcpy( out, &head, sizeof(head) );
+    return attach( out, size );
+}
+
+bool TrpSchemaSnapshot::writeFile( const std::string& file_name ) {
+    if ( !header ) {
+        error = "No snapshot to write";
+        return false;
+    }
+
+    std::ofstream out( file_name.c_str(), std::ios::binary | std::ios::trunc );
+    if ( out.is_open() ) out.write( image, image_size );
+    if ( !out.is_open() || !out.good() ) {
+        error = "Cannot write " + file_name;
+        return false;
+    }
+    return true;
+}
+
+bool TrpSchemaSnapshot::openFile( const std::string& file_name ) {
+    buffer.clear();
+    detach();
+    if ( !file.open( file_name ) ) return fail( file.getError() );
+    return attach( file.data(), file.size() );
+}
+
+bool TrpSchemaSnapshot::setBuffer( const char* data, size_t size ) {
+    file.close();
+    buffer.clear();
+    return attach( data, size );
+}
+
+static bool inBounds( uint32_t first, uint32_t count, uint32_t limit ) {
+    return static_cast<uint64_t>(first) + count <= limit;
+}
+
+static bool isNode( uint32_t index, uint32_t count ) {
+    return index == TRP_SNAPSHOT_NONE || index < count;
+}
+
+// Everything instantiate() will read is checked here, once: a truncated,
+// corrupted or foreign file is refused instead of read out of bounds
+bool TrpSchemaSnapshot::attach( const char* data, size_t size ) {
+    TrpSnapshotHeader head;
+
+    detach();
+    error.clear();
+    if ( !data || size < sizeof(head) ) return fail( "Not a schema snapshot: too short" );
+    if ( reinterpret_cast<size_t>(data) % sizeof(uint64_t) ) return fail( "Snapshot image is not 8-byte aligned" );
+
+    std::memcpy( &head, data, sizeof(head) );
+    if ( std::memcmp( head.magic, TRP_SNAPSHOT_MAGIC, sizeof(TRP_SNAPSHOT_MAGIC) ) )
+        return fail( "Not a schema snapshot" );
+    if ( head.byte_order != TRP_SNAPSHOT_BYTE_ORDER ) return fail( "Snapshot was written with another byte order" );
+    if ( head.version != TRP_SNAPSHOT_VERSION ) {
+        std::ostringstream oss;
+        oss << "Unsupported snapshot version " << head.version << ", expected " << TRP_SNAPSHOT_VERSION;
+        return fail( oss.str() );
+    }
+
+    uint64_t expected = sizeof(head) + static_cast<uint64_t>(head.node_count) * sizeof(TrpSnapshotNode)
+        + static_cast<uint64_t>(head.key_count) * sizeof(TrpSnapshotKey)
+        + static_cast<uint64_t>(head.slot_count) * sizeof(uint32_t) + head.pool_size;
+    if ( expected != size || !head.node_count ) return fail( "Snapshot size does not match its header" );
+    if ( checksum( data + sizeof(head), size - sizeof(head) ) != head.checksum ) return fail( "Snapshot checksum mismatch" );
+
+    const TrpSnapshotNode* first_node = reinterpret_cast<const TrpSnapshotNode*>(data + sizeof(head));
+    const TrpSnapshotKey* first_key = reinterpret_cast<const TrpSnapshotKey*>(first_node + head.node_count);
+    const uint32_t* first_slot = reinterpret_cast<const uint32_t*>(first_key + head.key_count);
+
+    for ( uint32_t i = 0; i < head.node_count; i++ ) {
+        const TrpSnapshotNode& node = first_node[i];
+        bool valid;
+
+        switch (node.type) {
+            case SCHEMA_STRING:
+                valid = node.extra <= FORMAT_BASE64;
+                break;
+            case SCHEMA_NUMBER:
+            case SCHEMA_BOOLEAN:
+            case SCHEMA_NULL:
+                valid = true;
+                break;
+            case SCHEMA_OBJECT:
+                valid = inBounds( node.first, node.count, head.key_count );
+                break;
+            case SCHEMA_ARRAY:
+                valid = isNode( node.item, head.node_count ) && inBounds( node.first, node.count, head.slot_count );
+                break;
+            case SCHEMA_UNION:
+                valid = node.extra <= UNION_ONE_OF && inBounds( node.first, node.count, head.slot_count );
+                break;
+            default:
+                valid = false;
+        }
+        if ( !valid ) return fail( "Snapshot is corrupted: bad node" );
+    }
+    for ( uint32_t i = 0; i < head.key_count; i++ ) {
+        if ( !inBounds( first_key[i].name, first_key[i].length, head.pool_size ) || !isNode( first_key[i].node, head.node_count ) )
+            return fail( "Snapshot is corrupted: bad key" );
+    }
+    for ( uint32_t i = 0; i < head.slot_count; i++ ) {
+        if ( !isNode( first_slot[i], head.node_count ) ) return fail( "Snapshot is corrupted: bad slot" );
+    }
+
+    image = data;
+    image_size = size;
+    header = reinterpret_cast<const TrpSnapshotHeader*>(data);
+    nodes = first_node;
+    keys = first_key;
+    slots = first_slot;
+    pool = reinterpret_cast<const char*>(first_slot + head.slot_count);
+    return true;
+}
+
+// Every node is made first and linked after, so children may come before
+// their parents and cycles close on nodes that already exist
+TrpSchema* TrpSchemaSnapshot::instantiate( TrpSchemaFactory& factory ) const {
+    if ( !header ) return NULL;
+
+    std::vector<TrpSchema*> built( header->node_count, static_cast<TrpSchema*>(NULL) );
+
+    for ( uint32_t i = 0; i < header->node_count; i++ ) {
+        const TrpSnapshotNode& node = nodes[i];
+
+        switch (node.type) {
+            case SCHEMA_STRING: {
+                TrpSchemaString& str = factory.string();
+
+                if ( node.flags & SNAP_HAS_MIN ) str.min( static_cast<size_t>(node.min) );
+                if ( node.flags & SNAP_HAS_MAX ) str.max( static_cast<size_t>(node.max) );
+                if ( node.flags & SNAP_CODE_POINTS ) str.codePoints();
+                if ( node.extra ) str.format( static_cast<TrpStringFormat>(node.extra) );
+                built[i] = &str;
+                break;
+            }
+            case SCHEMA_NUMBER: {
+                TrpSchemaNumber& nbr = factory.number();
+
+                if ( node.flags & SNAP_HAS_MIN ) {
+                    if ( node.flags & SNAP_MIN_EXCLUSIVE ) nbr.exclusiveMin( node.min );
+                    else nbr.min( node.min );
+                }
+                if ( node.flags & SNAP_HAS_MAX ) {
+                    if ( node.flags & SNAP_MAX_EXCLUSIVE ) nbr.exclusiveMax( node.max );
+                    else nbr.max( node.max );
+                }
+                if ( node.flags & SNAP_INTEGER ) nbr.integer();
+                if ( node.flags & SNAP_MULTIPLE ) nbr.multipleOf( node.multiple );
+                built[i] = &nbr;
+                break;
+            }
+            case SCHEMA_BOOLEAN: {
+                TrpSchemaBool& bl = factory.boolean();
+
+                if ( node.flags & SNAP_CONST ) bl.constant( node.extra != 0 );
+                built[i] = &bl;
+                break;
+            }
+            case SCHEMA_NULL:
+                built[i] = &factory.null();
+                break;
+            case SCHEMA_OBJECT: {
+                TrpSchemaObject& obj = factory.object();
+
+                if ( node.flags & SNAP_HAS_MIN ) obj.min( static_cast<size_t>(node.min) );
+                if ( node.flags & SNAP_HAS_MAX ) obj.max( static_cast<size_t>(node.max) );
+                built[i] = &obj;
+                break;
+            }
+            case SCHEMA_ARRAY: {
+                TrpSchemaArray& arr = factory.array();
+
+                if ( node.flags & SNAP_HAS_MIN ) arr.min( static_cast<size_t>(node.min) );
+                if ( node.flags & SNAP_HAS_MAX ) arr.max( static_cast<size_t>(node.max) );
+                arr.uniq( (node.flags & SNAP_UNIQ) != 0 );
+                built[i] = &arr;
+                break;
+            }
+            default:
+                built[i] = node.extra == UNION_ONE_OF ? &factory.oneOf() : &factory.anyOf();
+                break;
+        }
+    }
+
+    for ( uint32_t i = 0; i < header->node_count; i++ ) {
+        const TrpSnapshotNode& node = nodes[i];
+
+        if ( node.type == SCHEMA_OBJECT ) {
+            TrpSchemaObject* obj = static_cast<TrpSchemaObject*>(built[i]);
+
+            for ( uint32_t k = node.first; k < node.first + node.count; k++ )
+                obj->property( std::string( pool + keys[k].name, keys[k].length ), keys[k].node == TRP_SNAPSHOT_NONE ? NULL : built[keys[k].node] );
+            for ( uint32_t k = node.first; k < node.first + node.count; k++ )
+                if ( keys[k].required ) obj->required( std::string( pool + keys[k].name, keys[k].length ) );
+        } else if ( node.type == SCHEMA_ARRAY ) {
+            TrpSchemaArray* arr = static_cast<TrpSchemaArray*>(built[i]);
+            SchemaVec tuple;
+
+            if ( node.item != TRP_SNAPSHOT_NONE ) arr->item( built[node.item] );
+            for ( uint32_t s = node.first; s < node.first + node.count; s++ )
+                tuple.push_back( slots[s] == TRP_SNAPSHOT_NONE ? NULL : built[slots[s]] );
+            arr->tuple( tuple );
+        } else if ( node.type == SCHEMA_UNION ) {
+            TrpSchemaUnion* uni = static_cast<TrpSchemaUnion*>(built[i]);
+
+            for ( uint32_t s = node.first; s < node.first + node.count; s++ )
+                if ( slots[s] != TRP_SNAPSHOT_NONE ) uni->branch( built[slots[s]] );
+        }
+    }
+    return built[0];
+}
@@ -1,7 +1,8 @@
 #include "../include/TrpSchemaString.hpp"
 
 
-TrpSchemaString::TrpSchemaString( void ) : has_min(false), has_max(false) {}
+TrpSchemaString::TrpSchemaString( void ) : has_min(false), has_max(false),
+    code_points(false), _format(FORMAT_NONE), has_pattern(false), has_enum(false) {}
 
 TrpSchemaString& TrpSchemaString::min( size_t _min_len ) {
     has_min = true;
@@ -15,45 +16,90 @@ TrpSchemaString& TrpSchemaString::max( size_t _max_len ) {
     return *this;
 }
 
-bool TrpSchemaString::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
-    bool got_error = false;
+TrpSchemaString& TrpSchemaString::format( TrpStringFormat _fmt ) {
+    _format = _fmt;
+    return *this;
+}
 
-    if ( !value || value->getType() != TRP_STRING ) {
-        ValidationError err;
+TrpSchemaString& TrpSchemaString::codePoints( bool _enabled ) {
+    code_points = _enabled;
+    return *this;
+}
+
+TrpSchemaString& TrpSchemaString::pattern( const std::string& _source ) {
+    has_pattern = true;
+    _pattern.compile( _source );
+    return *this;
+}
 
-        err.expected = SCHEMA_STRING;
-        err.actual = value ? value->getType() : TRP_NULL;
-        err.path = ctx.getCurrentPath();
-        err.msg = "Expected string, found " + tokenTypeToString(err.actual);
+TrpSchemaString& TrpSchemaString::enumValues( const std::vector<std::string>& values ) {
+    has_enum = true;
+    enum_values.assign( values );
+    return *this;
+}
+
+TrpSchemaString& TrpSchemaString::constant( const std::string& value ) {
+    return enumValues( std::vector<std::string>( 1, value ) );
+}
 
-        ctx.pushError( err );
+size_t TrpSchemaString::measure( const char* data, size_t size ) const {
+    if ( code_points ) return trpUtf8Length( data, size );
+    return size;
+}
+
+bool TrpSchemaString::validate(ITrpJsonValue* value, TrpValidatorContext& ctx) const {
+    if ( !value || value->getType() != TRP_STRING ) {
+        ctx.pushTypeError( this, SCHEMA_STRING, value ? value->getType() : TRP_NULL );
         return false;
     }
 
     TrpJsonString* str = static_cast<TrpJsonString*>(value);
 
-    if (has_max && str->getValue().size() > max_len) {
-        ValidationError err;
+    return checkString( str->getValue(), ctx );
+}
+
+bool TrpSchemaString::checkString( const char* data, size_t size, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
+
+    if ( (has_min || has_max) && !checkLength( measure( data, size ), ctx ) ) {
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    if ( _format != FORMAT_NONE && !trpCheckFormat( _format, data, size ) ) {
+        ctx.pushError( ERR_STRING_FORMAT, this, _format, 0 );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        std::stringstream error;
-        error << "String size should be at most " << max_len << " chars, but got " << str->getValue().size();
-        err.path = ctx.getCurrentPath();
-        err.msg = error.str();
+    if ( has_pattern && !_pattern.match( data, size ) ) {
+        ctx.pushPattern( this, _pattern.getSource() );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        ctx.pushError( err );
+    if ( has_enum && !enum_values.contains( data, size ) ) {
+        ctx.pushError( ERR_ENUM, this, enum_values.size(), 0 );
         if ( !got_error ) got_error = true;
     }
 
-    if (has_min && str->getValue().size() < min_len) {
-        ValidationError err;
+    if (got_error) return false;
+    return true;
+}
 
-        std::stringstream error;
-        error << "String size should be at least " << max_len << " chars, but got " << str->getValue().size();
-        err.path = ctx.getCurrentPath();
-        err.msg = error.str();
+bool TrpSchemaString::checkLength( size_t len, TrpValidatorContext& ctx ) const {
+    bool got_error = false;
+
+    if (has_max && len > max_len) {
+        ctx.pushError( ERR_STRING_TOO_LONG, this, max_len, len );
+        if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
 
-        ctx.pushError( err );
+    if (has_min && len < min_len) {
+        ctx.pushError( ERR_STRING_TOO_SHORT, this, min_len, len );
         if ( !got_error ) got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
     }
 
     if (got_error) return false;
@@ -0,0 +1,160 @@
+#include "../include/TrpSchemaUnion.hpp"
+#include <algorithm>
+
+// TRP_ERROR for the schema types that take any value
+static TrpJsonType branchType( const TrpSchema* schema ) {
+    switch (schema->getType()) {
+        case SCHEMA_STRING: return TRP_STRING;
+        case SCHEMA_NUMBER: return TRP_NUMBER;
+        case SCHEMA_BOOLEAN: return TRP_BOOL;
+        case SCHEMA_OBJECT: return TRP_OBJECT;
+        case SCHEMA_ARRAY: return TRP_ARRAY;
+        case SCHEMA_NULL: return TRP_NULL;
+        default: return TRP_ERROR;
+    }
+}
+
+TrpSchemaUnion::TrpSchemaUnion( void ) : mode(UNION_ANY_OF) {}
+
+TrpSchemaUnion& TrpSchemaUnion::branch( TrpSchema* schema ) {
+    return branch( std::string(), schema );
+}
+
+TrpSchemaUnion& TrpSchemaUnion::discriminator( const std::string& _key ) {
+    key = _key;
+    return *this;
+}
+
+TrpSchemaUnion& TrpSchemaUnion::branch( const std::string& tag, TrpSchema* schema ) {
+    if ( !schema ) return *this;
+    if ( !tag.empty() && std::find( tags.begin(), tags.end(), tag ) != tags.end() ) {
+        if ( duplicate_tag.empty() ) duplicate_tag = tag;
+        return *this;
+    }
+
+    branches.push_back( schema );
+    tags.push_back( tag );
+    indexBranches();
+    return *this;
+}
+
+// Untagged branches by type, tagged ones by tag
+void TrpSchemaUnion::indexBranches( void ) {
+    std::vector<std::string> values;
+
+    for ( size_t t = 0; t < TRP_UNION_TYPES; t++ ) by_type[t].clear();
+    for ( size_t i = 0; i < branches.size(); i++ ) {
+        if ( !tags[i].empty() ) {
+            values.push_back( tags[i] );
+            continue;
+        }
+
+        TrpJsonType type = branchType( branches[i] );
+        for ( size_t t = 0; t < TRP_UNION_TYPES; t++ ) {
+            if ( type == TRP_ERROR || static_cast<size_t>(type) == t ) by_type[t].push_back( i );
+        }
+    }
+
+    tag_set.assign( values );
+    tag_branch.assign( tag_set.size(), 0 );
+    for ( size_t i = 0; i < branches.size(); i++ ) {
+        size_t slot;
+        if ( !tags[i].empty() && tag_set.find( tags[i].data(), tags[i].size(), slot ) ) tag_branch[slot] = i;
+    }
+}
+
+TrpUnionPick TrpSchemaUnion::pickUntagged( TrpJsonType type, size_t& index ) const {
+    if ( static_cast<size_t>(type) >= TRP_UNION_TYPES || by_type[type].empty() ) return UNION_NONE;
+    if ( by_type[type].size() > 1 ) return UNION_TRY;
+
+    index = by_type[type][0];
+    return UNION_BRANCH;
+}
+
+TrpUnionPick TrpSchemaUnion::pickType( TrpJsonType type, size_t& index ) const {
+    if ( type == TRP_OBJECT && !tag_branch.empty() ) return UNION_TRY;
+    return pickUntagged( type, index );
+}
+
+TrpUnionPick TrpSchemaUnion::pick( ITrpJsonValue* value, TrpValidatorContext& ctx, size_t& index ) const {
+    TrpJsonType type = value ? value->getType() : TRP_ERROR;
+
+    if ( type == TRP_OBJECT && !tag_branch.empty() ) {
+        ITrpJsonValue* tag = static_cast<TrpJsonObject*>(value)->find( key );
+
+        if ( !tag ) return pickObject( TRP_ERROR, NULL, 0, ctx, index );
+        if ( tag->getType() != TRP_STRING ) return pickObject( tag->getType(), NULL, 0, ctx, index );
+
+        const std::string& str = static_cast<TrpJsonString*>(tag)->getValue();
+        return pickObject( TRP_STRING, str.data(), str.size(), ctx, index );
+    }
+
+    TrpUnionPick found = pickUntagged( type, index );
+    if ( found == UNION_NONE ) reportType( type, ctx );
+    return found;
+}
+
+// An object without a known tag still goes to the untagged object branches,
+// if there are any
+TrpUnionPick TrpSchemaUnion::pickObject( TrpJsonType tag_type, const char* tag, size_t size, TrpValidatorContext& ctx, size_t& index ) const {
+    size_t slot;
+
+    if ( tag_type == TRP_STRING && tag_set.find( tag, size, slot ) ) {
+        index = tag_branch[slot];
+        return UNION_BRANCH;
+    }
+
+    if ( by_type[TRP_OBJECT].empty() ) {
+        if ( tag_type != TRP_ERROR ) ctx.pushError( ERR_UNION_TAG, this, key );
+        else ctx.pushMissing( this, key );
+        return UNION_NONE;
+    }
+    return pickUntagged( TRP_OBJECT, index );
+}
+
+void TrpSchemaUnion::reportType( TrpJsonType actual, TrpValidatorContext& ctx ) const {
+    unsigned int mask = 0;
+
+    for ( size_t t = 0; t < TRP_UNION_TYPES; t++ ) {
+        if ( !by_type[t].empty() || (t == TRP_OBJECT && !tag_branch.empty()) ) mask |= 1u << t;
+    }
+    ctx.pushError( ERR_UNION_TYPE, this, mask, actual );
+}
+
+// The fallback for branches that share the value's type: anyOf stops at
+// the first match, oneOf needs to know there is no second one.
+bool TrpSchemaUnion::tryBranches( ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
+    const std::vector<size_t>& candidates = by_type[value->getType()];
+    TrpValidatorContext scratch( true );    // one per value, cleared per branch
+    size_t matches = 0;
+
+    for ( size_t i = 0; i < candidates.size() && matches < 2; i++ ) {
+        scratch.clear();
+        if ( branches[candidates[i]]->validate( value, scratch ) ) {
+            matches++;
+            if ( mode == UNION_ANY_OF ) return true;
+        }
+    }
+
+    return reportTrial( matches, candidates.size(), ctx );
+}
+
+bool TrpSchemaUnion::reportTrial( size_t matches, size_t tried, TrpValidatorContext& ctx ) const {
+    if ( matches == 1 ) return true;
+    if ( matches ) ctx.pushError( ERR_UNION_AMBIGUOUS, this );
+    else ctx.pushError( ERR_UNION_NO_MATCH, this, tried );
+    return false;
+}
+
+bool TrpSchemaUnion::validate( ITrpJsonValue* value, TrpValidatorContext& ctx ) const {
+    size_t index;
+
+    switch (pick( value, ctx, index )) {
+        case UNION_BRANCH:
+            return branches[index]->validate( value, ctx );
+        case UNION_TRY:
+            return tryBranches( value, ctx );
+        default:
+            return false;
+    }
+}
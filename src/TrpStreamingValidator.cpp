@@ -0,0 +1,472 @@
+#include "../include/TrpStreamingValidator.hpp"
+#include "../include/TrpBufferParser.hpp"
+#include <algorithm>
+#include <functional>
+
+static TrpJsonType tokenToJsonType( TrpTokenType type ) {
+    switch (type) {
+        case T_BRACE_OPEN: return TRP_OBJECT;
+        case T_BRACKET_OPEN: return TRP_ARRAY;
+        case T_STRING: return TRP_STRING;
+        case T_NUMBER: return TRP_NUMBER;
+        case T_TRUE:
+        case T_FALSE: return TRP_BOOL;
+        case T_NULL: return TRP_NULL;
+        default: return TRP_ERROR;
+    }
+}
+
+static TrpJsonType schemaToJsonType( SchemaType type ) {
+    switch (type) {
+        case SCHEMA_STRING: return TRP_STRING;
+        case SCHEMA_NUMBER: return TRP_NUMBER;
+        case SCHEMA_BOOLEAN: return TRP_BOOL;
+        case SCHEMA_OBJECT: return TRP_OBJECT;
+        case SCHEMA_ARRAY: return TRP_ARRAY;
+        case SCHEMA_NULL: return TRP_NULL;
+        default: return TRP_ERROR;
+    }
+}
+
+// A scalar as TrpBufferParser builds it, or an empty container
+static ITrpJsonValue* makeValue( const token& tok ) {
+    switch (tok.type) {
+        case T_BRACE_OPEN: return new TrpJsonObject();
+        case T_BRACKET_OPEN: return new TrpJsonArray();
+        case T_STRING: return new TrpJsonString( tok.value );
+        case T_NUMBER: return new TrpJsonNumber( std::strtod( tok.value.c_str(), NULL ) );
+        case T_TRUE: return new TrpJsonBool( true );
+        case T_FALSE: return new TrpJsonBool( false );
+        default: return new TrpJsonNull();
+    }
+}
+
+// Values only the whole subtree can decide: untried union branches, and
+// arrays whose items are compared (uniq) or counted first (tuple)
+static bool needsValue( const TrpSchema* schema, TrpJsonType actual ) {
+    if ( schema->getType() == SCHEMA_UNION ) return true;
+    if ( actual != TRP_ARRAY || schema->getType() != SCHEMA_ARRAY ) return false;
+
+    const TrpSchemaArray* arr = static_cast<const TrpSchemaArray*>(schema);
+    return arr->isUniq() || !arr->getTuple().empty();
+}
+
+// Adds `key` to the sorted `keys`, false when it is there already
+static bool addKey( std::vector<const std::string*>& keys, const std::string* key ) {
+    std::vector<const std::string*>::iterator it =
+        std::lower_bound( keys.begin(), keys.end(), key, std::less<const std::string*>() );
+
+    if ( it != keys.end() && *it == key ) return false;
+    keys.insert( it, key );
+    return true;
+}
+
+TrpStreamingValidator::TrpStreamingValidator( const TrpSchema& _root )
+    : root(_root), ctx(NULL), depth(0), expect(EXPECT_VALUE),
+    done(true), failed(false), syntax_error(false), scanning(false),
+    repeated(false), first_error(0), capture_schema(NULL), capture_depth(0) {}
+
+TrpStreamingValidator::~TrpStreamingValidator( void ) {
+    dropCapture();
+}
+
+void TrpStreamingValidator::dropCapture( void ) {
+    if ( capture_stack.empty() ) return;
+    delete capture_stack[0];
+    capture_stack.clear();
+}
+
+void TrpStreamingValidator::begin( TrpValidatorContext& _ctx ) {
+    dropCapture();
+    ctx = &_ctx;
+    depth = 0;
+    expect = EXPECT_VALUE;
+    done = false;
+    failed = false;
+    syntax_error = false;
+    scanning = false;
+    repeated = false;
+    first_error = _ctx.errorCount();
+    last_err = token();
+}
+
+bool TrpStreamingValidator::syntaxError( const token& tok, const std::string& msg ) {
+    last_err = tok;
+    if ( tok.type != T_ERROR ) {
+        last_err.type = T_ERROR;
+        last_err.value = msg;
+    }
+    syntax_error = true;
+    done = true;
+    dropCapture();
+    return false;
+}
+
+// Called once a value (scalar or container) is fully consumed. Propagates
+// the failure to the enclosing container and stops early when the context
+// has no error budget left.
+bool TrpStreamingValidator::endValue( bool ok ) {
+    if ( !ok ) {
+        if ( depth ) frames[depth - 1].failed = true;
+        else failed = true;
+    }
+    if ( (!ok || scanning) && !readOn() ) return false;
+
+    expect = depth ? EXPECT_COMMA_OR_END : EXPECT_EOF;
+    return true;
+}
+
+// With the error budget spent the document has failed, but a key repeated
+// later in an object still open would replace a value that failed: those
+// objects are read on for their keys. False once nothing is left to read.
+bool TrpStreamingValidator::readOn( void ) {
+    if ( ctx->shouldContinue() ) return true;
+
+    failed = true;
+    scanning = true;
+    for ( size_t i = 0; i < depth; i++ ) {
+        if ( frames[i].is_object && frames[i].schema ) return true;
+    }
+    done = true;
+    return false;
+}
+
+// The value already validated for the key is not the one the tree keeps
+bool TrpStreamingValidator::repeatedKey( void ) {
+    while ( depth ) {
+        if ( frames[--depth].pushed_path ) ctx->popPath();
+    }
+    dropCapture();
+    repeated = true;
+    done = true;
+    return false;
+}
+
+// The tree's verdict on the document, in place of the pass's
+bool TrpStreamingValidator::validateTree( bool parsed, ITrpJsonValue* document, const token& err ) {
+    ctx->dropErrors( first_error );
+    if ( !parsed ) return syntaxError( err, err.value );
+
+    failed = !root.validate( document, *ctx );
+    expect = EXPECT_EOF;
+    return !failed;
+}
+
+bool TrpStreamingValidator::checkScalar( const token& tok, const TrpSchema* schema ) {
+    switch (schema->getType()) {
+        case SCHEMA_STRING:
+            return static_cast<const TrpSchemaString*>(schema)->checkString( tok.value, *ctx );
+        case SCHEMA_NUMBER:
+            return static_cast<const TrpSchemaNumber*>(schema)->checkNumber(
+                std::strtod(tok.value.c_str(), NULL), *ctx );
+        case SCHEMA_BOOLEAN:
+            return static_cast<const TrpSchemaBool*>(schema)->checkValue( tok.type == T_TRUE, *ctx );
+        default:
+            return true;
+    }
+}
+
+// Replaces a union by the branch the token type selects. Stays on the union
+// when its branches must be tried on the whole value, NULL and false
+// (reported) when no branch takes the type.
+bool TrpStreamingValidator::resolveUnion( const TrpSchema*& schema, TrpJsonType actual ) {
+    while ( schema && schema->getType() == SCHEMA_UNION ) {
+        const TrpSchemaUnion* uni = static_cast<const TrpSchemaUnion*>(schema);
+        size_t branch;
+
+        switch (uni->pickType( actual, branch )) {
+            case UNION_BRANCH:
+                schema = uni->getBranches()[branch];
+                break;
+            case UNION_NONE:
+                uni->reportType( actual, *ctx );
+                schema = NULL;
+                return false;
+            default:
+                return true;
+        }
+    }
+    return true;
+}
+
+// Starts buffering the value `tok` opens for `schema`; a scalar is checked
+// right away
+bool TrpStreamingValidator::deferValue( const token& tok, const TrpSchema* schema, bool pushed ) {
+    ITrpJsonValue* value = makeValue( tok );
+
+    if ( tok.type == T_BRACE_OPEN || tok.type == T_BRACKET_OPEN ) {
+        openContainer( tok, NULL, pushed );
+        capture_schema = schema;
+        capture_depth = depth;
+        capture_stack.push_back( value );
+        return true;
+    }
+
+    bool ok = schema->validate( value, *ctx );
+    delete value;
+    if ( pushed ) ctx->popPath();
+    return endValue( ok );
+}
+
+// A value inside the one being buffered
+bool TrpStreamingValidator::captureValue( const token& tok ) {
+    Frame& parent = frames[depth - 1];
+    ITrpJsonValue* value = makeValue( tok );
+
+    if ( parent.is_object ) {
+        static_cast<TrpJsonObject*>(capture_stack.back())->add( capture_key, value );
+    } else {
+        parent.count++;
+        static_cast<TrpJsonArray*>(capture_stack.back())->add( value );
+    }
+
+    if ( tok.type == T_BRACE_OPEN || tok.type == T_BRACKET_OPEN ) {
+        capture_stack.push_back( value );
+        return openContainer( tok, NULL, false );
+    }
+    return endValue( true );
+}
+
+bool TrpStreamingValidator::finishCapture( void ) {
+    ITrpJsonValue* value = capture_stack[0];
+
+    capture_stack.clear();
+    bool ok = capture_schema->validate( value, *ctx );
+    delete value;
+
+    if ( frames[depth - 1].pushed_path ) ctx->popPath();
+    depth--;
+    return endValue( ok );
+}
+
+bool TrpStreamingValidator::openContainer( const token& tok, const TrpSchema* schema, bool pushed ) {
+    if ( depth == frames.size() ) frames.push_back( Frame() );
+
+    Frame& frame = frames[depth++];
+
+    frame.schema = schema;
+    frame.is_object = tok.type == T_BRACE_OPEN;
+    frame.pushed_path = pushed;
+    frame.failed = false;
+    frame.count = 0;
+    frame.next = NULL;
+    frame.next_key = NULL;
+    frame.next_declared = false;
+    frame.seen.clear();
+    frame.declared.clear();
+    frame.undeclared.clear();
+
+    if ( schema && frame.is_object ) {
+        frame.seen.resize( static_cast<const TrpSchemaObject*>(schema)->getRequired().size(), 0 );
+    }
+
+    expect = frame.is_object ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+    return true;
+}
+
+bool TrpStreamingValidator::beginValue( const token& tok ) {
+    TrpJsonType actual = tokenToJsonType( tok.type );
+    const TrpSchema* schema = NULL;
+    bool pushed = false;
+    bool ok = true;
+
+    if ( actual == TRP_ERROR ) return syntaxError( tok, "Unexpected token, expected a value" );
+    if ( !capture_stack.empty() ) return captureValue( tok );
+    if ( scanning ) {
+        if ( tok.type == T_BRACE_OPEN || tok.type == T_BRACKET_OPEN ) return openContainer( tok, NULL, false );
+        return endValue( true );
+    }
+
+    size_t index = 0;
+    if ( !depth ) {
+        schema = &root;
+    } else {
+        Frame& parent = frames[depth - 1];
+        index = parent.count;
+
+        if ( parent.is_object ) {
+            schema = parent.next;
+            if ( parent.next_declared && !schema ) parent.failed = true;
+            if ( schema ) {
+                ctx->pushKey( *parent.next_key );
+                pushed = true;
+            }
+        } else {
+            parent.count++;
+            if ( parent.schema ) {
+                schema = static_cast<const TrpSchemaArray*>(parent.schema)->getItem();
+                if ( schema ) {
+                    ctx->pushIndex( index );
+                    pushed = true;
+                }
+            }
+        }
+    }
+
+    if ( schema && !resolveUnion( schema, actual ) ) ok = false;
+    if ( schema && needsValue( schema, actual ) ) return deferValue( tok, schema, pushed );
+    if ( schema && schemaToJsonType( schema->getType() ) != actual ) {
+        ctx->pushTypeError( schema, schema->getType(), actual );
+        schema = NULL;
+        ok = false;
+    }
+
+    if ( tok.type == T_BRACE_OPEN || tok.type == T_BRACKET_OPEN ) {
+        if ( !ok ) {
+            if ( pushed ) ctx->popPath();
+            pushed = false;
+            if ( depth ) frames[depth - 1].failed = true;
+            else failed = true;
+            if ( !readOn() ) return false;
+        }
+        return openContainer( tok, schema, pushed );
+    }
+
+    if ( schema && !checkScalar( tok, schema ) ) ok = false;
+    if ( pushed ) ctx->popPath();
+
+    return endValue( ok );
+}
+
+bool TrpStreamingValidator::closeContainer( void ) {
+    if ( !capture_stack.empty() ) {
+        if ( depth == capture_depth ) return finishCapture();
+        capture_stack.pop_back();
+        depth--;
+        return endValue( true );
+    }
+
+    Frame& frame = frames[depth - 1];
+    bool ok = !frame.failed;
+
+    if ( frame.schema && ctx->shouldContinue() ) {
+        if ( frame.is_object ) {
+            const TrpSchemaObject* obj = static_cast<const TrpSchemaObject*>(frame.schema);
+
+            if ( !obj->checkSize( frame.count, *ctx ) ) ok = false;
+            for ( size_t i = 0; i < frame.seen.size() && ctx->shouldContinue(); i++ ) {
+                if ( !frame.seen[i] ) {
+                    obj->reportMissing( obj->getRequired()[i], *ctx );
+                    ok = false;
+                }
+            }
+        } else {
+            const TrpSchemaArray* arr = static_cast<const TrpSchemaArray*>(frame.schema);
+
+            if ( !arr->checkSize( frame.count, *ctx ) ) ok = false;
+        }
+    }
+
+    if ( frame.pushed_path ) ctx->popPath();
+    depth--;
+
+    return endValue( ok );
+}
+
+bool TrpStreamingValidator::feed( const token& tok ) {
+    if ( done ) return false;
+    if ( tok.type == T_ERROR ) return syntaxError( tok, tok.value );
+
+    switch (expect) {
+        case EXPECT_EOF:
+            if ( tok.type != T_END_OF_FILE ) return syntaxError( tok, "Unexpected token after document" );
+            done = true;
+            return false;
+
+        case EXPECT_VALUE_OR_END:
+            if ( tok.type == T_BRACKET_CLOSE ) return closeContainer();
+            return beginValue( tok );
+
+        case EXPECT_VALUE:
+            return beginValue( tok );
+
+        case EXPECT_KEY_OR_END:
+            if ( tok.type == T_BRACE_CLOSE ) return closeContainer();
+            /* fall through */
+        case EXPECT_KEY: {
+            if ( tok.type != T_STRING ) return syntaxError( tok, "Expected property name" );
+
+            Frame& frame = frames[depth - 1];
+            frame.count++;
+            if ( !capture_stack.empty() ) capture_key = tok.value;
+            frame.next = NULL;
+            frame.next_key = NULL;
+            frame.next_declared = false;
+
+            if ( frame.schema ) {
+                const TrpSchemaObject* obj = static_cast<const TrpSchemaObject*>(frame.schema);
+                std::map<std::string, TrpSchema*>::const_iterator it = obj->getProperties().find( tok.value );
+
+                if ( it != obj->getProperties().end() ) {
+                    if ( !addKey( frame.declared, &it->first ) ) return repeatedKey();
+                    frame.next = it->second;
+                    frame.next_key = &it->first;
+                    frame.next_declared = true;
+                } else if ( (obj->hasMin() || obj->hasMax()) && !frame.undeclared.insert( tok.value ).second ) {
+                    frame.count--;          // counted once, as in the tree
+                }
+                for ( size_t i = 0; i < frame.seen.size(); i++ ) {
+                    if ( obj->getRequired()[i] == tok.value ) frame.seen[i] = 1;
+                }
+            }
+            expect = EXPECT_COLON;
+            return true;
+        }
+
+        case EXPECT_COLON:
+            if ( tok.type != T_COLON ) return syntaxError( tok, "Expected ':' after property name" );
+            expect = EXPECT_VALUE;
+            return true;
+
+        case EXPECT_COMMA_OR_END: {
+            bool is_object = frames[depth - 1].is_object;
+
+            if ( tok.type == T_COMMA ) {
+                expect = is_object ? EXPECT_KEY : EXPECT_VALUE;
+                return true;
+            }
+            if ( tok.type == (is_object ? T_BRACE_CLOSE : T_BRACKET_CLOSE) ) return closeContainer();
+            return syntaxError( tok, is_object ? "Expected ',' or '}'" : "Expected ',' or ']'" );
+        }
+    }
+    return syntaxError( tok, "Unexpected token" );
+}
+
+bool TrpStreamingValidator::isValid( void ) const {
+    return done && !failed && !syntax_error && expect == EXPECT_EOF;
+}
+
+bool TrpStreamingValidator::validate( TrpJsonLexer& lexer, TrpValidatorContext& _ctx ) {
+    begin( _ctx );
+    while ( feed( lexer.getNextToken() ) )
+        ;
+    if ( !repeated ) return isValid();
+
+    TrpJsonParser parser( lexer.getFileName() );
+    bool parsed = parser.parse();
+    return validateTree( parsed, parser.getAST(), parser.getLastError() );
+}
+
+bool TrpStreamingValidator::validate( TrpBufferLexer& lexer, TrpValidatorContext& _ctx ) {
+    begin( _ctx );
+    do {
+        lexer.nextToken( current );
+    } while ( feed( current ) );
+    if ( !repeated ) return isValid();
+
+    TrpBufferParser parser( lexer.data(), lexer.size() );
+    bool parsed = parser.parse();
+    return validateTree( parsed, parser.getAST(), parser.getLastError() );
+}
+
+bool TrpStreamingValidator::hasSyntaxError( void ) const {
+    return syntax_error;
+}
+
+const token& TrpStreamingValidator::getLastError( void ) const {
+    return last_err;
+}
+
+bool TrpStreamingValidator::hasRepeatedKey( void ) const {
+    return repeated;
+}
@@ -0,0 +1,401 @@
+#include "../include/TrpStringFormat.hpp"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define TRP_SSE2 1
+#endif
+
+// AVX2 kernels are compiled for their own target and picked at run time
+#if defined(TRP_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define TRP_AVX2 1
+#endif
+
+enum TrpByteClass
+{
+    CLASS_HEX,          // [0-9a-fA-F]
+    CLASS_BASE64        // [0-9a-zA-Z+/]
+};
+
+static bool isDigit( unsigned char c ) {
+    return c >= '0' && c <= '9';
+}
+
+// `c | 0x20` lowercases letters and maps nothing else onto them
+static bool isAlpha( unsigned char c ) {
+    return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+}
+
+static bool isHex( unsigned char c ) {
+    return isDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+static bool inClass( unsigned char c, TrpByteClass cls ) {
+    if ( cls == CLASS_HEX ) return isHex(c);
+    return isDigit(c) || isAlpha(c) || c == '+' || c == '/';
+}
+
+static bool allInClassScalar( const unsigned char* p, size_t n, TrpByteClass cls ) {
+    for ( size_t i = 0; i < n; i++ ) {
+        if ( !inClass( p[i], cls ) ) return false;
+    }
+    return true;
+}
+
+static size_t utf8LengthScalar( const unsigned char* p, size_t n ) {
+    size_t count = 0;
+
+    for ( size_t i = 0; i < n; i++ ) {
+        if ( (p[i] & 0xc0) != 0x80 ) count++;
+    }
+    return count;
+}
+
+#ifdef TRP_SSE2
+
+// Signed compares: bytes >= 0x80 are negative, so no ASCII range takes them
+static inline __m128i inRange16( __m128i v, char lo, char hi ) {
+    return _mm_and_si128( _mm_cmpgt_epi8( v, _mm_set1_epi8( lo - 1 ) ),
+                          _mm_cmplt_epi8( v, _mm_set1_epi8( hi + 1 ) ) );
+}
+
+static inline __m128i classify16( __m128i v, TrpByteClass cls ) {
+    __m128i folded = _mm_or_si128( v, _mm_set1_epi8( 0x20 ) );
+    __m128i ok = inRange16( v, '0', '9' );
+
+    if ( cls == CLASS_HEX ) return _mm_or_si128( ok, inRange16( folded, 'a', 'f' ) );
+
+    ok = _mm_or_si128( ok, inRange16( folded, 'a', 'z' ) );
+    ok = _mm_or_si128( ok, _mm_cmpeq_epi8( v, _mm_set1_epi8( '+' ) ) );
+    return _mm_or_si128( ok, _mm_cmpeq_epi8( v, _mm_set1_epi8( '/' ) ) );
+}
+
+// 64 bytes per branch
+static bool allInClassSse2( const unsigned char* p, size_t n, TrpByteClass cls ) {
+    size_t i = 0;
+
+    for ( ; i + 64 <= n; i += 64 ) {
+        __m128i ok = classify16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i) ), cls );
+        ok = _mm_and_si128( ok, classify16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i + 16) ), cls ) );
+        ok = _mm_and_si128( ok, classify16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i + 32) ), cls ) );
+        ok = _mm_and_si128( ok, classify16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i + 48) ), cls ) );
+        if ( _mm_movemask_epi8( ok ) != 0xffff ) return false;
+    }
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m128i ok = classify16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i) ), cls );
+        if ( _mm_movemask_epi8( ok ) != 0xffff ) return false;
+    }
+    return allInClassScalar( p + i, n - i, cls );
+}
+
+// Continuation bytes are 0x80..0xbf, -128..-65 signed. Matches are counted
+// in byte lanes, summed with psadbw before a lane can overflow.
+static size_t utf8LengthSse2( const unsigned char* p, size_t n ) {
+    const __m128i continuation = _mm_set1_epi8( -65 );
+    size_t count = 0, i = 0;
+
+    while ( i + 16 <= n ) {
+        __m128i lanes = _mm_setzero_si128();
+
+        for ( size_t rounds = 0; i + 16 <= n && rounds < 255; i += 16, rounds++ ) {
+            __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i) );
+            lanes = _mm_sub_epi8( lanes, _mm_cmpgt_epi8( v, continuation ) );
+        }
+
+        __m128i sums = _mm_sad_epu8( lanes, _mm_setzero_si128() );
+        count += _mm_cvtsi128_si32( sums ) + _mm_cvtsi128_si32( _mm_srli_si128( sums, 8 ) );
+    }
+    return count + utf8LengthScalar( p + i, n - i );
+}
+
+#endif
+
+#ifdef TRP_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i inRange32( __m256i v, char lo, char hi ) {
+    return _mm256_and_si256( _mm256_cmpgt_epi8( v, _mm256_set1_epi8( lo - 1 ) ),
+                             _mm256_cmpgt_epi8( _mm256_set1_epi8( hi + 1 ), v ) );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i classify32( __m256i v, TrpByteClass cls ) {
+    __m256i folded = _mm256_or_si256( v, _mm256_set1_epi8( 0x20 ) );
+    __m256i ok = inRange32( v, '0', '9' );
+
+    if ( cls == CLASS_HEX ) return _mm256_or_si256( ok, inRange32( folded, 'a', 'f' ) );
+
+    ok = _mm256_or_si256( ok, inRange32( folded, 'a', 'z' ) );
+    ok = _mm256_or_si256( ok, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '+' ) ) );
+    return _mm256_or_si256( ok, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '/' ) ) );
+}
+
+__attribute__((target("avx2")))
+static bool allInClassAvx2( const unsigned char* p, size_t n, TrpByteClass cls ) {
+    size_t i = 0;
+
+    for ( ; i + 128 <= n; i += 128 ) {
+        __m256i ok = classify32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i) ), cls );
+        ok = _mm256_and_si256( ok, classify32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i + 32) ), cls ) );
+        ok = _mm256_and_si256( ok, classify32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i + 64) ), cls ) );
+        ok = _mm256_and_si256( ok, classify32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i + 96) ), cls ) );
+        if ( _mm256_movemask_epi8( ok ) != -1 ) return false;
+    }
+    for ( ; i + 32 <= n; i += 32 ) {
+        __m256i ok = classify32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i) ), cls );
+        if ( _mm256_movemask_epi8( ok ) != -1 ) return false;
+    }
+    return allInClassSse2( p + i, n - i, cls );
+}
+
+__attribute__((target("avx2")))
+static size_t utf8LengthAvx2( const unsigned char* p, size_t n ) {
+    const __m256i continuation = _mm256_set1_epi8( -65 );
+    size_t count = 0, i = 0;
+
+    while ( i + 32 <= n ) {
+        __m256i lanes = _mm256_setzero_si256();
+
+        for ( size_t rounds = 0; i + 32 <= n && rounds < 255; i += 32, rounds++ ) {
+            __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + i) );
+            lanes = _mm256_sub_epi8( lanes, _mm256_cmpgt_epi8( v, continuation ) );
+        }
+
+        __m256i sums = _mm256_sad_epu8( lanes, _mm256_setzero_si256() );
+        __m128i half = _mm_add_epi64( _mm256_castsi256_si128( sums ), _mm256_extracti128_si256( sums, 1 ) );
+        count += _mm_cvtsi128_si32( half ) + _mm_cvtsi128_si32( _mm_srli_si128( half, 8 ) );
+    }
+    return count + utf8LengthSse2( p + i, n - i );
+}
+
+static bool hasAvx2( void ) {
+    static const bool avx2 = ( __builtin_cpu_init(), __builtin_cpu_supports( "avx2" ) != 0 );
+    return avx2;
+}
+
+#endif
+
+static bool allInClass( const unsigned char* p, size_t n, TrpByteClass cls ) {
+#if defined(TRP_AVX2)
+    if ( n >= 32 && hasAvx2() ) return allInClassAvx2( p, n, cls );
+#endif
+#if defined(TRP_SSE2)
+    return allInClassSse2( p, n, cls );
+#else
+    return allInClassScalar( p, n, cls );
+#endif
+}
+
+size_t trpUtf8Length( const char* data, size_t size ) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+#if defined(TRP_AVX2)
+    if ( size >= 32 && hasAvx2() ) return utf8LengthAvx2( p, size );
+#endif
+#if defined(TRP_SSE2)
+    return utf8LengthSse2( p, size );
+#else
+    return utf8LengthScalar( p, size );
+#endif
+}
+
+#define TRP_UUID_DASHES ((1u << 8) | (1u << 13) | (1u << 18) | (1u << 23))
+
+// Two blocks give the hex and dash masks of the first 32 bytes at once
+static bool isUuid( const unsigned char* p, size_t n ) {
+    if ( n != 36 ) return false;
+
+#ifdef TRP_SSE2
+    __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+    __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + 16) );
+    unsigned int hex = _mm_movemask_epi8( classify16( a, CLASS_HEX ) )
+        | (static_cast<unsigned int>(_mm_movemask_epi8( classify16( b, CLASS_HEX ) )) << 16);
+    unsigned int dash = _mm_movemask_epi8( _mm_cmpeq_epi8( a, _mm_set1_epi8( '-' ) ) )
+        | (static_cast<unsigned int>(_mm_movemask_epi8( _mm_cmpeq_epi8( b, _mm_set1_epi8( '-' ) ) )) << 16);
+
+    if ( dash != TRP_UUID_DASHES || (hex | dash) != 0xffffffffu ) return false;
+    return allInClassScalar( p + 32, 4, CLASS_HEX );
+#else
+    for ( size_t i = 0; i < n; i++ ) {
+        bool want_dash = i < 32 && (TRP_UUID_DASHES & (1u << i));
+        if ( want_dash ? p[i] != '-' : !isHex( p[i] ) ) return false;
+    }
+    return true;
+#endif
+}
+
+static bool isIpv4( const unsigned char* p, size_t n ) {
+    size_t i = 0;
+
+    for ( int part = 0; part < 4; part++ ) {
+        if ( part ) {
+            if ( i >= n || p[i] != '.' ) return false;
+            i++;
+        }
+
+        size_t start = i;
+        unsigned int value = 0;
+        while ( i < n && isDigit( p[i] ) && i - start < 3 ) value = value * 10 + (p[i++] - '0');
+        if ( i == start || value > 255 || (i - start > 1 && p[start] == '0') ) return false;
+    }
+    return i == n;
+}
+
+// Up to 8 groups of 1-4 hex digits; one "::" stands for at least one zero
+// group; a dotted quad may replace the last two groups
+static bool isIpv6( const unsigned char* p, size_t n ) {
+    size_t groups = 0, i = 0;
+    bool compressed = false;
+
+    if ( n < 2 ) return false;
+    if ( p[0] == ':' ) {
+        if ( p[1] != ':' ) return false;
+        compressed = true;
+        i = 2;
+    }
+
+    while ( i < n ) {
+        size_t end = i;
+        while ( end < n && isHex( p[end] ) && end - i < 5 ) end++;
+
+        if ( end < n && p[end] == '.' ) {
+            if ( groups > 6 || !isIpv4( p + i, n - i ) ) return false;
+            groups += 2;
+            break;
+        }
+        if ( end == i || end - i > 4 ) return false;
+        groups++;
+        i = end;
+        if ( i == n ) break;
+
+        if ( p[i++] != ':' || i == n ) return false;
+        if ( p[i] == ':' ) {
+            if ( compressed ) return false;
+            compressed = true;
+            i++;
+        }
+    }
+    return compressed ? groups <= 7 : groups == 8;
+}
+
+static bool readDigits( const unsigned char* p, size_t count, unsigned int& value ) {
+    value = 0;
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( !isDigit( p[i] ) ) return false;
+        value = value * 10 + (p[i] - '0');
+    }
+    return true;
+}
+
+// YYYY-MM-DDTHH:MM:SS[.frac](Z|+HH:MM|-HH:MM), T and Z in either case,
+// with real calendar days and a leap second allowed
+static bool isDateTime( const unsigned char* p, size_t n ) {
+    static const unsigned int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    unsigned int year, month, day, hour, minute, second;
+
+    if ( n < 20 ) return false;
+    if ( !readDigits( p, 4, year ) || p[4] != '-' || !readDigits( p + 5, 2, month )
+        || p[7] != '-' || !readDigits( p + 8, 2, day ) || (p[10] | 0x20) != 't'
+        || !readDigits( p + 11, 2, hour ) || p[13] != ':' || !readDigits( p + 14, 2, minute )
+        || p[16] != ':' || !readDigits( p + 17, 2, second ) ) return false;
+
+    size_t i = 19;
+    if ( p[i] == '.' ) {
+        size_t start = ++i;
+        while ( i < n && isDigit( p[i] ) ) i++;
+        if ( i == start ) return false;
+    }
+
+    if ( i < n && (p[i] | 0x20) == 'z' ) {
+        i++;
+    } else if ( i < n && (p[i] == '+' || p[i] == '-') ) {
+        unsigned int offset_hour, offset_minute;
+        if ( n - i != 6 || !readDigits( p + i + 1, 2, offset_hour ) || p[i + 3] != ':'
+            || !readDigits( p + i + 4, 2, offset_minute ) || offset_hour > 23 || offset_minute > 59 ) return false;
+        i += 6;
+    } else {
+        return false;
+    }
+    if ( i != n ) return false;
+
+    if ( month < 1 || month > 12 || day < 1 ) return false;
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    unsigned int month_days = days[month - 1] + (month == 2 && leap ? 1 : 0);
+    return day <= month_days && hour <= 23 && minute <= 59 && second <= 60;
+}
+
+static bool isAtext( unsigned char c ) {
+    static const char specials[] = "!#$%&'*+/=?^_`{|}~-";
+
+    if ( isDigit(c) || isAlpha(c) ) return true;
+    for ( const char* s = specials; *s; s++ ) {
+        if ( c == static_cast<unsigned char>(*s) ) return true;
+    }
+    return false;
+}
+
+// dot-atom local part (RFC 5322) @ host name (RFC 1123 labels)
+static bool isEmail( const unsigned char* p, size_t n ) {
+    size_t at = 0;
+
+    while ( at < n && p[at] != '@' ) at++;
+    if ( at == 0 || at > 64 || at == n || n - at - 1 > 253 ) return false;
+
+    for ( size_t i = 0; i < at; i++ ) {
+        if ( p[i] == '.' ) {
+            if ( i == 0 || i == at - 1 || p[i - 1] == '.' ) return false;
+        } else if ( !isAtext( p[i] ) ) {
+            return false;
+        }
+    }
+
+    size_t label = 0;
+    for ( size_t i = at + 1; i < n; i++ ) {
+        if ( p[i] == '.' ) {
+            if ( !label || p[i - 1] == '-' ) return false;
+            label = 0;
+        } else if ( isDigit( p[i] ) || isAlpha( p[i] ) || p[i] == '-' ) {
+            if ( (!label && p[i] == '-') || ++label > 63 ) return false;
+        } else {
+            return false;
+        }
+    }
+    return label && p[n - 1] != '-';
+}
+
+static bool isBase64( const unsigned char* p, size_t n ) {
+    size_t body = n;
+
+    if ( n % 4 ) return false;
+    if ( body && p[body - 1] == '=' ) body--;
+    if ( body && p[body - 1] == '=' ) body--;
+    return allInClass( p, body, CLASS_BASE64 );
+}
+
+bool trpCheckFormat( TrpStringFormat format, const char* data, size_t size ) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+    switch (format) {
+        case FORMAT_UUID: return isUuid( p, size );
+        case FORMAT_IPV4: return isIpv4( p, size );
+        case FORMAT_IPV6: return isIpv6( p, size );
+        case FORMAT_DATE_TIME: return isDateTime( p, size );
+        case FORMAT_EMAIL: return isEmail( p, size );
+        case FORMAT_HEX: return allInClass( p, size, CLASS_HEX );
+        case FORMAT_BASE64: return isBase64( p, size );
+        default: return true;
+    }
+}
+
+const char* trpFormatName( TrpStringFormat format ) {
+    switch (format) {
+        case FORMAT_UUID: return "uuid";
+        case FORMAT_IPV4: return "ipv4";
+        case FORMAT_IPV6: return "ipv6";
+        case FORMAT_DATE_TIME: return "date-time";
+        case FORMAT_EMAIL: return "email";
+        case FORMAT_HEX: return "hex";
+        case FORMAT_BASE64: return "base64";
+        default: return "string";
+    }
+}
@@ -0,0 +1,53 @@
+#include "../include/TrpTape.hpp"
+#include <cstring>
+
+// Keeps the capacity, a tape is refilled document after document
+void TrpTape::clear( void ) {
+    words.clear();
+    strings.clear();
+}
+
+TrpJsonType TrpTape::type( size_t index ) const {
+    switch (tag( index )) {
+        case TAPE_OBJECT: return TRP_OBJECT;
+        case TAPE_ARRAY: return TRP_ARRAY;
+        case TAPE_STRING: return TRP_STRING;
+        case TAPE_NUMBER: return TRP_NUMBER;
+        case TAPE_TRUE:
+        case TAPE_FALSE: return TRP_BOOL;
+        case TAPE_NULL: return TRP_NULL;
+        default: return TRP_ERROR;
+    }
+}
+
+size_t TrpTape::next( size_t index ) const {
+    switch (tag( index )) {
+        case TAPE_OBJECT:
+        case TAPE_ARRAY: return payload( index );
+        case TAPE_NUMBER: return index + 2;
+        default: return index + 1;
+    }
+}
+
+double TrpTape::number( size_t index ) const {
+    double nbr;
+
+    std::memcpy( &nbr, &words[index + 1], sizeof(nbr) );
+    return nbr;
+}
+
+const char* TrpTape::string( size_t index, size_t& length ) const {
+    const char* data = strings.data() + payload( index );
+    uint32_t size;
+
+    std::memcpy( &size, data, sizeof(size) );
+    length = size;
+    return data + sizeof(size);
+}
+
+std::string TrpTape::stringValue( size_t index ) const {
+    size_t length;
+    const char* data = string( index, length );
+
+    return std::string( data, length );
+}
@@ -0,0 +1,184 @@
+#include "../include/TrpTapeParser.hpp"
+#include <cstdlib>
+#include <cstring>
+
+TrpTapeParser::TrpTapeParser( void ) : lexer(NULL, 0), input_size(0), parsed(false) {}
+
+TrpTapeParser::TrpTapeParser( const char* _data, size_t _size )
+    : lexer(_data, _size), input_size(_size), parsed(false) {}
+
+TrpTapeParser::TrpTapeParser( const std::string& _data )
+    : lexer(_data), input_size(_data.size()), parsed(false) {}
+
+bool TrpTapeParser::openFile( const std::string& file_name ) {
+    tape.clear();
+    parsed = false;
+    lexer.reset( NULL, 0 );
+    input_size = 0;
+    if ( !file.open( file_name ) ) {
+        last_err.type = T_ERROR;
+        last_err.value = file.getError();
+        last_err.line = last_err.col = 0;
+        return false;
+    }
+    lexer.reset( file.data(), file.size() );
+    input_size = file.size();
+    return true;
+}
+
+void TrpTapeParser::setBuffer( const char* _data, size_t _size ) {
+    tape.clear();
+    parsed = false;
+    file.close();
+    lexer.reset( _data, _size );
+    input_size = _size;
+}
+
+// The first parse sizes the tape from the input: a word per four bytes and
+// half the input for strings covers most documents in one allocation each
+bool TrpTapeParser::parse( void ) {
+    tape.clear();
+    parsed = false;
+    lexer.reset();
+    if ( tape.words.capacity() < input_size / 4 ) tape.words.reserve( input_size / 4 + 16 );
+    if ( tape.strings.capacity() < input_size / 2 ) tape.strings.reserve( input_size / 2 + 64 );
+
+    lexer.nextToken( current );
+    if ( !parseValue() ) {
+        tape.clear();
+        return false;
+    }
+
+    // parseValue() leaves `current` on the token after the value
+    if ( current.type != T_END_OF_FILE ) {
+        fail( "Unexpected token after document" );
+        tape.clear();
+        return false;
+    }
+
+    parsed = true;
+    return true;
+}
+
+bool TrpTapeParser::fail( const std::string& message ) {
+    last_err = current;
+    if ( current.type != T_ERROR ) {
+        last_err.type = T_ERROR;
+        last_err.value = message;
+    }
+    return false;
+}
+
+void TrpTapeParser::appendWord( TrpTapeTag tag, uint64_t payload ) {
+    tape.words.push_back( (static_cast<uint64_t>(tag) << 56) | (payload & TRP_TAPE_PAYLOAD) );
+}
+
+void TrpTapeParser::appendString( const std::string& value ) {
+    uint32_t size = value.size();
+
+    appendWord( TAPE_STRING, tape.strings.size() );
+    tape.strings.append( reinterpret_cast<const char*>(&size), sizeof(size) );
+    tape.strings.append( value );
+    tape.strings += '\0';
+}
+
+// The end word holds the count, the open word where to jump past the end
+void TrpTapeParser::closeContainer( size_t open, TrpTapeTag tag, size_t count ) {
+    appendWord( tag, count );
+    tape.words[open] |= tape.words.size();
+}
+
+// Appends the value starting at `current` and moves past it
+bool TrpTapeParser::parseValue( void ) {
+    switch (current.type) {
+        case T_BRACE_OPEN:
+            return parseObject();
+        case T_BRACKET_OPEN:
+            return parseArray();
+        case T_STRING:
+            appendString( current.value );
+            break;
+        case T_NUMBER: {
+            double nbr = std::strtod( current.value.c_str(), NULL );
+            uint64_t bits;
+
+            std::memcpy( &bits, &nbr, sizeof(bits) );
+            appendWord( TAPE_NUMBER, 0 );
+            tape.words.push_back( bits );
+            break;
+        }
+        case T_TRUE:
+            appendWord( TAPE_TRUE, 0 );
+            break;
+        case T_FALSE:
+            appendWord( TAPE_FALSE, 0 );
+            break;
+        case T_NULL:
+            appendWord( TAPE_NULL, 0 );
+            break;
+        default:
+            return fail( "Unexpected token, expected a value" );
+    }
+
+    lexer.nextToken( current );
+    return true;
+}
+
+bool TrpTapeParser::parseObject( void ) {
+    size_t open = tape.words.size();
+    size_t members = 0;
+
+    appendWord( TAPE_OBJECT, 0 );
+    lexer.nextToken( current );
+    if ( current.type == T_BRACE_CLOSE ) {
+        closeContainer( open, TAPE_OBJECT_END, 0 );
+        lexer.nextToken( current );
+        return true;
+    }
+
+    for ( ;; ) {
+        if ( current.type != T_STRING ) return fail( "Expected string key in object" );
+        appendString( current.value );
+
+        lexer.nextToken( current );
+        if ( current.type != T_COLON ) return fail( "Expected ':' after object key" );
+
+        lexer.nextToken( current );
+        if ( !parseValue() ) return false;
+        members++;
+
+        if ( current.type == T_BRACE_CLOSE ) break;
+        if ( current.type != T_COMMA ) return fail( "Expected ',' or '}' in object" );
+        lexer.nextToken( current );
+    }
+
+    closeContainer( open, TAPE_OBJECT_END, members );
+    lexer.nextToken( current );
+    return true;
+}
+
+bool TrpTapeParser::parseArray( void ) {
+    size_t open = tape.words.size();
+    size_t size = 0;
+
+    appendWord( TAPE_ARRAY, 0 );
+    lexer.nextToken( current );
+    if ( current.type == T_BRACKET_CLOSE ) {
+        closeContainer( open, TAPE_ARRAY_END, 0 );
+        lexer.nextToken( current );
+        return true;
+    }
+
+    for ( ;; ) {
+        if ( !parseValue() ) return false;
+        size++;
+
+        if ( current.type == T_BRACKET_CLOSE ) break;
+        if ( current.type != T_COMMA ) return fail( "Expected ',' or ']' in array" );
+        lexer.nextToken( current );
+    }
+
+    closeContainer( open, TAPE_ARRAY_END, size );
+    lexer.nextToken( current );
+    return true;
+}
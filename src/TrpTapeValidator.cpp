@@ -0,0 +1,411 @@
+#include "../include/TrpTapeValidator.hpp"
+#include <algorithm>
+#include <cstring>
+
+TrpTapeValidator::TrpTapeValidator( const TrpSchema& _root ) : root(_root), tape(NULL) {}
+
+bool TrpTapeValidator::validate( const TrpTape& _tape, TrpValidatorContext& ctx ) {
+    if ( _tape.empty() ) return true;
+
+    tape = &_tape;
+    members.clear();
+    return validateValue( &root, 0, ctx );
+}
+
+// Same ordering as std::string::compare, which is what JsonObjectMap uses
+static int compareKey( const char* a, size_t a_len, const char* b, size_t b_len ) {
+    int diff = std::memcmp( a, b, a_len < b_len ? a_len : b_len );
+
+    if ( diff ) return diff;
+    if ( a_len < b_len ) return -1;
+    return a_len > b_len ? 1 : 0;
+}
+
+// Repeated keys stay in document order, so the last one is the last of its run
+bool TrpTapeValidator::memberLess( const Member& a, const Member& b ) {
+    int diff = compareKey( a.key, a.length, b.key, b.length );
+    return diff ? diff < 0 : a.value < b.value;
+}
+
+// Appends the object's members to `members`, sorted and with one entry per
+// key. Returns how many, which is the size TrpJsonObject would have.
+size_t TrpTapeValidator::collectMembers( size_t index ) {
+    size_t base = members.size();
+
+    for ( size_t i = tape->first( index ); i < tape->end( index ); i = tape->next( i + 1 ) ) {
+        Member member;
+        member.key = tape->string( i, member.length );
+        member.value = i + 1;
+        members.push_back( member );
+    }
+    if ( members.size() - base < 2 ) return members.size() - base;
+
+    std::sort( members.begin() + base, members.end(), memberLess );
+
+    size_t kept = base;
+    for ( size_t i = base; i < members.size(); i++ ) {
+        if ( i + 1 < members.size()
+            && !compareKey( members[i].key, members[i].length, members[i + 1].key, members[i + 1].length ) ) continue;
+        members[kept++] = members[i];
+    }
+    members.resize( kept );
+    return kept - base;
+}
+
+bool TrpTapeValidator::validateValue( const TrpSchema* schema, size_t index, TrpValidatorContext& ctx ) {
+    if ( !schema ) return false;
+
+    TrpJsonType type = tape->type( index );
+
+    switch (schema->getType()) {
+        case SCHEMA_STRING: {
+            if ( type != TRP_STRING ) break;
+            size_t length;
+            const char* str = tape->string( index, length );
+            return static_cast<const TrpSchemaString*>(schema)->checkString( str, length, ctx );
+        }
+        case SCHEMA_NUMBER:
+            if ( type != TRP_NUMBER ) break;
+            return static_cast<const TrpSchemaNumber*>(schema)->checkNumber( tape->number( index ), ctx );
+        case SCHEMA_BOOLEAN:
+            if ( type != TRP_BOOL ) break;
+            return static_cast<const TrpSchemaBool*>(schema)->checkValue( tape->boolean( index ), ctx );
+        case SCHEMA_NULL:
+            if ( type != TRP_NULL ) break;
+            return true;
+        case SCHEMA_OBJECT:
+            if ( type != TRP_OBJECT ) break;
+            return validateObject( static_cast<const TrpSchemaObject*>(schema), index, ctx );
+        case SCHEMA_ARRAY:
+            if ( type != TRP_ARRAY ) break;
+            return validateArray( static_cast<const TrpSchemaArray*>(schema), index, ctx );
+        case SCHEMA_UNION:
+            return validateUnion( static_cast<const TrpSchemaUnion*>(schema), index, ctx );
+        default:
+            // a schema type only the DOM validators know
+            return true;
+    }
+
+    ctx.pushTypeError( schema, schema->getType(), type );
+    return false;
+}
+
+// The merge walk of TrpSchemaObject::validateMembers() over the sorted members
+bool TrpTapeValidator::validateObject( const TrpSchemaObject* schema, size_t index, TrpValidatorContext& ctx ) {
+    const std::map<std::string, TrpSchema*>& properties = schema->getProperties();
+    const std::vector<bool>& required = schema->getRequiredMask();
+    size_t base = members.size();
+    size_t size = collectMembers( index );
+    bool got_errors = false;
+    bool stop = false;
+
+    if ( !schema->checkSize( size, ctx ) ) {
+        got_errors = true;
+        stop = !ctx.shouldContinue();
+    }
+
+    std::map<std::string, TrpSchema*>::const_iterator it = properties.begin();
+    size_t j = base;
+
+    for ( size_t k = 0; !stop && it != properties.end(); ) {
+        int diff = j == base + size ? -1
+            : compareKey( it->first.data(), it->first.size(), members[j].key, members[j].length );
+
+        if ( diff > 0 ) {
+            j++;
+            continue;
+        }
+
+        if ( diff < 0 ) {
+            if ( required[k] ) {
+                schema->reportMissing( it->first, ctx );
+                got_errors = true;
+            }
+        } else {
+            ctx.pushKey( it->first );
+            if ( !validateValue( it->second, members[j].value, ctx ) ) got_errors = true;
+            ctx.popPath();
+            j++;
+        }
+        if ( got_errors && !ctx.shouldContinue() ) stop = true;
+        it++;
+        k++;
+    }
+
+    members.resize( base );
+    if ( got_errors ) return false;
+    return true;
+}
+
+bool TrpTapeValidator::validateArray( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx ) {
+    const SchemaVec& tuple = schema->getTuple();
+    size_t size = tape->count( index );
+    bool got_error = false;
+
+    if ( !schema->checkSize( size, ctx ) ) {
+        got_error = true;
+        if ( !ctx.shouldContinue() ) return false;
+    }
+
+    const TrpSchema* item = schema->getItem();
+    if ( item && item->getType() == SCHEMA_NUMBER ) {
+        if ( !validateNumbers( static_cast<const TrpSchemaNumber*>(item), index, ctx ) ) {
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        }
+    } else if ( item ) {
+        size_t i = 0;
+        for ( size_t pos = tape->first( index ); pos < tape->end( index ); pos = tape->next( pos ), i++ ) {
+            ctx.pushIndex( i );
+            if ( !validateValue( item, pos, ctx ) ) got_error = true;
+            ctx.popPath();
+            if ( got_error && !ctx.shouldContinue() ) return false;
+        }
+    }
+
+    if ( !tuple.empty() ) {
+        if ( !schema->checkTupleSize( size, ctx ) ) {
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        } else {
+            size_t pos = tape->first( index );
+            for ( size_t i = 0; i < tuple.size() && i < size; i++, pos = tape->next( pos ) ) {
+                ctx.pushIndex( i );
+                if ( !validateValue( tuple[i], pos, ctx ) ) got_error = true;
+                ctx.popPath();
+                if ( got_error && !ctx.shouldContinue() ) return false;
+            }
+        }
+    }
+
+    if ( schema->isUniq() && !checkUniq( schema, index, ctx ) ) got_error = true;
+
+    if ( got_error ) return false;
+    return true;
+}
+
+#define TRP_TAPE_RUN 64
+
+// TrpSchemaNumber::validateItems() over the tape: numbers sit one word after
+// their tag, so packing a run is a strided copy
+bool TrpTapeValidator::validateNumbers( const TrpSchemaNumber* item, size_t index, TrpValidatorContext& ctx ) {
+    double packed[TRP_TAPE_RUN];
+    size_t end = tape->end( index );
+    size_t i = 0;
+    bool got_error = false;
+
+    for ( size_t run = tape->first( index ); run < end; ) {
+        size_t pos = run;
+        size_t count = 0;
+
+        for ( ; pos < end && count < TRP_TAPE_RUN && tape->tag( pos ) == TAPE_NUMBER; pos += 2 ) {
+            packed[count++] = tape->number( pos );
+        }
+
+        // a run is cut short by anything but a number, which then fails alone
+        if ( count && item->acceptsAll( packed, count ) ) {
+            run = pos;
+            i += count;
+            continue;
+        }
+
+        if ( !count ) count = 1;
+        for ( ; count; count--, run = tape->next( run ), i++ ) {
+            ctx.pushIndex( i );
+            if ( !validateValue( item, run, ctx ) ) got_error = true;
+            ctx.popPath();
+            if ( got_error && !ctx.shouldContinue() ) return false;
+        }
+    }
+
+    if ( got_error ) return false;
+    return true;
+}
+
+bool TrpTapeValidator::validateUnion( const TrpSchemaUnion* schema, size_t index, TrpValidatorContext& ctx ) {
+    TrpJsonType type = tape->type( index );
+    TrpUnionPick found;
+    size_t branch = 0;
+
+    if ( type == TRP_OBJECT && schema->isTagged() ) {
+        const std::string& key = schema->getDiscriminator();
+        size_t tag = 0;
+
+        // the last occurrence, like the DOM keeps
+        for ( size_t i = tape->first( index ); i < tape->end( index ); i = tape->next( i + 1 ) ) {
+            size_t length;
+            const char* name = tape->string( i, length );
+            if ( !compareKey( name, length, key.data(), key.size() ) ) tag = i + 1;
+        }
+
+        if ( !tag ) {
+            found = schema->pickObject( TRP_ERROR, NULL, 0, ctx, branch );
+        } else if ( tape->type( tag ) != TRP_STRING ) {
+            found = schema->pickObject( tape->type( tag ), NULL, 0, ctx, branch );
+        } else {
+            size_t length;
+            const char* str = tape->string( tag, length );
+            found = schema->pickObject( TRP_STRING, str, length, ctx, branch );
+        }
+    } else {
+        found = schema->pickType( type, branch );
+        if ( found == UNION_NONE ) schema->reportType( type, ctx );
+    }
+
+    if ( found == UNION_BRANCH ) return validateValue( schema->getBranches()[branch], index, ctx );
+    if ( found == UNION_NONE ) return false;
+
+    // TrpSchemaUnion::tryBranches(), each candidate into a fail-fast scratch context
+    const std::vector<size_t>& candidates = schema->getCandidates( type );
+    TrpValidatorContext scratch( true );    // one per value, cleared per branch
+    size_t matches = 0;
+
+    for ( size_t i = 0; i < candidates.size() && matches < 2; i++ ) {
+        scratch.clear();
+        if ( validateValue( schema->getBranches()[candidates[i]], index, scratch ) ) {
+            matches++;
+            if ( schema->getMode() == UNION_ANY_OF ) return true;
+        }
+    }
+    return schema->reportTrial( matches, candidates.size(), ctx );
+}
+
+// Finalizer from splitmix64, as in TrpJsonHash
+static size_t mix( size_t h ) {
+    h ^= h >> 31;
+    h *= static_cast<size_t>(0x7fb5d329728ea185ULL);
+    h ^= h >> 27;
+    h *= static_cast<size_t>(0x81dadef4bc2dd44dULL);
+    h ^= h >> 33;
+    return h;
+}
+
+static size_t hashBytes( const char* data, size_t len, size_t seed ) {
+    size_t h = seed ^ static_cast<size_t>(0xcbf29ce484222325ULL) ^ len;
+
+    for ( size_t i = 0; i < len; i++ ) h = (h ^ static_cast<unsigned char>(data[i])) * static_cast<size_t>(0x100000001b3ULL);
+    return mix( h );
+}
+
+// Structural, object members combined order-independently, -0 like 0
+size_t TrpTapeValidator::hashValue( size_t index ) const {
+    switch (tape->tag( index )) {
+        case TAPE_NULL:
+            return mix( 1 );
+        case TAPE_TRUE:
+            return mix( 2 );
+        case TAPE_FALSE:
+            return mix( 3 );
+        case TAPE_NUMBER: {
+            double nbr = tape->number( index );
+            if ( nbr == 0 ) nbr = 0;
+            return hashBytes( reinterpret_cast<const char*>(&nbr), sizeof(nbr), TRP_NUMBER );
+        }
+        case TAPE_STRING: {
+            size_t length;
+            const char* str = tape->string( index, length );
+            return hashBytes( str, length, TRP_STRING );
+        }
+        case TAPE_ARRAY: {
+            size_t h = 0;
+            for ( size_t i = tape->first( index ); i < tape->end( index ); i = tape->next( i ) ) h = mix( h * 31 + hashValue( i ) );
+            return mix( (h ^ tape->count( index )) + TRP_ARRAY );
+        }
+        case TAPE_OBJECT: {
+            size_t sum = 0;
+            for ( size_t i = tape->first( index ); i < tape->end( index ); i = tape->next( i + 1 ) ) {
+                sum += mix( hashValue( i ) ^ (hashValue( i + 1 ) * 31) );
+            }
+            return mix( (sum ^ tape->count( index )) + TRP_OBJECT );
+        }
+        default:
+            return 0;
+    }
+}
+
+// trpJsonEqual() over the tape. Object members are matched by key, so the
+// order they were written in does not matter.
+bool TrpTapeValidator::equalValues( size_t a, size_t b ) const {
+    TrpTapeTag tag = tape->tag( a );
+
+    if ( tag != tape->tag( b ) ) return false;
+
+    switch (tag) {
+        case TAPE_NUMBER:
+            return tape->number( a ) == tape->number( b );
+        case TAPE_STRING: {
+            size_t a_len, b_len;
+            const char* a_str = tape->string( a, a_len );
+            const char* b_str = tape->string( b, b_len );
+            return !compareKey( a_str, a_len, b_str, b_len );
+        }
+        case TAPE_ARRAY: {
+            if ( tape->count( a ) != tape->count( b ) ) return false;
+            for ( size_t i = tape->first( a ), j = tape->first( b ); i < tape->end( a ); i = tape->next( i ), j = tape->next( j ) ) {
+                if ( !equalValues( i, j ) ) return false;
+            }
+            return true;
+        }
+        case TAPE_OBJECT: {
+            if ( tape->count( a ) != tape->count( b ) ) return false;
+            for ( size_t i = tape->first( a ); i < tape->end( a ); i = tape->next( i + 1 ) ) {
+                size_t a_len, b_len, found = 0;
+                const char* key = tape->string( i, a_len );
+
+                for ( size_t j = tape->first( b ); j < tape->end( b ); j = tape->next( j + 1 ) ) {
+                    const char* other = tape->string( j, b_len );
+                    if ( !compareKey( key, a_len, other, b_len ) ) found = j + 1;
+                }
+                if ( !found || !equalValues( i + 1, found ) ) return false;
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+// TrpSchemaArray::checkUniq() with tape positions instead of DOM nodes
+bool TrpTapeValidator::checkUniq( const TrpSchemaArray* schema, size_t index, TrpValidatorContext& ctx ) const {
+    size_t size = tape->count( index );
+    bool got_error = false;
+
+    if ( size < 2 ) return true;
+
+    size_t capacity = 4;
+    while ( capacity < size * 2 ) capacity <<= 1;
+    size_t mask = capacity - 1;
+
+    std::vector<size_t> slots( capacity, 0 );   // item + 1, 0 is empty
+    std::vector<size_t> hashes( size );
+    std::vector<size_t> positions( size );
+
+    size_t pos = tape->first( index );
+    for ( size_t i = 0; i < size; i++, pos = tape->next( pos ) ) {
+        size_t hash = hashValue( pos );
+        size_t slot = hash & mask;
+        bool is_duplicate = false;
+
+        hashes[i] = hash;
+        positions[i] = pos;
+        while ( slots[slot] ) {
+            size_t other = slots[slot] - 1;
+            if ( hashes[other] == hash && equalValues( positions[other], pos ) ) {
+                is_duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        if ( is_duplicate ) {
+            schema->reportDuplicate( i, ctx );
+            got_error = true;
+            if ( !ctx.shouldContinue() ) return false;
+        } else {
+            slots[slot] = i + 1;
+        }
+    }
+
+    if ( got_error ) return false;
+    return true;
+}
@@ -0,0 +1,126 @@
+#include "../include/TrpThreadPool.hpp"
+
+TrpThreadPool::TrpThreadPool( size_t _threads ) : queued(0), next(0), stopping(false) {
+    size_t count = _threads ? _threads : 1;
+
+    pthread_mutex_init( &lock, NULL );
+    pthread_cond_init( &changed, NULL );
+    pthread_key_create( &self, NULL );
+
+    queues.resize( count );
+    workers.resize( count );
+    threads.resize( count );
+    for ( size_t i = 0; i < count; i++ ) {
+        queues[i] = new Queue();
+        pthread_mutex_init( &queues[i]->lock, NULL );
+        workers[i].pool = this;
+        workers[i].index = i;
+    }
+    for ( size_t i = 0; i < count; i++ ) pthread_create( &threads[i], NULL, workerMain, &workers[i] );
+}
+
+TrpThreadPool::~TrpThreadPool() {
+    pthread_mutex_lock( &lock );
+    stopping = true;
+    pthread_cond_broadcast( &changed );
+    pthread_mutex_unlock( &lock );
+
+    for ( size_t i = 0; i < threads.size(); i++ ) pthread_join( threads[i], NULL );
+    for ( size_t i = 0; i < queues.size(); i++ ) {
+        pthread_mutex_destroy( &queues[i]->lock );
+        delete queues[i];
+    }
+
+    pthread_key_delete( self );
+    pthread_cond_destroy( &changed );
+    pthread_mutex_destroy( &lock );
+}
+
+void* TrpThreadPool::workerMain( void* arg ) {
+    Worker* worker = static_cast<Worker*>(arg);
+    TrpThreadPool& pool = *worker->pool;
+
+    pthread_setspecific( pool.self, worker );
+    for ( ;; ) {
+        pthread_mutex_lock( &pool.lock );
+        while ( !pool.queued && !pool.stopping ) pthread_cond_wait( &pool.changed, &pool.lock );
+        if ( !pool.queued ) {
+            pthread_mutex_unlock( &pool.lock );
+            return NULL;
+        }
+        pthread_mutex_unlock( &pool.lock );
+
+        pool.runOne( worker->index );
+    }
+}
+
+// Newest task of queue `home` first, then the oldest of the others.
+// Returns false when every queue was empty.
+bool TrpThreadPool::runOne( size_t home ) {
+    Slot slot;
+    bool found = false;
+
+    for ( size_t i = 0; i < queues.size() && !found; i++ ) {
+        Queue& queue = *queues[(home + i) % queues.size()];
+
+        pthread_mutex_lock( &queue.lock );
+        if ( !queue.slots.empty() ) {
+            if ( i == 0 ) {
+                slot = queue.slots.back();
+                queue.slots.pop_back();
+            } else {
+                slot = queue.slots.front();
+                queue.slots.pop_front();
+            }
+            found = true;
+        }
+        pthread_mutex_unlock( &queue.lock );
+    }
+    if ( !found ) return false;
+
+    pthread_mutex_lock( &lock );
+    queued--;
+    pthread_mutex_unlock( &lock );
+
+    slot.task->run();
+
+    pthread_mutex_lock( &lock );
+    if ( !--*slot.pending ) pthread_cond_broadcast( &changed );
+    pthread_mutex_unlock( &lock );
+    return true;
+}
+
+// A worker keeps its tasks for itself until someone steals them; tasks from
+// outside are dealt round robin. Queuing happens under `lock`, so `queued`
+// is counted before anyone can take the tasks.
+void TrpThreadPool::run( TrpTask** tasks, size_t count ) {
+    Worker* worker = static_cast<Worker*>(pthread_getspecific( self ));
+    size_t pending = count;
+
+    if ( !count ) return;
+
+    pthread_mutex_lock( &lock );
+    size_t home = worker ? worker->index : next++ % queues.size();
+
+    for ( size_t i = 0; i < count; i++ ) {
+        Queue& queue = *queues[worker ? home : (home + i) % queues.size()];
+        Slot slot;
+
+        slot.task = tasks[i];
+        slot.pending = &pending;
+        pthread_mutex_lock( &queue.lock );
+        queue.slots.push_back( slot );
+        pthread_mutex_unlock( &queue.lock );
+    }
+    queued += count;
+    pthread_cond_broadcast( &changed );
+
+    for ( ;; ) {
+        while ( pending && !queued ) pthread_cond_wait( &changed, &lock );
+        if ( !pending ) break;
+        pthread_mutex_unlock( &lock );
+        runOne( home );
+        pthread_mutex_lock( &lock );
+    }
+    pthread_mutex_unlock( &lock );
+}
@@ -1,43 +1,596 @@
 #include "../include/TrpValidatorContext.hpp"
+#include "../include/TrpSchema.hpp"
+#include "../include/tokenTypeToString.hpp"
+#include "../include/TrpThreadPool.hpp"
+#include "../include/TrpStringFormat.hpp"
+#include "../include/TrpProfiler.hpp"
+#include <cstdlib>
 
-TrpValidatorContext::TrpValidatorContext( void ) {}
+TrpValidatorContext::TrpValidatorContext( bool _fail_fast, size_t _max_errors )
+    : fail_fast(_fail_fast), max_errors(_max_errors), path_format(PATH_DOTTED),
+    memo_enabled(false), memo_count(0), memo_hits(0), memo_misses(0), memo_depth(0),
+    document_hashes(NULL), pool(NULL), parallel_min(TRP_PARALLEL_MIN_ITEMS),
+    split_state(NULL), split_range(0), profiler(NULL) {
+}
+
+// Room for a typical depth on the first push, so a context that never
+// enters a container (a union trial on a scalar) never allocates
+static inline void reservePath( TrpValidationPath& paths ) {
+    if ( !paths.capacity() ) paths.reserve( 32 );
+}
+
+static TrpJsonType schemaToJsonType( SchemaType type ) {
+    switch (type) {
+        case SCHEMA_STRING: return TRP_STRING;
+        case SCHEMA_NUMBER: return TRP_NUMBER;
+        case SCHEMA_BOOLEAN: return TRP_BOOL;
+        case SCHEMA_OBJECT: return TRP_OBJECT;
+        case SCHEMA_ARRAY: return TRP_ARRAY;
+        case SCHEMA_NULL: return TRP_NULL;
+        default: return TRP_ERROR;
+    }
+}
+
+static const char* schemaTypeName( SchemaType type ) {
+    switch (type) {
+        case SCHEMA_STRING: return "string";
+        case SCHEMA_NUMBER: return "number";
+        case SCHEMA_BOOLEAN: return "boolean";
+        case SCHEMA_OBJECT: return "object";
+        case SCHEMA_ARRAY: return "array";
+        case SCHEMA_NULL: return "null";
+        case SCHEMA_UNION: return "union";
+        default: return "any";
+    }
+}
+
+// "string or number" from a mask of TrpJsonType bits
+static std::string unionTypes( unsigned int mask ) {
+    static const char* names[] = { "null", "boolean", "number", "string", "array", "object" };
+    std::string out;
+
+    for ( unsigned int t = 0; t < sizeof(names) / sizeof(names[0]); t++ ) {
+        if ( !(mask & (1u << t)) ) continue;
+        if ( !out.empty() ) out += " or ";
+        out += names[t];
+    }
+    return out.empty() ? "nothing" : out;
+}
+
+void TrpValidatorContext::pushKey( const std::string& _key ) {
+    TrpPathSegment seg;
+
+    seg.kind = PATH_KEY;
+    seg.index = 0;
+    seg.key = &_key;
+    reservePath( paths );
+    paths.push_back( seg );
+    if ( profiler ) profiler->enterKey( _key );
+}
+
+void TrpValidatorContext::pushIndex( size_t _index ) {
+    TrpPathSegment seg;
+
+    seg.kind = PATH_INDEX;
+    seg.index = _index;
+    seg.key = NULL;
+    reservePath( paths );
+    paths.push_back( seg );
+    if ( profiler ) profiler->enterIndex();
+}
 
 void TrpValidatorContext::pushPath( const std::string _path ) {
-    if ( _path.empty() ) return;
-    paths.push_back( _path );
+    size_t last = _path.size() - 1;
+
+    if ( _path.size() > 2 && _path[0] == '[' && _path[last] == ']'
+        && _path.find_first_not_of( "0123456789", 1 ) == last ) {
+        pushIndex( std::strtoul( _path.c_str() + 1, NULL, 10 ) );
+        return;
+    }
+    pushKey( *path_keys.insert( !_path.empty() && _path[0] == '.' ? _path.substr( 1 ) : _path ).first );
 }
 
 void TrpValidatorContext::popPath( void ) {
     if ( paths.empty() ) return;
     paths.pop_back();
+    if ( profiler ) profiler->leave();
+}
+
+// Returns NULL once the error budget is spent. Constraint errors default to
+// "found what the schema expects": only type errors have a different actual.
+TrpErrorRecord* TrpValidatorContext::newRecord( TrpErrorCode code, const TrpSchema* schema ) {
+    return newRecord( code, schema, schema ? schema->getType() : SCHEMA_ANY );
+}
+
+TrpErrorRecord* TrpValidatorContext::newRecord( TrpErrorCode code, const TrpSchema* schema, SchemaType expected ) {
+    if ( profiler ) profiler->countError();
+    if ( !shouldContinue() ) return NULL;
+
+    TrpErrorRecord record;
+    record.code = code;
+    record.expected = expected;
+    record.actual = schemaToJsonType( record.expected );
+    record.schema = schema;
+    record.key = NULL;
+    record.limit = 0;
+    record.value = 0;
+    record.path_first = error_paths.size();
+    record.path_length = paths.size();
+    error_paths.insert( error_paths.end(), paths.begin(), paths.end() );
+
+    records.push_back( record );
+    return &records.back();
 }
 
 void TrpValidatorContext::pushError( ValidationError err ) {
-    errors.push_back( err );
+    TrpErrorRecord* record = newRecord( ERR_CUSTOM, NULL );
+    if ( !record ) return;
+
+    record->expected = err.expected;
+    record->actual = err.actual;
+    record->path_first = custom.size();
+    record->path_length = 0;
+    custom.push_back( err );
+}
+
+void TrpValidatorContext::pushError( TrpErrorCode code, const TrpSchema* schema, double limit, double value ) {
+    TrpErrorRecord* record = newRecord( code, schema );
+    if ( !record ) return;
+
+    record->limit = limit;
+    record->value = value;
+}
+
+void TrpValidatorContext::pushError( TrpErrorCode code, const TrpSchema* schema, const std::string& key ) {
+    TrpErrorRecord* record = newRecord( code, schema );
+    if ( !record ) return;
+
+    record->key = &key;
+}
+
+void TrpValidatorContext::pushTypeError( const TrpSchema* schema, SchemaType expected, TrpJsonType actual ) {
+    TrpErrorRecord* record = newRecord( ERR_TYPE, schema );
+    if ( !record ) return;
+
+    record->expected = expected;
+    record->actual = actual;
+}
+
+void TrpValidatorContext::pushMissing( const TrpSchema* schema, const std::string& key ) {
+    TrpErrorRecord* record = newRecord( ERR_MISSING_PROPERTY, schema );
+    if ( !record ) return;
+
+    record->key = &key;
+}
+
+void TrpValidatorContext::pushPattern( const TrpSchema* schema, const std::string& pattern ) {
+    TrpErrorRecord* record = newRecord( ERR_STRING_PATTERN, schema );
+    if ( !record ) return;
+
+    record->key = &pattern;
+}
+
+void TrpValidatorContext::pushError( TrpErrorCode code, SchemaType expected, double limit, double value ) {
+    TrpErrorRecord* record = newRecord( code, NULL, expected );
+    if ( !record ) return;
+
+    record->limit = limit;
+    record->value = value;
+}
+
+void TrpValidatorContext::pushError( TrpErrorCode code, SchemaType expected, const std::string& key ) {
+    TrpErrorRecord* record = newRecord( code, NULL, expected );
+    if ( !record ) return;
+
+    record->key = &key;
+}
+
+void TrpValidatorContext::pushTypeError( SchemaType expected, TrpJsonType actual ) {
+    TrpErrorRecord* record = newRecord( ERR_TYPE, NULL, expected );
+    if ( !record ) return;
+
+    record->actual = actual;
+}
+
+void TrpValidatorContext::clear( void ) {
+    records.clear();
+    error_paths.clear();
+    custom.clear();
+    errors.clear();
+    paths.clear();
+    path_keys.clear();
+}
+
+// The first record dropped of each kind is where its path, or its custom
+// error, starts
+void TrpValidatorContext::dropErrors( size_t count ) {
+    for ( size_t i = records.size(); i-- > count; ) {
+        if ( records[i].code == ERR_CUSTOM ) custom.resize( records[i].path_first );
+        else error_paths.resize( records[i].path_first );
+    }
+    if ( records.size() > count ) records.resize( count );
+    if ( errors.size() > count ) errors.resize( count );
+}
+
+void TrpValidatorContext::enableMemo( bool _enabled ) {
+    memo_enabled = _enabled;
+}
+
+void TrpValidatorContext::setDocumentHashes( TrpJsonHashCache* hashes ) {
+    document_hashes = hashes;
+}
+
+void TrpValidatorContext::clearMemo( void ) {
+    memo.clear();
+    memo_count = 0;
+    memo_hits = memo_misses = 0;
+}
+
+static size_t memoSlot( const TrpSchema* schema, size_t hash, size_t mask ) {
+    return (hash ^ (reinterpret_cast<size_t>(schema) * 0x9e3779b97f4a7c15ULL)) & mask;
+}
+
+// Takes the bytes out of `entry`. A value equal to one already there is
+// not stored twice.
+void TrpValidatorContext::memoInsert( TrpMemoEntry& entry ) {
+    if ( (memo_count + 1) * 2 > memo.size() ) {
+        std::vector<TrpMemoEntry> old;
+        TrpMemoEntry empty = { NULL, 0, std::string() };
+
+        old.swap( memo );
+        memo.assign( old.empty() ? 64 : old.size() * 2, empty );
+        memo_count = 0;
+        for ( size_t i = 0; i < old.size(); i++ ) {
+            if ( old[i].schema ) memoInsert( old[i] );
+        }
+    }
+
+    size_t mask = memo.size() - 1;
+    size_t pos = memoSlot( entry.schema, entry.hash, mask );
+    while ( memo[pos].schema ) {
+        if ( memo[pos].schema == entry.schema && memo[pos].hash == entry.hash && memo[pos].value == entry.value ) return;
+        pos = (pos + 1) & mask;
+    }
+    memo[pos].schema = entry.schema;
+    memo[pos].hash = entry.hash;
+    memo[pos].value.swap( entry.value );
+    memo_count++;
+}
+
+// The first container hashed fills hash_cache for its whole subtree, so the
+// nested lookups cost one probe each. The cache is dropped when the
+// outermost bracket closes, before the document can go away. Hashes given
+// with setDocumentHashes() belong to the parser and are left alone. A hash
+// hit is only a hit once the value matches the stored copy; values that
+// collide keep probing, and each gets an entry of its own.
+bool TrpValidatorContext::memoEnter( const TrpSchema* schema, ITrpJsonValue* value, size_t& hash ) {
+    hash = 0;
+    if ( !value || (value->getType() != TRP_OBJECT && value->getType() != TRP_ARRAY) ) {
+        memo_depth++;
+        return false;
+    }
+
+    if ( document_hashes ) {
+        if ( !document_hashes->find( value, hash ) ) hash = trpJsonHash( value, *document_hashes );
+    } else {
+        hash = trpJsonHash( value, hash_cache );
+    }
+    if ( !memo.empty() ) {
+        size_t mask = memo.size() - 1;
+        for ( size_t pos = memoSlot( schema, hash, mask ); memo[pos].schema; pos = (pos + 1) & mask ) {
+            if ( memo[pos].schema == schema && memo[pos].hash == hash && trpJsonEqualEncoded( value, memo[pos].value ) ) {
+                memo_hits++;
+                if ( !memo_depth ) hash_cache.clear();
+                return true;
+            }
+        }
+    }
+
+    memo_misses++;
+    memo_depth++;
+    return false;
+}
+
+void TrpValidatorContext::memoLeave( const TrpSchema* schema, ITrpJsonValue* value, size_t hash, bool valid ) {
+    if ( valid && value && (value->getType() == TRP_OBJECT || value->getType() == TRP_ARRAY) ) {
+        TrpMemoEntry entry = { schema, hash, std::string() };
+
+        trpJsonEncode( value, entry.value );
+        memoInsert( entry );
+    }
+    if ( memo_depth && !--memo_depth ) hash_cache.clear();
 }
 
-std::string TrpValidatorContext::getCurrentPath( void ) {
+static void appendIndex( std::string& out, size_t nbr ) {
+    char buf[24];
+    size_t len = 0;
+
+    do {
+        buf[len++] = '0' + (nbr % 10);
+        nbr /= 10;
+    } while ( nbr );
+
+    while ( len ) out += buf[--len];
+}
+
+// RFC 6901: '~' is written as "~0" and '/' as "~1"
+static void appendPointerKey( std::string& out, const std::string& key ) {
+    for ( size_t i = 0; i < key.size(); i++ ) {
+        if ( key[i] == '~' ) out += "~0";
+        else if ( key[i] == '/' ) out += "~1";
+        else out += key[i];
+    }
+}
+
+std::string TrpValidatorContext::getCurrentPath( void ) const {
+    return getCurrentPath( path_format );
+}
+
+std::string TrpValidatorContext::getCurrentPath( TrpPathFormat _format ) const {
     std::string full_path;
 
-    for (TrpValidationPath::iterator it = paths.begin(); it != paths.end(); it ++) {
-        full_path += *it;
+    if ( !paths.empty() ) appendPath( full_path, &paths[0], paths.size(), _format );
+    return full_path;
+}
+
+void TrpValidatorContext::appendPath( std::string& out, const TrpPathSegment* first, size_t length, TrpPathFormat _format ) const {
+    for ( const TrpPathSegment* it = first; it != first + length; it++ ) {
+        if ( _format == PATH_POINTER ) {
+            out += '/';
+            if ( it->kind == PATH_KEY ) appendPointerKey( out, *it->key );
+            else appendIndex( out, it->index );
+        } else if ( it->kind == PATH_KEY ) {
+            out += '.';
+            out += *it->key;
+        } else {
+            out += '[';
+            appendIndex( out, it->index );
+            out += ']';
+        }
     }
+}
 
+std::string TrpValidatorContext::formatPath( const TrpErrorRecord& record ) const {
+    return formatPath( record, path_format );
+}
+
+std::string TrpValidatorContext::formatPath( const TrpErrorRecord& record, TrpPathFormat _format ) const {
+    std::string full_path;
+
+    if ( record.code == ERR_CUSTOM ) return custom[record.path_first].path;
+    if ( record.path_length ) appendPath( full_path, &error_paths[record.path_first], record.path_length, _format );
     return full_path;
 }
 
+// Limits are doubles; integral ones print without exponent or decimals
+static std::string numberToString( double nbr ) {
+    std::stringstream oss;
+    oss.precision( 15 );
+    oss << nbr;
+
+    return oss.str();
+}
+
+std::string TrpValidatorContext::formatMessage( const TrpErrorRecord& record ) const {
+    std::string limit = numberToString( record.limit );
+    std::string value = numberToString( record.value );
+
+    switch (record.code) {
+        case ERR_CUSTOM:
+            return custom[record.path_first].msg;
+        case ERR_TYPE:
+            return std::string("Expected ") + schemaTypeName( record.expected )
+                + ", found " + tokenTypeToString( record.actual );
+        case ERR_STRING_TOO_LONG:
+            return "String size should be at most " + limit + " chars, but got " + value;
+        case ERR_STRING_TOO_SHORT:
+            return "String size should be at least " + limit + " chars, but got " + value;
+        case ERR_STRING_FORMAT:
+            return std::string("String is not a valid ") + trpFormatName( static_cast<TrpStringFormat>(record.limit) );
+        case ERR_STRING_PATTERN:
+            return "String does not match pattern '" + *record.key + "'";
+        case ERR_ENUM:
+            if ( record.limit == 1 ) return "Value does not equal the schema constant";
+            return "Value is not one of the " + limit + " allowed values";
+        case ERR_NUMBER_TOO_LARGE:
+            return "Number exceeds maximum value of " + limit;
+        case ERR_NUMBER_TOO_SMALL:
+            return "Number is below minimum value of " + limit;
+        case ERR_NUMBER_NOT_BELOW:
+            return "Number must be less than " + limit;
+        case ERR_NUMBER_NOT_ABOVE:
+            return "Number must be greater than " + limit;
+        case ERR_NUMBER_NOT_INTEGER:
+            return "Number must be an integer, but got " + value;
+        case ERR_NUMBER_NOT_MULTIPLE:
+            return "Number must be a multiple of " + limit;
+        case ERR_ARRAY_TOO_LONG:
+            return "Array must contain at most " + limit + " items, but got " + value;
+        case ERR_ARRAY_TOO_SHORT:
+            return "Array must contain at least " + limit + " items, but got " + value;
+        case ERR_TUPLE_SIZE:
+            return "Tuple array must have exactly " + limit + " items, but has " + value;
+        case ERR_DUPLICATE_ITEM:
+            return "Duplicate item found in array, Items must be unique";
+        case ERR_OBJECT_TOO_SMALL:
+            return "Object must have at least " + limit + " properties, but has " + value;
+        case ERR_OBJECT_TOO_LARGE:
+            return "Object must have at most " + limit + " properties, but has " + value;
+        case ERR_MISSING_PROPERTY:
+            return "Required property '" + *record.key + "' is missing";
+        case ERR_UNION_TYPE:
+            return "Expected " + unionTypes( static_cast<unsigned int>(record.limit) )
+                + ", found " + tokenTypeToString( static_cast<TrpJsonType>(record.value) );
+        case ERR_UNION_TAG:
+            return "Property '" + *record.key + "' does not select a branch of the union";
+        case ERR_UNION_NO_MATCH:
+            return "Value matches none of the " + limit + " candidate branches";
+        case ERR_UNION_AMBIGUOUS:
+            return "Value matches more than one branch of oneOf";
+    }
+    return "Unknown error";
+}
+
+void TrpValidatorContext::setPathFormat( TrpPathFormat _format ) {
+    path_format = _format;
+    errors.clear();
+}
+
+bool TrpValidatorContext::shouldContinue( void ) const {
+    if ( fail_fast && !records.empty() ) return false;
+    if ( max_errors && records.size() >= max_errors ) return false;
+    return true;
+}
+
+bool TrpValidatorContext::isFailFast( void ) const {
+    return fail_fast;
+}
+
+size_t TrpValidatorContext::getMaxErrors( void ) const {
+    return max_errors;
+}
+
+// Renders the records not rendered by a previous call
 const TrpValidationError& TrpValidatorContext::getErrors( void ) const {
+    for ( size_t i = errors.size(); i < records.size(); i++ ) {
+        ValidationError err;
+
+        err.path = formatPath( records[i] );
+        err.msg = formatMessage( records[i] );
+        err.expected = records[i].expected;
+        err.actual = records[i].actual;
+        errors.push_back( err );
+    }
     return errors;
 }
 
 bool TrpValidatorContext::printErrors( void ) const {
-    bool got_errors = !errors.empty();
-    for (size_t i = 0; i < errors.size(); i++) {
+    bool got_errors = !records.empty();
+    for (size_t i = 0; i < records.size(); i++) {
         std::cerr
-            << errors[i].path
+            << formatPath( records[i] )
             << ": "
-            << errors[i].msg
+            << formatMessage( records[i] )
             << std::endl;
     }
     return got_errors;
-}
\ No newline at end of file
+}
+
+struct TrpSplitState {
+    const TrpValidatorContext* owner;
+    pthread_mutex_t lock;
+    size_t stop;                // ranges after this one are not needed
+};
+
+class TrpSplitTask : public TrpTask {
+    public:
+        const TrpSplitBody* body;
+        TrpValidatorContext* ctx;
+        TrpSplitState* state;
+        size_t range;
+        size_t first, last;
+        bool valid;
+
+        TrpSplitTask( void ) : body(NULL), ctx(NULL), state(NULL), range(0), first(0), last(0), valid(true) {}
+
+        void run( void ) {
+            if ( ctx->isCancelled() ) return;
+
+            valid = body->validateRange( first, last, *ctx );
+            if ( ctx->shouldContinue() ) return;
+
+            // this range alone spent the budget, the later ones cannot add anything
+            pthread_mutex_lock( &state->lock );
+            if ( range < state->stop ) state->stop = range;
+            pthread_mutex_unlock( &state->lock );
+        }
+};
+
+void TrpValidatorContext::setThreadPool( TrpThreadPool* _pool, size_t _min_items ) {
+    pool = _pool;
+    parallel_min = _min_items ? _min_items : 1;
+}
+
+bool TrpValidatorContext::isCancelled( void ) const {
+    if ( !split_state ) return false;
+
+    pthread_mutex_lock( &split_state->lock );
+    bool cancelled = split_range > split_state->stop;
+    pthread_mutex_unlock( &split_state->lock );
+
+    return cancelled || split_state->owner->isCancelled();
+}
+
+// A few ranges per thread, so stealing evens out uneven members. Ranges are
+// merged in order, and only while the budget lasts, which is what the
+// sequential walk would have recorded.
+bool TrpValidatorContext::split( const TrpSplitBody& body, size_t count ) {
+    size_t ranges = pool->size() * 4;
+    if ( ranges > count ) ranges = count;
+    if ( ranges < 2 ) return body.validateRange( 0, count, *this );
+
+    TrpSplitState state;
+    state.owner = this;
+    state.stop = ranges;
+    pthread_mutex_init( &state.lock, NULL );
+
+    std::vector<TrpValidatorContext> contexts( ranges, TrpValidatorContext( fail_fast, max_errors ) );
+    std::vector<TrpSplitTask> tasks( ranges );
+    std::vector<TrpTask*> queue( ranges );
+
+    for ( size_t i = 0; i < ranges; i++ ) {
+        TrpValidatorContext& range = contexts[i];
+
+        range.path_format = path_format;
+        range.paths = paths;
+        range.pool = pool;
+        range.parallel_min = parallel_min;
+        range.split_state = &state;
+        range.split_range = i;
+
+        tasks[i].body = &body;
+        tasks[i].ctx = &range;
+        tasks[i].state = &state;
+        tasks[i].range = i;
+        tasks[i].first = count * i / ranges;
+        tasks[i].last = count * (i + 1) / ranges;
+        queue[i] = &tasks[i];
+    }
+
+    pool->run( &queue[0], ranges );
+
+    bool valid = true;
+    for ( size_t i = 0; i < ranges; i++ ) {
+        if ( !tasks[i].valid ) valid = false;
+        merge( contexts[i] );
+    }
+
+    pthread_mutex_destroy( &state.lock );
+    return valid;
+}
+
+// The range's paths already start with ours
+void TrpValidatorContext::merge( const TrpValidatorContext& range ) {
+    size_t base = error_paths.size();
+
+    error_paths.insert( error_paths.end(), range.error_paths.begin(), range.error_paths.end() );
+    // keys the range copied in pushPath() go away with it
+    for ( size_t i = base; i < error_paths.size() && !range.path_keys.empty(); i++ ) {
+        TrpPathSegment& seg = error_paths[i];
+        if ( seg.kind != PATH_KEY ) continue;
+
+        std::set<std::string>::const_iterator it = range.path_keys.find( *seg.key );
+        if ( it != range.path_keys.end() && &*it == seg.key ) seg.key = &*path_keys.insert( *it ).first;
+    }
+    for ( size_t i = 0; i < range.records.size() && shouldContinue(); i++ ) {
+        TrpErrorRecord record = range.records[i];
+
+        if ( record.code == ERR_CUSTOM ) {
+            custom.push_back( range.custom[record.path_first] );
+            record.path_first = custom.size() - 1;
+        } else {
+            record.path_first += base;
+        }
+        records.push_back( record );
+    }
+}
@@ -0,0 +1,201 @@
+#include "../include/TrpValueSet.hpp"
+#include <algorithm>
+#include <cstring>
+
+#define TRP_SET_MAX_DISPLACE 65536
+// seeds tried before falling back to a sorted lookup
+#define TRP_SET_MAX_SEEDS 32
+
+// Enum values are short: a word at a time, the tail assembled byte by byte
+// so nothing here calls out of line
+static uint64_t hashValue( const char* data, size_t size, size_t seed ) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    uint64_t h = (seed + 1) * 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t word;
+
+    for ( ; size >= sizeof(word); p += sizeof(word), size -= sizeof(word) ) {
+        std::memcpy( &word, p, sizeof(word) );
+        h = (h ^ word) * 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 29;
+    }
+    for ( word = 0; size; size-- ) word = (word << 8) | p[size - 1];
+    h = (h ^ word) * 0x94d049bb133111ebULL;
+    h ^= h >> 32;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    return h ^ (h >> 29);
+}
+
+// h mod `range` without a division: the top 32 bits scaled to the range
+static size_t reduce( uint64_t h, size_t range ) {
+    return static_cast<size_t>(((h >> 32) * static_cast<uint64_t>(range)) >> 32);
+}
+
+// Slot of a value with hash `h` in a bucket displaced by `d`
+static size_t displaced( uint64_t h, size_t d, size_t slots ) {
+    h ^= (d + 1) * 0x9e3779b97f4a7c15ULL;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 31;
+    return reduce( h, slots );
+}
+
+struct TrpSetBucket {
+    size_t index;
+    std::vector<size_t> values;
+};
+
+// biggest first, they are the hardest to place
+static bool bucketBefore( const TrpSetBucket* a, const TrpSetBucket* b ) {
+    if ( a->values.size() != b->values.size() ) return a->values.size() > b->values.size();
+    return a->index < b->index;
+}
+
+TrpValueSet::TrpValueSet( void ) : seed(0), hashed(true) {}
+
+void TrpValueSet::assign( const std::vector<std::string>& values ) {
+    std::vector<std::string> unique( values );
+
+    std::sort( unique.begin(), unique.end() );
+    unique.erase( std::unique( unique.begin(), unique.end() ), unique.end() );
+
+    // a seed only fails when two values share a full hash or a bucket
+    // cannot be placed, each try is a fresh draw
+    hashed = true;
+    for ( seed = 0; seed < TRP_SET_MAX_SEEDS; seed++ ) {
+        if ( build( unique ) ) return;
+    }
+
+    // no seed worked: the values in sorted order, found by binary search
+    hashed = false;
+    pool.clear();
+    offsets.clear();
+    displace.clear();
+    for ( size_t i = 0; i < unique.size(); i++ ) {
+        offsets.push_back( pool.size() );
+        pool += unique[i];
+    }
+    offsets.push_back( pool.size() );
+}
+
+// One bucket per value on average. Buckets of several values search for a
+// displacement that sends all of them to free slots; single values then
+// take the remaining slots directly.
+bool TrpValueSet::build( const std::vector<std::string>& values ) {
+    size_t count = values.size();
+    std::vector<uint64_t> hashes( count );
+
+    pool.clear();
+    offsets.clear();
+    displace.clear();
+    if ( !count ) return true;
+
+    for ( size_t i = 0; i < count; i++ ) hashes[i] = hashValue( values[i].data(), values[i].size(), seed );
+
+    std::vector<uint64_t> sorted( hashes );
+    std::sort( sorted.begin(), sorted.end() );
+    if ( std::adjacent_find( sorted.begin(), sorted.end() ) != sorted.end() ) return false;
+
+    std::vector<TrpSetBucket> buckets( count );
+    std::vector<TrpSetBucket*> order( count );
+    for ( size_t b = 0; b < count; b++ ) {
+        buckets[b].index = b;
+        order[b] = &buckets[b];
+    }
+    for ( size_t i = 0; i < count; i++ ) buckets[reduce( hashes[i], count )].values.push_back( i );
+    std::sort( order.begin(), order.end(), bucketBefore );
+
+    std::vector<size_t> slot_of( count );
+    std::vector<char> taken( count, 0 );
+    std::vector<size_t> slots;
+    size_t free_slot = 0;
+
+    displace.resize( count, 0 );
+    for ( size_t b = 0; b < count; b++ ) {
+        const TrpSetBucket& bucket = *order[b];
+
+        if ( bucket.values.empty() ) break;
+        if ( bucket.values.size() == 1 ) {
+            while ( taken[free_slot] ) free_slot++;
+            taken[free_slot] = 1;
+            slot_of[bucket.values[0]] = free_slot;
+            displace[bucket.index] = -1 - static_cast<int>(free_slot);
+            continue;
+        }
+
+        size_t d;
+        for ( d = 0; d < TRP_SET_MAX_DISPLACE; d++ ) {
+            size_t placed;
+
+            slots.clear();
+            for ( placed = 0; placed < bucket.values.size(); placed++ ) {
+                size_t slot = displaced( hashes[bucket.values[placed]], d, count );
+                if ( taken[slot] || std::find( slots.begin(), slots.end(), slot ) != slots.end() ) break;
+                slots.push_back( slot );
+            }
+            if ( placed == bucket.values.size() ) break;
+        }
+        if ( d == TRP_SET_MAX_DISPLACE ) return false;
+
+        for ( size_t i = 0; i < slots.size(); i++ ) {
+            taken[slots[i]] = 1;
+            slot_of[bucket.values[i]] = slots[i];
+        }
+        displace[bucket.index] = static_cast<int>(d);
+    }
+
+    std::vector<size_t> value_at( count );
+    for ( size_t i = 0; i < count; i++ ) value_at[slot_of[i]] = i;
+
+    offsets.resize( count + 1 );
+    for ( size_t slot = 0; slot < count; slot++ ) {
+        offsets[slot] = pool.size();
+        pool += values[value_at[slot]];
+    }
+    offsets[count] = pool.size();
+    return true;
+}
+
+// Slot `slot` against the probe: <0, 0 or >0 like memcmp, shorter first on a tie
+int TrpValueSet::compareSlot( size_t slot, const char* data, size_t size ) const {
+    size_t length = offsets[slot + 1] - offsets[slot];
+    int diff = std::memcmp( pool.data() + offsets[slot], data, length < size ? length : size );
+
+    if ( diff ) return diff;
+    return length < size ? -1 : length > size;
+}
+
+bool TrpValueSet::find( const char* data, size_t size, size_t& slot ) const {
+    if ( !hashed ) {
+        size_t lo = 0, hi = this->size();
+
+        while ( lo < hi ) {
+            size_t mid = lo + (hi - lo) / 2;
+            int diff = compareSlot( mid, data, size );
+
+            if ( !diff ) {
+                slot = mid;
+                return true;
+            }
+            if ( diff < 0 ) lo = mid + 1;
+            else hi = mid;
+        }
+        return false;
+    }
+    if ( displace.empty() ) return false;
+
+    size_t count = displace.size();
+    uint64_t h = hashValue( data, size, seed );
+    int d = displace[reduce( h, count )];
+    slot = d < 0 ? static_cast<size_t>(-1 - d) : displaced( h, d, count );
+
+    size_t first = offsets[slot];
+    return offsets[slot + 1] - first == size && !std::memcmp( pool.data() + first, data, size );
+}
+
+bool TrpValueSet::contains( const char* data, size_t size ) const {
+    size_t slot;
+    return find( data, size, slot );
+}
+
+std::string TrpValueSet::at( size_t slot ) const {
+    return pool.substr( offsets[slot], offsets[slot + 1] - offsets[slot] );
+}